@@ -70,6 +70,15 @@ data class IptvChannel(
     val logo: String = "",
 )
 
+/** One page of an iptv_channels_get answer; [nextCursor] fetches the next. */
+data class IptvChannelPage(
+    val playlistId: String,
+    val offset: Int,
+    val total: Int,
+    val channels: List<IptvChannel>,
+    val nextCursor: String?,
+)
+
 // ── History ───────────────────────────────────────────────────────────────────
 
 data class HistoryEntry(
@@ -2,16 +2,21 @@ package com.qaryxos.companion.data.ws
 
 import android.content.Context
 import com.google.gson.GsonBuilder
+import com.google.gson.JsonObject
 import com.google.gson.JsonParser
 import com.qaryxos.companion.data.models.HistoryEntry
 import com.qaryxos.companion.data.models.IptvChannel
+import com.qaryxos.companion.data.models.IptvChannelPage
 import com.qaryxos.companion.data.models.IptvPlaylist
 import com.qaryxos.companion.data.models.ServicesMsg
 import com.qaryxos.companion.data.models.StatusMsg
 import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.CoroutineStart
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.Job
 import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.async
+import kotlinx.coroutines.coroutineScope
 import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.MutableSharedFlow
 import kotlinx.coroutines.flow.MutableStateFlow
@@ -19,7 +24,9 @@ import kotlinx.coroutines.flow.SharedFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.asSharedFlow
 import kotlinx.coroutines.flow.asStateFlow
+import kotlinx.coroutines.flow.first
 import kotlinx.coroutines.launch
+import kotlinx.coroutines.withTimeoutOrNull
 import okhttp3.OkHttpClient
 import okhttp3.Request
 import okhttp3.Response
@@ -77,20 +84,26 @@ object WsClient {
     private val _status = MutableStateFlow<StatusMsg?>(null)
     val status: StateFlow<StatusMsg?> = _status.asStateFlow()
 
+    /** seq of the last status change applied to [status]. */
+    private var statusSeq = 0L
+
     private val _historyFlow = MutableSharedFlow<List<HistoryEntry>>(extraBufferCapacity = 1)
     val historyFlow: SharedFlow<List<HistoryEntry>> = _historyFlow.asSharedFlow()
 
     private val _playlistsFlow = MutableSharedFlow<List<IptvPlaylist>>(extraBufferCapacity = 1)
     val playlistsFlow: SharedFlow<List<IptvPlaylist>> = _playlistsFlow.asSharedFlow()
 
-    /** Emits (playlistId, channels) whenever iptv_channels response arrives.
-     *  playlistId may be empty if the request had no filter. */
-    private val _iptvChannelsFlow = MutableSharedFlow<Pair<String, List<IptvChannel>>>(extraBufferCapacity = 1)
-    val iptvChannelsFlow: SharedFlow<Pair<String, List<IptvChannel>>> = _iptvChannelsFlow.asSharedFlow()
+    /** Emits every page of iptv_channels answers. playlistId is empty if the
+     *  request had no playlist filter. */
+    private val _iptvChannelsFlow = MutableSharedFlow<IptvChannelPage>(extraBufferCapacity = 8)
+    val iptvChannelsFlow: SharedFlow<IptvChannelPage> = _iptvChannelsFlow.asSharedFlow()
 
     private val _errorFlow = MutableSharedFlow<String>(extraBufferCapacity = 4)
     val errorFlow: SharedFlow<String> = _errorFlow.asSharedFlow()
 
+    /** Acks of the streaming import (and errors, which end it). */
+    private val _importAcks = MutableSharedFlow<JsonObject>(extraBufferCapacity = 8)
+
     private val _servicesFlow = MutableStateFlow<ServicesMsg?>(null)
     val servicesFlow: StateFlow<ServicesMsg?> = _servicesFlow.asStateFlow()
 
@@ -149,6 +162,9 @@ object WsClient {
     fun seek(seconds: Double) = send(mapOf("cmd" to "seek", "seconds" to seconds))
     fun volume(level: Int)    = send(mapOf("cmd" to "volume", "level" to level))
 
+    /** Full status; sent on connect and whenever a status_delta arrives out of order. */
+    fun statusGet()           = send(mapOf("cmd" to "status_get"))
+
     // Navigation
     fun sendKey(key: String)      = send(mapOf("cmd" to "key", "key" to key))
     fun navigate(screen: String)  = send(mapOf("cmd" to "navigate", "screen" to screen))
@@ -162,13 +178,70 @@ object WsClient {
     fun playlistAdd(url: String, name: String)   = send(mapOf("cmd" to "playlist_add", "url" to url, "name" to name))
     fun playlistDel(id: String)                  = send(mapOf("cmd" to "playlist_del", "id" to id))
 
-    /** Request up to 500 channels for [playlistId] from the server. */
-    fun iptvChannelsGet(playlistId: String)      = send(mapOf("cmd" to "iptv_channels_get", "playlist_id" to playlistId))
+    /** Request the first [limit] channels of [playlistId]; the answer carries a
+     *  cursor for [iptvChannelsNext] if there are more. */
+    fun iptvChannelsGet(playlistId: String, limit: Int = 200) =
+        send(mapOf("cmd" to "iptv_channels_get", "playlist_id" to playlistId,
+                   "limit" to limit, "fields" to "id,name,url,group"))
+
+    /** Next page of an iptv_channels_get, from the same catalog snapshot. */
+    fun iptvChannelsNext(cursor: String, limit: Int = 200) =
+        send(mapOf("cmd" to "iptv_channels_get", "cursor" to cursor, "limit" to limit))
+
+    /** Search channel names across all playlists; cheap enough to send on every keystroke. */
+    fun iptvSearch(query: String, limit: Int = 50) =
+        send(mapOf("cmd" to "iptv_search", "query" to query, "limit" to limit))
 
     /** Import channels parsed locally from an M3U file (no HTTP download on server). */
     fun playlistImport(name: String, channels: List<Map<String, String>>) =
         send(mapOf("cmd" to "playlist_import", "name" to name, "channels" to channels))
 
+    /** Import a large file in batches of [batchSize] channels. Each batch waits
+     *  for the server's ack, so neither side ever holds more than one batch;
+     *  [onProgress] gets the channel count after each. Returns the final
+     *  count, or -1 if the server refused or stopped answering. */
+    suspend fun playlistImportStreaming(
+        name: String,
+        channels: List<Map<String, String>>,
+        batchSize: Int = 1000,
+        onProgress: (Int) -> Unit = {},
+    ): Int {
+        suspend fun request(msg: Map<String, Any>, match: (JsonObject) -> Boolean): JsonObject? =
+            withTimeoutOrNull(15_000) {
+                coroutineScope {
+                    // Subscribe before sending so the ack can't slip past
+                    val ack = async(start = CoroutineStart.UNDISPATCHED) {
+                        _importAcks.first { it.get("type")?.asString == "error" || match(it) }
+                    }
+                    send(msg)
+                    ack.await()
+                }
+            }?.takeIf { it.get("type")?.asString == "playlist_import" }
+
+        val begin = request(mapOf("cmd" to "playlist_import_begin", "name" to name)) {
+            it.get("seq")?.asInt == 0 && it.get("channel_count")?.asInt == 0
+        } ?: return -1
+        val id = begin.get("id").asString
+
+        var seq = 0
+        for (batch in channels.chunked(batchSize)) {
+            val s = ++seq
+            val ack = request(mapOf("cmd" to "playlist_import_batch", "id" to id,
+                                    "seq" to s, "channels" to batch)) {
+                it.get("id")?.asString == id && it.get("seq")?.asInt == s
+            }
+            if (ack == null) {
+                send(mapOf("cmd" to "playlist_import_abort", "id" to id))
+                return -1
+            }
+            onProgress(ack.get("channel_count").asInt)
+        }
+        val done = request(mapOf("cmd" to "playlist_import_commit", "id" to id)) {
+            it.get("id")?.asString == id && it.get("done")?.asBoolean == true
+        }
+        return done?.get("channel_count")?.asInt ?: -1
+    }
+
     // Services
     fun serviceGet()                             = send(mapOf("cmd" to "service_get"))
     fun serviceSet(name: String, enabled: Boolean) =
@@ -184,14 +257,36 @@ object WsClient {
         override fun onOpen(webSocket: WebSocket, response: Response) {
             _state.value = WsState.CONNECTED
             reconnectDelay = 2_000L   // reset backoff on successful connect
+            statusGet()               // the box only sends changes from here on
         }
 
         override fun onMessage(webSocket: WebSocket, text: String) {
             try {
                 val obj = JsonParser.parseString(text).asJsonObject
                 when (obj.get("type")?.asString) {
-                    "status" ->
+                    "status" -> {
+                        statusSeq = obj.get("seq")?.asLong ?: 0L
                         _status.tryEmit(gson.fromJson(obj, StatusMsg::class.java))
+                    }
+
+                    "status_delta" -> {
+                        // Same seq: position only; next seq: apply; else resync
+                        val seq = obj.get("seq")?.asLong ?: 0L
+                        val cur = _status.value
+                        if (cur == null || (seq != statusSeq && seq != statusSeq + 1)) {
+                            statusGet()
+                        } else {
+                            statusSeq = seq
+                            _status.value = cur.copy(
+                                state    = obj.get("state")?.asString      ?: cur.state,
+                                url      = obj.get("url")?.asString        ?: cur.url,
+                                position = obj.get("position")?.asDouble   ?: cur.position,
+                                duration = obj.get("duration")?.asDouble   ?: cur.duration,
+                                volume   = obj.get("volume")?.asInt        ?: cur.volume,
+                                paused   = obj.get("paused")?.asBoolean    ?: cur.paused,
+                            )
+                        }
+                    }
 
                     "history" -> {
                         val list = obj.getAsJsonArray("entries")
@@ -208,18 +303,28 @@ object WsClient {
                     }
 
                     "iptv_channels" -> {
-                        val plId = obj.get("playlist_id")?.asString ?: ""
                         val list = obj.getAsJsonArray("channels")
                             ?.map { gson.fromJson(it, IptvChannel::class.java) }
                             ?: emptyList()
-                        _iptvChannelsFlow.tryEmit(plId to list)
+                        _iptvChannelsFlow.tryEmit(IptvChannelPage(
+                            playlistId = obj.get("playlist_id")?.asString ?: "",
+                            offset     = obj.get("offset")?.asInt ?: 0,
+                            total      = obj.get("total")?.asInt ?: list.size,
+                            channels   = list,
+                            nextCursor = obj.get("next_cursor")?.asString,
+                        ))
                     }
 
                     "services" ->
                         _servicesFlow.value = gson.fromJson(obj, ServicesMsg::class.java)
 
-                    "error" ->
+                    "playlist_import" ->
+                        _importAcks.tryEmit(obj)
+
+                    "error" -> {
+                        _importAcks.tryEmit(obj)
                         _errorFlow.tryEmit(obj.get("msg")?.asString ?: "unknown error")
+                    }
                 }
             } catch (_: Exception) { /* ignore malformed frames */ }
         }
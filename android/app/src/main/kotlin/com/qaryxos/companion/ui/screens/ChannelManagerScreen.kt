@@ -7,6 +7,7 @@ import androidx.compose.foundation.clickable
 import androidx.compose.foundation.layout.*
 import androidx.compose.foundation.lazy.LazyColumn
 import androidx.compose.foundation.lazy.items
+import androidx.compose.foundation.lazy.rememberLazyListState
 import androidx.compose.material.icons.Icons
 import androidx.compose.material.icons.filled.*
 import androidx.compose.material3.*
@@ -137,6 +138,7 @@ private fun PlaylistListScreen(onOpenChannels: (IptvPlaylist) -> Unit) {
     var newUrl    by remember { mutableStateOf("") }
     var newName   by remember { mutableStateOf("") }
     var adding    by remember { mutableStateOf(false) }
+    var imported  by remember { mutableIntStateOf(0) }
     var addError  by remember { mutableStateOf<String?>(null) }
 
     LaunchedEffect(Unit) {
@@ -158,10 +160,15 @@ private fun PlaylistListScreen(onOpenChannels: (IptvPlaylist) -> Unit) {
                 if (channels.isEmpty()) {
                     addError = "Не удалось найти каналы в файле"
                 } else {
-                    WsClient.playlistImport(newName.ifBlank { "Imported" }, channels)
-                    kotlinx.coroutines.delay(600)
-                    WsClient.playlistsGet()
-                    newName = ""; showAdd = false
+                    imported = 0
+                    val count = WsClient.playlistImportStreaming(
+                        newName.ifBlank { "Imported" }, channels) { imported = it }
+                    if (count < 0) {
+                        addError = "Импорт не удался"
+                    } else {
+                        WsClient.playlistsGet()
+                        newName = ""; showAdd = false
+                    }
                 }
             } catch (e: Exception) {
                 addError = "Ошибка: ${e.message}"
@@ -239,7 +246,7 @@ private fun PlaylistListScreen(onOpenChannels: (IptvPlaylist) -> Unit) {
                             }
                             Icon(Icons.Default.FolderOpen, null)
                             Spacer(Modifier.width(8.dp))
-                            Text("Выбрать M3U файл")
+                            Text(if (adding && imported > 0) "Импорт: $imported" else "Выбрать M3U файл")
                         }
                     }
 
@@ -312,20 +319,41 @@ private fun PlaylistCard(
 private fun ChannelListScreen(playlist: IptvPlaylist, onBack: () -> Unit) {
     val scope = rememberCoroutineScope()
     var channels by remember { mutableStateOf<List<IptvChannel>>(emptyList()) }
+    var total    by remember { mutableIntStateOf(0) }
+    var cursor   by remember { mutableStateOf<String?>(null) }
     var loading  by remember { mutableStateOf(true) }
     var query    by remember { mutableStateOf("") }
+    val listState = rememberLazyListState()
 
     LaunchedEffect(playlist.id) {
         launch {
-            WsClient.iptvChannelsFlow.collect { (plId, list) ->
-                if (plId == playlist.id || plId.isEmpty()) {
-                    channels = list; loading = false
+            WsClient.iptvChannelsFlow.collect { page ->
+                if (page.playlistId != playlist.id && page.playlistId.isNotEmpty()) return@collect
+                when (page.offset) {
+                    0             -> channels = page.channels
+                    channels.size -> channels = channels + page.channels
+                    else          -> return@collect
                 }
+                total = page.total; cursor = page.nextCursor; loading = false
             }
         }
         WsClient.iptvChannelsGet(playlist.id)
     }
 
+    // Pages are fetched as the list scrolls to within 50 rows of its end
+    LaunchedEffect(listState) {
+        snapshotFlow {
+            val info = listState.layoutInfo
+            val nearEnd = (info.visibleItemsInfo.lastOrNull()?.index ?: 0) >= info.totalItemsCount - 50
+            Triple(nearEnd, cursor, loading)
+        }.collect { (nearEnd, next, busy) ->
+            if (nearEnd && !busy && next != null) {
+                loading = true
+                WsClient.iptvChannelsNext(next)
+            }
+        }
+    }
+
     val filtered = remember(channels, query) {
         if (query.isBlank()) channels
         else channels.filter {
@@ -344,7 +372,7 @@ private fun ChannelListScreen(playlist: IptvPlaylist, onBack: () -> Unit) {
                 Text(playlist.name, style = MaterialTheme.typography.titleMedium,
                     maxLines = 1, overflow = TextOverflow.Ellipsis)
                 if (!loading)
-                    Text("${filtered.size} / ${channels.size} каналов",
+                    Text("${filtered.size} / $total каналов",
                         style = MaterialTheme.typography.bodySmall,
                         color = MaterialTheme.colorScheme.onSurfaceVariant)
             }
@@ -366,6 +394,7 @@ private fun ChannelListScreen(playlist: IptvPlaylist, onBack: () -> Unit) {
         if (loading) LinearProgressIndicator(Modifier.fillMaxWidth())
 
         LazyColumn(
+            state             = listState,
             contentPadding    = PaddingValues(12.dp),
             verticalArrangement = Arrangement.spacedBy(6.dp),
         ) {
@@ -0,0 +1,671 @@
+/* IPTV catalog benchmark: parse, cache, load and query throughput/latency.
+ *
+ *   qaryx_bench_iptv [-p playlists] [-q queries] [-j] [channels...]
+ *
+ * For each channel count (default 1000 10000 100000) a synthetic M3U is
+ * split across the playlists and written to a scratch data dir: Cyrillic
+ * and Latin names, tokenised URLs of ~200 bytes, one group per ~20
+ * channels. Each size runs in its own process so peak RSS is its own.
+ *   parse   — the streaming M3U parser alone, over the files in memory
+ *   save    — one store holding every channel, sealed and written out
+ *   open    — the same cache mapped and verified again
+ *   add     — iptv_add_playlist() for every playlist, end to end
+ *             (file:// download → parse → store → index → cache)
+ *   boot    — iptv_load() from the binary caches (what a restart costs)
+ *   by_id   — iptv_get_channel() on random ids
+ *   by_url  — iptv_get_channel_by_url() on random URLs
+ *   groups  — pinning the catalog and listing its groups
+ *   group   — switching the IPTV screen to a random group: one catalog
+ *             query plus reading the rows that fit on screen
+ *   all     — same for "All channels"
+ *   search  — iptv_search() on random name prefixes, as typed
+ *   rss     — peak resident set of the run
+ * A second process per size serves the same playlists from a loopback
+ * HTTP responder (ETag, Last-Modified, 304 on a match, every response held
+ * back HTTP_DELAY_MS) and times iptv_refresh_all() three times:
+ *   r304    — nothing changed: every request must carry both validators
+ *             and get a 304
+ *   rnew    — one playlist changed on the server: only its cache is rewritten
+ *   rsame   — validators off: full bodies, the same bytes as before
+ * Each checks that unchanged playlists leave their .bin untouched (same
+ * mtime) and that no more than IPTV_REFRESH_PARALLEL downloads are ever
+ * open at once, and fails the run otherwise.
+ * Throughput lines give the time, items/s and MB/s; per-query lines give
+ * mean / p50 / p99 / max in microseconds. With -j every line is a JSON
+ * object instead, for scripts and CI. */
+
+#include "iptv.h"
+#include "iptv_store.h"
+#include "m3u.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define SCREEN_ROWS 16    /* rows the channel pane shows at 1080p */
+#define GROUP_SIZE  20    /* channels per synthetic group */
+#define HTTP_DELAY_MS 100 /* the responder's think time per request */
+
+static int g_json;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* ── Reporting ────────────────────────────────────────────────────────────── */
+
+static void report_lat(const char *what, int n, double *lat, int q) {
+    double sum = 0;
+    for (int i = 0; i < q; i++) sum += lat[i];
+    qsort(lat, q, sizeof(double), cmp_double);
+    if (g_json)
+        printf("{\"channels\":%d,\"op\":\"%s\",\"queries\":%d,\"mean_us\":%.3f,"
+               "\"p50_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f}\n",
+               n, what, q, sum / q, lat[q / 2], lat[q * 99 / 100], lat[q - 1]);
+    else
+        printf("%7d  %-7s  mean %8.2f  p50 %8.2f  p99 %8.2f  max %8.2f us\n",
+               n, what, sum / q, lat[q / 2], lat[q * 99 / 100], lat[q - 1]);
+}
+
+/* One timed pass over items records totalling bytes. */
+static void report_rate(const char *what, int n, double us, double items, double bytes) {
+    double s = us / 1e6;
+    if (g_json)
+        printf("{\"channels\":%d,\"op\":\"%s\",\"ms\":%.3f,\"items_per_s\":%.0f,"
+               "\"mb_per_s\":%.2f}\n", n, what, us / 1e3, items / s, bytes / 1e6 / s);
+    else
+        printf("%7d  %-7s  %10.1f ms  %12.0f /s  %8.1f MB/s\n",
+               n, what, us / 1e3, items / s, bytes / 1e6 / s);
+}
+
+static void report_rss(int n) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    if (g_json) printf("{\"channels\":%d,\"op\":\"rss\",\"peak_kb\":%ld}\n", n, ru.ru_maxrss);
+    else        printf("%7d  %-7s  %10ld KB peak\n", n, "rss", ru.ru_maxrss);
+}
+
+/* ── Synthetic playlists ──────────────────────────────────────────────────── */
+
+static const char *const g_words[] = {
+    "Первый", "Россия", "Матч", "Кино", "Новости", "Спорт", "Детский", "Музыка",
+    "Наука", "Дом", "Ёлки", "Классика", "News", "Sport", "Movies", "Kids",
+    "Discovery", "History", "Travel", "Music",
+};
+#define N_WORDS (int)(sizeof(g_words) / sizeof(g_words[0]))
+
+/* Deterministic per-channel name: two words and a number. */
+static void channel_name(int ch, char *out, size_t cap) {
+    unsigned h = (unsigned)ch * 2654435761u;
+    snprintf(out, cap, "%s %s %d", g_words[h % N_WORDS], g_words[(h >> 8) % N_WORDS],
+             ch % 1000);
+}
+
+/* pl{k}.m3u for k in [0, playlists): channels spread evenly. Returns the
+ * total size written. */
+static size_t write_playlists(const char *dir, int channels, int playlists) {
+    int groups = channels / GROUP_SIZE > 0 ? channels / GROUP_SIZE : 1;
+    size_t bytes = 0;
+    for (int k = 0, ch = 0; k < playlists; k++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/pl%d.m3u", dir, k);
+        FILE *f = fopen(path, "w");
+        if (!f) { perror(path); exit(1); }
+        fputs("#EXTM3U\n", f);
+        int end = (int)((long long)channels * (k + 1) / playlists);
+        for (; ch < end; ch++) {
+            char name[128];
+            channel_name(ch, name, sizeof(name));
+            unsigned t = (unsigned)ch * 2246822519u;
+            fprintf(f, "#EXTINF:-1 tvg-id=\"ch%d\" tvg-logo=\"http://logo.example/%d.png\" "
+                       "group-title=\"Группа %s %d\",%s\n"
+                       "http://edge%02u.stream.example/live/hls/%d/playlist_1080p.m3u8"
+                       "?token=%08x%08x%08x%08x&expires=%u&sig=%08x%08x%08x&cdn=primary\n",
+                    ch, ch, g_words[ch % groups % N_WORDS], ch % groups, name,
+                    t % 64, ch, t, t ^ 0x5bd1e995u, t * 3u, t * 7u, 1700000000u + t % 86400,
+                    t * 11u, t * 13u, t * 17u);
+        }
+        bytes += (size_t)ftell(f);
+        fclose(f);
+    }
+    return bytes;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); exit(1); }
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc(*len ? *len : 1);
+    if (!buf || fread(buf, 1, *len, f) != *len) { perror(path); exit(1); }
+    fclose(f);
+    return buf;
+}
+
+static void rm_tree(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        if (e->d_type == DT_DIR) rm_tree(path);
+        else                     unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+/* ── Parse and cache ──────────────────────────────────────────────────────── */
+
+static void count_channel(const IptvChannel *ch, void *ud) {
+    (*(int *)ud)++;
+}
+
+static void store_channel(const IptvChannel *ch, void *ud) {
+    iptv_store_add(ud, ch->id, ch->name, ch->url, ch->group, ch->logo, ch->tvg_id);
+}
+
+/* Feed every playlist through parser callback cb. */
+static void parse_all(char **bufs, const size_t *lens, int playlists,
+                      M3uChannelCb cb, void *ud) {
+    M3uParser *p = malloc(sizeof(*p));
+    if (!p) exit(1);
+    for (int k = 0; k < playlists; k++) {
+        m3u_init(p, "bench", cb, ud);
+        m3u_feed(p, bufs[k], lens[k]);
+        m3u_finish(p);
+    }
+    free(p);
+}
+
+static void bench_parse_cache(const char *dir, int channels, int playlists, size_t bytes) {
+    char  **bufs = malloc(playlists * sizeof(char *));
+    size_t *lens = malloc(playlists * sizeof(size_t));
+    for (int k = 0; k < playlists; k++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/pl%d.m3u", dir, k);
+        bufs[k] = read_file(path, &lens[k]);
+    }
+
+    int parsed = 0;
+    double t0 = now_us();
+    parse_all(bufs, lens, playlists, count_channel, &parsed);
+    report_rate("parse", channels, now_us() - t0, parsed, (double)bytes);
+    if (parsed != channels)
+        fprintf(stderr, "bench: parsed %d channels, expected %d\n", parsed, channels);
+
+    IptvStore *st = iptv_store_new("bench");
+    if (!st) { fprintf(stderr, "bench: out of memory\n"); exit(1); }
+    parse_all(bufs, lens, playlists, store_channel, st);
+    iptv_store_seal(st);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench.bin", dir);
+    t0 = now_us();
+    if (iptv_store_save(st, path) < 0) { fprintf(stderr, "bench: save failed\n"); exit(1); }
+    double t_save = now_us() - t0;
+    size_t cache_len;
+    free(read_file(path, &cache_len));
+    report_rate("save", channels, t_save, st->count, (double)cache_len);
+    iptv_store_unref(st);
+
+    t0 = now_us();
+    st = iptv_store_open(path);
+    double t_open = now_us() - t0;
+    if (!st) { fprintf(stderr, "bench: cache did not load back\n"); exit(1); }
+    report_rate("open", channels, t_open, iptv_store_count(st), (double)cache_len);
+    iptv_store_unref(st);
+    unlink(path);
+
+    for (int k = 0; k < playlists; k++) free(bufs[k]);
+    free(bufs);
+    free(lens);
+}
+
+/* ── Catalog ──────────────────────────────────────────────────────────────── */
+
+static void run(int channels, int playlists, int queries) {
+    char dir[] = "/tmp/qaryx_bench_XXXXXX";
+    if (!mkdtemp(dir)) { perror("mkdtemp"); exit(1); }
+    iptv_set_data_dir(dir);
+    iptv_load();                       /* empty dir: start from nothing */
+    size_t bytes = write_playlists(dir, channels, playlists);
+
+    bench_parse_cache(dir, channels, playlists, bytes);
+
+    double t0 = now_us();
+    for (int k = 0; k < playlists; k++) {
+        char url[512], name[32];
+        snprintf(url,  sizeof(url),  "file://%s/pl%d.m3u", dir, k);
+        snprintf(name, sizeof(name), "Bench %d", k);
+        if (iptv_add_playlist(url, name) < 0) {
+            fprintf(stderr, "bench: failed to load %s\n", url);
+            exit(1);
+        }
+    }
+    report_rate("add", channels, now_us() - t0, channels, (double)bytes);
+
+    t0 = now_us();
+    iptv_load();
+    report_rate("boot", channels, now_us() - t0, channels, (double)bytes);
+
+    IptvChannelList *all = iptv_get_channels(NULL, NULL);
+    int n = iptv_list_count(all);
+    if (n != channels)
+        fprintf(stderr, "bench: expected %d channels, got %d\n", channels, n);
+
+    char **ids   = malloc(queries * sizeof(char *));
+    char **urls  = malloc(queries * sizeof(char *));
+    char **names = malloc(queries * sizeof(char *));
+    double *lat  = malloc(queries * sizeof(double));
+    srand(42);
+    for (int i = 0; i < queries; i++) {
+        IptvChannel ch;
+        iptv_list_get(all, rand() % n, &ch);
+        ids[i]   = strdup(ch.id);
+        urls[i]  = strdup(ch.url);
+        names[i] = strdup(ch.name);
+    }
+    iptv_list_free(all);
+
+    int miss = 0;
+    for (int i = 0; i < queries; i++) {
+        t0 = now_us();
+        IptvChannelList *l = iptv_get_channel(ids[i]);
+        IptvChannel ch;
+        if (iptv_list_get(l, 0, &ch) < 0) miss++;
+        iptv_list_free(l);
+        lat[i] = now_us() - t0;
+    }
+    report_lat("by_id", n, lat, queries);
+
+    for (int i = 0; i < queries; i++) {
+        t0 = now_us();
+        IptvChannelList *l = iptv_get_channel_by_url(urls[i]);
+        IptvChannel ch;
+        if (iptv_list_get(l, 0, &ch) < 0) miss++;
+        iptv_list_free(l);
+        lat[i] = now_us() - t0;
+    }
+    report_lat("by_url", n, lat, queries);
+
+    for (int i = 0; i < queries; i++) {
+        t0 = now_us();
+        IptvCatalog *c = iptv_catalog_acquire();
+        int gn;
+        const char **g = iptv_catalog_groups(c, &gn);
+        if (gn == 0 || !g[gn - 1]) miss++;
+        iptv_catalog_release(c);
+        lat[i] = now_us() - t0;
+    }
+    report_lat("groups", n, lat, queries);
+
+    /* Group switches go through a pinned catalog, as the UI does */
+    IptvCatalog *cat = iptv_catalog_acquire();
+    int gn; const char **groups = iptv_catalog_groups(cat, &gn);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < queries; i++) {
+            t0 = now_us();
+            IptvChannelList *l = iptv_catalog_channels(cat, NULL,
+                                     pass ? NULL : groups[rand() % gn]);
+            int rows = iptv_list_count(l);
+            if (rows == 0) miss++;
+            for (int r = 0; r < rows && r < SCREEN_ROWS; r++) {
+                IptvChannel ch;
+                iptv_list_get(l, r, &ch);
+            }
+            iptv_list_free(l);
+            lat[i] = now_us() - t0;
+        }
+        report_lat(pass ? "all" : "group", n, lat, queries);
+    }
+    iptv_catalog_release(cat);
+
+    /* Search-as-you-type: each query is a prefix of a channel name, one to
+     * eight bytes long (extended to a character boundary) */
+    for (int i = 0; i < queries; i++) {
+        char q[16];
+        size_t len = strlen(names[i]), cut = 1 + (size_t)(i % 8);
+        if (cut > len) cut = len;
+        while (((unsigned char)names[i][cut] & 0xC0) == 0x80) cut++;
+        memcpy(q, names[i], cut);
+        q[cut] = '\0';
+        t0 = now_us();
+        int total;
+        IptvChannelList *l = iptv_search(q, 50, &total);
+        if (total == 0) miss++;
+        iptv_list_free(l);
+        lat[i] = now_us() - t0;
+    }
+    report_lat("search", n, lat, queries);
+    if (miss) fprintf(stderr, "bench: %d lookups came back empty\n", miss);
+
+    for (int i = 0; i < queries; i++) { free(ids[i]); free(urls[i]); free(names[i]); }
+    free(ids); free(urls); free(names); free(lat);
+    rm_tree(dir);
+    report_rss(channels);
+}
+
+/* ── Loopback HTTP ────────────────────────────────────────────────────────── */
+
+/* Serves GET /pl{k}.m3u from the scratch dir, one thread per connection and
+ * one request per connection. ETag and Last-Modified come from the file's
+ * size and mtime; a request carrying the current ETag (or, without one, the
+ * current Last-Modified) gets a 304. With validators off it sends neither
+ * and always answers 200. */
+static struct {
+    char       dir[64];
+    int        fd;
+    atomic_int validators;
+    atomic_int open, peak;          /* connections */
+    atomic_int requests, conditional, not_modified;
+} g_http;
+
+/* Value of the request header "\r\n<name>:", or "" if absent. */
+static void http_header(const char *req, const char *name, char *out, size_t cap) {
+    char key[64];
+    snprintf(key, sizeof(key), "\r\n%s:", name);
+    out[0] = '\0';
+    const char *p = strcasestr(req, key);
+    if (!p) return;
+    p += strlen(key);
+    while (*p == ' ') p++;
+    size_t n = strcspn(p, "\r\n");
+    if (n >= cap) n = cap - 1;
+    memcpy(out, p, n);
+    out[n] = '\0';
+}
+
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void *http_conn(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    int open = atomic_fetch_add(&g_http.open, 1) + 1;
+    int peak = atomic_load(&g_http.peak);
+    while (open > peak && !atomic_compare_exchange_weak(&g_http.peak, &peak, open)) {}
+
+    char req[4096];
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) goto done;
+        len += (size_t)n;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n")) break;
+        if (len == sizeof(req) - 1) goto done;
+    }
+    atomic_fetch_add(&g_http.requests, 1);
+
+    char path[600], inm[128], ims[64], etag[64], lm[64], head[512];
+    struct stat sb;
+    int k;
+    if (sscanf(req, "GET /pl%d.m3u ", &k) != 1 ||
+        (snprintf(path, sizeof(path), "%s/pl%d.m3u", g_http.dir, k), stat(path, &sb) < 0)) {
+        static const char nf[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n"
+                                 "Connection: close\r\n\r\n";
+        send_all(fd, nf, sizeof(nf) - 1);
+        goto done;
+    }
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)sb.st_size,
+             (unsigned long long)sb.st_mtim.tv_sec * 1000000000ull + sb.st_mtim.tv_nsec);
+    struct tm tm;
+    strftime(lm, sizeof(lm), "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&sb.st_mtime, &tm));
+    http_header(req, "If-None-Match",     inm, sizeof(inm));
+    http_header(req, "If-Modified-Since", ims, sizeof(ims));
+    if (inm[0] && ims[0]) atomic_fetch_add(&g_http.conditional, 1);
+
+    int val   = atomic_load(&g_http.validators);
+    int match = val && (inm[0] ? !strcmp(inm, etag) : ims[0] && !strcmp(ims, lm));
+    char vh[160] = "";
+    if (val) snprintf(vh, sizeof(vh), "ETag: %s\r\nLast-Modified: %s\r\n", etag, lm);
+
+    usleep(HTTP_DELAY_MS * 1000);
+    if (match) {
+        atomic_fetch_add(&g_http.not_modified, 1);
+        int n = snprintf(head, sizeof(head), "HTTP/1.1 304 Not Modified\r\n%s"
+                                             "Connection: close\r\n\r\n", vh);
+        send_all(fd, head, (size_t)n);
+        goto done;
+    }
+    size_t blen;
+    char *body = read_file(path, &blen);
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: audio/x-mpegurl\r\n"
+                                         "Content-Length: %zu\r\n%sConnection: close\r\n\r\n",
+                     blen, vh);
+    if (send_all(fd, head, (size_t)n) == 0) send_all(fd, body, blen);
+    free(body);
+done:
+    shutdown(fd, SHUT_WR);
+    close(fd);
+    atomic_fetch_sub(&g_http.open, 1);
+    return NULL;
+}
+
+static void *http_accept(void *arg) {
+    for (;;) {
+        int c = accept4(g_http.fd, NULL, NULL, SOCK_CLOEXEC);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return NULL;
+        }
+        pthread_t t;
+        if (pthread_create(&t, NULL, http_conn, (void *)(intptr_t)c) != 0) { close(c); continue; }
+        pthread_detach(t);
+    }
+}
+
+/* Start serving dir on an ephemeral loopback port. Returns the port. */
+static int http_start(const char *dir) {
+    snprintf(g_http.dir, sizeof(g_http.dir), "%s", dir);
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t alen = sizeof(addr);
+    g_http.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    pthread_t t;
+    if (g_http.fd < 0 || bind(g_http.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(g_http.fd, 64) < 0 ||
+        getsockname(g_http.fd, (struct sockaddr *)&addr, &alen) < 0 ||
+        pthread_create(&t, NULL, http_accept, NULL) != 0) {
+        perror("bench: http");
+        exit(1);
+    }
+    pthread_detach(t);
+    return ntohs(addr.sin_port);
+}
+
+/* ── Refresh ──────────────────────────────────────────────────────────────── */
+
+/* One iptv_refresh_all() against the responder. bins/mt hold each
+ * playlist's cache path and its mtime before; only playlist changed (or
+ * none, -1) may rewrite its cache. with_304: every request must come back
+ * conditional and be answered 304. Returns the number of failed checks. */
+static int refresh_pass(const char *what, int channels, int playlists,
+                        char (*bins)[512], struct timespec *mt,
+                        int changed, int with_304) {
+    atomic_store(&g_http.peak, 0);
+    atomic_store(&g_http.requests, 0);
+    atomic_store(&g_http.conditional, 0);
+    atomic_store(&g_http.not_modified, 0);
+
+    double t0 = now_us();
+    int ok = iptv_refresh_all();
+    double us = now_us() - t0;
+
+    int kept = 0, rewritten = 0, fail = 0;
+    for (int k = 0; k < playlists; k++) {
+        struct stat sb;
+        if (stat(bins[k], &sb) < 0) { perror(bins[k]); fail++; continue; }
+        if (sb.st_mtim.tv_sec == mt[k].tv_sec && sb.st_mtim.tv_nsec == mt[k].tv_nsec) {
+            kept++;
+        } else {
+            if (k == changed) rewritten = 1;
+            mt[k] = sb.st_mtim;
+        }
+    }
+    int req  = atomic_load(&g_http.requests), cond = atomic_load(&g_http.conditional);
+    int nm   = atomic_load(&g_http.not_modified), peak = atomic_load(&g_http.peak);
+
+    if (g_json)
+        printf("{\"channels\":%d,\"op\":\"%s\",\"ms\":%.3f,\"requests\":%d,"
+               "\"conditional\":%d,\"not_modified\":%d,\"peak_conn\":%d,\"cache_kept\":%d}\n",
+               channels, what, us / 1e3, req, cond, nm, peak, kept);
+    else
+        printf("%7d  %-7s  %10.1f ms  %4d req  %4d cond  %4d 304  %2d conn  %4d/%d kept\n",
+               channels, what, us / 1e3, req, cond, nm, peak, kept, playlists);
+
+    if (ok != playlists) {
+        fprintf(stderr, "bench: %s: %d of %d playlists refreshed\n", what, ok, playlists);
+        fail++;
+    }
+    if (with_304 && (cond != req || nm != req)) {
+        fprintf(stderr, "bench: %s: %d of %d requests conditional, %d answered 304\n",
+                what, cond, req, nm);
+        fail++;
+    }
+    if (kept != playlists - (changed >= 0) || (changed >= 0 && !rewritten)) {
+        fprintf(stderr, "bench: %s: %d of %d caches kept, expected %d\n",
+                what, kept, playlists, playlists - (changed >= 0));
+        fail++;
+    }
+    if (peak > IPTV_REFRESH_PARALLEL) {
+        fprintf(stderr, "bench: %s: %d downloads open at once, limit %d\n",
+                what, peak, IPTV_REFRESH_PARALLEL);
+        fail++;
+    }
+    return fail;
+}
+
+static void run_refresh(int channels, int playlists, int queries) {
+    char dir[] = "/tmp/qaryx_bench_XXXXXX";
+    if (!mkdtemp(dir)) { perror("mkdtemp"); exit(1); }
+    iptv_set_data_dir(dir);
+    iptv_load();
+    write_playlists(dir, channels, playlists);
+    int port = http_start(dir);
+    atomic_store(&g_http.validators, 1);
+
+    for (int k = 0; k < playlists; k++) {
+        char url[64], name[32];
+        snprintf(url,  sizeof(url),  "http://127.0.0.1:%d/pl%d.m3u", port, k);
+        snprintf(name, sizeof(name), "Bench %d", k);
+        if (iptv_add_playlist(url, name) < 0) {
+            fprintf(stderr, "bench: failed to load %s\n", url);
+            exit(1);
+        }
+    }
+
+    /* Cache file and its mtime per playlist, indexed like pl{k}.m3u */
+    char (*bins)[512]   = calloc(playlists, sizeof(*bins));
+    struct timespec *mt = calloc(playlists, sizeof(*mt));
+    if (!bins || !mt) exit(1);
+    IptvCatalog *c = iptv_catalog_acquire();
+    int npl;
+    const IptvPlaylist *pls = iptv_catalog_playlists(c, &npl);
+    for (int i = 0; i < npl; i++) {
+        int k;
+        const char *slash = strrchr(pls[i].url, '/');
+        if (!slash || sscanf(slash, "/pl%d.m3u", &k) != 1 || k < 0 || k >= playlists) continue;
+        snprintf(bins[k], sizeof(bins[k]), "%s/iptv/%s.bin", dir, pls[i].id);
+        struct stat sb;
+        if (stat(bins[k], &sb) < 0) { perror(bins[k]); exit(1); }
+        mt[k] = sb.st_mtim;
+    }
+    iptv_catalog_release(c);
+
+    int fail = refresh_pass("r304", channels, playlists, bins, mt, -1, 1);
+
+    /* Same channels, different bytes: a new ETag and a new hash */
+    char path[512];
+    snprintf(path, sizeof(path), "%s/pl0.m3u", dir);
+    FILE *f = fopen(path, "a");
+    if (!f) { perror(path); exit(1); }
+    fputs("# revised\n", f);
+    fclose(f);
+    fail += refresh_pass("rnew", channels, playlists, bins, mt, 0, 0);
+
+    atomic_store(&g_http.validators, 0);
+    fail += refresh_pass("rsame", channels, playlists, bins, mt, -1, 0);
+
+    free(bins);
+    free(mt);
+    rm_tree(dir);
+    if (fail) exit(1);
+}
+
+int main(int argc, char **argv) {
+    int playlists = 16, queries = 10000;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:q:j")) != -1) {
+        switch (opt) {
+        case 'p': playlists = atoi(optarg); break;
+        case 'q': queries   = atoi(optarg); break;
+        case 'j': g_json    = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-p playlists] [-q queries] [-j] [channels...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (playlists < 1) playlists = 1;
+    if (queries   < 1) queries   = 1;
+
+    static const int defaults[] = { 1000, 10000, 100000 };
+    int nsizes = argc - optind, rc = 0;
+    for (int i = 0; i < (nsizes ? nsizes : 3); i++) {
+        int channels = nsizes ? atoi(argv[optind + i]) : defaults[i];
+        if (channels < playlists) continue;
+
+        /* One process per size and pass: peak RSS and catalog state are
+         * its own */
+        static void (*const passes[])(int, int, int) = { run, run_refresh };
+        for (int r = 0; r < 2; r++) {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid < 0) { perror("fork"); return 1; }
+            if (pid == 0) {
+                /* Budgets sized to the run, so the bench measures the
+                 * catalog rather than the limits */
+                iptv_set_limits(channels, playlists, channels / 1000 * 2 + 64);
+                passes[r](channels, playlists, queries);
+                fflush(stdout);
+                _exit(0);
+            }
+            int status;
+            if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+                rc = 1;
+        }
+    }
+    return rc;
+}
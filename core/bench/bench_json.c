@@ -0,0 +1,479 @@
+/* cJSON parser benchmark, with a check of its vector scanners.
+ *
+ *   qaryx_bench_json [-n channels] [-r rounds] [-j]
+ *
+ * check   — cjson_scan_str() and cjson_skip_ws() against their plain C
+ *           versions at every start offset and stop position, with stop
+ *           bytes, high bytes and control bytes around them, including
+ *           strings that end on the last byte before an unmapped page.
+ *           Then every corpus document is parsed with cJSON_Parse() and
+ *           its tree compared with a walk by the original byte-at-a-time
+ *           parser (kept below as the reference). Any difference is
+ *           printed and the run exits with 1.
+ * parse   — cJSON_Parse() throughput, best of -r rounds, over:
+ *             compact   a channel list as the phone imports it (default
+ *                       100000 channels; Cyrillic and Latin names, some
+ *                       escaped, URLs of ~120 bytes)
+ *             indented  the same list pretty-printed
+ *             ytdlp     yt-dlp --dump-json lines, one document each
+ *             edges     short documents built around every awkward case
+ * The scanners in use are printed first ("sse2", "neon" or "scalar").
+ * Configure with -DCMAKE_C_FLAGS=-DCJSON_NO_SIMD for the scalar numbers.
+ * With -j every line is a JSON object instead, for scripts and CI. */
+
+#include "cjson.h"
+#include "cjson_scan.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static int g_json;
+static int g_failed;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* xorshift: the corpus is the same on every run */
+static uint64_t g_rng = 0x9e3779b97f4a7c15ull;
+
+static uint32_t rnd(uint32_t n) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return (uint32_t)(g_rng % n);
+}
+
+/* ── Growable text ────────────────────────────────────────────────────────── */
+
+typedef struct {
+    char  *p;
+    size_t len, cap;
+} Buf;
+
+static void put(Buf *b, const char *s, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (b->len + n + 1 > cap) cap *= 2;
+        char *p = realloc(b->p, cap);
+        if (!p) { perror("realloc"); exit(1); }
+        b->p   = p;
+        b->cap = cap;
+    }
+    memcpy(b->p + b->len, s, n);
+    b->len += n;
+    b->p[b->len] = '\0';
+}
+
+static void puts_(Buf *b, const char *s) { put(b, s, strlen(s)); }
+
+__attribute__((format(printf, 2, 3)))
+static void printf_(Buf *b, const char *fmt, ...) {
+    char    tmp[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    put(b, tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+}
+
+/* ── Digests ──────────────────────────────────────────────────────────────── */
+
+/* Both sides reduce a document to the same event stream, hashed */
+typedef uint64_t Digest;
+
+static void dg(Digest *d, const void *p, size_t n) {
+    const unsigned char *s = p;
+    for (size_t i = 0; i < n; i++) *d = (*d ^ s[i]) * 1099511628211ull;
+}
+
+static void dg_tag(Digest *d, char t)             { dg(d, &t, 1); }
+static void dg_str(Digest *d, const char *s)      { dg(d, s, strlen(s) + 1); }
+static void dg_num(Digest *d, double v)           { dg(d, &v, sizeof(v)); }
+
+static void tree_digest(const cJSON *c, Digest *d) {
+    switch (c->type) {
+    case CJSON_NULL:   dg_tag(d, 'z'); break;
+    case CJSON_BOOL:   dg_tag(d, c->valuebool ? 't' : 'f'); break;
+    case CJSON_NUMBER: dg_tag(d, 'n'); dg_num(d, c->valuedouble); break;
+    case CJSON_STRING: dg_tag(d, 's'); dg_str(d, c->valuestring); break;
+    case CJSON_ARRAY:
+    case CJSON_OBJECT:
+        dg_tag(d, c->type == CJSON_ARRAY ? '[' : '{');
+        for (const cJSON *ch = c->child; ch; ch = ch->next) {
+            if (c->type == CJSON_OBJECT) { dg_tag(d, 'k'); dg_str(d, ch->string); }
+            tree_digest(ch, d);
+        }
+        dg_tag(d, c->type == CJSON_ARRAY ? ']' : '}');
+        break;
+    }
+}
+
+/* ── Reference parser ─────────────────────────────────────────────────────── */
+
+/* The parser as it was before the vector scanners, byte by byte, with the
+ * tree replaced by digest events. */
+static const char *ref_ws(const char *s) {
+    while (s && *s && (unsigned char)*s <= ' ') s++;
+    return s;
+}
+
+static const char *ref_string(const char *s, Digest *d) {
+    if (*s != '"') return NULL;
+    s++;
+    const char *b = s;
+    size_t len = 0;
+    while (*s && *s != '"') {
+        if (*s == '\\' && !s[1]) return NULL;   /* the original read past the end */
+        if (*s == '\\') s++;
+        s++; len++;
+    }
+    char *p = malloc(len + 1), *w = p;
+    s = b;
+    while (*s && *s != '"') {
+        if (*s == '\\') {
+            s++;
+            switch (*s) {
+                case '"': *w++='"'; break;
+                case '\\': *w++='\\'; break;
+                case '/': *w++='/'; break;
+                case 'n': *w++='\n'; break;
+                case 'r': *w++='\r'; break;
+                case 't': *w++='\t'; break;
+                default: *w++=*s; break;
+            }
+        } else { *w++=*s; }
+        s++;
+    }
+    *w = '\0';
+    dg_str(d, p);
+    free(p);
+    return (*s == '"') ? s+1 : NULL;
+}
+
+static const char *ref_value(const char *s, Digest *d);
+
+static const char *ref_array(const char *s, Digest *d) {
+    dg_tag(d, '[');
+    s = ref_ws(s);
+    if (*s == ']') { dg_tag(d, ']'); return s+1; }
+    s = ref_value(s, d);
+    while (s && (s=ref_ws(s)) && *s == ',')
+        s = ref_value(ref_ws(s+1), d);
+    dg_tag(d, ']');
+    return (s && *s==']') ? s+1 : NULL;
+}
+
+static const char *ref_object(const char *s, Digest *d) {
+    dg_tag(d, '{');
+    s = ref_ws(s);
+    if (*s == '}') { dg_tag(d, '}'); return s+1; }
+    dg_tag(d, 'k');
+    s = ref_string(s, d);
+    if (!s) return NULL;
+    s = ref_ws(s);
+    if (*s != ':') return NULL;
+    s = ref_value(ref_ws(s+1), d);
+    while (s && (s=ref_ws(s)) && *s == ',') {
+        s = ref_ws(s+1);
+        dg_tag(d, 'k');
+        s = ref_string(s, d);
+        if (!s) return NULL;
+        s = ref_ws(s);
+        if (*s != ':') return NULL;
+        s = ref_value(ref_ws(s+1), d);
+    }
+    dg_tag(d, '}');
+    return (s && *s=='}') ? s+1 : NULL;
+}
+
+static const char *ref_value(const char *s, Digest *d) {
+    s = ref_ws(s);
+    if (!s) return NULL;
+    if (*s == '"') { dg_tag(d, 's'); return ref_string(s, d); }
+    if (*s == '[') return ref_array(ref_ws(s+1), d);
+    if (*s == '{') return ref_object(ref_ws(s+1), d);
+    if (!strncmp(s,"true",4))  { dg_tag(d, 't'); return s+4; }
+    if (!strncmp(s,"false",5)) { dg_tag(d, 'f'); return s+5; }
+    if (!strncmp(s,"null",4))  { dg_tag(d, 'z'); return s+4; }
+    char *ep;
+    double v = strtod(s, &ep);
+    if (s == ep) return NULL;
+    dg_tag(d, 'n'); dg_num(d, v);
+    return ep;
+}
+
+/* 0 when cJSON and the reference agree on doc (both reject it, or both
+ * read the same values) */
+static int check_doc(const char *what, int i, const char *doc) {
+    Digest  want = 14695981039346656037ull, got = want;
+    int     ok_ref = ref_value(ref_ws(doc), &want) != NULL;
+    cJSON  *t = cJSON_Parse(doc);
+    if (t) tree_digest(t, &got);
+    cJSON_Delete(t);
+    if (ok_ref == (t != NULL) && (!t || got == want)) return 0;
+    fprintf(stderr, "bench_json: %s #%d differs (reference %s, cJSON %s): %.120s\n",
+            what, i, ok_ref ? "accepts" : "rejects", t ? "accepts" : "rejects", doc);
+    g_failed = 1;
+    return -1;
+}
+
+/* ── Corpus ───────────────────────────────────────────────────────────────── */
+
+static const char *const k_names[] = {
+    "Первый канал", "Россия 1", "НТВ", "Discovery Science", "BBC World News",
+    "Euronews", "Матч ТВ", "National Geographic", "Cartoon Network", "Fashion TV",
+};
+
+/* Channel name, sometimes with escapes in it */
+static void put_name(Buf *b, int i) {
+    printf_(b, "%s %d", k_names[i % 10], i);
+    switch (rnd(40)) {
+    case 0: puts_(b, " \\\"HD\\\""); break;
+    case 1: puts_(b, " \\\\ backup"); break;
+    case 2: puts_(b, "\\n\\t+1"); break;
+    case 3: puts_(b, " \\u0410\\/\\b"); break;
+    }
+}
+
+static void build_channels(Buf *b, int n, int indent) {
+    const char *nl = indent ? "\n" : "", *in1 = indent ? "  " : "", *in2 = indent ? "    " : "";
+    const char *sep = indent ? ": " : ":";
+    printf_(b, "[%s", nl);
+    for (int i = 0; i < n; i++) {
+        printf_(b, "%s{%s%s\"id\"%s\"pl_0002b5f5_%08x\",%s%s\"name\"%s\"", in1, nl, in2, sep,
+                (unsigned)i * 2654435761u, nl, in2, sep);
+        put_name(b, i);
+        printf_(b, "\",%s%s\"url\"%s\"http://iptv.example.net/live/%u/%08x/index.m3u8?token=%08x%08x\",%s",
+                nl, in2, sep, (unsigned)i, rnd(1u << 31), rnd(1u << 31), rnd(1u << 31), nl);
+        printf_(b, "%s\"group\"%s\"Группа %d\",%s%s\"logo\"%s\"http://logo.example.net/%d.png\"%s%s}%s%s",
+                in2, sep, i / 20, nl, in2, sep, i, nl, in1, i + 1 < n ? "," : "", nl);
+    }
+    puts_(b, "]");
+}
+
+static void build_ytdlp(Buf *b, int i) {
+    printf_(b, "{\"_type\": \"url\", \"ie_key\": \"Youtube\", \"id\": \"v%07d\", "
+               "\"url\": \"https://www.youtube.com/watch?v=v%07d\", ", i, i);
+    puts_(b, "\"title\": \"Выпуск ");
+    put_name(b, i);
+    printf_(b, "\", \"description\": null, \"duration\": %d.0, \"channel_id\": \"UC%016x\", "
+               "\"channel\": \"Канал\", \"thumbnails\": [", 60 + i % 3600, i);
+    for (int k = 0; k < 4; k++)
+        printf_(b, "%s{\"url\": \"https://i.ytimg.com/vi/v%07d/hq%d.jpg\", \"height\": %d, \"width\": %d}",
+                k ? ", " : "", i, k, 90 * (k + 1), 160 * (k + 1));
+    printf_(b, "], \"view_count\": %d, \"live_status\": null, \"playable_in_embed\": true}",
+            i * 37);
+}
+
+/* Short documents around the cases the scanners must get right: every
+ * string length and whitespace run across a 16-byte boundary, control and
+ * high bytes next to stops, escapes in every position, broken input. */
+static int build_edges(char ***out) {
+    static const char fill[] = "aZ\x01\x1f\x7f\x80\xbf\xd0\xff ~#";
+    static const char wsb[]  = " \t\n\r\x01\x0b\x1f ";
+    int   n = 0, cap = 0;
+    char **v = NULL;
+    Buf   b = { 0 };
+#define EMIT() do {                                                         \
+        if (n == cap) { cap = cap ? cap * 2 : 1024;                         \
+                        v = realloc(v, (size_t)cap * sizeof(*v)); }          \
+        v[n++] = strdup(b.p); b.len = 0;                                    \
+    } while (0)
+
+    for (int pad = 0; pad < 16; pad++) {
+        for (int len = 0; len < 70; len++) {
+            /* "xxx..." at every length after pad bytes of whitespace */
+            b.len = 0;
+            for (int k = 0; k < pad; k++) put(&b, &wsb[k % 8], 1);
+            puts_(&b, "[\"");
+            for (int k = 0; k < len; k++) put(&b, &fill[rnd(sizeof(fill) - 1)], 1);
+            puts_(&b, "\"]");
+            EMIT();
+
+            /* one escape at every position */
+            static const char esc[] = "\"\\/nrtbfu";
+            for (int k = 0; k <= len; k += 7) {
+                b.len = 0;
+                for (int j = 0; j < pad; j++) puts_(&b, " ");
+                puts_(&b, "{\"k\":\"");
+                for (int j = 0; j < len; j++) {
+                    if (j == k) { put(&b, "\\", 1); put(&b, &esc[rnd(sizeof(esc) - 1)], 1); }
+                    put(&b, &fill[rnd(sizeof(fill) - 1)], 1);
+                }
+                puts_(&b, "\"}");
+                EMIT();
+            }
+
+            /* whitespace run of len bytes between tokens, then a high byte */
+            b.len = 0;
+            puts_(&b, "{");
+            for (int k = 0; k < len; k++) put(&b, &wsb[rnd(8)], 1);
+            puts_(&b, "\"a\"");
+            for (int k = 0; k < len; k++) put(&b, &wsb[rnd(8)], 1);
+            puts_(&b, ":[1,");
+            for (int k = 0; k < pad; k++) put(&b, &wsb[rnd(8)], 1);
+            puts_(&b, "\"\xd0\x96\"]}");
+            EMIT();
+        }
+    }
+
+    static const char *const fixed[] = {
+        "", " ", "\"", "\"abc", "\"abc\\", "\"a\\\"", "\"a\\\"\"", "[\"a\\\\\",\"b\"]",
+        "{\"a\":\"b\\\\\\\"c\"}", "[1,2,", "{\"a\" 1}", "{\"a\":}", "\x80", "[\x80]",
+        "[\"\\u00e9\"]", "  \r\n\t [ \r\n ] ", "{\"\":\"\"}", "[true,false,null,-1.5e3]",
+        "\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\\\"\"",
+    };
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(*fixed); i++) {
+        b.len = 0;
+        puts_(&b, fixed[i]);
+        EMIT();
+    }
+#undef EMIT
+    free(b.p);
+    *out = v;
+    return n;
+}
+
+/* ── Scanner check ────────────────────────────────────────────────────────── */
+
+static int check_scanners(void) {
+    long   page = sysconf(_SC_PAGESIZE);
+    char  *mem  = mmap(NULL, (size_t)page * 2, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) { perror("mmap"); return -1; }
+    mprotect(mem + page, (size_t)page, PROT_NONE);      /* reading past faults */
+
+    static const unsigned char str_stop[] = { '"', '\\', 0 };
+    static const unsigned char str_fill[] = { 'a', 0x01, 0x1f, 0x20, 0x21, 0x5b, 0x5d,
+                                              0x7f, 0x80, 0xa2, 0xdc, 0xff };
+    static const unsigned char ws_stop[]  = { 0, '!', 'a', '"', 0x7f, 0x80, 0xff };
+    static const unsigned char ws_fill[]  = { ' ', '\t', '\n', '\r', 0x01, 0x1f };
+
+    /* Every start offset, stop position and stop byte; the block sits at
+     * the start of the page and then flush against the guard page */
+    for (int at_end = 0; at_end < 2; at_end++) {
+        for (int off = 0; off < 32; off++) {
+            for (int pos = 0; pos < 80; pos++) {
+                char *base = at_end ? mem + page - (off + pos + 1) : mem;
+                char *s    = base + off;
+                for (int kind = 0; kind < 2; kind++) {
+                    const unsigned char *stop = kind ? ws_stop : str_stop;
+                    const unsigned char *fill = kind ? ws_fill : str_fill;
+                    int nstop = kind ? 7 : 3, nfill = kind ? 6 : 12;
+                    for (int st = 0; st < nstop; st++) {
+                        for (int k = 0; k < pos; k++) s[k] = (char)fill[rnd((uint32_t)nfill)];
+                        s[pos] = (char)stop[st];
+                        if (!at_end) s[pos + 1] = '\0';
+                        const char *want = kind ? cjson_skip_ws_scalar(s) : cjson_scan_str_scalar(s);
+                        const char *got  = kind ? cjson_skip_ws(s)        : cjson_scan_str(s);
+                        if (got != want) {
+                            fprintf(stderr, "bench_json: %s at offset %d stops at %td, "
+                                    "expected %d (stop 0x%02x%s)\n",
+                                    kind ? "skip_ws" : "scan_str", off, got - s, pos,
+                                    stop[st], at_end ? ", page end" : "");
+                            g_failed = 1;
+                            munmap(mem, (size_t)page * 2);
+                            return -1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    munmap(mem, (size_t)page * 2);
+    return 0;
+}
+
+/* ── Parse throughput ─────────────────────────────────────────────────────── */
+
+static void report(const char *what, int docs, size_t bytes, double us) {
+    double mb = bytes / 1e6;
+    if (g_json)
+        printf("{\"bench\":\"json\",\"what\":\"%s\",\"simd\":\"%s\",\"docs\":%d,"
+               "\"bytes\":%zu,\"us\":%.0f,\"mb_s\":%.1f}\n",
+               what, CJSON_SIMD, docs, bytes, us, mb / (us / 1e6));
+    else
+        printf("%-9s %7d docs %8.2f MB %9.2f ms %8.1f MB/s\n",
+               what, docs, mb, us / 1e3, mb / (us / 1e6));
+}
+
+/* Best of rounds over the documents; checked against the reference once */
+static void run_docs(const char *what, char **docs, int n, int rounds) {
+    size_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+        bytes += strlen(docs[i]);
+        check_doc(what, i, docs[i]);
+    }
+    double best = 0;
+    for (int r = 0; r < rounds; r++) {
+        double t0 = now_us();
+        for (int i = 0; i < n; i++) cJSON_Delete(cJSON_Parse(docs[i]));
+        double t = now_us() - t0;
+        if (!r || t < best) best = t;
+    }
+    report(what, n, bytes, best);
+}
+
+int main(int argc, char **argv) {
+    int channels = 100000, rounds = 5, opt;
+    while ((opt = getopt(argc, argv, "n:r:j")) != -1) {
+        switch (opt) {
+        case 'n': channels = atoi(optarg); break;
+        case 'r': rounds   = atoi(optarg); break;
+        case 'j': g_json   = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-n channels] [-r rounds] [-j]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (channels < 1) channels = 1;
+    if (rounds   < 1) rounds   = 1;
+
+    double t0 = now_us();
+    int    sc = check_scanners();
+    if (g_json)
+        printf("{\"bench\":\"json\",\"what\":\"scanners\",\"simd\":\"%s\",\"ok\":%s}\n",
+               CJSON_SIMD, sc ? "false" : "true");
+    else
+        printf("scanners  %s, %s (%.0f ms)\n", CJSON_SIMD, sc ? "MISMATCH" : "match scalar",
+               (now_us() - t0) / 1e3);
+
+    Buf b = { 0 };
+    build_channels(&b, channels, 0);
+    char *doc = b.p;
+    run_docs("compact", &doc, 1, rounds);
+    free(b.p);
+
+    b = (Buf){ 0 };
+    build_channels(&b, channels, 1);
+    doc = b.p;
+    run_docs("indented", &doc, 1, rounds);
+    free(b.p);
+
+    int    ny = channels / 10 ? channels / 10 : 1;
+    char **yt = malloc((size_t)ny * sizeof(*yt));
+    for (int i = 0; i < ny; i++) {
+        b = (Buf){ 0 };
+        build_ytdlp(&b, i);
+        yt[i] = b.p;
+    }
+    run_docs("ytdlp", yt, ny, rounds);
+    for (int i = 0; i < ny; i++) free(yt[i]);
+    free(yt);
+
+    char **edges;
+    int    ne = build_edges(&edges);
+    run_docs("edges", edges, ne, rounds);
+    for (int i = 0; i < ne; i++) free(edges[i]);
+    free(edges);
+
+    if (g_failed) fprintf(stderr, "bench_json: cJSON output differs from the reference\n");
+    return g_failed;
+}
@@ -0,0 +1,837 @@
+/* WebSocket server benchmark: command round trips and broadcast fan-out
+ * under load, over loopback.
+ *
+ *   qaryx_bench_ws [-c clients] [-s slow] [-d seconds] [-n channels]
+ *                  [-i import] [-j] [-v] [mix...]
+ *
+ * The server — ws.c and cmd.c as the app runs them, with command handlers
+ * over a synthetic catalog of -n channels (default 20000) — runs in a child
+ * process with its own event loop. Like the app while a playlist loads, it
+ * broadcasts a status delta every 20 ms (coalescing key, as position
+ * updates) and a 500-channel page every second. The parent opens
+ *   -c fast clients  (default 8) each keeping commands from the mix in
+ *                    flight and timing command → reply; they also time
+ *                    every broadcast from the server until it arrives
+ *   -s slow readers  (default 2) that send nothing and read 4 KB every
+ *                    100 ms, so they fall behind; they show what a stuck
+ *                    phone costs everyone else (and get cut off)
+ * Mixes, each run for -d seconds (default 3; default: all four):
+ *   key       key presses in pipelined bursts of 10
+ *   channels  iptv_channels_get pages of 100–500 at random offsets, served
+ *             by the app's own handler (iptv_pages.c)
+ *   import    playlist_import of -i channels (default 2000), each imported,
+ *             cached and removed again
+ *   mixed     80% key bursts, 18% channel pages, 2% imports
+ * The bench's key handler acknowledges each press so it can be timed (the
+ * app's sends nothing back); the other replies have the app's shape.
+ *
+ * Per mix:
+ *   key / channels / import — reply latency: count, rate and mean / p50 /
+ *             p99 / max in microseconds
+ *   fanout  — time spent in ws_broadcast_frame(), per broadcast
+ *   status / page — broadcast → arrival at the fast clients
+ *   server  — syscalls per message (epoll_wait, epoll_ctl, recv, writev,
+ *             timer reads, over commands received + frames queued), slow
+ *             clients cut off, and the server's RSS now and at peak
+ * Before the mixes, streamed iptv_channels_get requests — one whose parts
+ * reach the end of the list, one that stops short — are checked: every
+ * part must arrive and every next_cursor handed out must continue; the
+ * bench exits 1 otherwise.
+ * With -j every line is a JSON object instead, for scripts and CI. -v
+ * keeps the server's log on stderr. */
+
+#include "ws.h"
+#include "cmd.h"
+#include "wire.h"
+#include "iptv.h"
+#include "iptv_pages.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#define TICK_MS       20      /* status broadcast period */
+#define PAGE_TICKS    50      /* ... and a channel page every 50 ticks */
+#define PAGE_SIZE     500
+#define KEY_BURST     10
+#define SLOW_READ     4096    /* a slow reader takes this much ... */
+#define SLOW_EVERY_MS 100     /* ... this often */
+#define MAX_INFLIGHT  16
+
+static int g_json;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* ── Samples ──────────────────────────────────────────────────────────────── */
+
+typedef struct {
+    double *v;
+    int     n, cap;
+} Samples;
+
+static void sample_add(Samples *s, double v) {
+    if (s->n == s->cap) {
+        int     cap = s->cap ? s->cap * 2 : 1024;
+        double *p   = realloc(s->v, cap * sizeof(double));
+        if (!p) return;
+        s->v   = p;
+        s->cap = cap;
+    }
+    s->v[s->n++] = v;
+}
+
+/* Sort, and the mean. */
+static double sample_sort(Samples *s) {
+    double sum = 0;
+    for (int i = 0; i < s->n; i++) sum += s->v[i];
+    qsort(s->v, s->n, sizeof(double), cmp_double);
+    return s->n ? sum / s->n : 0;
+}
+
+static double pct(const Samples *s, int p) { return s->v[(long long)s->n * p / 100]; }
+
+/* ── Server (child process) ───────────────────────────────────────────────── */
+
+static int      s_ep, s_listen, s_timer, s_ctl;
+static uint64_t s_sys;        /* syscalls made by the loop; writev counted by ws.c */
+static uint64_t s_cmds;
+static Samples  s_fan;        /* µs per broadcast since the last bench_stats */
+
+static void srv_poll_cb(int fd, int want_write) {
+    struct epoll_event ev = {
+        .events  = EPOLLIN | EPOLLHUP | EPOLLERR | (want_write ? EPOLLOUT : 0),
+        .data.fd = fd,
+    };
+    epoll_ctl(s_ep, EPOLL_CTL_MOD, fd, &ev);
+    s_sys++;
+}
+
+/* "offset", "total" and a "channels" array of id, name, url and group,
+ * as the app's iptv_channels_get pages. */
+static void encode_page(Wire *w, int off, int limit) {
+    IptvChannelList *l = iptv_get_channels(NULL, NULL);
+    int total = iptv_list_count(l);
+    wire_knum(w, "offset", off);
+    wire_knum(w, "total",  total);
+    wire_key(w, "channels");
+    wire_arr(w);
+    for (int i = off; i < off + limit && i < total; i++) {
+        IptvChannel ch; iptv_list_get(l, i, &ch);
+        wire_obj(w);
+        wire_kstr(w, "id",    ch.id);
+        wire_kstr(w, "name",  ch.name);
+        wire_kstr(w, "url",   ch.url);
+        wire_kstr(w, "group", ch.group);
+        wire_end(w);
+    }
+    wire_end(w);
+    iptv_list_free(l);
+}
+
+static void on_key(CmdCtx *c) { cmd_wire_send(c, cmd_wire_begin(c, "ack")); }
+
+static void on_playlist_import(CmdCtx *c) {
+    char id[32];
+    int  count = -1;
+    if (iptv_import_begin(cmd_str(c, "name", "Imported"), id, sizeof(id)) >= 0) {
+        if (iptv_import_batch(id, cmd_raw(c, "channels")) >= 0)
+            count = iptv_import_commit(id);
+        iptv_remove_playlist(id);
+    }
+    if (count < 0) { cmd_error(c, "playlist import failed"); return; }
+    Wire *w = cmd_wire_begin(c, "playlist_import");
+    wire_knum(w, "channel_count", count);
+    cmd_wire_send(c, w);
+}
+
+/* Cumulative counters, and the fan-out samples since the last call. */
+static void on_bench_stats(CmdCtx *c) {
+    WsStats st;
+    ws_get_stats(&st);
+    double mean = sample_sort(&s_fan);
+    Wire *w = cmd_wire_begin(c, "bench_stats");
+    wire_knum(w, "cmds",      (double)s_cmds);
+    wire_knum(w, "queued",    (double)st.queued);
+    wire_knum(w, "syscalls",  (double)(s_sys + st.writes));
+    wire_knum(w, "cut_off",   (double)st.cut_off);
+    wire_knum(w, "fan_n",     s_fan.n);
+    if (s_fan.n) {
+        wire_knum(w, "fan_mean", mean);
+        wire_knum(w, "fan_p50",  pct(&s_fan, 50));
+        wire_knum(w, "fan_p99",  pct(&s_fan, 99));
+        wire_knum(w, "fan_max",  s_fan.v[s_fan.n - 1]);
+    }
+    cmd_wire_send(c, w);
+    s_fan.n = 0;
+}
+
+static const CmdDef k_bench_cmds[] = {
+    { "key",               on_key,             { { "key",    CMD_ARG_STR, 1 } }, CMD_QUIET },
+    { "playlist_import",   on_playlist_import, { { "name",     CMD_ARG_STR,   0 },
+                                                 { "channels", CMD_ARG_ARRAY, 1 } },
+                                               CMD_QUIET | CMD_RAW },
+    { "bench_stats",       on_bench_stats,     { { 0 } }, CMD_QUIET },
+};
+
+static void on_msg(int client, const char *json) {
+    s_cmds++;
+    cmd_dispatch(client, json);
+}
+
+static void broadcast(const Wire *w, int key) {
+    double   t0 = now_us();
+    WsFrame *f  = ws_frame_wire(w, NULL);
+    ws_broadcast_frame(f, key);
+    ws_frame_unref(f);
+    sample_add(&s_fan, now_us() - t0);
+}
+
+static void tick(void) {
+    static unsigned seq;
+    static Wire     w;
+    seq++;
+    wire_reset(&w, WIRE_JSON);
+    wire_obj(&w);
+    wire_kstr(&w, "type", "status_delta");
+    wire_knum(&w, "t",        now_us());
+    wire_knum(&w, "seq",      seq);
+    wire_knum(&w, "position", seq * (TICK_MS / 1000.0));
+    wire_end(&w);
+    broadcast(&w, 1);
+
+    if (seq % PAGE_TICKS) return;
+    wire_reset(&w, WIRE_JSON);
+    wire_obj(&w);
+    wire_kstr(&w, "type", "iptv_channels");
+    wire_knum(&w, "t", now_us());
+    encode_page(&w, (int)(seq / PAGE_TICKS * PAGE_SIZE % 10000), PAGE_SIZE);
+    wire_end(&w);
+    broadcast(&w, 0);
+}
+
+static void ep_add(int fd) {
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLHUP | EPOLLERR, .data.fd = fd };
+    epoll_ctl(s_ep, EPOLL_CTL_ADD, fd, &ev);
+    s_sys++;
+}
+
+/* Synthetic playlist: Cyrillic names, long tokenised URLs, 20 per group. */
+static void write_playlist(const char *path, int channels) {
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    fputs("#EXTM3U\n", f);
+    for (int ch = 0; ch < channels; ch++) {
+        unsigned t = (unsigned)ch * 2246822519u;
+        fprintf(f, "#EXTINF:-1 tvg-id=\"ch%d\" group-title=\"Группа %d\",Канал %d HD\n"
+                   "http://edge%02u.stream.example/live/hls/%d/playlist_1080p.m3u8"
+                   "?token=%08x%08x%08x&sig=%08x%08x\n",
+                ch, ch / 20, ch, t % 64, ch, t, t ^ 0x5bd1e995u, t * 3u, t * 7u, t * 11u);
+    }
+    fclose(f);
+}
+
+static void rm_tree(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        if (e->d_type == DT_DIR) rm_tree(path);
+        else                     unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+/* Runs until the parent closes ctl. Writes the port to ready once
+ * listening (0 on failure). */
+static void serve(int channels, int import, int ready, int ctl) {
+    char dir[] = "/tmp/qaryx_bench_ws_XXXXXX", path[512];
+    uint16_t port = 0;
+    if (!mkdtemp(dir)) { perror("mkdtemp"); goto fail; }
+    iptv_set_data_dir(dir);
+    iptv_set_limits(channels + import, 8, (channels + import) / 1000 * 2 + 64);
+    iptv_load();
+    snprintf(path, sizeof(path), "%s/bench.m3u", dir);
+    write_playlist(path, channels);
+    char url[600];
+    snprintf(url, sizeof(url), "file://%s", path);
+    if (iptv_add_playlist(url, "Bench") < 0) { fprintf(stderr, "bench: catalog failed\n"); goto fail; }
+
+    cmd_register(k_bench_cmds, sizeof(k_bench_cmds) / sizeof(k_bench_cmds[0]));
+    iptv_pages_register();
+    if (ws_init(0, on_msg) < 0) goto fail;
+    ws_set_poll_cb(srv_poll_cb);
+    s_listen = ws_listen_fd();
+    struct sockaddr_in6 addr;
+    socklen_t alen = sizeof(addr);
+    getsockname(s_listen, (struct sockaddr *)&addr, &alen);
+    port = ntohs(addr.sin6_port);   /* same offset in sockaddr_in */
+
+    s_ep    = epoll_create1(EPOLL_CLOEXEC);
+    s_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    s_ctl   = ctl;
+    struct itimerspec its = { { 0, TICK_MS * 1000000L }, { 0, TICK_MS * 1000000L } };
+    timerfd_settime(s_timer, 0, &its, NULL);
+    ep_add(s_listen);
+    ep_add(s_timer);
+    ep_add(s_ctl);
+    if (write(ready, &port, sizeof(port)) != sizeof(port)) goto done;
+
+    for (;;) {
+        struct epoll_event ev[64];
+        int n = epoll_wait(s_ep, ev, 64, 100);
+        s_sys++;
+        for (int i = 0; i < n; i++) {
+            int fd = ev[i].data.fd;
+            if (fd == s_ctl) goto done;
+            if (fd == s_listen) {
+                int c = ws_accept();
+                s_sys++;
+                if (c >= 0) ep_add(c);
+            } else if (fd == s_timer) {
+                uint64_t x;
+                if (read(s_timer, &x, sizeof(x)) > 0) { tick(); ws_tick(); }
+                s_sys++;
+            } else {
+                /* A closed client leaves the epoll set with its fd */
+                int gone = 0;
+                if (ev[i].events & EPOLLOUT) gone = ws_client_write(fd) < 0;
+                if (!gone && (ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    s_sys++;
+                    gone = ws_client_read(fd) < 0;
+                }
+                if (gone) iptv_pages_client_gone(fd);
+            }
+        }
+    }
+fail:
+    if (write(ready, &port, sizeof(port)) < 0) {}
+done:
+    ws_destroy();
+    rm_tree(dir);
+}
+
+/* ── Clients ──────────────────────────────────────────────────────────────── */
+
+enum { K_KEY, K_CHANNELS, K_IMPORT, K_N };
+static const char *const k_kind[K_N] = { "key", "channels", "import" };
+
+typedef struct {
+    int      fd;
+    int      slow;
+    int      dead;
+    char    *buf;
+    size_t   len, cap;
+    double   sent[MAX_INFLIGHT];   /* by req_id % MAX_INFLIGHT */
+    int      kind[MAX_INFLIGHT];
+    int      inflight;
+    unsigned req;
+    double   next_read;            /* slow readers */
+} Client;
+
+static Client  *g_cl;
+static int      g_ncl, g_nfast;
+static int      g_ep;
+static uint16_t g_port;
+static int      g_mix;             /* -1 = mixed */
+static int      g_running;         /* issue new commands on replies */
+static int      g_channels;
+static char    *g_import;          /* playlist_import message up to its req_id */
+static size_t   g_import_len;
+static Samples  g_lat[K_N], g_status, g_page;
+static char     g_stats[4096];     /* last bench_stats reply */
+static int      g_have_stats;
+static Client  *g_probe;           /* its replies are kept, see probe() */
+static char    *g_probe_msg[16];
+static int      g_nprobe;
+
+static void send_all(int fd, const void *p, size_t n) {
+    const char *b = p;
+    while (n > 0) {
+        ssize_t w = send(fd, b, n, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) return;
+            struct pollfd pf = { fd, POLLOUT, 0 };
+            poll(&pf, 1, 1000);
+            continue;
+        }
+        b += w;
+        n -= (size_t)w;
+    }
+}
+
+/* One masked text frame. The masking key is all zeros: the server still
+ * unmasks, and the client stays cheap next to what it measures. */
+static void send_text(Client *c, const char *msg, size_t n) {
+    uint8_t h[14];
+    int     hl = 0;
+    h[hl++] = 0x81;
+    if (n < 126)        { h[hl++] = 0x80 | (uint8_t)n; }
+    else if (n < 65536) { h[hl++] = 0x80 | 126; h[hl++] = (uint8_t)(n >> 8); h[hl++] = (uint8_t)n; }
+    else {
+        h[hl++] = 0x80 | 127;
+        for (int i = 7; i >= 0; i--) h[hl++] = (uint8_t)(n >> (i * 8));
+    }
+    memset(h + hl, 0, 4);
+    hl += 4;
+    send_all(c->fd, h, hl);
+    send_all(c->fd, msg, n);
+}
+
+static void send_cmd(Client *c, int kind) {
+    char     msg[160];
+    unsigned id = ++c->req;
+    c->sent[id % MAX_INFLIGHT] = now_us();
+    c->kind[id % MAX_INFLIGHT] = kind;
+    c->inflight++;
+    switch (kind) {
+    case K_KEY:
+        send_text(c, msg, (size_t)snprintf(msg, sizeof(msg),
+                  "{\"cmd\":\"key\",\"key\":\"%s\",\"req_id\":%u}",
+                  id % 2 ? "down" : "up", id));
+        break;
+    case K_CHANNELS: {
+        int limit = 100 + rand() % (PAGE_SIZE - 99);
+        send_text(c, msg, (size_t)snprintf(msg, sizeof(msg),
+                  "{\"cmd\":\"iptv_channels_get\",\"offset\":%d,\"limit\":%d,\"req_id\":%u}",
+                  rand() % g_channels, limit, id));
+        break;
+    }
+    default: {
+        int n = snprintf(g_import + g_import_len, 32, "%u}", id);
+        send_text(c, g_import, g_import_len + (size_t)n);
+    }
+    }
+}
+
+static void issue(Client *c) {
+    int kind = g_mix;
+    if (kind < 0) {
+        int r = rand() % 100;
+        kind = r < 80 ? K_KEY : r < 98 ? K_CHANNELS : K_IMPORT;
+    }
+    for (int i = 0; i < (kind == K_KEY ? KEY_BURST : 1); i++) send_cmd(c, kind);
+}
+
+/* Value of "key": in a flat message, or def. */
+static double msg_num(const char *msg, const char *key, double def) {
+    char pat[48];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char *p = strstr(msg, pat);
+    return p ? strtod(p + strlen(pat), NULL) : def;
+}
+
+static void on_message(Client *c, const char *msg) {
+    const char *r = strstr(msg, "\"req_id\":");
+    if (c == g_probe) {
+        if (r && g_nprobe < (int)(sizeof(g_probe_msg) / sizeof(g_probe_msg[0])))
+            g_probe_msg[g_nprobe++] = strdup(msg);
+        return;
+    }
+    if (r) {
+        unsigned id = (unsigned)strtoul(r + 9, NULL, 10);
+        if (!strncmp(msg, "{\"type\":\"bench_stats\"", 21)) {
+            snprintf(g_stats, sizeof(g_stats), "%s", msg);
+            g_have_stats = 1;
+            return;
+        }
+        if (c->inflight <= 0) return;
+        sample_add(&g_lat[c->kind[id % MAX_INFLIGHT]], now_us() - c->sent[id % MAX_INFLIGHT]);
+        if (--c->inflight == 0 && g_running) issue(c);
+        return;
+    }
+    /* Broadcasts carry the time they were made */
+    double t = msg_num(msg, "t", 0);
+    if (!t) return;
+    if (!strncmp(msg, "{\"type\":\"status_delta\"", 22)) sample_add(&g_status, now_us() - t);
+    else                                                 sample_add(&g_page,   now_us() - t);
+}
+
+static void client_close(Client *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd       = -1;
+    c->dead     = 1;
+    c->len      = 0;
+    c->inflight = 0;
+}
+
+/* Everything a fast client has been sent so far. */
+static void client_read(Client *c) {
+    for (;;) {
+        if (c->cap - c->len < 65536) {
+            size_t cap = c->cap * 2 > c->len + 65536 ? c->cap * 2 : c->len + 65536;
+            char  *p   = realloc(c->buf, cap);
+            if (!p) { client_close(c); return; }
+            c->buf = p;
+            c->cap = cap;
+        }
+        ssize_t n = recv(c->fd, c->buf + c->len, c->cap - c->len - 1, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) { client_close(c); return; }
+        if (n < 0) break;
+        c->len += (size_t)n;
+    }
+    size_t off = 0;
+    while (c->len - off >= 2) {
+        uint8_t *b  = (uint8_t *)c->buf + off;
+        uint64_t pl = b[1] & 0x7f;
+        size_t   hl = 2;
+        if (pl == 126) {
+            if (c->len - off < 4) break;
+            pl = (uint64_t)b[2] << 8 | b[3];
+            hl = 4;
+        } else if (pl == 127) {
+            if (c->len - off < 10) break;
+            pl = 0;
+            for (int i = 0; i < 8; i++) pl = pl << 8 | b[2 + i];
+            hl = 10;
+        }
+        if (c->len - off < hl + pl) break;
+        if ((b[0] & 0x0f) == 0x8) { client_close(c); return; }
+        if ((b[0] & 0x0f) == 0x1) {
+            char saved = (char)b[hl + pl];
+            b[hl + pl] = '\0';
+            on_message(c, (char *)b + hl);
+            b[hl + pl] = (uint8_t)saved;
+        }
+        off += hl + pl;
+    }
+    memmove(c->buf, c->buf + off, c->len - off);
+    c->len -= off;
+}
+
+/* Connect and upgrade, blocking; then non-blocking. Returns 0 or -1. */
+static int client_open(Client *c) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) return -1;
+    if (c->slow) {
+        int small = SLOW_READ;
+        setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    }
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons(g_port),
+                             .sin_addr = { htonl(INADDR_LOOPBACK) } };
+    if (connect(c->fd, (struct sockaddr *)&a, sizeof(a)) < 0) { client_close(c); return -1; }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    static const char req[] =
+        "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    send_all(c->fd, req, sizeof(req) - 1);
+
+    /* Read the reply a byte at a time so no frame after it is consumed */
+    char hdr[1024];
+    size_t n = 0;
+    while (n < sizeof(hdr) - 1 && (n < 4 || memcmp(hdr + n - 4, "\r\n\r\n", 4))) {
+        if (recv(c->fd, hdr + n, 1, 0) != 1) { client_close(c); return -1; }
+        n++;
+    }
+    hdr[n] = '\0';
+    if (!strstr(hdr, " 101 ")) { client_close(c); return -1; }
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+    c->dead      = 0;
+    c->len       = 0;
+    c->inflight  = 0;
+    c->next_read = now_us();
+    if (!c->slow) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        epoll_ctl(g_ep, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+    return 0;
+}
+
+/* Serve the clients for up to ms milliseconds. */
+static void pump(int ms) {
+    struct epoll_event ev[64];
+    int n = epoll_wait(g_ep, ev, 64, ms);
+    for (int i = 0; i < n; i++) {
+        Client *c = ev[i].data.ptr;
+        if (!c->dead) client_read(c);
+    }
+    /* Slow readers nibble on a timer, whatever is waiting */
+    double t = now_us();
+    for (int i = 0; i < g_ncl; i++) {
+        Client *c = &g_cl[i];
+        if (!c->slow || c->dead || t < c->next_read) continue;
+        char    scratch[SLOW_READ];
+        ssize_t r = recv(c->fd, scratch, sizeof(scratch), 0);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) client_close(c);
+        c->next_read += SLOW_EVERY_MS * 1000.0;
+    }
+}
+
+/* Cumulative server counters (resetting its fan-out samples). */
+static int server_stats(char *out, size_t cap) {
+    Client *c = &g_cl[0];
+    if (c->dead) return -1;
+    g_have_stats = 0;
+    send_text(c, "{\"cmd\":\"bench_stats\",\"req_id\":0}", 32);
+    for (double end = now_us() + 5e6; !g_have_stats && !c->dead && now_us() < end; ) pump(10);
+    if (!g_have_stats) return -1;
+    snprintf(out, cap, "%s", g_stats);
+    return 0;
+}
+
+static long proc_kb(pid_t pid, const char *field) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    FILE *f = fopen(path, "r");
+    long  kb = -1;
+    if (!f) return -1;
+    while (fgets(line, sizeof(line), f))
+        if (!strncmp(line, field, strlen(field))) kb = atol(line + strlen(field));
+    fclose(f);
+    return kb;
+}
+
+/* ── Stream check ─────────────────────────────────────────────────────────── */
+
+/* Send msg from the probe client and wait for n replies. Returns how many
+ * came, in g_probe_msg. */
+static void probe_clear(void) {
+    for (int i = 0; i < g_nprobe; i++) free(g_probe_msg[i]);
+    g_nprobe = 0;
+}
+
+static int probe(const char *msg, int n) {
+    probe_clear();
+    send_text(g_probe, msg, strlen(msg));
+    for (double end = now_us() + 5e6; g_nprobe < n && !g_probe->dead && now_us() < end; )
+        pump(10);
+    return g_nprobe;
+}
+
+/* A streamed iptv_channels_get from offset: all its parts must arrive, and
+ * each next_cursor among them must continue. Returns the failures. */
+static int check_stream(int offset) {
+    int  parts = (g_channels - offset + PAGE_SIZE - 1) / PAGE_SIZE, fail = 0, ntok = 0;
+    char msg[256], tok[8][32];
+    if (parts > 8) parts = 8;
+    snprintf(msg, sizeof(msg), "{\"cmd\":\"iptv_channels_get\",\"offset\":%d,\"limit\":%d,"
+                               "\"stream\":true,\"req_id\":1}", offset, PAGE_SIZE);
+    if (probe(msg, parts) < parts) {
+        fprintf(stderr, "bench: stream from %d: %d of %d parts\n", offset, g_nprobe, parts);
+        return 1;
+    }
+    for (int i = 0; i < g_nprobe && ntok < 8; i++) {
+        const char *t = strstr(g_probe_msg[i], "\"next_cursor\":\"");
+        if (t) sscanf(t + 15, "%31[^\"]", tok[ntok++]);
+    }
+    for (int i = 0; i < ntok; i++) {
+        snprintf(msg, sizeof(msg), "{\"cmd\":\"iptv_channels_get\",\"cursor\":\"%.31s\","
+                                   "\"limit\":%d,\"req_id\":2}", tok[i], PAGE_SIZE);
+        if (probe(msg, 1) < 1 || strncmp(g_probe_msg[0], "{\"type\":\"iptv_channels\"", 23)) {
+            fprintf(stderr, "bench: stream from %d: cursor %s does not continue: %.80s\n",
+                    offset, tok[i], g_nprobe ? g_probe_msg[0] : "no reply");
+            fail++;
+        }
+    }
+    return fail;
+}
+
+/* ── Reporting ────────────────────────────────────────────────────────────── */
+
+static void report_lat(const char *mix, const char *what, Samples *s, double secs) {
+    if (!s->n) return;
+    double mean = sample_sort(s);
+    if (g_json)
+        printf("{\"mix\":\"%s\",\"op\":\"%s\",\"n\":%d,\"per_s\":%.0f,\"mean_us\":%.1f,"
+               "\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+               mix, what, s->n, s->n / secs, mean, pct(s, 50), pct(s, 99), s->v[s->n - 1]);
+    else
+        printf("%-8s  %-8s  %7d  %8.0f /s  mean %9.1f  p50 %9.1f  p99 %9.1f  max %9.1f us\n",
+               mix, what, s->n, s->n / secs, mean, pct(s, 50), pct(s, 99), s->v[s->n - 1]);
+    s->n = 0;
+}
+
+static void run_mix(const char *mix, double secs, pid_t server) {
+    /* Everyone starts connected: slow readers cut off last round come back */
+    for (int i = 0; i < g_ncl; i++)
+        if (g_cl[i].dead && client_open(&g_cl[i]) < 0)
+            fprintf(stderr, "bench: client %d could not reconnect\n", i);
+
+    char before[4096], after[4096];
+    if (server_stats(before, sizeof(before)) < 0) {
+        fprintf(stderr, "bench: server not answering\n");
+        exit(1);
+    }
+    g_status.n = g_page.n = 0;
+    for (int k = 0; k < K_N; k++) g_lat[k].n = 0;
+
+    g_running = 1;
+    double t0 = now_us();
+    for (int i = 0; i < g_nfast; i++) if (!g_cl[i].dead) issue(&g_cl[i]);
+    while (now_us() - t0 < secs * 1e6) pump(5);
+    g_running = 0;
+    double elapsed = (now_us() - t0) / 1e6;
+
+    /* Let what's in flight come back */
+    for (double end = now_us() + 5e6; now_us() < end; ) {
+        int busy = 0;
+        for (int i = 0; i < g_nfast; i++) busy |= !g_cl[i].dead && g_cl[i].inflight > 0;
+        if (!busy) break;
+        pump(5);
+    }
+    if (server_stats(after, sizeof(after)) < 0) {
+        fprintf(stderr, "bench: server not answering\n");
+        exit(1);
+    }
+
+    for (int k = 0; k < K_N; k++) report_lat(mix, k_kind[k], &g_lat[k], elapsed);
+    report_lat(mix, "status", &g_status, elapsed);
+    report_lat(mix, "page",   &g_page,   elapsed);
+
+    double msgs = msg_num(after, "cmds", 0) + msg_num(after, "queued", 0)
+                - msg_num(before, "cmds", 0) - msg_num(before, "queued", 0);
+    double sys  = msg_num(after, "syscalls", 0) - msg_num(before, "syscalls", 0);
+    int    cut  = (int)(msg_num(after, "cut_off", 0) - msg_num(before, "cut_off", 0));
+    int    fan_n = (int)msg_num(after, "fan_n", 0);
+    long   rss = proc_kb(server, "VmRSS:"), hwm = proc_kb(server, "VmHWM:");
+    if (g_json) {
+        printf("{\"mix\":\"%s\",\"op\":\"fanout\",\"n\":%d,\"mean_us\":%.1f,\"p50_us\":%.1f,"
+               "\"p99_us\":%.1f,\"max_us\":%.1f}\n", mix, fan_n,
+               msg_num(after, "fan_mean", 0), msg_num(after, "fan_p50", 0),
+               msg_num(after, "fan_p99", 0), msg_num(after, "fan_max", 0));
+        printf("{\"mix\":\"%s\",\"op\":\"server\",\"msgs\":%.0f,\"syscalls_per_msg\":%.3f,"
+               "\"cut_off\":%d,\"rss_kb\":%ld,\"peak_kb\":%ld}\n",
+               mix, msgs, msgs > 0 ? sys / msgs : 0, cut, rss, hwm);
+    } else {
+        printf("%-8s  %-8s  %7d  %10s  mean %9.1f  p50 %9.1f  p99 %9.1f  max %9.1f us\n",
+               mix, "fanout", fan_n, "",
+               msg_num(after, "fan_mean", 0), msg_num(after, "fan_p50", 0),
+               msg_num(after, "fan_p99", 0), msg_num(after, "fan_max", 0));
+        printf("%-8s  %-8s  %7.0f msgs  %6.2f syscalls/msg  %d cut off  rss %ld KB (peak %ld KB)\n",
+               mix, "server", msgs, msgs > 0 ? sys / msgs : 0, cut, rss, hwm);
+    }
+    fflush(stdout);
+}
+
+/* {"cmd":"playlist_import","name":..,"channels":[..],"req_id": — the id
+ * and closing brace are written per send, into the spare room. */
+static void build_import(int n) {
+    size_t cap = (size_t)n * 256 + 128, len = 0;
+    g_import = malloc(cap + 32);
+    if (!g_import) exit(1);
+    len += (size_t)snprintf(g_import, cap, "{\"cmd\":\"playlist_import\",\"name\":\"Bench import\","
+                                           "\"channels\":[");
+    for (int i = 0; i < n; i++)
+        len += (size_t)snprintf(g_import + len, cap - len,
+                                "%s{\"name\":\"Импорт %d\",\"url\":\"http://import.example/live/%d/"
+                                "index.m3u8?token=%08x%08x\",\"group\":\"Импорт %d\"}",
+                                i ? "," : "", i, i, i * 2654435761u, i * 40503u, i / 20);
+    len += (size_t)snprintf(g_import + len, cap - len, "],\"req_id\":");
+    g_import_len = len;
+}
+
+int main(int argc, char **argv) {
+    int    fast = 8, slow = 2, import = 2000, verbose = 0;
+    double secs = 3;
+    int    opt;
+    g_channels = 20000;
+    while ((opt = getopt(argc, argv, "c:s:d:n:i:jv")) != -1) {
+        switch (opt) {
+        case 'c': fast       = atoi(optarg); break;
+        case 's': slow       = atoi(optarg); break;
+        case 'd': secs       = atof(optarg); break;
+        case 'n': g_channels = atoi(optarg); break;
+        case 'i': import     = atoi(optarg); break;
+        case 'j': g_json     = 1;            break;
+        case 'v': verbose    = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-c clients] [-s slow] [-d seconds] [-n channels] "
+                            "[-i import] [-j] [-v] [key|channels|import|mixed...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (fast < 1)        fast = 1;
+    if (slow < 0)        slow = 0;
+    if (fast + slow > WS_MAX_CLIENTS) slow = WS_MAX_CLIENTS - fast > 0 ? WS_MAX_CLIENTS - fast : 0;
+    if (fast > WS_MAX_CLIENTS) fast = WS_MAX_CLIENTS;
+    if (g_channels < PAGE_SIZE) g_channels = PAGE_SIZE;
+    if (import < 1)      import = 1;
+    if (secs <= 0)       secs = 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    int ready[2], ctl[2];
+    if (pipe(ready) < 0 || pipe(ctl) < 0) { perror("pipe"); return 1; }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); return 1; }
+    if (pid == 0) {
+        close(ready[0]);
+        close(ctl[1]);
+        if (!verbose) {
+            int null = open("/dev/null", O_WRONLY);
+            if (null >= 0) { dup2(null, 2); close(null); }
+        }
+        serve(g_channels, import, ready[1], ctl[0]);
+        _exit(0);
+    }
+    close(ready[1]);
+    close(ctl[0]);
+    if (read(ready[0], &g_port, sizeof(g_port)) != sizeof(g_port) || !g_port) {
+        fprintf(stderr, "bench: server failed to start (run with -v)\n");
+        return 1;
+    }
+
+    build_import(import);
+    srand(42);
+    g_ep    = epoll_create1(EPOLL_CLOEXEC);
+    g_nfast = fast;
+    g_ncl   = fast + slow;
+    g_cl    = calloc(g_ncl, sizeof(Client));
+    for (int i = 0; i < g_ncl; i++) {
+        g_cl[i].slow = i >= fast;
+        if (client_open(&g_cl[i]) < 0) { fprintf(stderr, "bench: connect failed\n"); return 1; }
+    }
+
+    /* The first fast client probes before the mixes start */
+    g_probe = &g_cl[0];
+    int fail = check_stream(g_channels > 3 * PAGE_SIZE ? g_channels - 3 * PAGE_SIZE + 100 : 0) +
+               check_stream(0);
+    probe_clear();
+    g_probe = NULL;
+
+    static const char *const mixes[] = { "key", "channels", "import", "mixed" };
+    int nmix = argc - optind;
+    for (int i = 0; i < (nmix ? nmix : 4); i++) {
+        const char *mix = nmix ? argv[optind + i] : mixes[i];
+        g_mix = -2;
+        for (int k = 0; k < K_N; k++) if (!strcmp(mix, k_kind[k])) g_mix = k;
+        if (!strcmp(mix, "mixed")) g_mix = -1;
+        if (g_mix == -2) { fprintf(stderr, "bench: unknown mix '%s'\n", mix); continue; }
+        run_mix(mix, secs, pid);
+    }
+
+    for (int i = 0; i < g_ncl; i++) { client_close(&g_cl[i]); free(g_cl[i].buf); }
+    close(ctl[1]);                   /* the server exits */
+    int status;
+    waitpid(pid, &status, 0);
+    free(g_cl);
+    free(g_import);
+    return fail ? 1 : 0;
+}
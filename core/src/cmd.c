@@ -0,0 +1,497 @@
+#include "cmd.h"
+#include "ws.h"
+#include "jpull.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ── Table ────────────────────────────────────────────────────────────────── */
+
+/* Latency buckets: bucket b counts calls under 2^b µs (bucket 0: under
+ * 1 µs), the last one everything slower. */
+#define CMD_HIST_BUCKETS 16
+
+typedef struct {
+    const CmdDef *def;
+    size_t        len;       /* strlen(def->name) */
+    int           flat;      /* scalar arguments only, or CMD_RAW: no cJSON tree */
+    uint64_t      calls, errors, total_us, max_us;
+    uint32_t      hist[CMD_HIST_BUCKETS];
+} CmdEntry;
+
+/* Commands in registration order, and an open-addressing table over their
+ * names (index + 1, 0 = empty) kept at most half full. Dispatch runs on the
+ * event loop only, so the counters need no locking. */
+static CmdEntry *g_cmds  = NULL;
+static int       g_ncmds = 0;
+static int      *g_slots = NULL;
+static uint32_t  g_mask  = 0;
+static uint64_t  g_unknown, g_bad_json;
+
+/* Messages that need a tree are parsed into one arena, reset after each,
+ * so most of them cost no malloc at all. */
+static cJSON_Arena *g_arena = NULL;
+
+static uint32_t name_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) { h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
+}
+
+static CmdEntry *lookup(const char *name, size_t len) {
+    if (!g_slots) return NULL;
+    for (uint32_t i = name_hash(name, len);; i++) {
+        int k = g_slots[i & g_mask];
+        if (!k) return NULL;
+        CmdEntry *e = &g_cmds[k - 1];
+        if (e->len == len && !memcmp(e->def->name, name, len)) return e;
+    }
+}
+
+static int rehash(uint32_t cap) {
+    int *slots = calloc(cap, sizeof(int));
+    if (!slots) return -1;
+    for (int k = 0; k < g_ncmds; k++) {
+        uint32_t i = name_hash(g_cmds[k].def->name, g_cmds[k].len);
+        while (slots[i & (cap - 1)]) i++;
+        slots[i & (cap - 1)] = k + 1;
+    }
+    free(g_slots);
+    g_slots = slots;
+    g_mask  = cap - 1;
+    return 0;
+}
+
+int cmd_register(const CmdDef *defs, int n) {
+    CmdEntry *t = realloc(g_cmds, (g_ncmds + n) * sizeof(CmdEntry));
+    if (!t) return -1;
+    g_cmds = t;
+    for (int k = 0; k < n; k++) {
+        size_t len = strlen(defs[k].name);
+        if (lookup(defs[k].name, len)) {
+            fprintf(stderr, "cmd: '%s' registered twice\n", defs[k].name);
+            return -1;
+        }
+        CmdEntry *e = &g_cmds[g_ncmds++];
+        memset(e, 0, sizeof(*e));
+        e->def  = &defs[k];
+        e->len  = len;
+        e->flat = 1;
+        for (int i = 0; i < CMD_MAX_ARGS && defs[k].args[i].name; i++)
+            if (defs[k].args[i].type == CMD_ARG_ARRAY || defs[k].args[i].type == CMD_ARG_OBJECT)
+                e->flat = (defs[k].flags & CMD_RAW) != 0;
+        if ((uint32_t)g_ncmds * 2 > g_mask + 1 || !g_slots) {
+            uint32_t cap = 16;
+            while (cap < (uint32_t)g_ncmds * 2) cap *= 2;
+            if (rehash(cap) < 0) return -1;
+        } else {
+            uint32_t i = name_hash(e->def->name, len);
+            while (g_slots[i & g_mask]) i++;
+            g_slots[i & g_mask] = g_ncmds;
+        }
+    }
+    return 0;
+}
+
+/* ── Top-level scan ───────────────────────────────────────────────────────── */
+
+/* Walks the members of a JSON object without building anything: string
+ * values are unescaped into a small buffer, numbers and literals decoded,
+ * nested values skipped. Anything it can't handle (escaped keys, long
+ * strings, too many members) makes dispatch fall back to cJSON. */
+#define SCAN_FIELDS 16
+#define SCAN_BUF    2048
+
+typedef struct {
+    const char *key;       /* not NUL-terminated */
+    size_t      klen;
+    CmdVal      v;
+} ScanField;
+
+typedef struct {
+    const char *p;
+    char       *out, *end; /* free part of the string buffer */
+    int         done;      /* closing brace reached */
+} Scan;
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+static int hex4(const char *p) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        int  d = c >= '0' && c <= '9' ? c - '0' :
+                 c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                 c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0) return -1;
+        v = v << 4 | d;
+    }
+    return v;
+}
+
+/* Unescape the string starting at p (the opening quote) into the buffer.
+ * Returns the position after the closing quote, or NULL. */
+static const char *scan_str(Scan *s, const char *p, const char **out) {
+    char *o = s->out;
+    for (p++; *p != '"'; ) {
+        if (!*p || o + 5 > s->end) return NULL;
+        if (*p != '\\') { *o++ = *p++; continue; }
+        p++;
+        char c = *p++;
+        switch (c) {
+        case '"': case '\\': case '/': *o++ = c; break;
+        case 'b': *o++ = '\b'; break;
+        case 'f': *o++ = '\f'; break;
+        case 'n': *o++ = '\n'; break;
+        case 'r': *o++ = '\r'; break;
+        case 't': *o++ = '\t'; break;
+        case 'u': {
+            int cp = hex4(p);
+            if (cp < 0) return NULL;
+            p += 4;
+            if (cp >= 0xD800 && cp < 0xDC00 && p[0] == '\\' && p[1] == 'u') {
+                int lo = hex4(p + 2);
+                if (lo < 0xDC00 || lo > 0xDFFF) return NULL;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+            }
+            if (cp < 0x80)         { *o++ = (char)cp; }
+            else if (cp < 0x800)   { *o++ = (char)(0xC0 | cp >> 6);  *o++ = (char)(0x80 | (cp & 0x3F)); }
+            else if (cp < 0x10000) { *o++ = (char)(0xE0 | cp >> 12); *o++ = (char)(0x80 | (cp >> 6 & 0x3F));
+                                     *o++ = (char)(0x80 | (cp & 0x3F)); }
+            else                   { *o++ = (char)(0xF0 | cp >> 18); *o++ = (char)(0x80 | (cp >> 12 & 0x3F));
+                                     *o++ = (char)(0x80 | (cp >> 6 & 0x3F)); *o++ = (char)(0x80 | (cp & 0x3F)); }
+            break;
+        }
+        default: return NULL;
+        }
+    }
+    *o++ = '\0';
+    *out   = s->out;
+    s->out = o;
+    return p + 1;
+}
+
+static const char *skip_nested(const char *p) {
+    int depth = 0;
+    do {
+        if (*p == '"') {
+            for (p++; *p != '"'; p++) {
+                if (!*p) return NULL;
+                if (*p == '\\' && !*++p) return NULL;
+            }
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+        } else if (!*p) {
+            return NULL;
+        }
+        p++;
+    } while (depth > 0);
+    return p;
+}
+
+/* Read one member into f. Returns 0, or -1 to give up on the scan. */
+static int scan_field(Scan *s, ScanField *f) {
+    const char *p = s->p;
+    if (*p != '"') return -1;
+    f->key = ++p;
+    while (*p && *p != '"' && *p != '\\') p++;
+    if (*p != '"') return -1;
+    f->klen = (size_t)(p - f->key);
+    p = skip_ws(p + 1);
+    if (*p != ':') return -1;
+    p = skip_ws(p + 1);
+
+    memset(&f->v, 0, sizeof(f->v));
+    if (*p == '"') {
+        f->v.type = CMD_ARG_STR;
+        p = scan_str(s, p, &f->v.str);
+    } else if (*p == '{' || *p == '[') {
+        f->v.type = *p == '{' ? CMD_ARG_OBJECT : CMD_ARG_ARRAY;
+        f->v.raw  = p;
+        p = skip_nested(p);
+    } else if (!strncmp(p, "true", 4) || !strncmp(p, "false", 5)) {
+        f->v.type = CMD_ARG_BOOL;
+        f->v.num  = *p == 't';
+        p += *p == 't' ? 4 : 5;
+    } else if (!strncmp(p, "null", 4)) {
+        p += 4;
+    } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        char *end;
+        f->v.type = CMD_ARG_NUM;
+        f->v.num  = strtod(p, &end);
+        p = end;
+    } else {
+        return -1;
+    }
+    if (!p) return -1;
+    p = skip_ws(p);
+    if (*p == '}')      s->done = 1;
+    else if (*p != ',') return -1;
+    s->p = skip_ws(p + 1);
+    return 0;
+}
+
+/* ── Dispatch ─────────────────────────────────────────────────────────────── */
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static CmdVal tree_val(const cJSON *req, const char *name) {
+    CmdVal v = { 0 };
+    const cJSON *it = cJSON_GetObjectItem(req, name);
+    if (!it) return v;
+    switch (it->type) {
+    case CJSON_STRING: v.type = CMD_ARG_STR;    v.str  = it->valuestring; break;
+    case CJSON_NUMBER: v.type = CMD_ARG_NUM;    v.num  = it->valuedouble; break;
+    case CJSON_BOOL:   v.type = CMD_ARG_BOOL;   v.num  = it->valuebool;   break;
+    case CJSON_ARRAY:  v.type = CMD_ARG_ARRAY;  v.item = it;              break;
+    case CJSON_OBJECT: v.type = CMD_ARG_OBJECT; v.item = it;              break;
+    default: break;
+    }
+    return v;
+}
+
+static const ScanField *scan_find(const ScanField *f, int n, const char *name) {
+    size_t len = strlen(name);
+    for (int i = 0; i < n; i++)
+        if (f[i].klen == len && !memcmp(f[i].key, name, len)) return &f[i];
+    return NULL;
+}
+
+static const char *type_name(CmdArgType t) {
+    switch (t) {
+    case CMD_ARG_STR:    return "a string";
+    case CMD_ARG_NUM:    return "a number";
+    case CMD_ARG_BOOL:   return "a boolean";
+    case CMD_ARG_ARRAY:  return "an array";
+    case CMD_ARG_OBJECT: return "an object";
+    default:             return "null";
+    }
+}
+
+static cJSON *parse_req(const char *json) {
+    if (!g_arena && !(g_arena = cJSON_ArenaNew())) return NULL;
+    cJSON_ArenaReset(g_arena);          /* what a failed parse left behind */
+    return cJSON_ParseIn(g_arena, json);
+}
+
+void cmd_dispatch(int client, const char *json) {
+    long long t0 = now_us();
+
+    /* Find "cmd" without parsing; for scalar-only commands keep going and
+     * take the arguments from the scan too */
+    ScanField f[SCAN_FIELDS];
+    char      buf[SCAN_BUF];
+    Scan      s = { skip_ws(json), buf, buf + sizeof(buf), 0 };
+    CmdEntry *e = NULL;
+    int       n = 0, scanned = 0, named = 0;
+    if (*s.p == '{') {
+        s.p = skip_ws(s.p + 1);
+        s.done = *s.p == '}';
+        while (!s.done && n < SCAN_FIELDS && scan_field(&s, &f[n]) == 0) {
+            ScanField *k = &f[n++];
+            if (k->klen == 3 && !memcmp(k->key, "cmd", 3) && k->v.type == CMD_ARG_STR) {
+                named = 1;
+                e = lookup(k->v.str, strlen(k->v.str));
+                if (!e || !e->flat) break;
+            }
+        }
+        scanned = s.done;
+    }
+
+    cJSON *req = NULL;
+    if (!e && !named) {
+        /* Scan gave up before "cmd" (or there is none): ask cJSON */
+        req = parse_req(json);
+        if (!req) {
+            fprintf(stderr, "ws recv: JSON parse failed\n");
+            g_bad_json++;
+            return;
+        }
+        const char *name = cJSON_GetString(req, "cmd", "");
+        e = lookup(name, strlen(name));
+    }
+    if (!e) {
+        fprintf(stderr, "ws recv: unknown command: %.200s\n", json);
+        g_unknown++;
+        cJSON_ArenaReset(g_arena);
+        return;
+    }
+    if (!(e->def->flags & CMD_QUIET)) fprintf(stderr, "ws recv: %.200s\n", json);
+
+    CmdCtx c = { .client = client, .cmd = e->def->name, .json = json, .def = e->def };
+    if (!req && !(e->flat && scanned)) {
+        req = parse_req(json);
+        if (!req) {
+            fprintf(stderr, "ws recv: JSON parse failed\n");
+            g_bad_json++;
+            e->errors++;
+            return;
+        }
+    }
+    c.req = req;
+    if (req) {
+        c.req_id = tree_val(req, "req_id");
+        for (int i = 0; i < CMD_MAX_ARGS && e->def->args[i].name; i++)
+            c.arg[i] = tree_val(req, e->def->args[i].name);
+    } else {
+        const ScanField *r = scan_find(f, n, "req_id");
+        if (r) c.req_id = r->v;
+        for (int i = 0; i < CMD_MAX_ARGS && e->def->args[i].name; i++) {
+            r = scan_find(f, n, e->def->args[i].name);
+            if (r) c.arg[i] = r->v;
+        }
+    }
+
+    /* Schema check */
+    for (int i = 0; i < CMD_MAX_ARGS && e->def->args[i].name; i++) {
+        const CmdArg *a = &e->def->args[i];
+        if (c.arg[i].type == a->type || (c.arg[i].type == CMD_ARG_NONE && !a->required))
+            continue;
+        char msg[128];
+        if (c.arg[i].type == CMD_ARG_NONE)
+            snprintf(msg, sizeof(msg), "%s: missing '%s'", e->def->name, a->name);
+        else
+            snprintf(msg, sizeof(msg), "%s: '%s' must be %s", e->def->name, a->name,
+                     type_name(a->type));
+        fprintf(stderr, "ws recv: %s\n", msg);
+        cmd_error(&c, msg);
+        break;
+    }
+    if (!c.failed) e->def->fn(&c);
+    if (req) cJSON_ArenaReset(g_arena);
+
+    long long us = now_us() - t0;
+    int b = 0;
+    while (b < CMD_HIST_BUCKETS - 1 && us >= (1ll << b)) b++;
+    e->calls++;
+    e->errors   += c.failed;
+    e->total_us += (uint64_t)us;
+    if ((uint64_t)us > e->max_us) e->max_us = (uint64_t)us;
+    e->hist[b]++;
+}
+
+/* ── Arguments and replies ────────────────────────────────────────────────── */
+
+static const CmdVal *arg_val(const CmdCtx *c, const char *name) {
+    for (int i = 0; c->def && i < CMD_MAX_ARGS && c->def->args[i].name; i++)
+        if (!strcmp(c->def->args[i].name, name)) return &c->arg[i];
+    fprintf(stderr, "cmd: %s: '%s' is not in the schema\n", c->cmd, name);
+    return NULL;
+}
+
+const char *cmd_str(const CmdCtx *c, const char *name, const char *def) {
+    const CmdVal *v = arg_val(c, name);
+    return v && v->type == CMD_ARG_STR ? v->str : def;
+}
+
+double cmd_num(const CmdCtx *c, const char *name, double def) {
+    const CmdVal *v = arg_val(c, name);
+    return v && v->type == CMD_ARG_NUM ? v->num : def;
+}
+
+int cmd_bool(const CmdCtx *c, const char *name, int def) {
+    const CmdVal *v = arg_val(c, name);
+    return v && v->type == CMD_ARG_BOOL ? (int)v->num : def;
+}
+
+const cJSON *cmd_item(const CmdCtx *c, const char *name) {
+    const CmdVal *v = arg_val(c, name);
+    return v ? v->item : NULL;
+}
+
+const char *cmd_raw(const CmdCtx *c, const char *name) {
+    const CmdVal *v = arg_val(c, name);
+    if (!v || (v->type != CMD_ARG_ARRAY && v->type != CMD_ARG_OBJECT)) return NULL;
+    if (v->raw) return v->raw;
+
+    /* The scan gave up and the message went through cJSON: find the member
+     * in the text again */
+    JPull       j = {0};
+    const char *at = NULL;
+    JpTok       t;
+    jp_init(&j, c->json);
+    if (jp_next(&j) == JP_OBJ) {
+        while (!at && (t = jp_next(&j)) != JP_CLOSE && t != JP_ERROR) {
+            if (t != JP_OBJ && t != JP_ARR) continue;
+            if (!strcmp(j.key, name)) at = j.at;
+            else if (jp_skip(&j) < 0) break;
+        }
+    }
+    jp_free(&j);
+    return at;
+}
+
+/* One encoder for every reply: handlers run one at a time on the event
+ * loop, and it keeps its buffer between them. */
+static Wire g_reply;
+
+Wire *cmd_wire_begin(CmdCtx *c, const char *type) {
+    wire_reset(&g_reply, ws_client_format(c->client));
+    wire_obj(&g_reply);
+    wire_kstr(&g_reply, "type", type);
+    return &g_reply;
+}
+
+void cmd_wire_send(CmdCtx *c, Wire *w) {
+    if (c->req_id.type == CMD_ARG_STR)      wire_kstr(w, "req_id", c->req_id.str);
+    else if (c->req_id.type == CMD_ARG_NUM) wire_knum(w, "req_id", c->req_id.num);
+    wire_end(w);
+    if (w->failed) fprintf(stderr, "cmd: %s: reply encoding failed\n", c->cmd);
+    else           ws_send_wire(c->client, w);
+}
+
+void cmd_error(CmdCtx *c, const char *msg) {
+    c->failed = 1;
+    Wire *w = cmd_wire_begin(c, "error");
+    wire_kstr(w, "msg", msg);
+    cmd_wire_send(c, w);
+}
+
+/* ── Statistics ───────────────────────────────────────────────────────────── */
+
+/* Upper bound (µs) of the bucket holding quantile q. */
+static uint64_t quantile_us(const CmdEntry *e, double q) {
+    uint64_t want = (uint64_t)(q * (double)e->calls);
+    uint64_t seen = 0;
+    if (want < 1) want = 1;
+    for (int b = 0; b < CMD_HIST_BUCKETS - 1; b++) {
+        seen += e->hist[b];
+        if (seen >= want) return (1ull << b) < e->max_us ? (1ull << b) : e->max_us;
+    }
+    return e->max_us;
+}
+
+void cmd_stats_reply(CmdCtx *c) {
+    Wire *w = cmd_wire_begin(c, "cmd_stats");
+    wire_key(w, "unknown");  wire_int(w, (int64_t)g_unknown);
+    wire_key(w, "bad_json"); wire_int(w, (int64_t)g_bad_json);
+    wire_key(w, "commands");
+    wire_arr(w);
+    for (int k = 0; k < g_ncmds; k++) {
+        const CmdEntry *e = &g_cmds[k];
+        if (!e->calls) continue;
+        wire_obj(w);
+        wire_kstr (w, "cmd",     e->def->name);
+        wire_key  (w, "calls");   wire_int(w, (int64_t)e->calls);
+        wire_key  (w, "errors");  wire_int(w, (int64_t)e->errors);
+        wire_knum (w, "mean_us", (double)e->total_us / (double)e->calls);
+        wire_key  (w, "p50_us");  wire_int(w, (int64_t)quantile_us(e, 0.50));
+        wire_key  (w, "p99_us");  wire_int(w, (int64_t)quantile_us(e, 0.99));
+        wire_key  (w, "max_us");  wire_int(w, (int64_t)e->max_us);
+        wire_kbool(w, "tree",    !e->flat);
+        wire_end(w);
+    }
+    wire_end(w);
+    cmd_wire_send(c, w);
+}
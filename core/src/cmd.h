@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+#include "../third_party/cjson.h"
+#include "wire.h"
+
+/* WebSocket command table.
+ *
+ * Each area of the app registers its commands at startup: a name, a
+ * handler and the arguments it takes. Dispatch looks the name up in a hash
+ * table, checks the arguments against the schema and times the handler,
+ * keeping call counts and a latency histogram per command.
+ *
+ * The command name is found by a scan of the message's top level that
+ * allocates nothing. Commands whose arguments are all scalars (key, seek,
+ * volume, ...) take their values from that same scan and never build a
+ * cJSON tree; the others get the parsed message as well. */
+
+typedef enum {
+    CMD_ARG_NONE = 0,      /* absent (or null) */
+    CMD_ARG_STR,
+    CMD_ARG_NUM,
+    CMD_ARG_BOOL,
+    CMD_ARG_ARRAY,
+    CMD_ARG_OBJECT,
+} CmdArgType;
+
+#define CMD_MAX_ARGS 8
+
+typedef struct {
+    const char *name;
+    CmdArgType  type;
+    int         required;
+} CmdArg;
+
+typedef struct {
+    CmdArgType   type;
+    const char  *str;      /* CMD_ARG_STR */
+    double       num;      /* CMD_ARG_NUM, CMD_ARG_BOOL */
+    const cJSON *item;     /* CMD_ARG_ARRAY / CMD_ARG_OBJECT */
+    const char  *raw;      /* CMD_ARG_ARRAY / CMD_ARG_OBJECT: its text, when not parsed */
+} CmdVal;
+
+typedef struct CmdCtx {
+    int          client;   /* sender's fd, for cmd_wire_send() */
+    const char  *cmd;
+    const char  *json;     /* the raw message */
+    const cJSON *req;      /* parsed message; NULL for scalar-only commands */
+    CmdVal       req_id;   /* "req_id", echoed in replies */
+    CmdVal       arg[CMD_MAX_ARGS];   /* in schema order */
+    const struct CmdDef *def;
+    int          failed;
+} CmdCtx;
+
+typedef void (*CmdFn)(CmdCtx *c);
+
+/* Flags */
+#define CMD_QUIET 1        /* don't log each call (frequent or read-only) */
+#define CMD_RAW   2        /* leave array/object arguments unparsed: cmd_raw() */
+
+typedef struct CmdDef {
+    const char *name;
+    CmdFn       fn;
+    CmdArg      args[CMD_MAX_ARGS];   /* up to the first with name NULL */
+    int         flags;
+} CmdDef;
+
+/* Add n commands. defs must stay valid; call before dispatching starts.
+   Returns -1 on a duplicate name or out of memory. */
+int  cmd_register(const CmdDef *defs, int n);
+
+/* Parse, validate and run one message from client. */
+void cmd_dispatch(int client, const char *json);
+
+/* Argument values by name (as declared in the schema), or def if absent. */
+const char  *cmd_str (const CmdCtx *c, const char *name, const char *def);
+double       cmd_num (const CmdCtx *c, const char *name, double def);
+int          cmd_bool(const CmdCtx *c, const char *name, int def);
+const cJSON *cmd_item(const CmdCtx *c, const char *name);
+
+/* Text of an array or object argument, for CMD_RAW commands that read it
+   with jpull.h (cmd_item() is then NULL). It runs on past the value, to the
+   end of the message. NULL if absent. */
+const char  *cmd_raw (const CmdCtx *c, const char *name);
+
+/* Replies, encoded directly in the client's format: cmd_wire_begin()
+   opens the message object with its "type" and returns the shared encoder;
+   add the rest of the fields, then cmd_wire_send() appends req_id, closes
+   it and sends it. */
+Wire *cmd_wire_begin(CmdCtx *c, const char *type);
+void  cmd_wire_send (CmdCtx *c, Wire *w);
+
+/* Reply {"type":"error","msg":msg} and count the call as failed. */
+void cmd_error(CmdCtx *c, const char *msg);
+
+/* Reply with the counters and latency percentiles of every command, as a
+   "cmd_stats" message. */
+void cmd_stats_reply(CmdCtx *c);
@@ -1,4 +1,6 @@
 #include "config.h"
+#include "iptv.h"
+#include "ws.h"
 #include "../third_party/cjson.h"
 #include <stdio.h>
 #include <string.h>
@@ -13,6 +15,11 @@ static void set_defaults(Config *cfg) {
     cfg->screen_w = 1920;
     cfg->screen_h = 1080;
     strcpy(cfg->ytdlp_quality, "720");
+    cfg->iptv_max_channels  = IPTV_DEFAULT_MAX_CHANNELS;
+    cfg->iptv_max_playlists = IPTV_DEFAULT_MAX_PLAYLISTS;
+    cfg->iptv_mem_mb        = IPTV_DEFAULT_MEM_MB;
+    cfg->ws_max_msg_mb      = WS_DEFAULT_MAX_MESSAGE >> 20;
+    cfg->status_pos_ms      = 1000;
 }
 
 void config_load(Config *cfg) {
@@ -40,6 +47,11 @@ void config_load(Config *cfg) {
     cfg->volume   = (int)     cJSON_GetNumber(j, "volume",   cfg->volume);
     cfg->screen_w = (int)     cJSON_GetNumber(j, "screen_w", cfg->screen_w);
     cfg->screen_h = (int)     cJSON_GetNumber(j, "screen_h", cfg->screen_h);
+    cfg->iptv_max_channels  = (int)cJSON_GetNumber(j, "iptv_max_channels",  cfg->iptv_max_channels);
+    cfg->iptv_max_playlists = (int)cJSON_GetNumber(j, "iptv_max_playlists", cfg->iptv_max_playlists);
+    cfg->iptv_mem_mb        = (int)cJSON_GetNumber(j, "iptv_mem_mb",        cfg->iptv_mem_mb);
+    cfg->ws_max_msg_mb      = (int)cJSON_GetNumber(j, "ws_max_msg_mb",      cfg->ws_max_msg_mb);
+    cfg->status_pos_ms      = (int)cJSON_GetNumber(j, "status_pos_ms",      cfg->status_pos_ms);
 
     const char *s;
     if ((s = cJSON_GetString(j, "data_dir",    NULL))) strncpy(cfg->data_dir,    s, sizeof(cfg->data_dir)-1);
@@ -48,6 +60,7 @@ void config_load(Config *cfg) {
     if ((s = cJSON_GetString(j, "ytdlp_quality", NULL))) strncpy(cfg->ytdlp_quality, s, sizeof(cfg->ytdlp_quality)-1);
     if ((s = cJSON_GetString(j, "iptv_proxy",       NULL))) strncpy(cfg->iptv_proxy,       s, sizeof(cfg->iptv_proxy)-1);
     if ((s = cJSON_GetString(j, "youtube_channel",  NULL))) strncpy(cfg->youtube_channel,  s, sizeof(cfg->youtube_channel)-1);
+    if ((s = cJSON_GetString(j, "epg_url",          NULL))) strncpy(cfg->epg_url,          s, sizeof(cfg->epg_url)-1);
 
     cJSON_Delete(j);
 }
@@ -14,6 +14,12 @@ typedef struct {
     char     ytdlp_quality[16]; /* max resolution: "480", "720", "1080". Default "720" */
     char     iptv_proxy[256];   /* optional HTTP proxy for IPTV M3U download + stream playback */
     char     youtube_channel[512]; /* default YouTube channel/playlist URL to show on startup */
+    int      iptv_max_channels;    /* across all playlists, default 200000 */
+    int      iptv_max_playlists;   /* default 256 */
+    int      iptv_mem_mb;          /* channel data budget, default 64 */
+    char     epg_url[512];         /* optional XMLTV guide (.xml or .xml.gz), fetched at startup */
+    int      ws_max_msg_mb;        /* largest WebSocket message accepted, default 16 */
+    int      status_pos_ms;        /* least interval between position updates, default 1000 */
 } Config;
 
 /* Load config from CONFIG_FILE. Missing keys get defaults. */
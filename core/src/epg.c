@@ -0,0 +1,576 @@
+#include "epg.h"
+#include "xmltv.h"
+#include "http_dl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+/* ── On-disk layout ───────────────────────────────────────────────────────────
+ *   EpgHdr
+ *   EpgChan[chan_count]     at chan_off
+ *   EpgProg[prog_count]     at prog_off — grouped by channel, sorted by start
+ *   EpgKey[key_cap]         at id_off   — tvg-id → channel (open addressing)
+ *   EpgKey[key_cap]         at name_off — folded display name → channel
+ *   char strings[str_len]   at str_off, offset 0 == ""
+ * The checksum covers the tables; strings are only bounds-checked, since
+ * descriptions make up most of the file and damage there is harmless. */
+
+#define EPG_MAGIC   0x50455851u   /* "QXEP" */
+#define EPG_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t prog_size;
+    uint32_t chan_count;
+    uint32_t prog_count;
+    uint32_t key_cap;
+    uint32_t chan_off;
+    uint32_t prog_off;
+    uint32_t id_off;
+    uint32_t name_off;
+    uint32_t str_off;
+    uint32_t str_len;
+    uint32_t checksum;
+} EpgHdr;
+
+typedef struct {
+    uint32_t id;          /* XMLTV channel id */
+    uint32_t name;        /* first display name */
+    uint32_t first;       /* programmes [first, first + count) */
+    uint32_t count;
+} EpgChan;
+
+typedef struct {
+    uint32_t start;       /* UTC seconds */
+    uint32_t stop;
+    uint32_t title;
+    uint32_t desc;
+} EpgProg;
+
+typedef struct {
+    uint32_t str;         /* key string offset */
+    uint32_t chan;        /* channel + 1, 0 = empty */
+} EpgKey;
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= 16777619u; }
+    return h;
+}
+
+/* Display names match case-insensitively (ASCII). */
+static uint32_t fold_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        h ^= c; h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t id_hash(const char *s) { return fnv1a(2166136261u, s, strlen(s)); }
+
+static char g_dir[300] = "/var/lib/qaryxos";
+
+void epg_set_data_dir(const char *dir) {
+    if (dir && *dir) snprintf(g_dir, sizeof(g_dir), "%s", dir);
+}
+
+static void epg_path(char *buf, size_t cap, const char *suffix) {
+    snprintf(buf, cap, "%s/" EPG_FILE "%s", g_dir, suffix);
+}
+
+/* ── Guide generations ────────────────────────────────────────────────────── */
+
+struct Epg {
+    atomic_int     refs;
+    void          *map;
+    size_t         len;
+    uint32_t       chan_count, prog_count, key_cap, str_len;
+    const EpgChan *chans;
+    const EpgProg *progs;
+    const EpgKey  *ids, *names;
+    const char    *strs;
+};
+
+static Epg                g_epg_empty;
+static _Atomic(Epg *)     g_epg = NULL;
+static atomic_int         g_epg_readers;
+
+Epg *epg_acquire(void) {
+    atomic_fetch_add(&g_epg_readers, 1);
+    Epg *e = atomic_load(&g_epg);
+    if (e) atomic_fetch_add_explicit(&e->refs, 1, memory_order_relaxed);
+    atomic_fetch_sub(&g_epg_readers, 1);
+    return e ? e : &g_epg_empty;
+}
+
+void epg_release(Epg *e) {
+    if (!e || e == &g_epg_empty) return;
+    if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_acq_rel) == 1) {
+        munmap(e->map, e->len);
+        free(e);
+    }
+}
+
+static void install(Epg *e) {
+    Epg *old = atomic_exchange(&g_epg, e);
+    while (atomic_load(&g_epg_readers) > 0) sched_yield();
+    epg_release(old);
+}
+
+static Epg *epg_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(EpgHdr)) { close(fd); return NULL; }
+    size_t sz  = (size_t)st.st_size;
+    void  *map = mmap(NULL, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const EpgHdr *h    = map;
+    const char   *base = map;
+    uint64_t keys_sz   = (uint64_t)h->key_cap * sizeof(EpgKey);
+    if (h->magic != EPG_MAGIC || h->version != EPG_VERSION ||
+        h->prog_size != sizeof(EpgProg) || h->chan_off != sizeof(EpgHdr) ||
+        (h->key_cap & (h->key_cap - 1)) || h->key_cap < h->chan_count ||
+        (uint64_t)h->chan_off + (uint64_t)h->chan_count * sizeof(EpgChan) != h->prog_off ||
+        (uint64_t)h->prog_off + (uint64_t)h->prog_count * sizeof(EpgProg) != h->id_off ||
+        (uint64_t)h->id_off + keys_sz != h->name_off ||
+        (uint64_t)h->name_off + keys_sz != h->str_off ||
+        h->str_len == 0 || (uint64_t)h->str_off + h->str_len != sz ||
+        base[sz - 1] != '\0' ||
+        fnv1a(2166136261u, base + h->chan_off, h->str_off - h->chan_off) != h->checksum) {
+        fprintf(stderr, "epg: %s: bad or damaged file\n", path);
+        munmap(map, sz);
+        return NULL;
+    }
+
+    const EpgChan *c = (const EpgChan *)(base + h->chan_off);
+    const EpgProg *p = (const EpgProg *)(base + h->prog_off);
+    const EpgKey  *k = (const EpgKey *)(base + h->id_off);
+    int bad = 0;
+    for (uint32_t i = 0; i < h->chan_count; i++)
+        bad |= c[i].id >= h->str_len || c[i].name >= h->str_len ||
+               (uint64_t)c[i].first + c[i].count > h->prog_count;
+    for (uint32_t i = 0; i < h->prog_count; i++)
+        bad |= p[i].title >= h->str_len || p[i].desc >= h->str_len;
+    for (uint32_t i = 0; i < 2 * h->key_cap; i++)   /* both key tables */
+        bad |= k[i].str >= h->str_len || k[i].chan > h->chan_count;
+    if (bad) {
+        fprintf(stderr, "epg: %s: offsets out of range\n", path);
+        munmap(map, sz);
+        return NULL;
+    }
+
+    Epg *e = calloc(1, sizeof(*e));
+    if (!e) { munmap(map, sz); return NULL; }
+    atomic_init(&e->refs, 1);
+    e->map        = map;
+    e->len        = sz;
+    e->chan_count = h->chan_count;
+    e->prog_count = h->prog_count;
+    e->key_cap    = h->key_cap;
+    e->str_len    = h->str_len;
+    e->chans      = c;
+    e->progs      = p;
+    e->ids        = k;
+    e->names      = k + h->key_cap;
+    e->strs       = base + h->str_off;
+    return e;
+}
+
+void epg_load(void) {
+    char path[320];
+    epg_path(path, sizeof(path), "");
+    Epg *e = epg_open(path);
+    if (!e) return;
+    fprintf(stderr, "epg: %u channels, %u programmes\n", e->chan_count, e->prog_count);
+    install(e);
+}
+
+/* ── Queries ──────────────────────────────────────────────────────────────── */
+
+long epg_find(const Epg *e, const char *tvg_id, const char *name) {
+    if (!e->key_cap) return -1;
+    uint32_t mask = e->key_cap - 1;
+    if (tvg_id && *tvg_id) {
+        for (uint32_t i = id_hash(tvg_id);; i++) {
+            const EpgKey *k = &e->ids[i & mask];
+            if (!k->chan) break;
+            if (!strcmp(e->strs + k->str, tvg_id)) return (long)k->chan - 1;
+        }
+    }
+    if (name && *name) {
+        for (uint32_t i = fold_hash(name);; i++) {
+            const EpgKey *k = &e->names[i & mask];
+            if (!k->chan) break;
+            if (!strcasecmp(e->strs + k->str, name)) return (long)k->chan - 1;
+        }
+    }
+    return -1;
+}
+
+static void fill(const Epg *e, const EpgProg *p, EpgProgramme *out) {
+    out->start = p->start;
+    out->stop  = p->stop;
+    out->title = e->strs + p->title;
+    out->desc  = e->strs + p->desc;
+}
+
+/* Index within the run of the last programme starting at or before t,
+ * or -1 if all start later. Runs never overlap, so that is the only
+ * candidate for "on air at t". */
+static long at_or_before(const EpgProg *run, uint32_t n, int64_t t) {
+    uint32_t lo = 0, hi = n;                /* first with start > t */
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((int64_t)run[mid].start <= t) lo = mid + 1;
+        else                              hi = mid;
+    }
+    return (long)lo - 1;
+}
+
+int epg_now_next(const Epg *e, long ch, time_t t, EpgProgramme *now, EpgProgramme *next) {
+    if (ch < 0 || (uint32_t)ch >= e->chan_count) return 0;
+    const EpgChan *c   = &e->chans[ch];
+    const EpgProg *run = e->progs + c->first;
+    long i = at_or_before(run, c->count, t);
+    int  got = 0;
+    if (i >= 0 && (int64_t)run[i].stop > t) {
+        if (now) fill(e, &run[i], now);
+        got |= 1;
+    }
+    if ((uint32_t)(i + 1) < c->count) {
+        if (next) fill(e, &run[i + 1], next);
+        got |= 2;
+    }
+    return got;
+}
+
+int epg_range(const Epg *e, long ch, time_t from, time_t to,
+              EpgProgramme *out, int max) {
+    if (ch < 0 || (uint32_t)ch >= e->chan_count) return 0;
+    const EpgChan *c   = &e->chans[ch];
+    const EpgProg *run = e->progs + c->first;
+    long i = at_or_before(run, c->count, from);
+    if (i < 0 || (int64_t)run[i].stop <= from) i++;
+    int n = 0;
+    for (; (uint32_t)i < c->count && (int64_t)run[i].start < to; i++, n++)
+        if (n < max) fill(e, &run[i], &out[n]);
+    return n;
+}
+
+/* ── Building ─────────────────────────────────────────────────────────────── */
+
+/* While a guide streams in, programme records (16 bytes + channel) stay in
+ * memory for the final sort, but their text goes straight to a temporary
+ * strings file — descriptions are most of a guide. */
+
+typedef struct {
+    char    *id;          /* owned copy, for lookups during the build */
+    uint32_t hash;
+    uint32_t id_off, name_off;
+} BChan;
+
+typedef struct { uint32_t chan; EpgProg p; } BProg;
+typedef struct { uint32_t hash, str, chan; } BName;
+
+typedef struct {
+    BChan    *chans;  uint32_t nchan, chan_cap;
+    uint32_t *chash;  uint32_t chash_cap;     /* id → channel + 1 */
+    BName    *names;  uint32_t nname, name_cap;
+    BProg    *progs;  size_t   nprog, prog_cap;
+    FILE     *strs;   uint32_t str_len;
+    int64_t   now;
+    int       failed;
+
+    XmltvParser xp;
+    z_stream    z;
+    int         probed, gz;
+    int         gz_end;      /* the last gzip member was complete */
+} Builder;
+
+static uint32_t b_str(Builder *b, const char *s) {
+    if (!s || !*s || b->failed) return 0;
+    size_t n = strlen(s) + 1;
+    if (b->str_len + n > UINT32_MAX / 2) { b->failed = 1; return 0; }
+    if (fwrite(s, 1, n, b->strs) != n)  { b->failed = 1; return 0; }
+    uint32_t off = b->str_len;
+    b->str_len += (uint32_t)n;
+    return off;
+}
+
+static int chash_grow(Builder *b) {
+    uint32_t  cap = b->chash_cap ? b->chash_cap * 2 : 1024;
+    uint32_t *h   = calloc(cap, sizeof(uint32_t));
+    if (!h) return -1;
+    for (uint32_t c = 0; c < b->nchan; c++) {
+        uint32_t i = b->chans[c].hash;
+        while (h[i & (cap - 1)]) i++;
+        h[i & (cap - 1)] = c + 1;
+    }
+    free(b->chash);
+    b->chash     = h;
+    b->chash_cap = cap;
+    return 0;
+}
+
+/* Channel index of an XMLTV id, adding it on first sight; -1 on failure. */
+static long b_chan(Builder *b, const char *id) {
+    if (b->nchan * 2 >= b->chash_cap && chash_grow(b) < 0) { b->failed = 1; return -1; }
+    uint32_t hash = id_hash(id), i = hash;
+    for (;; i++) {
+        uint32_t c = b->chash[i & (b->chash_cap - 1)];
+        if (!c) break;
+        if (!strcmp(b->chans[c - 1].id, id)) return (long)c - 1;
+    }
+    if (b->nchan == b->chan_cap) {
+        uint32_t cap = b->chan_cap ? b->chan_cap * 2 : 256;
+        BChan *nc = realloc(b->chans, cap * sizeof(BChan));
+        if (!nc) { b->failed = 1; return -1; }
+        b->chans    = nc;
+        b->chan_cap = cap;
+    }
+    char *dup = strdup(id);
+    if (!dup) { b->failed = 1; return -1; }
+    uint32_t c = b->nchan++;
+    b->chans[c] = (BChan){ dup, hash, b_str(b, id), 0 };
+    b->chash[i & (b->chash_cap - 1)] = c + 1;
+    return c;
+}
+
+static void on_channel(const char *id, const char *name, void *ud) {
+    Builder *b = ud;
+    long c = b_chan(b, id);
+    if (c < 0 || !*name) return;
+    uint32_t off = b_str(b, name);
+    if (!b->chans[c].name_off) b->chans[c].name_off = off;
+    if (b->nname == b->name_cap) {
+        uint32_t cap = b->name_cap ? b->name_cap * 2 : 256;
+        BName *nn = realloc(b->names, cap * sizeof(BName));
+        if (!nn) { b->failed = 1; return; }
+        b->names    = nn;
+        b->name_cap = cap;
+    }
+    b->names[b->nname++] = (BName){ fold_hash(name), off, (uint32_t)c };
+}
+
+static void on_programme(const XmltvProgramme *p, void *ud) {
+    Builder *b = ud;
+    int64_t end = p->stop ? p->stop : p->start;
+    if (end < b->now - EPG_KEEP_PAST || p->start > b->now + EPG_MAX_AHEAD) return;
+    if (p->start < 0 || p->start > UINT32_MAX || end > UINT32_MAX) return;
+    long c = b_chan(b, p->channel);
+    if (c < 0) return;
+    if (b->nprog == b->prog_cap) {
+        size_t cap = b->prog_cap ? b->prog_cap * 2 : 4096;
+        BProg *np = realloc(b->progs, cap * sizeof(BProg));
+        if (!np) { b->failed = 1; return; }
+        b->progs    = np;
+        b->prog_cap = cap;
+    }
+    b->progs[b->nprog++] = (BProg){ (uint32_t)c, {
+        (uint32_t)p->start, (uint32_t)p->stop, b_str(b, p->title), b_str(b, p->desc) } };
+}
+
+/* Body chunks: sniff gzip on the first bytes, inflate if needed, parse. */
+static int on_chunk(const char *data, size_t len, void *ud) {
+    Builder *b = ud;
+    if (!b->probed && len > 0) {
+        b->probed = 1;
+        b->gz = len >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+        if (b->gz && inflateInit2(&b->z, 16 + MAX_WBITS) != Z_OK) return 0;
+    }
+    if (!b->gz) {
+        xmltv_feed(&b->xp, data, len);
+        return !b->failed;
+    }
+
+    char out[65536];
+    b->z.next_in  = (Bytef *)data;
+    b->z.avail_in = (uInt)len;
+    while (b->z.avail_in > 0) {
+        b->z.next_out  = (Bytef *)out;
+        b->z.avail_out = sizeof(out);
+        int rc = inflate(&b->z, Z_NO_FLUSH);
+        xmltv_feed(&b->xp, out, sizeof(out) - b->z.avail_out);
+        if (rc == Z_STREAM_END) {
+            b->gz_end = 1;
+            if (b->z.avail_in == 0 || inflateReset(&b->z) != Z_OK) break;   /* next member */
+            b->gz_end = 0;
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            fprintf(stderr, "epg: gzip error %d\n", rc);
+            return 0;
+        } else if (rc == Z_BUF_ERROR && b->z.avail_out == sizeof(out)) {
+            break;                                   /* needs more input */
+        }
+    }
+    return !b->failed;
+}
+
+static int cmp_prog(const void *a, const void *b) {
+    const BProg *x = a, *y = b;
+    if (x->chan != y->chan)         return x->chan < y->chan ? -1 : 1;
+    if (x->p.start != y->p.start)   return x->p.start < y->p.start ? -1 : 1;
+    return 0;
+}
+
+/* Sort programmes into per-channel runs, drop duplicates and make each run
+ * non-overlapping so "on air at t" is a single binary search. */
+static void b_sort(Builder *b) {
+    qsort(b->progs, b->nprog, sizeof(BProg), cmp_prog);
+    size_t o = 0;
+    for (size_t i = 0; i < b->nprog; i++) {
+        if (o > 0 && b->progs[o - 1].chan == b->progs[i].chan &&
+            b->progs[o - 1].p.start == b->progs[i].p.start) continue;
+        b->progs[o++] = b->progs[i];
+    }
+    b->nprog = o;
+    for (size_t i = 0; i < b->nprog; i++) {
+        EpgProg *p    = &b->progs[i].p;
+        int      last = i + 1 == b->nprog || b->progs[i + 1].chan != b->progs[i].chan;
+        uint32_t next = last ? 0 : b->progs[i + 1].p.start;
+        if (!p->stop || p->stop <= p->start)
+            p->stop = last ? p->start + 3600 : next;   /* unknown end: assume an hour */
+        else if (!last && p->stop > next)
+            p->stop = next;
+    }
+}
+
+static void put_key(EpgKey *t, uint32_t mask, uint32_t hash, uint32_t str, uint32_t chan) {
+    while (t[hash & mask].chan) hash++;
+    t[hash & mask] = (EpgKey){ str, chan + 1 };
+}
+
+/* Write the finished guide to path. Returns 0 on success. */
+static int b_write(Builder *b, const char *path, const char *strs_path) {
+    uint32_t need = b->nchan > b->nname ? b->nchan : b->nname;
+    uint32_t cap  = 16;
+    while (cap < need * 2) cap <<= 1;
+
+    EpgChan *chans = calloc(b->nchan ? b->nchan : 1, sizeof(EpgChan));
+    EpgProg *progs = malloc((b->nprog ? b->nprog : 1) * sizeof(EpgProg));
+    EpgKey  *keys  = calloc(2 * (size_t)cap, sizeof(EpgKey));
+    int ok = chans && progs && keys;
+    if (ok) {
+        for (uint32_t c = 0; c < b->nchan; c++) {
+            chans[c].id   = b->chans[c].id_off;
+            chans[c].name = b->chans[c].name_off;
+            put_key(keys, cap - 1, b->chans[c].hash, b->chans[c].id_off, c);
+        }
+        for (uint32_t n = 0; n < b->nname; n++)
+            put_key(keys + cap, cap - 1, b->names[n].hash, b->names[n].str, b->names[n].chan);
+        for (size_t i = 0; i < b->nprog; i++) {
+            EpgChan *c = &chans[b->progs[i].chan];
+            if (!c->count) c->first = (uint32_t)i;
+            c->count++;
+            progs[i] = b->progs[i].p;
+        }
+    }
+
+    size_t chans_sz = (size_t)b->nchan * sizeof(EpgChan);
+    size_t progs_sz = b->nprog * sizeof(EpgProg);
+    size_t keys_sz  = 2 * (size_t)cap * sizeof(EpgKey);
+    EpgHdr h = {
+        .magic      = EPG_MAGIC,
+        .version    = EPG_VERSION,
+        .prog_size  = sizeof(EpgProg),
+        .chan_count = b->nchan,
+        .prog_count = (uint32_t)b->nprog,
+        .key_cap    = cap,
+        .chan_off   = sizeof(EpgHdr),
+        .prog_off   = (uint32_t)(sizeof(EpgHdr) + chans_sz),
+        .id_off     = (uint32_t)(sizeof(EpgHdr) + chans_sz + progs_sz),
+        .name_off   = (uint32_t)(sizeof(EpgHdr) + chans_sz + progs_sz + keys_sz / 2),
+        .str_off    = (uint32_t)(sizeof(EpgHdr) + chans_sz + progs_sz + keys_sz),
+        .str_len    = b->str_len,
+    };
+    if ((uint64_t)h.str_off + b->str_len > UINT32_MAX) ok = 0;
+
+    char tmp[340]; snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f   = ok ? fopen(tmp, "wb") : NULL;
+    FILE *src = ok ? fopen(strs_path, "rb") : NULL;
+    if (f && src) {
+        uint32_t sum = fnv1a(2166136261u, chans, chans_sz);
+        sum = fnv1a(sum, progs, progs_sz);
+        h.checksum = fnv1a(sum, keys, keys_sz);
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(chans, 1, chans_sz, f) == chans_sz &&
+             fwrite(progs, 1, progs_sz, f) == progs_sz &&
+             fwrite(keys,  1, keys_sz,  f) == keys_sz;
+        char buf[65536];
+        size_t n;
+        while (ok && (n = fread(buf, 1, sizeof(buf), src)) > 0)
+            ok = fwrite(buf, 1, n, f) == n;
+    } else {
+        ok = 0;
+    }
+    if (src) fclose(src);
+    if (f && fclose(f) != 0) ok = 0;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    free(chans); free(progs); free(keys);
+    return ok ? 0 : -1;
+}
+
+static void b_free(Builder *b) {
+    for (uint32_t c = 0; c < b->nchan; c++) free(b->chans[c].id);
+    free(b->chans); free(b->chash); free(b->names); free(b->progs);
+    if (b->strs) fclose(b->strs);
+    if (b->gz) inflateEnd(&b->z);
+}
+
+long epg_refresh(const char *url, const char *proxy) {
+    static pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;   /* one build at a time */
+    pthread_mutex_lock(&mu);
+
+    char path[320], strs_path[340];
+    epg_path(path, sizeof(path), "");
+    epg_path(strs_path, sizeof(strs_path), ".strs.tmp");
+    mkdir(g_dir, 0755);
+
+    Builder b = {0};
+    b.now  = time(NULL);
+    b.strs = fopen(strs_path, "w+b");
+    if (b.strs) fputc('\0', b.strs);             /* offset 0: the empty string */
+    b.str_len = 1;
+    xmltv_init(&b.xp, on_channel, on_programme, &b);
+
+    long ret = -1;
+    int got = b.strs && http_dl_stream(url, proxy, on_chunk, &b) == 0 && !b.failed;
+    if (got && b.gz && !b.gz_end) {
+        /* curl saw the whole body, but it ends mid-stream: keep the old guide */
+        fprintf(stderr, "epg: %s: gzip stream truncated\n", url);
+        got = 0;
+    }
+    if (got) {
+        b_sort(&b);
+        if (fflush(b.strs) == 0 && b_write(&b, path, strs_path) == 0) {
+            Epg *e = epg_open(path);
+            if (e) {
+                install(e);
+                ret = (long)b.nprog;
+            }
+        }
+    }
+    fprintf(stderr, "epg: %s: %ld channels, %ld programmes parsed, %ld kept%s\n",
+            url, b.xp.channels, b.xp.programmes, ret < 0 ? 0 : ret,
+            ret < 0 ? " (failed)" : "");
+    b_free(&b);
+    remove(strs_path);
+    pthread_mutex_unlock(&mu);
+    return ret;
+}
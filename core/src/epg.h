@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+/* Electronic programme guide from an XMLTV source.
+ *
+ * A refresh streams the guide (plain or gzip) through the XMLTV parser and
+ * writes <data_dir>/epg.bin: per-channel programme runs sorted by start
+ * time, channel lookup tables and a string blob. Readers mmap that file,
+ * so a guide of any size costs page cache, not heap, and a lookup is one
+ * hash probe plus a binary search over the channel's run.
+ *
+ * Like the IPTV catalog, readers pin an immutable generation lock-free;
+ * a refresh swaps in the new file when it is complete. */
+
+#define EPG_FILE       "epg.bin"
+#define EPG_KEEP_PAST  (24 * 3600)        /* programmes older than this are dropped */
+#define EPG_MAX_AHEAD  (14 * 24 * 3600)   /* ... and those starting further ahead */
+
+typedef struct {
+    int64_t     start;      /* UTC seconds */
+    int64_t     stop;
+    const char *title;
+    const char *desc;
+} EpgProgramme;
+
+typedef struct Epg Epg;
+
+/* Directory holding EPG_FILE. Must be called before epg_load(). */
+void epg_set_data_dir(const char *dir);
+
+/* Map the guide written by the last refresh, if any. */
+void epg_load(void);
+
+/* Download and index an XMLTV guide (http(s):// or file://, optionally
+   gzip-compressed). Blocks; readers keep the old guide until the new one
+   is in place. Returns the number of programmes kept, or -1. */
+long epg_refresh(const char *url, const char *proxy);
+
+/* Pin the current guide. Lock-free; never returns NULL. */
+Epg  *epg_acquire(void);
+void  epg_release(Epg *e);
+
+/* Guide channel for a playlist channel: matched by tvg-id first, then by
+   display name (ASCII case-insensitive). Returns -1 if the guide has neither. */
+long  epg_find(const Epg *e, const char *tvg_id, const char *name);
+
+/* Programme on air at t (*now) and the one after it (*next); either may be
+   NULL. Returns a bit mask: 1 = now filled, 2 = next filled. O(log n). */
+int   epg_now_next(const Epg *e, long ch, time_t t, EpgProgramme *now, EpgProgramme *next);
+
+/* Programmes overlapping [from, to), in start order. Fills at most max
+   entries of out and returns how many overlap in total. O(log n + k). */
+int   epg_range(const Epg *e, long ch, time_t from, time_t to,
+                EpgProgramme *out, int max);
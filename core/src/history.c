@@ -1,9 +1,12 @@
 #include "history.h"
-#include "../third_party/cjson.h"
+#include "wire.h"
+#include "jpull.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 static HistoryEntry g_entries[HISTORY_MAX];
 static int          g_count = 0;
@@ -15,46 +18,60 @@ void history_load(void) {
     fseek(f, 0, SEEK_END); long sz = ftell(f); fseek(f, 0, SEEK_SET);
     char *buf = malloc(sz + 1); fread(buf, 1, sz, f); buf[sz] = '\0'; fclose(f);
 
-    cJSON *arr = cJSON_Parse(buf); free(buf);
-    if (!arr) return;
-    int n = cJSON_GetArraySize(arr);
-    for (int i = 0; i < n && g_count < HISTORY_MAX; i++) {
-        cJSON *o = cJSON_GetArrayItem(arr, i);
-        HistoryEntry *e = &g_entries[g_count++];
-        strncpy(e->url,          cJSON_GetString(o,"url",""),          sizeof(e->url)-1);
-        strncpy(e->title,        cJSON_GetString(o,"title",""),        sizeof(e->title)-1);
-        strncpy(e->content_type, cJSON_GetString(o,"content_type","direct"), sizeof(e->content_type)-1);
-        strncpy(e->channel_name, cJSON_GetString(o,"channel_name",""), sizeof(e->channel_name)-1);
-        strncpy(e->thumbnail,    cJSON_GetString(o,"thumbnail",""),    sizeof(e->thumbnail)-1);
-        e->duration  = cJSON_GetNumber(o,"duration",0);
-        e->position  = cJSON_GetNumber(o,"position",0);
-        e->played_at = (time_t)cJSON_GetNumber(o,"played_at",0);
+    static const char *const keys[] = {
+        "url", "title", "content_type", "channel_name", "thumbnail",
+        "duration", "position", "played_at",
+    };
+    JpVal v[8];
+    JPull j = {0};
+    jp_init(&j, buf);
+    if (jp_next(&j) == JP_ARR) {
+        while (g_count < HISTORY_MAX && jp_fields(&j, keys, 8, v) > 0) {
+            HistoryEntry *e = &g_entries[g_count++];
+            memset(e, 0, sizeof(*e));
+            strncpy(e->url,          jp_vstr(&v[0], ""),       sizeof(e->url)-1);
+            strncpy(e->title,        jp_vstr(&v[1], ""),       sizeof(e->title)-1);
+            strncpy(e->content_type, jp_vstr(&v[2], "direct"), sizeof(e->content_type)-1);
+            strncpy(e->channel_name, jp_vstr(&v[3], ""),       sizeof(e->channel_name)-1);
+            strncpy(e->thumbnail,    jp_vstr(&v[4], ""),       sizeof(e->thumbnail)-1);
+            e->duration  = jp_vnum(&v[5], 0);
+            e->position  = jp_vnum(&v[6], 0);
+            e->played_at = (time_t)jp_vnum(&v[7], 0);
+        }
     }
-    cJSON_Delete(arr);
+    jp_free(&j);
+    free(buf);
 }
 
 void history_save(void) {
-    /* Ensure directory exists */
-    cJSON *arr = cJSON_CreateArray();
+    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", HISTORY_FILE);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+
+    Wire w = {0};
+    wire_reset(&w, WIRE_JSON);
+    wire_to_fd(&w, fd);
+    wire_arr(&w);
     for (int i = 0; i < g_count; i++) {
-        HistoryEntry *e = &g_entries[i];
-        cJSON *o = cJSON_CreateObject();
-        cJSON_AddStringToObject(o, "url",          e->url);
-        cJSON_AddStringToObject(o, "title",        e->title);
-        cJSON_AddStringToObject(o, "content_type", e->content_type);
-        cJSON_AddStringToObject(o, "channel_name", e->channel_name);
-        cJSON_AddStringToObject(o, "thumbnail",    e->thumbnail);
-        cJSON_AddNumberToObject(o, "duration",     e->duration);
-        cJSON_AddNumberToObject(o, "position",     e->position);
-        cJSON_AddNumberToObject(o, "played_at",    (double)e->played_at);
-        cJSON_AddItemToArray(arr, o);
+        const HistoryEntry *e = &g_entries[i];
+        wire_obj(&w);
+        wire_kstr(&w, "url",          e->url);
+        wire_kstr(&w, "title",        e->title);
+        wire_kstr(&w, "content_type", e->content_type);
+        wire_kstr(&w, "channel_name", e->channel_name);
+        wire_kstr(&w, "thumbnail",    e->thumbnail);
+        wire_knum(&w, "duration",     e->duration);
+        wire_knum(&w, "position",     e->position);
+        wire_knum(&w, "played_at",    (double)e->played_at);
+        wire_end(&w);
     }
-    char *s = cJSON_Print(arr); cJSON_Delete(arr);
+    wire_end(&w);
 
-    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", HISTORY_FILE);
-    FILE *f = fopen(tmp, "w");
-    if (f) { fputs(s, f); fclose(f); rename(tmp, HISTORY_FILE); }
-    free(s);
+    int ok = wire_flush(&w) == 0;
+    wire_free(&w);
+    if (close(fd) != 0) ok = 0;
+    if (ok) ok = rename(tmp, HISTORY_FILE) == 0;
+    if (!ok) { remove(tmp); fprintf(stderr, "history: failed to write %s\n", HISTORY_FILE); }
 }
 
 void history_record(const char *url, const char *title,
@@ -3,52 +3,160 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <strings.h>
 
-typedef struct { char *buf; size_t len; size_t cap; } Buf;
+typedef struct { HttpChunkCb cb; void *ud; } StreamCtx;
 
-static size_t write_cb(void *data, size_t size, size_t nmemb, void *ud) {
+static size_t stream_cb(void *data, size_t size, size_t nmemb, void *ud) {
+    StreamCtx *sc = ud;
     size_t bytes = size * nmemb;
-    Buf *b = ud;
-    /* Grow exponentially: O(log n_chunks) reallocs instead of O(n_chunks).
-     * For a 2 MB M3U (128 KB chunks): ~5 reallocs instead of ~128. */
-    if (b->len + bytes + 1 > b->cap) {
-        size_t newcap = b->cap ? b->cap * 2 : 65536;
-        while (newcap < b->len + bytes + 1) newcap *= 2;
-        char *p = realloc(b->buf, newcap);
-        if (!p) return 0;
-        b->buf = p;
-        b->cap = newcap;
-    }
-    memcpy(b->buf + b->len, data, bytes);
-    b->len += bytes;
-    b->buf[b->len] = '\0';
-    return bytes;
+    return sc->cb((const char *)data, bytes, sc->ud) ? bytes : 0;
 }
 
-char *http_dl_string(const char *url, const char *proxy) {
-    CURL *c = curl_easy_init();
-    if (!c) return NULL;
-
-    Buf b = {0};
-    curl_easy_setopt(c, CURLOPT_URL,            url);
-    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION,  write_cb);
-    curl_easy_setopt(c, CURLOPT_WRITEDATA,      &b);
-    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION,    1L);
-    curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT,   10L);  /* fail fast if server unreachable */
-    curl_easy_setopt(c, CURLOPT_TIMEOUT,          30L);
-    curl_easy_setopt(c, CURLOPT_USERAGENT,        "QaryxOS/2.0");
+/* Options shared by every streamed transfer. */
+static void setup_stream(CURL *c, const char *url, const char *proxy, StreamCtx *sc) {
+    curl_easy_setopt(c, CURLOPT_URL,             url);
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION,   stream_cb);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA,       sc);
+    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION,   1L);
+    curl_easy_setopt(c, CURLOPT_FAILONERROR,      1L);  /* a 404 page is not a playlist */
+    curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT,  10L);  /* fail fast if server unreachable */
+    curl_easy_setopt(c, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+    curl_easy_setopt(c, CURLOPT_LOW_SPEED_TIME,  30L);
+    curl_easy_setopt(c, CURLOPT_ACCEPT_ENCODING, "");   /* gzip M3U is ~5x smaller */
+    curl_easy_setopt(c, CURLOPT_USERAGENT,       "QaryxOS/2.0");
     if (proxy && proxy[0])
         curl_easy_setopt(c, CURLOPT_PROXY, proxy);
+}
+
+int http_dl_stream(const char *url, const char *proxy,
+                   HttpChunkCb cb, void *userdata) {
+    CURL *c = curl_easy_init();
+    if (!c) return -1;
+
+    StreamCtx sc = { cb, userdata };
+    setup_stream(c, url, proxy, &sc);
 
     CURLcode res = curl_easy_perform(c);
     curl_easy_cleanup(c);
 
     if (res != CURLE_OK) {
         fprintf(stderr, "http_dl: %s: %s\n", url, curl_easy_strerror(res));
-        free(b.buf);
-        return NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* ── Parallel conditional transfers ──────────────────────────────────────── */
+
+typedef struct {
+    HttpXfer          *x;
+    CURL              *c;         /* NULL once finished */
+    StreamCtx          sc;
+    struct curl_slist *hdrs;
+} MultiItem;
+
+/* Copy a header value (after "Name:") without surrounding space / CRLF. */
+static void header_value(char *dst, size_t cap, const char *v, size_t len) {
+    while (len > 0 && (*v == ' ' || *v == '\t')) { v++; len--; }
+    while (len > 0 && (v[len-1] == '\r' || v[len-1] == '\n' || v[len-1] == ' ')) len--;
+    if (len >= cap) len = cap - 1;
+    memcpy(dst, v, len);
+    dst[len] = '\0';
+}
+
+static size_t header_cb(char *data, size_t size, size_t nitems, void *ud) {
+    HttpXfer *x   = ud;
+    size_t    len = size * nitems;
+    if (len > 5 && !strncmp(data, "HTTP/", 5)) {
+        /* New response (e.g. after a redirect): forget the previous one's */
+        x->etag_out[0] = x->last_modified_out[0] = '\0';
+    } else if (len > 5 && !strncasecmp(data, "ETag:", 5)) {
+        header_value(x->etag_out, sizeof(x->etag_out), data + 5, len - 5);
+    } else if (len > 14 && !strncasecmp(data, "Last-Modified:", 14)) {
+        header_value(x->last_modified_out, sizeof(x->last_modified_out),
+                     data + 14, len - 14);
+    }
+    return len;
+}
+
+int http_dl_multi(HttpXfer *x, int n, const char *proxy, int max_parallel) {
+    if (n <= 0) return 0;
+    CURLM     *m     = curl_multi_init();
+    MultiItem *items = calloc(n, sizeof(MultiItem));
+    if (!m || !items) {
+        if (m) curl_multi_cleanup(m);
+        free(items);
+        for (int i = 0; i < n; i++) x[i].result = HTTP_DL_ERROR;
+        return 0;
+    }
+    curl_multi_setopt(m, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)max_parallel);
+
+    for (int i = 0; i < n; i++) {
+        MultiItem *it = &items[i];
+        it->x  = &x[i];
+        it->sc = (StreamCtx){ x[i].cb, x[i].userdata };
+        x[i].result = HTTP_DL_ERROR;
+        x[i].status = 0;
+        x[i].etag_out[0] = x[i].last_modified_out[0] = '\0';
+
+        CURL *c = curl_easy_init();
+        if (!c) continue;
+        setup_stream(c, x[i].url, proxy, &it->sc);
+        curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, header_cb);
+        curl_easy_setopt(c, CURLOPT_HEADERDATA,     &x[i]);
+        curl_easy_setopt(c, CURLOPT_PRIVATE,        it);
+
+        char h[256];
+        if (x[i].etag && x[i].etag[0]) {
+            snprintf(h, sizeof(h), "If-None-Match: %s", x[i].etag);
+            it->hdrs = curl_slist_append(it->hdrs, h);
+        }
+        if (x[i].last_modified && x[i].last_modified[0]) {
+            snprintf(h, sizeof(h), "If-Modified-Since: %s", x[i].last_modified);
+            it->hdrs = curl_slist_append(it->hdrs, h);
+        }
+        if (it->hdrs) curl_easy_setopt(c, CURLOPT_HTTPHEADER, it->hdrs);
+        curl_multi_add_handle(m, c);
+        it->c = c;
+    }
+
+    int ok = 0, running = 1;
+    while (running) {
+        if (curl_multi_perform(m, &running) != CURLM_OK) break;
+
+        CURLMsg *msg;
+        int      left;
+        while ((msg = curl_multi_info_read(m, &left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL      *c  = msg->easy_handle;
+            MultiItem *it = NULL;
+            curl_easy_getinfo(c, CURLINFO_PRIVATE,       (char **)&it);
+            curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &it->x->status);
+            if (msg->data.result != CURLE_OK) {
+                fprintf(stderr, "http_dl: %s: %s\n", it->x->url,
+                        curl_easy_strerror(msg->data.result));
+            } else {
+                it->x->result = it->x->status == 304 ? HTTP_DL_NOT_MODIFIED : HTTP_DL_OK;
+                ok++;
+            }
+            curl_multi_remove_handle(m, c);
+            curl_easy_cleanup(c);
+            it->c = NULL;
+        }
+        if (running) curl_multi_poll(m, NULL, 0, 1000, NULL);
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (items[i].c) {                 /* only after a multi-level error */
+            curl_multi_remove_handle(m, items[i].c);
+            curl_easy_cleanup(items[i].c);
+        }
+        curl_slist_free_all(items[i].hdrs);
     }
-    return b.buf;
+    free(items);
+    curl_multi_cleanup(m);
+    return ok;
 }
 
 int http_dl_file(const char *url, const char *dest_path) {
@@ -1,10 +1,42 @@
 #pragma once
 #include <stddef.h>
 
-/* Download URL content into a heap-allocated string (caller must free()).
+/* Called for each chunk of the response body as it arrives.
+   Return 0 to abort the transfer, non-zero to continue. */
+typedef int (*HttpChunkCb)(const char *data, size_t len, void *userdata);
+
+/* Stream URL content through cb without buffering the body.
    proxy: optional HTTP/SOCKS proxy URL (e.g. "http://127.0.0.1:10809"), or NULL.
-   Returns NULL on error. Uses libcurl synchronously. */
-char *http_dl_string(const char *url, const char *proxy);
+   Stalls (< 1 KB/s for 30 s) abort instead of a fixed total timeout, so
+   large playlists on slow links still complete. Returns 0 on success. */
+int http_dl_stream(const char *url, const char *proxy,
+                   HttpChunkCb cb, void *userdata);
+
+/* ── Parallel conditional transfers ──────────────────────────────────────── */
+
+#define HTTP_DL_ERROR        -1
+#define HTTP_DL_OK            0
+#define HTTP_DL_NOT_MODIFIED  1   /* 304: validators matched, no body */
+
+typedef struct {
+    /* in */
+    const char *url;
+    const char *etag;           /* sent as If-None-Match when non-empty */
+    const char *last_modified;  /* sent as If-Modified-Since when non-empty */
+    HttpChunkCb cb;             /* body chunks, same contract as http_dl_stream */
+    void       *userdata;
+    /* out */
+    int         result;         /* HTTP_DL_* */
+    long        status;         /* final HTTP status, 0 if none */
+    char        etag_out[128];  /* validators of the response, "" if absent */
+    char        last_modified_out[64];
+} HttpXfer;
+
+/* Run n streaming transfers concurrently on one curl multi handle, with at
+   most max_parallel connections open at a time (the rest queue). Body
+   callbacks of all transfers run on the calling thread. Same timeouts as
+   http_dl_stream. Returns the number of transfers that did not fail. */
+int http_dl_multi(HttpXfer *x, int n, const char *proxy, int max_parallel);
 
 /* Download URL content to a file path.
    Returns 0 on success. */
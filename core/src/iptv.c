@@ -1,5 +1,11 @@
 #include "iptv.h"
+#include "iptv_store.h"
+#include "iptv_index.h"
+#include "iptv_search.h"
+#include "m3u.h"
 #include "http_dl.h"
+#include "wire.h"
+#include "jpull.h"
 #include "../third_party/cjson.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,16 +14,44 @@
 #include <time.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /* ── In-memory state ──────────────────────────────────────────────────────── */
 
-static IptvPlaylist g_playlists[IPTV_MAX_PLAYLISTS];
-static int          g_pl_count = 0;
+static IptvPlaylist *g_playlists = NULL;
+static int           g_pl_count  = 0;
+static int           g_pl_cap    = 0;
 
-static IptvChannel  g_channels[IPTV_MAX_CHANNELS];
-static int          g_ch_count = 0;
+/* Channel store of each playlist, parallel to g_playlists. While a playlist
+ * downloads, its slot points at the store being filled; gmap/gcount record
+ * how much of it is already folded into the global group table, and idx is
+ * rebuilt whenever more of it has been published. */
+typedef struct {
+    IptvStore *store;
+    IptvIndex *idx;       /* id/url/group lookups over the published records */
+    uint32_t  *gmap;      /* store group index → global group id */
+    uint32_t  *gcount;    /* channels per store group counted in g_groups */
+    uint32_t   gmap_n;
+    uint32_t   counted;   /* records folded into the group counts */
+    int        filling;   /* store is still being written by a refresh */
+} PlSlot;
 
-/* Mutex protecting g_playlists, g_channels, g_pl_count, g_ch_count.
+static PlSlot       *g_slots     = NULL;   /* g_pl_cap entries */
+
+/* Group names of all playlists, interned in first-seen order. Id 0 is "no
+ * group". Names are never freed, so catalogs share them without copying. */
+typedef struct { char *name; int count; } GroupEnt;
+
+static GroupEnt    *g_groups      = NULL;
+static uint32_t     g_group_n     = 0;
+static uint32_t     g_group_cap   = 0;
+static uint32_t    *g_ghash       = NULL;   /* open addressing, 0 = empty */
+static uint32_t     g_ghash_cap   = 0;
+
+/* Mutex serialising writers of g_playlists, g_pl_count, g_slots and
+ * g_groups. Readers use catalog generations instead (see below).
  * Recursive so iptv_add_playlist() can call iptv_refresh_playlist() while
  * already holding the lock. */
 static pthread_mutex_t g_mu;
@@ -32,104 +66,207 @@ static void mu_init(void) {
 #define IPTV_LOCK()   do { pthread_once(&g_mu_once, mu_init); pthread_mutex_lock(&g_mu); } while(0)
 #define IPTV_UNLOCK() pthread_mutex_unlock(&g_mu)
 
+static void publish(void);
+
 static char g_proxy[256] = "";
 
+static char g_cache_dir[300]      = IPTV_DEFAULT_DATA_DIR "/iptv";
+static char g_playlists_file[300] = IPTV_DEFAULT_DATA_DIR "/playlists.json";
+
+static uint32_t g_max_channels  = IPTV_DEFAULT_MAX_CHANNELS;
+static int      g_max_playlists = IPTV_DEFAULT_MAX_PLAYLISTS;
+static size_t   g_mem_budget    = (size_t)IPTV_DEFAULT_MEM_MB << 20;
+
+static IptvChangeCb g_change_cb = NULL;
+
+void iptv_set_change_cb(IptvChangeCb cb) { g_change_cb = cb; }
+
 void iptv_set_proxy(const char *proxy) {
     if (proxy) strncpy(g_proxy, proxy, sizeof(g_proxy)-1);
     else        g_proxy[0] = '\0';
 }
 
-/* ── M3U parser ───────────────────────────────────────────────────────────── */
-
-static int parse_m3u(const char *content, const char *pl_id,
-                      IptvChannel *out, int max) {
-    int count = 0;
-    const char *p = content;
-    IptvChannel cur;
-    int has_meta = 0;
-
-    while (*p && count < max) {
-        /* Find next line */
-        const char *line_start = p;
-        const char *line_end   = strchr(p, '\n');
-        if (!line_end) line_end = p + strlen(p);
-
-        /* Copy line */
-        char line[1024];
-        int  llen = (int)(line_end - line_start);
-        if (llen >= (int)sizeof(line)) llen = sizeof(line)-1;
-        memcpy(line, line_start, llen);
-        /* Trim \r */
-        while (llen > 0 && (line[llen-1] == '\r' || line[llen-1] == '\n')) llen--;
-        line[llen] = '\0';
-        p = *line_end ? line_end+1 : line_end;
-
-        if (!*line) continue;
-
-        if (!strncmp(line, "#EXTINF:", 8)) {
-            memset(&cur, 0, sizeof(cur));
-            strncpy(cur.playlist_id, pl_id, sizeof(cur.playlist_id)-1);
-            has_meta = 1;
-
-            /* Extract attributes: tvg-id="..." group-title="..." tvg-logo="..." ,Name */
-            char *comma = strrchr(line, ',');
-            if (comma) {
-                strncpy(cur.name, comma+1, sizeof(cur.name)-1);
-                /* Trim leading space */
-                char *n = cur.name;
-                while (*n == ' ') memmove(n, n+1, strlen(n));
-            }
+void iptv_set_data_dir(const char *dir) {
+    if (!dir || !*dir) dir = IPTV_DEFAULT_DATA_DIR;
+    snprintf(g_cache_dir,      sizeof(g_cache_dir),      "%.255s/iptv", dir);
+    snprintf(g_playlists_file, sizeof(g_playlists_file), "%.255s/playlists.json", dir);
+}
 
-            /* Parse key="value" pairs */
-            const char *attr = line + 8;
-            while ((attr = strstr(attr, "="))) {
-                /* Find key start */
-                const char *key_end = attr;
-                const char *key_start = key_end - 1;
-                while (key_start > line && *key_start != ' ' &&
-                       *key_start != '\t') key_start--;
-                if (*key_start == ' ' || *key_start == '\t') key_start++;
-
-                char key[64] = {0};
-                int  klen = (int)(key_end - key_start);
-                if (klen >= (int)sizeof(key)) klen = sizeof(key)-1;
-                memcpy(key, key_start, klen);
-
-                attr++; /* skip '=' */
-                if (*attr == '"') {
-                    attr++;
-                    const char *val_end = strchr(attr, '"');
-                    if (!val_end) break;
-                    char val[256] = {0};
-                    int vlen = (int)(val_end - attr);
-                    if (vlen >= (int)sizeof(val)) vlen = sizeof(val)-1;
-                    memcpy(val, attr, vlen);
-
-                    if      (!strcasecmp(key,"tvg-id"))      strncpy(cur.id, val, sizeof(cur.id)-1);
-                    else if (!strcasecmp(key,"group-title")) strncpy(cur.group, val, sizeof(cur.group)-1);
-                    else if (!strcasecmp(key,"tvg-logo"))    strncpy(cur.logo,  val, sizeof(cur.logo)-1);
-
-                    attr = val_end + 1;
-                } else {
-                    attr++;
-                }
-            }
-        } else if (line[0] != '#' && has_meta) {
-            strncpy(cur.url, line, sizeof(cur.url)-1);
-
-            /* Generate stable id */
-            char id_src[128];
-            snprintf(id_src, sizeof(id_src), "%s_%s_%d", pl_id, cur.name, count);
-            /* Simple hash to 8 hex chars */
-            unsigned h = 5381;
-            for (const char *s = id_src; *s; s++) h = ((h << 5) + h) ^ (unsigned char)*s;
-            snprintf(cur.id, sizeof(cur.id), "%s_%08x", pl_id, h);
-
-            out[count++] = cur;
-            has_meta = 0;
+void iptv_set_limits(int max_channels, int max_playlists, int mem_mb) {
+    IPTV_LOCK();
+    if (max_channels  > 0) g_max_channels  = (uint32_t)max_channels;
+    if (max_playlists > 0) g_max_playlists = max_playlists;
+    if (mem_mb        > 0) g_mem_budget    = (size_t)mem_mb << 20;
+    IPTV_UNLOCK();
+}
+
+/* ── Groups ───────────────────────────────────────────────────────────────── */
+
+static uint32_t str_hash(const char *s) {
+    unsigned h = 5381;
+    for (; *s; s++) h = ((h<<5)+h)^(unsigned char)*s;
+    return h;
+}
+
+static int ghash_grow(void) {
+    uint32_t  cap = g_ghash_cap ? g_ghash_cap * 2 : 256;
+    uint32_t *h   = calloc(cap, sizeof(uint32_t));
+    if (!h) return -1;
+    for (uint32_t g = 1; g < g_group_n; g++) {
+        uint32_t i = str_hash(g_groups[g].name);
+        while (h[i & (cap-1)]) i++;
+        h[i & (cap-1)] = g;
+    }
+    free(g_ghash);
+    g_ghash     = h;
+    g_ghash_cap = cap;
+    return 0;
+}
+
+/* Global id of a group name; 0 for "" or an unknown name unless add is set. */
+static uint32_t group_id(const char *name, int add) {
+    if (!name || !*name) return 0;
+    if (g_group_n * 2 >= g_ghash_cap && ghash_grow() < 0) return 0;
+    uint32_t i = str_hash(name);
+    for (;; i++) {
+        uint32_t g = g_ghash[i & (g_ghash_cap-1)];
+        if (!g) break;
+        if (!strcmp(g_groups[g].name, name)) return g;
+    }
+    if (!add) return 0;
+    if (g_group_n == 0) g_group_n = 1;      /* reserve id 0 */
+    if (g_group_n >= g_group_cap) {
+        uint32_t cap = g_group_cap ? g_group_cap * 2 : 64;
+        GroupEnt *ng = realloc(g_groups, cap * sizeof(GroupEnt));
+        if (!ng) return 0;
+        g_groups    = ng;
+        g_group_cap = cap;
+        g_groups[0] = (GroupEnt){ "", 0 };
+    }
+    char *dup = strdup(name);
+    if (!dup) return 0;
+    uint32_t g = g_group_n++;
+    g_groups[g] = (GroupEnt){ dup, 0 };
+    g_ghash[i & (g_ghash_cap-1)] = g;
+    return g;
+}
+
+/* Fold records published since the last call into the group counts.
+ * Any locked reader may call this, so the writer never needs the lock to
+ * make its channels countable. Caller holds the lock. */
+static void slot_sync(PlSlot *sl) {
+    IptvStore *st = sl->store;
+    if (!st) return;
+    /* Count first: every group a published record uses is published too */
+    uint32_t n  = iptv_store_count(st);
+    uint32_t ng = iptv_store_groups(st);
+    if (ng > sl->gmap_n) {
+        uint32_t *gm = realloc(sl->gmap,   ng * sizeof(uint32_t));
+        if (gm) sl->gmap = gm;
+        uint32_t *gc = realloc(sl->gcount, ng * sizeof(uint32_t));
+        if (gc) sl->gcount = gc;
+        if (!gm || !gc) return;
+        for (uint32_t g = sl->gmap_n; g < ng; g++) {
+            sl->gmap[g]   = g ? group_id(iptv_store_str(st, st->groups[g].name), 1) : 0;
+            sl->gcount[g] = 0;
         }
+        sl->gmap_n = ng;
     }
-    return count;
+    for (uint32_t i = sl->counted; i < n; i++) {
+        uint32_t g = st->recs[i].group;
+        sl->gcount[g]++;
+        g_groups[sl->gmap[g]].count++;
+    }
+    sl->counted = n;
+}
+
+/* Detach a slot's store, taking its counts out of the group table, and
+ * return it (the reference passes to the caller). Caller holds the lock. */
+static IptvStore *slot_take(PlSlot *sl) {
+    for (uint32_t g = 0; g < sl->gmap_n; g++)
+        g_groups[sl->gmap[g]].count -= (int)sl->gcount[g];
+    IptvStore *st = sl->store;
+    iptv_index_unref(sl->idx);
+    free(sl->gmap);
+    free(sl->gcount);
+    memset(sl, 0, sizeof(*sl));
+    return st;
+}
+
+/* Attach st (taking over the caller's reference). Caller holds the lock. */
+static void slot_put(PlSlot *sl, IptvStore *st) {
+    iptv_store_unref(slot_take(sl));
+    sl->store = st;
+    slot_sync(sl);
+}
+
+/* Index over everything the slot's store has published. Only the playlist
+ * that changed is re-indexed; during a download that happens at most once
+ * per published batch, and without the search index, which would be thrown
+ * away just as often (searches scan such a playlist instead). Caller holds
+ * the lock. */
+static IptvIndex *slot_index(PlSlot *sl) {
+    if (!sl->store) return NULL;
+    uint32_t n = iptv_store_count(sl->store);
+    if (!sl->idx || sl->idx->count != n) {
+        IptvIndex *ix = iptv_index_build(sl->store, n, !sl->filling);
+        if (!ix) return sl->idx;          /* stale but consistent */
+        iptv_index_unref(sl->idx);
+        sl->idx = ix;
+    }
+    return sl->idx;
+}
+
+/* Approximate resident cost of a store's published channels, including
+ * the index built over them: about 20 bytes per channel for the id/URL/group
+ * tables and 100 for the name search index (normalized name plus roughly
+ * one trigram posting per character). */
+#define INDEX_BYTES_PER_CH 120
+
+static size_t store_bytes(const IptvStore *st) {
+    return (size_t)st->count * (sizeof(IptvStoreRec) + INDEX_BYTES_PER_CH) +
+           st->str_len + (size_t)st->group_count * sizeof(IptvStoreGroup);
+}
+
+/* What one playlist may still load without pushing the catalog over its
+ * budgets, given everything the other playlists hold. */
+typedef struct { uint32_t channels; size_t bytes; } Budget;
+
+/* Caller holds the lock. */
+static Budget budget_for(const PlSlot *skip) {
+    uint32_t n = 0;
+    size_t   b = 0;
+    for (int i = 0; i < g_pl_count; i++) {
+        if (&g_slots[i] == skip || !g_slots[i].store) continue;
+        n += iptv_store_count(g_slots[i].store);
+        b += store_bytes(g_slots[i].store);
+    }
+    return (Budget){ n < g_max_channels ? g_max_channels - n : 0,
+                     b < g_mem_budget   ? g_mem_budget   - b : 0 };
+}
+
+static int over_budget(const IptvStore *st, const Budget *b) {
+    return st->count >= b->channels || store_bytes(st) >= b->bytes;
+}
+
+/* Make room for one more playlist entry (and its slot). Caller holds the
+ * lock. Returns -1 at the playlist limit or when out of memory. */
+static int grow_playlists(void) {
+    if (g_pl_count >= g_max_playlists) {
+        fprintf(stderr, "iptv: playlist limit (%d) reached\n", g_max_playlists);
+        return -1;
+    }
+    if (g_pl_count < g_pl_cap) return 0;
+    int cap = g_pl_cap ? g_pl_cap * 2 : 8;
+    IptvPlaylist *pl = realloc(g_playlists, cap * sizeof(IptvPlaylist));
+    if (!pl) return -1;
+    g_playlists = pl;
+    PlSlot *sl = realloc(g_slots, cap * sizeof(PlSlot));
+    if (!sl) return -1;
+    memset(sl + g_pl_cap, 0, (cap - g_pl_cap) * sizeof(PlSlot));
+    g_slots  = sl;
+    g_pl_cap = cap;
+    return 0;
 }
 
 /* ── Disk persistence ─────────────────────────────────────────────────────── */
@@ -144,103 +281,145 @@ static void mkdirs(const char *path) {
 
 static char *channel_cache_path(const char *pl_id) {
     static char buf[512];
-    snprintf(buf, sizeof(buf), "%s/%s.json", IPTV_CACHE_DIR, pl_id);
+    snprintf(buf, sizeof(buf), "%s/%s.bin", g_cache_dir, pl_id);
     return buf;
 }
 
-static void save_channel_cache(const char *pl_id, IptvChannel *ch, int n) {
-    mkdirs(IPTV_CACHE_DIR);
-    cJSON *arr = cJSON_CreateArray();
-    for (int i = 0; i < n; i++) {
-        cJSON *o = cJSON_CreateObject();
-        cJSON_AddStringToObject(o, "id",          ch[i].id);
-        cJSON_AddStringToObject(o, "name",        ch[i].name);
-        cJSON_AddStringToObject(o, "url",         ch[i].url);
-        cJSON_AddStringToObject(o, "group",       ch[i].group);
-        cJSON_AddStringToObject(o, "logo",        ch[i].logo);
-        cJSON_AddStringToObject(o, "playlist_id", ch[i].playlist_id);
-        cJSON_AddItemToArray(arr, o);
-    }
-    char *s = cJSON_Print(arr);
-    cJSON_Delete(arr);
-
-    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", channel_cache_path(pl_id));
-    FILE *f = fopen(tmp, "w");
-    if (f) { fputs(s, f); fclose(f); rename(tmp, channel_cache_path(pl_id)); }
-    free(s);
-}
-
-static int load_channel_cache(const char *pl_id) {
-    FILE *f = fopen(channel_cache_path(pl_id), "r");
-    if (!f) return 0;
+/* Pre-binary cache location — read once at boot to migrate, never written. */
+static char *channel_json_path(const char *pl_id) {
+    static char buf[512];
+    snprintf(buf, sizeof(buf), "%s/%s.json", g_cache_dir, pl_id);
+    return buf;
+}
+
+static void save_channel_cache(const IptvStore *st) {
+    mkdirs(g_cache_dir);
+    if (iptv_store_save(st, channel_cache_path(st->pl_id)) < 0)
+        fprintf(stderr, "iptv: failed to write cache for %s\n", st->pl_id);
+}
+
+/* Legacy JSON cache — import path only. Returns a sealed store or NULL. */
+static IptvStore *load_channel_json(const char *pl_id) {
+    FILE *f = fopen(channel_json_path(pl_id), "r");
+    if (!f) return NULL;
     fseek(f,0,SEEK_END); long sz=ftell(f); fseek(f,0,SEEK_SET);
     char *buf = malloc(sz+1); fread(buf,1,sz,f); buf[sz]='\0'; fclose(f);
 
-    cJSON *arr = cJSON_Parse(buf); free(buf);
-    if (!arr) return 0;
+    static const char *const keys[] = { "id", "name", "url", "group", "logo" };
+    JpVal v[5];
+    JPull j = {0};
+    jp_init(&j, buf);
+    IptvStore *st = jp_next(&j) == JP_ARR ? iptv_store_new(pl_id) : NULL;
+    int r = 0;
+    while (st && (r = jp_fields(&j, keys, 5, v)) > 0)
+        iptv_store_add(st, jp_vstr(&v[0], ""), jp_vstr(&v[1], ""), jp_vstr(&v[2], ""),
+                           jp_vstr(&v[3], ""), jp_vstr(&v[4], ""), NULL);
+    jp_free(&j);
+    free(buf);
+    if (st && r < 0) { iptv_store_unref(st); return NULL; }
+    if (st) iptv_store_seal(st);
+    return st;
+}
 
-    int n = cJSON_GetArraySize(arr);
-    for (int i = 0; i < n && g_ch_count < IPTV_MAX_CHANNELS; i++) {
-        cJSON *o = cJSON_GetArrayItem(arr, i);
-        IptvChannel *c = &g_channels[g_ch_count++];
-        strncpy(c->id,          cJSON_GetString(o,"id",""),          sizeof(c->id)-1);
-        strncpy(c->name,        cJSON_GetString(o,"name",""),        sizeof(c->name)-1);
-        strncpy(c->url,         cJSON_GetString(o,"url",""),         sizeof(c->url)-1);
-        strncpy(c->group,       cJSON_GetString(o,"group",""),       sizeof(c->group)-1);
-        strncpy(c->logo,        cJSON_GetString(o,"logo",""),        sizeof(c->logo)-1);
-        strncpy(c->playlist_id, cJSON_GetString(o,"playlist_id",""),sizeof(c->playlist_id)-1);
+static IptvStore *load_channel_cache(const char *pl_id) {
+    IptvStore *st = iptv_store_open(channel_cache_path(pl_id));
+    if (st && strcmp(st->pl_id, pl_id)) {
+        fprintf(stderr, "iptv: cache for %s belongs to %s, ignored\n", pl_id, st->pl_id);
+        iptv_store_unref(st);
+        st = NULL;
     }
-    cJSON_Delete(arr);
-    return n;
+    if (st) return st;
+
+    /* No usable binary cache: import the old JSON one and convert it so the
+     * next boot takes the mmap path. */
+    st = load_channel_json(pl_id);
+    if (st && st->count > 0) {
+        save_channel_cache(st);
+        remove(channel_json_path(pl_id));
+        fprintf(stderr, "iptv: migrated %s to binary cache (%u channels)\n",
+                pl_id, st->count);
+    }
+    return st;
 }
 
 void iptv_save_playlists(void) {
-    mkdirs("/var/lib/qaryxos");
-    cJSON *root = cJSON_CreateObject();
-    cJSON *arr  = cJSON_CreateArray();
+    char dir[300];
+    strncpy(dir, g_playlists_file, sizeof(dir)-1);
+    dir[sizeof(dir)-1] = '\0';
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) { *slash = '\0'; mkdirs(dir); }
+    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", g_playlists_file);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+
+    Wire w = {0};
+    wire_reset(&w, WIRE_JSON);
+    wire_to_fd(&w, fd);
+    wire_obj(&w);
+    wire_key(&w, "playlists");
+    wire_arr(&w);
     for (int i = 0; i < g_pl_count; i++) {
-        cJSON *o = cJSON_CreateObject();
-        cJSON_AddStringToObject(o, "id",            g_playlists[i].id);
-        cJSON_AddStringToObject(o, "name",          g_playlists[i].name);
-        cJSON_AddStringToObject(o, "url",           g_playlists[i].url);
-        cJSON_AddNumberToObject(o, "updated_at",    (double)g_playlists[i].updated_at);
-        cJSON_AddNumberToObject(o, "channel_count", g_playlists[i].channel_count);
-        cJSON_AddItemToArray(arr, o);
+        const IptvPlaylist *p = &g_playlists[i];
+        wire_obj(&w);
+        wire_kstr(&w, "id",            p->id);
+        wire_kstr(&w, "name",          p->name);
+        wire_kstr(&w, "url",           p->url);
+        wire_knum(&w, "updated_at",    (double)p->updated_at);
+        wire_knum(&w, "channel_count", p->channel_count);
+        if (p->etag[0])          wire_kstr(&w, "etag",          p->etag);
+        if (p->last_modified[0]) wire_kstr(&w, "last_modified", p->last_modified);
+        if (p->content_hash) {
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)p->content_hash);
+            wire_kstr(&w, "content_hash", hex);
+        }
+        if (p->truncated) wire_kbool(&w, "truncated", 1);
+        wire_end(&w);
     }
-    cJSON_AddItemToObject(root, "playlists", arr);
-    char *s = cJSON_Print(root); cJSON_Delete(root);
+    wire_end(&w);
+    wire_end(&w);
 
-    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", IPTV_PLAYLISTS_FILE);
-    FILE *f = fopen(tmp, "w");
-    if (f) { fputs(s, f); fclose(f); rename(tmp, IPTV_PLAYLISTS_FILE); }
-    free(s);
+    int ok = wire_flush(&w) == 0;
+    wire_free(&w);
+    if (close(fd) != 0) ok = 0;
+    if (ok) ok = rename(tmp, g_playlists_file) == 0;
+    if (!ok) { remove(tmp); fprintf(stderr, "iptv: failed to write %s\n", g_playlists_file); }
 }
 
 void iptv_load(void) {
+    IPTV_LOCK();
+    for (int i = 0; i < g_pl_count; i++)
+        iptv_store_unref(slot_take(&g_slots[i]));
     g_pl_count = 0;
-    g_ch_count = 0;
 
-    FILE *f = fopen(IPTV_PLAYLISTS_FILE, "r");
-    if (!f) return;
+    FILE *f = fopen(g_playlists_file, "r");
+    if (!f) { publish(); IPTV_UNLOCK(); return; }
     fseek(f,0,SEEK_END); long sz=ftell(f); fseek(f,0,SEEK_SET);
     char *buf = malloc(sz+1); fread(buf,1,sz,f); buf[sz]='\0'; fclose(f);
 
     cJSON *root = cJSON_Parse(buf); free(buf);
-    if (!root) return;
+    if (!root) { publish(); IPTV_UNLOCK(); return; }
 
     cJSON *arr = cJSON_GetObjectItem(root, "playlists");
     int n = cJSON_GetArraySize(arr);
-    for (int i = 0; i < n && g_pl_count < IPTV_MAX_PLAYLISTS; i++) {
+    for (int i = 0; i < n && grow_playlists() == 0; i++) {
         cJSON *o = cJSON_GetArrayItem(arr, i);
         IptvPlaylist *p = &g_playlists[g_pl_count++];
+        memset(p, 0, sizeof(*p));
         strncpy(p->id,   cJSON_GetString(o,"id",""),   sizeof(p->id)-1);
         strncpy(p->name, cJSON_GetString(o,"name",""), sizeof(p->name)-1);
         strncpy(p->url,  cJSON_GetString(o,"url",""),  sizeof(p->url)-1);
         p->updated_at    = (time_t)cJSON_GetNumber(o,"updated_at",0);
         p->channel_count = (int)  cJSON_GetNumber(o,"channel_count",0);
-        load_channel_cache(p->id);
+        strncpy(p->etag,          cJSON_GetString(o,"etag",""),          sizeof(p->etag)-1);
+        strncpy(p->last_modified, cJSON_GetString(o,"last_modified",""), sizeof(p->last_modified)-1);
+        p->content_hash  = strtoull(cJSON_GetString(o,"content_hash","0"), NULL, 16);
+        p->truncated     = cJSON_GetBool(o,"truncated",0);
+        slot_put(&g_slots[g_pl_count-1], load_channel_cache(p->id));
     }
     cJSON_Delete(root);
+    publish();
+    IPTV_UNLOCK();
 }
 
 int iptv_add_playlist(const char *url, const char *name) {
@@ -248,190 +427,850 @@ int iptv_add_playlist(const char *url, const char *name) {
 
     /* Add playlist entry under lock, then release before the blocking download */
     IPTV_LOCK();
-    if (g_pl_count >= IPTV_MAX_PLAYLISTS) { IPTV_UNLOCK(); return -1; }
+    if (grow_playlists() < 0) { IPTV_UNLOCK(); return -1; }
 
     IptvPlaylist *pl = &g_playlists[g_pl_count];
+    memset(pl, 0, sizeof(*pl));
     unsigned h = 5381;
     for (const char *s = name; *s; s++) h = ((h<<5)+h)^(unsigned char)*s;
     snprintf(pl->id, sizeof(pl->id), "pl_%08x_%lx", h, (unsigned long)time(NULL));
-    strncpy(new_id, pl->id, sizeof(new_id)-1);
+    snprintf(new_id, sizeof(new_id), "%s", pl->id);
     strncpy(pl->name, name, sizeof(pl->name)-1);
     strncpy(pl->url,  url,  sizeof(pl->url)-1);
     pl->updated_at    = 0;
     pl->channel_count = 0;
     g_pl_count++;
+    publish();
     IPTV_UNLOCK();
 
     /* iptv_refresh_playlist manages its own locking (releases during download) */
     return iptv_refresh_playlist(new_id);
 }
 
+static int find_index(const char *id) {
+    for (int i = 0; i < g_pl_count; i++)
+        if (!strcmp(g_playlists[i].id, id)) return i;
+    return -1;
+}
+
 int iptv_remove_playlist(const char *id) {
     IPTV_LOCK();
     int ret = 0;
-    for (int i = 0; i < g_pl_count; i++) {
-        if (!strcmp(g_playlists[i].id, id)) {
-            int w = 0;
-            for (int j = 0; j < g_ch_count; j++)
-                if (strcmp(g_channels[j].playlist_id, id))
-                    g_channels[w++] = g_channels[j];
-            g_ch_count = w;
-            g_playlists[i] = g_playlists[--g_pl_count];
-            remove(channel_cache_path(id));
-            iptv_save_playlists();
-            ret = 1;
-            break;
-        }
+    int i = find_index(id);
+    if (i >= 0) {
+        /* Readers holding a channel list keep the store alive until they free it */
+        iptv_store_unref(slot_take(&g_slots[i]));
+        g_pl_count--;
+        g_playlists[i] = g_playlists[g_pl_count];
+        g_slots[i]     = g_slots[g_pl_count];
+        memset(&g_slots[g_pl_count], 0, sizeof(PlSlot));
+        remove(channel_cache_path(id));
+        remove(channel_json_path(id));
+        iptv_save_playlists();
+        publish();
+        ret = 1;
     }
     IPTV_UNLOCK();
     return ret;
 }
 
-int iptv_refresh_playlist(const char *id) {
-    /* Copy URL and proxy under lock, then release before blocking download */
+/* ── Refresh engine ───────────────────────────────────────────────────────── */
+
+/* All due playlists are fetched together on one curl multi handle, each
+ * with If-None-Match / If-Modified-Since from its last good download.
+ *   304           → nothing parsed, nothing rewritten
+ *   same body hash → the new store is dropped; cache and index stay as-is
+ *   otherwise      → the new store replaces the old one and is cached
+ *
+ * A playlist shown for the first time fills in progressively: channels are
+ * published in batches while it downloads, so the first groups appear after
+ * the first few hundred KB. A playlist that already has channels keeps
+ * them on screen until its replacement is complete. */
+#define REFRESH_BATCH      256
+#define NOTIFY_INTERVAL_MS 250
+
+typedef struct {
+    char        id[32];
+    char        url[512];
+    char        etag[128];
+    char        last_modified[64];
+    uint64_t    old_hash;
+    uint64_t    hash;        /* FNV-1a of the body as received */
+    IptvStore  *st;          /* store being filled */
+    IptvStore  *old;         /* previous store, kept to restore on failure */
+    int         progressive; /* publish while downloading */
+    int         attached;    /* st has replaced old in the playlist's slot */
+    Budget      budget;      /* what this playlist may still hold */
+    int         truncated;   /* channels were dropped by the budget */
+    int         pending;     /* channels added since the last publish */
+    long long   notified_ms;
+    M3uParser   parser;
+} RefreshCtx;
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Swap the new store into playlist i, keeping the old one aside.
+ * Caller holds the lock. */
+static void attach(RefreshCtx *rc, int i) {
+    if (rc->attached) return;
+    rc->old = slot_take(&g_slots[i]);
+    slot_put(&g_slots[i], iptv_store_ref(rc->st));
+    g_slots[i].filling = 1;
+    rc->attached = 1;
+}
+
+static void flush_batch(RefreshCtx *rc) {
+    iptv_store_publish(rc->st);
+    int count = (int)iptv_store_count(rc->st);
+    rc->pending = 0;
+
+    /* Readers get a new generation (which re-indexes this playlist) once
+     * per notify interval, not on every batch. */
+    long long t = now_ms();
+    if (!rc->progressive || t - rc->notified_ms < NOTIFY_INTERVAL_MS) return;
+    rc->notified_ms = t;
+
     IPTV_LOCK();
-    char url[512]  = "";
-    char proxy[256] = "";
-    int found = 0;
-    for (int i = 0; i < g_pl_count; i++) {
-        if (!strcmp(g_playlists[i].id, id)) {
-            strncpy(url, g_playlists[i].url, sizeof(url)-1);
-            strncpy(proxy, g_proxy, sizeof(proxy)-1);
-            found = 1;
-            break;
-        }
+    int i = find_index(rc->id);
+    if (i >= 0) {
+        attach(rc, i);
+        g_playlists[i].channel_count = count;
+        publish();
     }
     IPTV_UNLOCK();
-    if (!found) return -1;
 
-    char *content = http_dl_string(url, proxy[0] ? proxy : NULL);
-    if (!content) return -1;
+    if (g_change_cb) g_change_cb(rc->id, count, 0);
+}
+
+static void on_m3u_channel(const IptvChannel *ch, void *ud) {
+    RefreshCtx *rc = ud;
+    if (over_budget(rc->st, &rc->budget)) {
+        if (!rc->truncated)
+            fprintf(stderr, "iptv: %s: limit reached at %u channels, rest dropped\n",
+                    rc->id, rc->st->count);
+        rc->truncated = 1;
+        return;
+    }
+    iptv_store_add(rc->st, ch->id, ch->name, ch->url, ch->group, ch->logo, ch->tvg_id);
+    if (++rc->pending == REFRESH_BATCH) flush_batch(rc);
+}
 
-    /* Allocate temp channel buffer */
-    IptvChannel *tmp = malloc(sizeof(IptvChannel) * IPTV_MAX_CHANNELS);
-    if (!tmp) { free(content); return -1; }
+static int on_m3u_chunk(const char *data, size_t len, void *ud) {
+    RefreshCtx *rc = ud;
+    for (size_t i = 0; i < len; i++) {
+        rc->hash ^= (unsigned char)data[i];
+        rc->hash *= 1099511628211ull;
+    }
+    m3u_feed(&rc->parser, data, len);
+    return 1;
+}
 
-    int count = parse_m3u(content, id, tmp, IPTV_MAX_CHANNELS);
-    free(content);
+/* Apply one finished transfer. Returns the playlist's channel count, or -1
+ * if the download failed (the previous channels are kept). */
+static int refresh_finish(RefreshCtx *rc, const HttpXfer *x) {
+    IptvIndex *ix = NULL;
+    int changed = 0;
+    if (x->result == HTTP_DL_OK) {
+        m3u_finish(&rc->parser);
+        iptv_store_seal(rc->st);
+        changed = rc->attached || rc->hash != rc->old_hash;
+        if (changed) ix = iptv_index_build(rc->st, rc->st->count, 1);   /* off the lock */
+    }
 
-    /* Re-acquire lock to modify shared state */
     IPTV_LOCK();
+    int i = find_index(rc->id);
+    int count = -1;
+    if (x->result == HTTP_DL_ERROR) {
+        /* Failed mid-stream: put back what the last good refresh loaded */
+        if (rc->attached && i >= 0) {
+            slot_put(&g_slots[i], rc->old);
+            g_playlists[i].channel_count = rc->old ? (int)iptv_store_count(rc->old) : 0;
+        } else {
+            iptv_store_unref(rc->old);
+        }
+    } else if (i >= 0) {
+        IptvPlaylist *pl = &g_playlists[i];
+        if (changed) {
+            attach(rc, i);
+            if (g_slots[i].store == rc->st) {
+                g_slots[i].filling = 0;
+                if (ix) {
+                    iptv_index_unref(g_slots[i].idx);
+                    g_slots[i].idx = iptv_index_ref(ix);
+                }
+            }
+            pl->channel_count = (int)rc->st->count;
+            pl->content_hash  = rc->hash;
+            pl->truncated     = rc->truncated;
+            save_channel_cache(rc->st);
+        } else {
+            fprintf(stderr, "iptv: %s unchanged (%s)\n", rc->id,
+                    x->result == HTTP_DL_NOT_MODIFIED ? "304" : "same content");
+        }
+        /* A 304 may carry fresh validators; a 200 always replaces them */
+        if (x->result == HTTP_DL_OK || x->etag_out[0])
+            strncpy(pl->etag, x->etag_out, sizeof(pl->etag)-1);
+        if (x->result == HTTP_DL_OK || x->last_modified_out[0])
+            strncpy(pl->last_modified, x->last_modified_out, sizeof(pl->last_modified)-1);
+        pl->updated_at = time(NULL);
+        iptv_save_playlists();
+        count = pl->channel_count;
+        iptv_store_unref(rc->old);
+    } else {
+        iptv_store_unref(rc->old);   /* removed while downloading */
+    }
+    if (changed || x->result == HTTP_DL_ERROR) publish();
+    IPTV_UNLOCK();
+    iptv_index_unref(ix);
+    return count;
+}
 
-    /* Remove old channels for this playlist */
-    int w = 0;
-    for (int i = 0; i < g_ch_count; i++)
-        if (strcmp(g_channels[i].playlist_id, id))
-            g_channels[w++] = g_channels[i];
-    g_ch_count = w;
-
-    /* Add new channels */
-    int add = count;
-    if (g_ch_count + add > IPTV_MAX_CHANNELS) add = IPTV_MAX_CHANNELS - g_ch_count;
-    memcpy(g_channels + g_ch_count, tmp, add * sizeof(IptvChannel));
-    g_ch_count += add;
-    free(tmp);
-
-    /* Update playlist metadata */
-    for (int i = 0; i < g_pl_count; i++) {
-        if (!strcmp(g_playlists[i].id, id)) {
-            g_playlists[i].channel_count = count;
-            g_playlists[i].updated_at    = time(NULL);
-            break;
+/* Refresh ids[0..n) together. counts[i] receives each playlist's channel
+ * count or -1. Returns how many refreshed without error. */
+static int refresh_many(const char (*ids)[32], int n, int *counts) {
+    RefreshCtx *rcs = calloc(n ? n : 1, sizeof(RefreshCtx));
+    HttpXfer   *xs  = calloc(n ? n : 1, sizeof(HttpXfer));
+    RefreshCtx **run = calloc(n ? n : 1, sizeof(RefreshCtx *));
+    if (!rcs || !xs || !run) {
+        free(rcs); free(xs); free(run);
+        for (int k = 0; k < n; k++) counts[k] = -1;
+        return 0;
+    }
+
+    /* Snapshot what each download needs, then release before blocking */
+    char proxy[256] = "";
+    int  nrun = 0;
+    IPTV_LOCK();
+    snprintf(proxy, sizeof(proxy), "%s", g_proxy);
+    for (int k = 0; k < n; k++) {
+        counts[k] = -1;
+        int i = find_index(ids[k]);
+        if (i < 0 || !g_playlists[i].url[0]) continue;   /* imported: no URL */
+        RefreshCtx   *rc = &rcs[k];
+        IptvPlaylist *pl = &g_playlists[i];
+        rc->st = iptv_store_new(pl->id);
+        if (!rc->st) continue;
+        snprintf(rc->id,  sizeof(rc->id),  "%s", pl->id);
+        snprintf(rc->url, sizeof(rc->url), "%s", pl->url);
+        /* Validators only count if the channels they describe are loaded —
+         * all of them: a truncated playlist may fit now that limits changed */
+        int loaded = g_slots[i].store && iptv_store_count(g_slots[i].store) > 0;
+        int have   = loaded && !pl->truncated;
+        if (have) {
+            snprintf(rc->etag,          sizeof(rc->etag),          "%s", pl->etag);
+            snprintf(rc->last_modified, sizeof(rc->last_modified), "%s", pl->last_modified);
+            rc->old_hash = pl->content_hash;
         }
+        rc->hash        = 14695981039346656037ull;
+        rc->progressive = !loaded;
+        rc->budget      = budget_for(&g_slots[i]);
+        m3u_init(&rc->parser, rc->id, on_m3u_channel, rc);
+
+        xs[nrun] = (HttpXfer){ .url = rc->url, .etag = rc->etag,
+                               .last_modified = rc->last_modified,
+                               .cb = on_m3u_chunk, .userdata = rc };
+        run[nrun++] = rc;
     }
-    save_channel_cache(id, g_channels + g_ch_count - add, add);
-    iptv_save_playlists();
     IPTV_UNLOCK();
+
+    /* Parse while downloading: memory is one curl chunk per transfer + the
+     * channels themselves, stored once. */
+    http_dl_multi(xs, nrun, proxy[0] ? proxy : NULL, IPTV_REFRESH_PARALLEL);
+
+    int ok = 0;
+    for (int r = 0; r < nrun; r++) {
+        RefreshCtx *rc = run[r];
+        int k = (int)(rc - rcs);
+        counts[k] = refresh_finish(rc, &xs[r]);
+        if (counts[k] >= 0) ok++;
+        iptv_store_unref(rc->st);
+        if (g_change_cb) g_change_cb(rc->id, counts[k], 1);
+    }
+    for (int k = 0; k < n; k++)
+        if (!rcs[k].st && g_change_cb) g_change_cb(ids[k], -1, 1);
+    free(rcs); free(xs); free(run);
+    return ok;
+}
+
+int iptv_refresh_playlist(const char *id) {
+    char ids[1][32] = {{0}};
+    snprintf(ids[0], sizeof(ids[0]), "%s", id);
+    int count;
+    refresh_many((const char (*)[32])ids, 1, &count);
     return count;
 }
 
-int iptv_import_channels(const char *name, void *channels_cjson_array) {
+int iptv_refresh_all(void) {
     IPTV_LOCK();
-    if (g_pl_count >= IPTV_MAX_PLAYLISTS) { IPTV_UNLOCK(); return -1; }
-    cJSON *arr = (cJSON *)channels_cjson_array;
-    if (!arr) { IPTV_UNLOCK(); return -1; }
+    int n = g_pl_count;
+    char (*ids)[32] = calloc(n ? n : 1, sizeof(*ids));
+    int  *counts    = calloc(n ? n : 1, sizeof(int));
+    for (int i = 0; ids && i < n; i++)
+        strncpy(ids[i], g_playlists[i].id, sizeof(ids[i])-1);
+    IPTV_UNLOCK();
+    int ok = (ids && counts) ? refresh_many((const char (*)[32])ids, n, counts) : 0;
+    free(ids); free(counts);
+    return ok;
+}
+
+/* ── File import ──────────────────────────────────────────────────────────── */
+
+/* Channels pre-parsed on the phone arrive in batches (one WebSocket message
+ * each) and go straight into the playlist's store, which fills in on screen
+ * the way a first download does. Nothing but the store itself grows with
+ * the playlist's size. An import that hears nothing for IMPORT_IDLE_S
+ * (the phone went away) is dropped when the next one begins. */
+#define IMPORT_MAX    4
+#define IMPORT_IDLE_S 120
+
+typedef struct {
+    char       id[32];
+    IptvStore *st;           /* NULL = free entry */
+    Budget     budget;
+    uint32_t   seen;         /* channels received, kept or not */
+    int        truncated;
+    long long  notified_ms;
+    time_t     active_at;
+} ImportCtx;
+
+static ImportCtx g_imports[IMPORT_MAX];
+
+/* Caller holds the lock. */
+static ImportCtx *import_find(const char *id) {
+    for (int k = 0; k < IMPORT_MAX; k++)
+        if (g_imports[k].st && !strcmp(g_imports[k].id, id)) return &g_imports[k];
+    return NULL;
+}
+
+/* Caller holds the lock. */
+static void import_drop(ImportCtx *im) {
+    iptv_store_unref(im->st);
+    memset(im, 0, sizeof(*im));
+}
+
+int iptv_import_begin(const char *name, char *id_out, size_t id_cap) {
+    IPTV_LOCK();
+    ImportCtx *im = NULL;
+    for (int k = 0; k < IMPORT_MAX; k++) {
+        ImportCtx *e = &g_imports[k];
+        if (e->st && time(NULL) - e->active_at > IMPORT_IDLE_S) {
+            fprintf(stderr, "iptv: import %s abandoned\n", e->id);
+            iptv_remove_playlist(e->id);
+            import_drop(e);
+        }
+        if (!e->st && !im) im = e;
+    }
+    if (!im) {
+        fprintf(stderr, "iptv: too many imports in progress\n");
+        IPTV_UNLOCK();
+        return -1;
+    }
+    if (grow_playlists() < 0) { IPTV_UNLOCK(); return -1; }
 
     IptvPlaylist *pl = &g_playlists[g_pl_count];
+    memset(pl, 0, sizeof(*pl));
     unsigned h = 5381;
     for (const char *s = name; *s; s++) h = ((h<<5)+h)^(unsigned char)*s;
     snprintf(pl->id, sizeof(pl->id), "pl_%08x_%lx", h, (unsigned long)time(NULL));
+
+    IptvStore *st = iptv_store_new(pl->id);
+    if (!st) { IPTV_UNLOCK(); return -1; }
     strncpy(pl->name, name, sizeof(pl->name)-1);
     pl->url[0]        = '\0';   /* file-based: no URL */
     pl->updated_at    = time(NULL);
     pl->channel_count = 0;
-    g_pl_count++;
 
-    int n = cJSON_GetArraySize(arr);
-    int added = 0;
-    for (int i = 0; i < n && g_ch_count < IPTV_MAX_CHANNELS; i++) {
-        cJSON *o = cJSON_GetArrayItem(arr, i);
-        IptvChannel *c = &g_channels[g_ch_count];
-        memset(c, 0, sizeof(*c));
-        strncpy(c->name,        cJSON_GetString(o,"name",""),   sizeof(c->name)-1);
-        strncpy(c->url,         cJSON_GetString(o,"url",""),    sizeof(c->url)-1);
-        strncpy(c->group,       cJSON_GetString(o,"group",""),  sizeof(c->group)-1);
-        strncpy(c->logo,        cJSON_GetString(o,"logo",""),   sizeof(c->logo)-1);
-        strncpy(c->playlist_id, pl->id,                         sizeof(c->playlist_id)-1);
+    PlSlot *sl = &g_slots[g_pl_count++];
+    slot_put(sl, iptv_store_ref(st));
+    sl->filling = 1;
+
+    memset(im, 0, sizeof(*im));
+    snprintf(im->id, sizeof(im->id), "%s", pl->id);
+    im->st        = st;
+    im->budget    = budget_for(sl);
+    im->active_at = time(NULL);
+    snprintf(id_out, id_cap, "%s", im->id);
+    publish();
+    IPTV_UNLOCK();
+    return 0;
+}
+
+int iptv_import_batch(const char *id, const char *channels_json) {
+    static const char *const keys[] = { "name", "url", "group", "logo", "tvg_id" };
+    IPTV_LOCK();
+    ImportCtx *im = import_find(id);
+    if (im) im->active_at = time(NULL);
+    IPTV_UNLOCK();
+    if (!im || !channels_json) return -1;
+
+    /* One pass over the array text, each channel copied into the store as
+     * it is read. The store has a single writer (this import), so the adds
+     * need no lock. */
+    JPull j = {0};
+    JpVal v[5];
+    int   r = 0;
+    jp_init(&j, channels_json);
+    if (jp_next(&j) != JP_ARR) { jp_free(&j); return -1; }
+    IptvStore *st = im->st;
+    for (; (r = jp_fields(&j, keys, 5, v)) > 0; im->seen++) {
+        if (over_budget(st, &im->budget)) {
+            if (!im->truncated)
+                fprintf(stderr, "iptv: %s: limit reached at %u channels, rest dropped\n",
+                        im->id, st->count);
+            im->truncated = 1;
+            break;
+        }
+        const char *ch_name = jp_vstr(&v[0], "");
         /* Generate stable id */
         unsigned ch_h = 5381;
-        for (const char *s = c->name; *s; s++) ch_h = ((ch_h<<5)+ch_h)^(unsigned char)*s;
-        snprintf(c->id, sizeof(c->id), "%s_%08x", pl->id, ch_h ^ (unsigned)i);
-        g_ch_count++;
-        added++;
+        for (const char *s = ch_name; *s; s++) ch_h = ((ch_h<<5)+ch_h)^(unsigned char)*s;
+        char ch_id[64];
+        snprintf(ch_id, sizeof(ch_id), "%s_%08x", im->id, ch_h ^ im->seen);
+        iptv_store_add(st, ch_id, ch_name, jp_vstr(&v[1], ""), jp_vstr(&v[2], ""),
+                       jp_vstr(&v[3], ""), jp_vstr(&v[4], ""));
     }
+    jp_free(&j);
+    iptv_store_publish(st);
+    if (r < 0) {
+        fprintf(stderr, "iptv: %s: malformed channel list, stopped at %u channels\n",
+                im->id, st->count);
+        return -1;
+    }
+    int count = (int)iptv_store_count(st);
 
-    pl->channel_count = added;
-    save_channel_cache(pl->id, g_channels + g_ch_count - added, added);
-    iptv_save_playlists();
+    long long t = now_ms();
+    if (t - im->notified_ms < NOTIFY_INTERVAL_MS) return count;
+    im->notified_ms = t;
+    IPTV_LOCK();
+    int i = find_index(id);
+    if (i >= 0) {
+        g_playlists[i].channel_count = count;
+        publish();
+    }
     IPTV_UNLOCK();
-    return added;
+    if (g_change_cb) g_change_cb(id, count, 0);
+    return count;
 }
 
-IptvPlaylist *iptv_get_playlists(int *n) {
-    /* No lock needed — caller must not modify the returned array.
-     * g_pl_count read is atomic on ARM64; worst case is a stale count
-     * which is acceptable for a display-only query. */
-    *n = g_pl_count;
-    return g_playlists;
+int iptv_import_commit(const char *id) {
+    IPTV_LOCK();
+    ImportCtx *im = import_find(id);
+    IptvStore *st = im ? iptv_store_ref(im->st) : NULL;
+    int truncated = im ? im->truncated : 0;
+    if (im) import_drop(im);
+    IPTV_UNLOCK();
+    if (!st) return -1;
+
+    iptv_store_seal(st);
+    IptvIndex *ix = iptv_index_build(st, st->count, 1);   /* off the lock */
+
+    IPTV_LOCK();
+    int count = -1;
+    int i = find_index(id);
+    if (i >= 0 && g_slots[i].store == st) {
+        g_slots[i].filling = 0;
+        if (ix) {
+            iptv_index_unref(g_slots[i].idx);
+            g_slots[i].idx = iptv_index_ref(ix);
+        }
+        count = (int)st->count;
+        g_playlists[i].channel_count = count;
+        g_playlists[i].truncated     = truncated;
+        save_channel_cache(st);
+        iptv_save_playlists();
+        publish();
+    }
+    IPTV_UNLOCK();
+    iptv_index_unref(ix);
+    iptv_store_unref(st);
+    if (g_change_cb) g_change_cb(id, count, 1);
+    return count;
 }
 
-IptvChannel *iptv_get_channels(const char *pl_id, const char *group, int *n) {
-    static IptvChannel result[IPTV_MAX_CHANNELS];
+void iptv_import_abort(const char *id) {
     IPTV_LOCK();
-    int count = 0;
-    for (int i = 0; i < g_ch_count && count < IPTV_MAX_CHANNELS; i++) {
-        if (pl_id && strcmp(g_channels[i].playlist_id, pl_id)) continue;
-        if (group  && strcmp(g_channels[i].group, group))       continue;
-        result[count++] = g_channels[i];
+    ImportCtx *im = import_find(id);
+    if (im) {
+        import_drop(im);
+        iptv_remove_playlist(id);
     }
     IPTV_UNLOCK();
-    *n = count;
-    return result;
 }
 
-IptvChannel *iptv_get_channel(const char *id) {
-    for (int i = 0; i < g_ch_count; i++)
-        if (!strcmp(g_channels[i].id, id)) return &g_channels[i];
-    return NULL;
+int iptv_import_channels(const char *name, const char *channels_json) {
+    char id[32];
+    if (!channels_json || iptv_import_begin(name, id, sizeof(id)) < 0) return -1;
+    if (iptv_import_batch(id, channels_json) < 0) {
+        iptv_import_abort(id);
+        return -1;
+    }
+    return iptv_import_commit(id);
 }
 
-const char **iptv_get_groups(int *n) {
-    static const char *groups[1024];
-    static char        group_bufs[1024][64];
-    IPTV_LOCK();
-    int count = 0;
-    for (int i = 0; i < g_ch_count; i++) {
-        if (!g_channels[i].group[0]) continue;
-        int found = 0;
-        for (int j = 0; j < count; j++)
-            if (!strcmp(groups[j], g_channels[i].group)) { found=1; break; }
-        if (!found && count < 1024) {
-            strncpy(group_bufs[count], g_channels[i].group, 63);
-            groups[count] = group_bufs[count];
-            count++;
+/* ── Catalog generations ──────────────────────────────────────────────────── */
+
+/* Everything readers see lives in an immutable IptvCatalog: copies of the
+ * playlist entries, one index per playlist and the list of group names.
+ * Writers change the master state above under g_mu, then build a new
+ * generation and publish it with one atomic pointer swap. Readers never
+ * take g_mu: they pin the current generation and keep it as long as they
+ * like, so a refresh can never tear an array under the render thread.
+ *
+ * Reclamation: a reader bumps g_cat_readers around the load + ref of the
+ * current pointer. After swapping, the writer waits for that counter to
+ * drain once; anyone who could still hold the old raw pointer then has
+ * already taken a reference on it. */
+
+struct IptvCatalog {
+    atomic_int    refs;
+    int           n;
+    IptvPlaylist *playlists;
+    IptvIndex   **idx;        /* parallel to playlists; NULL while empty */
+    const char  **groups;     /* non-empty groups; names are never freed */
+    int           group_n;
+};
+
+static void search_reset(void);
+
+static IptvCatalog              g_cat_empty;   /* before the first publish */
+static _Atomic(IptvCatalog *)   g_cat          = NULL;
+static atomic_int               g_cat_readers;
+
+static void catalog_free(IptvCatalog *c) {
+    for (int i = 0; i < c->n; i++) iptv_index_unref(c->idx[i]);
+    free(c->playlists);
+    free(c->idx);
+    free(c->groups);
+    free(c);
+}
+
+IptvCatalog *iptv_catalog_acquire(void) {
+    atomic_fetch_add(&g_cat_readers, 1);
+    IptvCatalog *c = atomic_load(&g_cat);
+    if (c) atomic_fetch_add_explicit(&c->refs, 1, memory_order_relaxed);
+    atomic_fetch_sub(&g_cat_readers, 1);
+    return c ? c : &g_cat_empty;
+}
+
+void iptv_catalog_release(IptvCatalog *c) {
+    if (!c || c == &g_cat_empty) return;
+    if (atomic_fetch_sub_explicit(&c->refs, 1, memory_order_acq_rel) == 1)
+        catalog_free(c);
+}
+
+/* Build a generation from g_playlists/g_slots and make it current.
+ * Only playlists whose store grew are re-indexed. Caller holds the lock. */
+static void publish(void) {
+    int n = g_pl_count;
+    for (int i = 0; i < n; i++) slot_sync(&g_slots[i]);   /* may intern groups */
+
+    IptvCatalog *c = calloc(1, sizeof(*c));
+    if (c) {
+        c->playlists = malloc((n ? n : 1) * sizeof(IptvPlaylist));
+        c->idx       = calloc(n ? n : 1, sizeof(IptvIndex *));
+        c->groups    = malloc((g_group_n ? g_group_n : 1) * sizeof(char *));
+    }
+    if (!c || !c->playlists || !c->idx || !c->groups) {
+        fprintf(stderr, "iptv: out of memory, catalog not updated\n");
+        if (c) { free(c->playlists); free(c->idx); free(c->groups); free(c); }
+        return;
+    }
+    atomic_init(&c->refs, 1);
+    c->n = n;
+    for (int i = 0; i < n; i++) {
+        c->playlists[i] = g_playlists[i];
+        c->idx[i]       = iptv_index_ref(slot_index(&g_slots[i]));
+    }
+    for (uint32_t g = 1; g < g_group_n; g++)
+        if (g_groups[g].count > 0) c->groups[c->group_n++] = g_groups[g].name;
+
+    IptvCatalog *old = atomic_exchange(&g_cat, c);
+    while (atomic_load(&g_cat_readers) > 0) sched_yield();
+    iptv_catalog_release(old);
+    search_reset();
+}
+
+const IptvPlaylist *iptv_catalog_playlists(const IptvCatalog *c, int *n) {
+    *n = c->n;
+    return c->playlists;
+}
+
+const char **iptv_catalog_groups(const IptvCatalog *c, int *n) {
+    *n = c->group_n;
+    return c->groups;
+}
+
+/* ── Queries ──────────────────────────────────────────────────────────────── */
+
+/* A run of channels from one playlist: either a group's posting list or,
+ * when recs is NULL, records [first, first + n). The index belongs to the
+ * catalog the list pins. */
+typedef struct {
+    const IptvIndex *ix;
+    const uint32_t  *recs;
+    uint32_t         first;
+    uint32_t         n;
+} ListSeg;
+
+struct IptvChannelList {
+    IptvCatalog *cat;         /* one reference */
+    ListSeg     *segs;
+    int          n_segs;
+    int          count;
+};
+
+/* Collect matching channels. Each filter may be NULL. Nothing is copied
+ * per channel: a group query costs one posting-list lookup per playlist and
+ * an id or URL lookup one hash probe per playlist. */
+static IptvChannelList *query(IptvCatalog *c, const char *pl_id, const char *group,
+                              const char *id, const char *url) {
+    IptvChannelList *l = calloc(1, sizeof(*l));
+    if (!l) return NULL;
+    l->segs = calloc(c->n ? c->n : 1, sizeof(ListSeg));
+    if (!l->segs) { free(l); return NULL; }
+    if (c != &g_cat_empty) atomic_fetch_add_explicit(&c->refs, 1, memory_order_relaxed);
+    l->cat = c;
+
+    for (int i = 0; i < c->n; i++) {
+        if (pl_id && strcmp(c->playlists[i].id, pl_id)) continue;
+        const IptvIndex *ix = c->idx[i];
+        if (!ix) continue;
+
+        ListSeg seg = { ix, NULL, 0, ix->count };
+        if (id || url) {
+            long r = id ? iptv_index_find_id(ix, id) : iptv_index_find_url(ix, url);
+            if (r < 0) continue;
+            seg.first = (uint32_t)r;
+            seg.n     = 1;
+        } else if (group) {
+            long g = iptv_index_find_group(ix, group);
+            if (g < 0) continue;
+            seg.recs = iptv_index_group(ix, (uint32_t)g, &seg.n);
         }
+        if (seg.n == 0) continue;
+        l->segs[l->n_segs++] = seg;
+        l->count += (int)seg.n;
+        if (id || url) break;
     }
-    IPTV_UNLOCK();
-    *n = count;
-    return groups;
+    return l;
+}
+
+IptvChannelList *iptv_catalog_channels(IptvCatalog *c, const char *pl_id,
+                                       const char *group) {
+    return query(c, pl_id, group, NULL, NULL);
+}
+
+IptvChannelList *iptv_get_channels(const char *pl_id, const char *group) {
+    IptvCatalog *c = iptv_catalog_acquire();
+    IptvChannelList *l = query(c, pl_id, group, NULL, NULL);
+    iptv_catalog_release(c);
+    return l;
+}
+
+IptvChannelList *iptv_get_channel(const char *id) {
+    IptvCatalog *c = iptv_catalog_acquire();
+    IptvChannelList *l = query(c, NULL, NULL, id, NULL);
+    iptv_catalog_release(c);
+    return l;
+}
+
+IptvChannelList *iptv_get_channel_by_url(const char *url) {
+    IptvCatalog *c = iptv_catalog_acquire();
+    IptvChannelList *l = query(c, NULL, NULL, NULL, url);
+    iptv_catalog_release(c);
+    return l;
+}
+
+int iptv_list_count(const IptvChannelList *l) {
+    return l ? l->count : 0;
+}
+
+int iptv_list_get(const IptvChannelList *l, int i, IptvChannel *out) {
+    if (!l || i < 0 || i >= l->count) return -1;
+    const ListSeg *seg = l->segs;
+    while ((uint32_t)i >= seg->n) { i -= (int)seg->n; seg++; }
+    const IptvStore    *st = seg->ix->st;
+    const IptvStoreRec *r  = &st->recs[seg->recs ? seg->recs[i] : seg->first + (uint32_t)i];
+    out->id          = iptv_store_str(st, r->id);
+    out->name        = iptv_store_str(st, r->name);
+    out->url         = iptv_store_str(st, r->url);
+    out->group       = iptv_store_str(st, st->groups[r->group].name);
+    out->logo        = iptv_store_str(st, r->logo);
+    out->tvg_id      = iptv_store_str(st, r->tvg_id);
+    out->playlist_id = st->pl_id;
+    return 0;
+}
+
+void iptv_list_free(IptvChannelList *l) {
+    if (!l) return;
+    iptv_catalog_release(l->cat);
+    free(l->segs);
+    free(l);
+}
+
+/* ── Search ───────────────────────────────────────────────────────────────── */
+
+#define SEARCH_QUERY_MAX 256
+
+typedef struct { uint32_t pl, rec; } SearchHit;
+
+/* Every match of the last query, in catalog order, so that a query typed
+ * one character further filters these instead of probing the indexes
+ * again. Dropped when a new generation is published. */
+static struct {
+    pthread_mutex_t mu;
+    IptvCatalog    *cat;         /* generation the hits refer to; one reference */
+    char            q[SEARCH_QUERY_MAX];
+    int             qchars;
+    SearchHit      *hits;
+    uint32_t        n, cap;
+} g_search = { .mu = PTHREAD_MUTEX_INITIALIZER };
+
+static void search_reset(void) {
+    pthread_mutex_lock(&g_search.mu);
+    iptv_catalog_release(g_search.cat);
+    g_search.cat = NULL;
+    g_search.n   = 0;
+    pthread_mutex_unlock(&g_search.mu);
+}
+
+/* Normalized name of a record. A playlist still loading has no search
+ * index; its names are normalized on the fly into buf. */
+static const char *search_name(const IptvIndex *ix, uint32_t rec, char *buf, size_t cap) {
+    if (ix->search) return iptv_search_name(ix->search, rec);
+    iptv_search_normalize(iptv_store_str(ix->st, ix->st->recs[rec].name), buf, cap);
+    return buf;
+}
+
+static int search_push(uint32_t pl, uint32_t rec) {
+    if (g_search.n == g_search.cap) {
+        uint32_t cap = g_search.cap ? g_search.cap * 2 : 256;
+        SearchHit *h = realloc(g_search.hits, cap * sizeof(SearchHit));
+        if (!h) return -1;
+        g_search.hits = h;
+        g_search.cap  = cap;
+    }
+    g_search.hits[g_search.n++] = (SearchHit){ pl, rec };
+    return 0;
+}
+
+/* Fill g_search.hits with every match of q in c. */
+static int search_collect(IptvCatalog *c, const char *q, int qchars) {
+    char buf[1024];
+    g_search.n = 0;
+    for (int i = 0; i < c->n; i++) {
+        const IptvIndex *ix = c->idx[i];
+        if (!ix) continue;
+        if (!ix->search) {
+            for (uint32_t r = 0; r < ix->count; r++)
+                if (iptv_search_match(search_name(ix, r, buf, sizeof(buf)), q, qchars) &&
+                    search_push((uint32_t)i, r) < 0) return -1;
+            continue;
+        }
+        uint32_t n;
+        int exact;
+        const uint32_t *cand = iptv_search_candidates(ix->search, q, qchars, &n, &exact);
+        for (uint32_t k = 0; k < n; k++)
+            if ((exact || iptv_search_match(iptv_search_name(ix->search, cand[k]), q, qchars)) &&
+                search_push((uint32_t)i, cand[k]) < 0) return -1;
+    }
+    return 0;
+}
+
+/* Keep the hits that still match the longer query q, in order. */
+static void search_filter(IptvCatalog *c, const char *q, int qchars) {
+    char buf[1024];
+    uint32_t o = 0;
+    for (uint32_t k = 0; k < g_search.n; k++) {
+        SearchHit h = g_search.hits[k];
+        if (iptv_search_match(search_name(c->idx[h.pl], h.rec, buf, sizeof(buf)), q, qchars))
+            g_search.hits[o++] = h;
+    }
+    g_search.n = o;
+}
+
+/* Rank: tier * 256 + name length (capped), lower is better. */
+static unsigned search_rank(const char *name, const char *q, size_t ql) {
+    size_t   len  = strlen(name);
+    unsigned tier = 3;
+    if (!strncmp(name, q, ql)) {
+        tier = len == ql ? 0 : 1;
+    } else {
+        for (const char *w = strchr(name, ' '); w; w = strchr(w + 1, ' '))
+            if (!strncmp(w + 1, q, ql)) { tier = 2; break; }
+    }
+    return tier * 256 + (unsigned)(len < 255 ? len : 255);
+}
+
+IptvChannelList *iptv_search(const char *query, int limit, int *total) {
+    char q[SEARCH_QUERY_MAX];
+    int  qchars = iptv_search_normalize(query ? query : "", q, sizeof(q));
+    if (total) *total = 0;
+    if (limit < 0) limit = 0;
+
+    IptvChannelList *l = calloc(1, sizeof(*l));
+    if (!l) return NULL;
+    IptvCatalog *c = iptv_catalog_acquire();
+    l->cat = c;                                   /* the list keeps this reference */
+
+    pthread_mutex_lock(&g_search.mu);
+    /* Same generation, and q extends the cached query without crossing
+     * from word-start to substring matching: the new matches are a subset */
+    int reuse = g_search.cat == c && g_search.qchars > 0 &&
+                !strncmp(q, g_search.q, strlen(g_search.q)) &&
+                (g_search.qchars < IPTV_SEARCH_MIN_SUBSTR) == (qchars < IPTV_SEARCH_MIN_SUBSTR);
+    if (qchars == 0) {
+        g_search.n = 0;
+    } else if (reuse) {
+        if (qchars != g_search.qchars) search_filter(c, q, qchars);
+    } else if (search_collect(c, q, qchars) < 0) {
+        g_search.n = 0;
+        qchars     = 0;                           /* don't reuse a partial set */
+    }
+    if (g_search.cat != c) {
+        iptv_catalog_release(g_search.cat);
+        if (c != &g_cat_empty) atomic_fetch_add_explicit(&c->refs, 1, memory_order_relaxed);
+        g_search.cat = c;
+    }
+    memcpy(g_search.q, q, sizeof(q));
+    g_search.qchars = qchars;
+
+    /* Counting sort on rank: O(n), stable, so ties stay in catalog order */
+    uint32_t n    = g_search.n;
+    uint32_t keep = n < (uint32_t)limit ? n : (uint32_t)limit;
+    unsigned short *rank = malloc((n ? n : 1) * sizeof(unsigned short));
+    l->segs = calloc(keep ? keep : 1, sizeof(ListSeg));
+    if (!rank || !l->segs) {
+        pthread_mutex_unlock(&g_search.mu);
+        free(rank);
+        iptv_list_free(l);
+        return NULL;
+    }
+    uint32_t pos[4 * 256 + 1] = { 0 };
+    size_t   ql = strlen(q);
+    char buf[1024];
+    for (uint32_t k = 0; k < n; k++) {
+        SearchHit h = g_search.hits[k];
+        rank[k] = (unsigned short)search_rank(search_name(c->idx[h.pl], h.rec, buf, sizeof(buf)),
+                                              q, ql);
+        pos[rank[k] + 1]++;
+    }
+    for (int b = 0; b < 4 * 256; b++) pos[b + 1] += pos[b];
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t p = pos[rank[k]]++;
+        if (p >= keep) continue;
+        SearchHit h = g_search.hits[k];
+        l->segs[p] = (ListSeg){ c->idx[h.pl], NULL, h.rec, 1 };
+    }
+    pthread_mutex_unlock(&g_search.mu);
+    free(rank);
+
+    l->n_segs = (int)keep;
+    l->count  = (int)keep;
+    if (total) *total = (int)n;
+    return l;
 }
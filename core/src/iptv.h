@@ -1,32 +1,73 @@
 #pragma once
 #include <time.h>
+#include <stddef.h>
+#include <stdint.h>
 
-#define IPTV_MAX_CHANNELS  5000
-#define IPTV_MAX_PLAYLISTS 16
-#define IPTV_CACHE_DIR     "/var/lib/qaryxos/iptv"
-#define IPTV_PLAYLISTS_FILE "/var/lib/qaryxos/playlists.json"
+/* Scaling target: at least 100k channels spread over up to 256 playlists,
+   with lock-free queries and group switches staying well under a frame
+   (see bench/bench_iptv.c). Nothing is sized for the target up front —
+   playlist tables grow as playlists are added, and each playlist's channels
+   live in its own store — so the limits below are budgets, not array sizes.
+   All three can be changed with iptv_set_limits(). */
+#define IPTV_DEFAULT_MAX_CHANNELS  200000   /* across all playlists */
+#define IPTV_DEFAULT_MAX_PLAYLISTS 256
+#define IPTV_DEFAULT_MEM_MB        64       /* channel records, strings and indexes */
 
+#define IPTV_REFRESH_PARALLEL      4        /* downloads open at once in a refresh */
+
+#define IPTV_DEFAULT_DATA_DIR      "/var/lib/qaryxos"
+
+/* A channel as seen by readers. The strings point into the playlist's
+   channel store and stay valid while the IptvChannelList they were read
+   from is held — even if the playlist is refreshed or removed meanwhile. */
 typedef struct {
-    char id[64];
-    char name[128];
-    char url[512];
-    char group[64];
-    char logo[256];
-    char playlist_id[32];
+    const char *id;
+    const char *name;
+    const char *url;
+    const char *group;
+    const char *logo;
+    const char *tvg_id;        /* EPG channel id, "" if the playlist has none */
+    const char *playlist_id;
 } IptvChannel;
 
+/* Result of a channel query: pins the catalog generation it was read from.
+   Release with iptv_list_free(). */
+typedef struct IptvChannelList IptvChannelList;
+
 typedef struct {
     char   id[32];
     char   name[64];
     char   url[512];
     time_t updated_at;
     int    channel_count;
+    /* Validators of the last good download, for conditional refresh */
+    char     etag[128];
+    char     last_modified[64];
+    uint64_t content_hash;   /* FNV-1a of the body */
+    int      truncated;      /* last load stopped at a channel or memory limit */
 } IptvPlaylist;
 
 /* Set HTTP/SOCKS proxy for M3U downloads (e.g. "http://127.0.0.1:10809").
    Pass NULL or "" to disable. Must be called before iptv_add_playlist(). */
 void iptv_set_proxy(const char *proxy);
 
+/* Directory holding playlists.json and the iptv/ channel caches.
+   Default IPTV_DEFAULT_DATA_DIR. Must be called before iptv_load(). */
+void iptv_set_data_dir(const char *dir);
+
+/* Catalog budgets; a value <= 0 keeps the current one. A playlist that
+   would exceed the channel or memory budget keeps the channels that fit
+   and is marked truncated; adding a playlist beyond max_playlists fails.
+   Lowering a limit never drops channels that are already loaded. */
+void iptv_set_limits(int max_channels, int max_playlists, int mem_mb);
+
+/* Change notification for progressive playlist loading.
+   Called from the refreshing thread (never with the IPTV lock held) while a
+   download is streaming in — at most every 250 ms, done=0 — and once when
+   it finishes (done=1, channel_count=-1 on failure). */
+typedef void (*IptvChangeCb)(const char *playlist_id, int channel_count, int done);
+void iptv_set_change_cb(IptvChangeCb cb);
+
 /* Load playlists + channel caches from disk. */
 void iptv_load(void);
 
@@ -39,17 +80,78 @@ int  iptv_add_playlist(const char *url, const char *name);
 /* Remove playlist and its cache. Returns 1 if found. */
 int  iptv_remove_playlist(const char *id);
 
-/* Refresh a single playlist from network. Returns channel count or -1. */
+/* Refresh a single playlist from network. Sends the stored ETag /
+   Last-Modified; on 304 or an identical body the channels and cache are
+   left untouched. Returns channel count or -1. */
 int  iptv_refresh_playlist(const char *id);
 
-/* Import channels from a pre-parsed JSON array (file-upload path).
-   channels_json: cJSON* array of {"name":"...","url":"...","group":"..."}.
+/* Refresh every playlist with a URL concurrently over one connection pool.
+   Blocks until all are done. Returns how many succeeded. */
+int  iptv_refresh_all(void);
+
+/* Import channels from a JSON array sent by the phone (file-upload path).
+   channels_json: the text of an array of {"name":"...","url":"...",
+   "group":"..."} (optionally "logo" and "tvg_id"); anything after the
+   array is ignored, so it may point into a larger message.
    Returns channel count or -1. */
-int  iptv_import_channels(const char *name, void *channels_cjson_array);
-
-/* Queries */
-IptvPlaylist *iptv_get_playlists(int *count_out);
-IptvChannel  *iptv_get_channels(const char *playlist_id, const char *group,
-                                 int *count_out);
-IptvChannel  *iptv_get_channel(const char *id);
-const char  **iptv_get_groups(int *count_out);
+int  iptv_import_channels(const char *name, const char *channels_json);
+
+/* Streaming import, for playlists too big to send as one message.
+   begin adds an empty playlist named name and writes its id to id_out;
+   each batch appends a JSON array as above and returns the channel count
+   so far (or -1 for an unknown id); commit seals, indexes and caches the
+   playlist and returns its final count (or -1). Channels show up while
+   the import runs, with progress through the change callback, as for a
+   download. abort removes the playlist. Batches of one import must not be
+   sent from two threads at once. */
+int  iptv_import_begin(const char *name, char *id_out, size_t id_cap);
+int  iptv_import_batch(const char *id, const char *channels_json);
+int  iptv_import_commit(const char *id);
+void iptv_import_abort(const char *id);
+
+/* ── Queries ──────────────────────────────────────────────────────────────
+ * Readers never block on a refresh: they pin an immutable catalog
+ * generation (playlists, indexes, group names) without taking any lock.
+ * Writers publish a new generation with an atomic pointer swap; the old one
+ * is freed when its last reader releases it. */
+
+typedef struct IptvCatalog IptvCatalog;
+
+/* Pin the current generation. Lock-free; never returns NULL. */
+IptvCatalog        *iptv_catalog_acquire(void);
+void                iptv_catalog_release(IptvCatalog *c);
+
+const IptvPlaylist *iptv_catalog_playlists(const IptvCatalog *c, int *count_out);
+
+/* Distinct non-empty group names across all playlists, in first-seen order. */
+const char        **iptv_catalog_groups(const IptvCatalog *c, int *count_out);
+
+/* Channels of a playlist and/or group (NULL = any) in generation c. Never
+   returns NULL unless out of memory; an empty list has count 0. The list
+   keeps c alive on its own. */
+IptvChannelList    *iptv_catalog_channels(IptvCatalog *c, const char *playlist_id,
+                                          const char *group);
+
+/* Same as above against the current generation. */
+IptvChannelList *iptv_get_channels(const char *playlist_id, const char *group);
+
+/* The channel with this id as a 0- or 1-element list. */
+IptvChannelList *iptv_get_channel(const char *id);
+
+/* The first channel streaming from this URL as a 0- or 1-element list. */
+IptvChannelList *iptv_get_channel_by_url(const char *url);
+
+/* Channels whose name matches query, best first: the exact name, then
+   names starting with it, then names with a word starting with it, then
+   any other substring; shorter names first within each tier. Case, accents
+   (ё = е) and punctuation are ignored, and queries under three characters
+   match word starts only. Returns at most limit channels; *total (may be
+   NULL) receives the number of matches. Meant for search-as-you-type: a
+   query extending the previous one filters its matches instead of
+   starting over. */
+IptvChannelList *iptv_search(const char *query, int limit, int *total);
+
+int  iptv_list_count(const IptvChannelList *l);
+/* Fill *out with the i-th channel. Returns 0, or -1 if i is out of range. */
+int  iptv_list_get(const IptvChannelList *l, int i, IptvChannel *out);
+void iptv_list_free(IptvChannelList *l);
@@ -0,0 +1,119 @@
+#include "iptv_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t str_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) { h ^= (unsigned char)*s; h *= 16777619u; }
+    return h;
+}
+
+/* Smallest power of two ≥ 2n (load factor ≤ 0.5), at least 16. */
+static uint32_t table_size(uint32_t n) {
+    uint32_t cap = 16;
+    while (cap < n * 2) cap <<= 1;
+    return cap;
+}
+
+static void insert(uint32_t *t, uint32_t mask, uint32_t h, uint32_t val) {
+    while (t[h & mask]) h++;
+    t[h & mask] = val;
+}
+
+IptvIndex *iptv_index_build(IptvStore *st, uint32_t count, int search) {
+    IptvIndex *ix = calloc(1, sizeof(*ix));
+    if (!ix) return NULL;
+    atomic_init(&ix->refs, 1);
+    ix->st    = iptv_store_ref(st);
+    ix->count = count;
+
+    /* Groups used by records [0, count) are all published by now */
+    ix->group_count = iptv_store_groups(st);
+    for (uint32_t i = 0; i < count; i++)
+        if (st->recs[i].group >= ix->group_count)
+            ix->group_count = st->recs[i].group + 1;
+
+    uint32_t hcap = table_size(count);
+    uint32_t gcap = table_size(ix->group_count);
+    ix->hmask     = hcap - 1;
+    ix->gmask     = gcap - 1;
+    ix->by_id     = calloc(hcap, sizeof(uint32_t));
+    ix->by_url    = calloc(hcap, sizeof(uint32_t));
+    ix->by_group  = calloc(gcap, sizeof(uint32_t));
+    ix->post_off  = calloc(ix->group_count + 1, sizeof(uint32_t));
+    ix->post      = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!ix->by_id || !ix->by_url || !ix->by_group || !ix->post_off || !ix->post) {
+        iptv_index_unref(ix);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const IptvStoreRec *r = &st->recs[i];
+        insert(ix->by_id,  ix->hmask, str_hash(iptv_store_str(st, r->id)),  i + 1);
+        insert(ix->by_url, ix->hmask, str_hash(iptv_store_str(st, r->url)), i + 1);
+        ix->post_off[r->group + 1]++;
+    }
+    for (uint32_t g = 1; g < ix->group_count; g++)
+        insert(ix->by_group, ix->gmask,
+               str_hash(iptv_store_str(st, st->groups[g].name)), g);
+
+    /* Counting sort: offsets first, then drop each record into its group */
+    for (uint32_t g = 0; g < ix->group_count; g++)
+        ix->post_off[g + 1] += ix->post_off[g];
+    uint32_t *fill = malloc((ix->group_count ? ix->group_count : 1) * sizeof(uint32_t));
+    if (!fill) { iptv_index_unref(ix); return NULL; }
+    memcpy(fill, ix->post_off, ix->group_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++)
+        ix->post[fill[st->recs[i].group]++] = i;
+    free(fill);
+    if (search) ix->search = iptv_search_build(st, count);
+    return ix;
+}
+
+IptvIndex *iptv_index_ref(IptvIndex *ix) {
+    if (ix) atomic_fetch_add_explicit(&ix->refs, 1, memory_order_relaxed);
+    return ix;
+}
+
+void iptv_index_unref(IptvIndex *ix) {
+    if (!ix || atomic_fetch_sub_explicit(&ix->refs, 1, memory_order_acq_rel) != 1)
+        return;
+    free(ix->by_id);
+    free(ix->by_url);
+    free(ix->by_group);
+    free(ix->post_off);
+    free(ix->post);
+    iptv_search_free(ix->search);
+    iptv_store_unref(ix->st);
+    free(ix);
+}
+
+/* ── Lookups ──────────────────────────────────────────────────────────────── */
+
+static long find_rec(const IptvIndex *ix, const uint32_t *t, const char *key,
+                     size_t field) {
+    for (uint32_t h = str_hash(key);; h++) {
+        uint32_t v = t[h & ix->hmask];
+        if (!v) return -1;
+        const IptvStoreRec *r = &ix->st->recs[v - 1];
+        uint32_t off = *(const uint32_t *)((const char *)r + field);
+        if (!strcmp(iptv_store_str(ix->st, off), key)) return (long)(v - 1);
+    }
+}
+
+long iptv_index_find_id(const IptvIndex *ix, const char *id) {
+    return find_rec(ix, ix->by_id, id, offsetof(IptvStoreRec, id));
+}
+
+long iptv_index_find_url(const IptvIndex *ix, const char *url) {
+    return find_rec(ix, ix->by_url, url, offsetof(IptvStoreRec, url));
+}
+
+long iptv_index_find_group(const IptvIndex *ix, const char *name) {
+    if (!*name) return 0;
+    for (uint32_t h = str_hash(name);; h++) {
+        uint32_t g = ix->by_group[h & ix->gmask];
+        if (!g) return -1;
+        if (!strcmp(iptv_store_str(ix->st, ix->st->groups[g].name), name)) return g;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "iptv_store.h"
+#include "iptv_search.h"
+
+/* Lookup tables over the first `count` records of one IptvStore:
+ *   - channel id  → record   (open addressing)
+ *   - stream URL  → record   (open addressing)
+ *   - group name  → group    (open addressing)
+ *   - group       → records  (posting lists, in playlist order)
+ *   - name trigrams → records (see iptv_search.h), for sealed stores
+ *
+ * Built in one O(count) pass and never modified afterwards, so it can be
+ * read without locking. A playlist that changes gets a new index; the
+ * others keep theirs. The index holds a reference on its store. */
+
+typedef struct IptvIndex {
+    atomic_int  refs;
+    IptvStore  *st;
+    uint32_t    count;        /* records covered */
+    uint32_t    group_count;  /* store groups covered */
+
+    uint32_t   *by_id;        /* record + 1, 0 = empty */
+    uint32_t   *by_url;
+    uint32_t    hmask;
+    uint32_t   *by_group;     /* group index, 0 = empty */
+    uint32_t    gmask;
+
+    uint32_t   *post_off;     /* group g's records: post[post_off[g] .. post_off[g+1]) */
+    uint32_t   *post;
+
+    IptvSearch *search;       /* NULL if not requested or out of memory */
+} IptvIndex;
+
+/* Index records [0, count) and the groups they use. count must not exceed
+   what the store has published. With search set, the name search index is
+   built too; only do that for a sealed store. Returns NULL on allocation
+   failure. */
+IptvIndex *iptv_index_build(IptvStore *st, uint32_t count, int search);
+
+IptvIndex *iptv_index_ref(IptvIndex *ix);
+void       iptv_index_unref(IptvIndex *ix);
+
+/* Record index of a channel, or -1. */
+long iptv_index_find_id(const IptvIndex *ix, const char *id);
+long iptv_index_find_url(const IptvIndex *ix, const char *url);
+
+/* Store group index for a name, or -1 if the store has no such group.
+   "" maps to group 0 (channels without a group). */
+long iptv_index_find_group(const IptvIndex *ix, const char *name);
+
+/* Records of store group g; *n receives the length. */
+static inline const uint32_t *iptv_index_group(const IptvIndex *ix, uint32_t g,
+                                               uint32_t *n) {
+    *n = ix->post_off[g + 1] - ix->post_off[g];
+    return ix->post + ix->post_off[g];
+}
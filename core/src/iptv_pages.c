@@ -0,0 +1,189 @@
+#include "iptv_pages.h"
+#include "iptv.h"
+#include "epg.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CURSOR_MAX       8
+#define CURSOR_IDLE_S    120
+#define PAGE_DEFAULT     100
+#define PAGE_MAX         500
+#define STREAM_PAGES     8      /* frames per streamed request: 8 × 500 fits a client queue */
+
+/* "fields" projection, a comma-separated subset of these */
+static const char *const k_chan_fields[] = {
+    "id", "name", "url", "group", "logo", "tvg_id", "playlist_id", "now",
+};
+enum { F_ID = 1, F_NAME = 2, F_URL = 4, F_GROUP = 8, F_LOGO = 16, F_TVG_ID = 32,
+       F_PLAYLIST = 64, F_NOW = 128,
+       F_DEFAULT = F_ID | F_NAME | F_URL | F_GROUP | F_NOW };
+
+typedef struct {
+    unsigned         id;            /* 0 = free */
+    int              client;        /* owner's fd */
+    IptvChannelList *list;
+    int              fields;
+    char             playlist_id[32];
+    char             group[128];
+    time_t           used;
+} ChanCursor;
+
+static ChanCursor s_cursors[CURSOR_MAX];
+static unsigned   s_cursor_seq = 0;
+
+static void cursor_close(ChanCursor *k) {
+    iptv_list_free(k->list);
+    memset(k, 0, sizeof(*k));
+}
+
+/* A slot for a new cursor of client, expiring idle ones on the way. */
+static ChanCursor *cursor_slot(int client, time_t now) {
+    ChanCursor *free_k = NULL, *lru = &s_cursors[0], *own = NULL;
+    for (int i = 0; i < CURSOR_MAX; i++) {
+        ChanCursor *k = &s_cursors[i];
+        if (k->id && now - k->used > CURSOR_IDLE_S) cursor_close(k);
+        if (!k->id && !free_k) free_k = k;
+        if (k->used < lru->used) lru = k;
+        if (k->id && k->client == client && (!own || k->used < own->used)) own = k;
+    }
+    if (free_k) return free_k;
+    if (own) lru = own;
+    cursor_close(lru);
+    return lru;
+}
+
+void iptv_pages_client_gone(int client) {
+    for (int i = 0; i < CURSOR_MAX; i++)
+        if (s_cursors[i].id && s_cursors[i].client == client) cursor_close(&s_cursors[i]);
+}
+
+/* "<id>:<offset>", opened by client */
+static ChanCursor *cursor_find(int client, const char *token, int *offset) {
+    char *end;
+    unsigned long id = strtoul(token, &end, 10);
+    if (*end != ':' || !id) return NULL;
+    long off = strtol(end + 1, &end, 10);
+    if (*end || off < 0) return NULL;
+    for (int i = 0; i < CURSOR_MAX; i++) {
+        if (s_cursors[i].id != id || s_cursors[i].client != client) continue;
+        if (off > iptv_list_count(s_cursors[i].list)) return NULL;
+        *offset = (int)off;
+        return &s_cursors[i];
+    }
+    return NULL;
+}
+
+static int parse_fields(const char *s) {
+    int mask = 0;
+    while (*s) {
+        size_t len = strcspn(s, ",");
+        for (size_t f = 0; f < sizeof(k_chan_fields) / sizeof(k_chan_fields[0]); f++)
+            if (strlen(k_chan_fields[f]) == len && !strncmp(s, k_chan_fields[f], len))
+                mask |= 1 << f;
+        s += len;
+        if (*s == ',') s++;
+    }
+    return mask ? mask : F_DEFAULT;
+}
+
+static void on_iptv_channels_get(CmdCtx *c) {
+    time_t      now = time(NULL);
+    const char *tok = cmd_str(c, "cursor", "");
+    ChanCursor  q   = { 0 }, *k = &q;
+    int         off = 0;
+    if (tok[0]) {
+        k = cursor_find(c->client, tok, &off);
+        if (!k) { cmd_error(c, "iptv_channels_get: cursor expired"); return; }
+    } else {
+        const char *pl_id = cmd_str(c, "playlist_id", "");
+        const char *group = cmd_str(c, "group", "");
+        snprintf(q.playlist_id, sizeof(q.playlist_id), "%s", pl_id);
+        snprintf(q.group,       sizeof(q.group),       "%s", group);
+        q.list   = iptv_get_channels(pl_id[0] ? pl_id : NULL, group[0] ? group : NULL);
+        q.client = c->client;
+        q.fields = F_DEFAULT;
+        /* Clamped before the cast: past the end there is nothing to send */
+        double o = cmd_num(c, "offset", 0);
+        int    n = iptv_list_count(q.list);
+        off = !(o > 0) ? 0 : o >= n ? n : (int)o;
+    }
+    const char *fields = cmd_str(c, "fields", "");
+    if (fields[0]) k->fields = parse_fields(fields);
+
+    double l     = cmd_num(c, "limit", PAGE_DEFAULT);
+    int    limit = !(l >= 1) ? 1 : l > PAGE_MAX ? PAGE_MAX : (int)l;
+    int    total = iptv_list_count(k->list);
+    int parts = cmd_bool(c, "stream", 0) ? (total - off + limit - 1) / limit : 1;
+    if (parts > STREAM_PAGES) parts = STREAM_PAGES;
+    if (parts < 1)            parts = 1;
+    if (off + parts * limit < total && !k->id) {
+        /* More to come: keep the snapshot */
+        ChanCursor *slot = cursor_slot(c->client, now);
+        *slot    = q;
+        if (++s_cursor_seq == 0) s_cursor_seq = 1;
+        slot->id = s_cursor_seq;
+        k = slot;
+    }
+    k->used = now;
+
+    Epg *epg = k->fields & F_NOW ? epg_acquire() : NULL;
+    for (int part = 0; part < parts; part++, off += limit) {
+        Wire *w = cmd_wire_begin(c, "iptv_channels");
+        if (k->playlist_id[0]) wire_kstr(w, "playlist_id", k->playlist_id);
+        if (k->group[0])       wire_kstr(w, "group",       k->group);
+        wire_knum(w, "offset", off);
+        wire_knum(w, "total",  total);
+        wire_key(w, "channels");
+        wire_arr(w);
+        for (int i = off; i < off + limit && i < total; i++) {
+            IptvChannel ch; iptv_list_get(k->list, i, &ch);
+            wire_obj(w);
+            if (k->fields & F_ID)       wire_kstr(w, "id",          ch.id);
+            if (k->fields & F_NAME)     wire_kstr(w, "name",        ch.name);
+            if (k->fields & F_URL)      wire_kstr(w, "url",         ch.url);
+            if (k->fields & F_GROUP)    wire_kstr(w, "group",       ch.group);
+            if (k->fields & F_LOGO)     wire_kstr(w, "logo",        ch.logo);
+            if (k->fields & F_TVG_ID)   wire_kstr(w, "tvg_id",      ch.tvg_id);
+            if (k->fields & F_PLAYLIST) wire_kstr(w, "playlist_id", ch.playlist_id);
+            EpgProgramme cur;
+            if (epg && epg_now_next(epg, epg_find(epg, ch.tvg_id, ch.name), now, &cur, NULL) & 1)
+                wire_kstr(w, "now", cur.title);
+            wire_end(w);
+        }
+        wire_end(w);
+        /* Only a kept snapshot can be continued: parts that reach the end
+         * of the list between them have no cursor */
+        if (k->id && off + limit < total) {
+            char next[32];
+            snprintf(next, sizeof(next), "%u:%d", k->id, off + limit);
+            wire_kstr(w, "next_cursor", next);
+        }
+        if (parts > 1) {
+            wire_knum(w, "part",  part);
+            wire_knum(w, "parts", parts);
+        }
+        cmd_wire_send(c, w);
+    }
+    epg_release(epg);
+    if (off >= total) {
+        if (k->id) cursor_close(k);
+        else       iptv_list_free(k->list);
+    }
+}
+
+static const CmdDef k_page_cmds[] = {
+    { "iptv_channels_get", on_iptv_channels_get, { { "playlist_id", CMD_ARG_STR,  0 },
+                                                   { "group",       CMD_ARG_STR,  0 },
+                                                   { "cursor",      CMD_ARG_STR,  0 },
+                                                   { "offset",      CMD_ARG_NUM,  0 },
+                                                   { "limit",       CMD_ARG_NUM,  0 },
+                                                   { "fields",      CMD_ARG_STR,  0 },
+                                                   { "stream",      CMD_ARG_BOOL, 0 } },
+                                                 CMD_QUIET },
+};
+
+int iptv_pages_register(void) {
+    return cmd_register(k_page_cmds, (int)(sizeof(k_page_cmds) / sizeof(k_page_cmds[0])));
+}
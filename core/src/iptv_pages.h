@@ -0,0 +1,18 @@
+#pragma once
+#include "cmd.h"
+
+/* iptv_channels_get pages through a channel list: {playlist_id, group,
+ * offset, limit, fields, stream} starts a query, {cursor} continues one.
+ * A query with more pages left keeps its list — and with it the catalog
+ * generation it was read from — under a cursor, so every page comes from
+ * the same snapshot even if a playlist is refreshed in between. A cursor
+ * belongs to the client that opened it and is dropped when that client
+ * disconnects or after CURSOR_IDLE_S idle; when all CURSOR_MAX are busy
+ * the client's own least recently used one goes, or failing that anyone's.
+ * Only the event loop touches them. */
+
+/* Add iptv_channels_get to the command table (see cmd_register()). */
+int  iptv_pages_register(void);
+
+/* Drop every cursor of a client that has gone. */
+void iptv_pages_client_gone(int client);
@@ -0,0 +1,273 @@
+#include "iptv_search.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Normalization ────────────────────────────────────────────────────────── */
+
+/* Base letters of U+00C0..U+00FF after case folding; 0 = separator. */
+static const char latin1[64] =
+    "aaaaaaaceeeeiiii" "dnooooo\0ouuuuyts"
+    "aaaaaaaceeeeiiii" "dnooooo\0ouuuuyty";
+
+static uint32_t fold(uint32_t c) {
+    if (c < 0x80) {
+        if (c >= 'A' && c <= 'Z') return c + 32;
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) return c;
+        return ' ';
+    }
+    if (c >= 0xC0 && c <= 0xFF)  return latin1[c - 0xC0] ? (uint32_t)latin1[c - 0xC0] : ' ';
+    if (c >= 0x80 && c < 0xC0)   return ' ';                 /* Latin-1 punctuation */
+    if (c == 0x401 || c == 0x451) return 0x435;              /* Ё ё → е */
+    if (c >= 0x410 && c <= 0x42F) return c + 0x20;           /* А-Я */
+    if (c >= 0x400 && c <= 0x40F) return c + 0x50;           /* Ѐ-Џ (Є І Ї Ў ...) */
+    if (c == 0x490) return 0x491;                            /* Ґ */
+    if (c >= 0x2000 && c <= 0x206F) return ' ';              /* general punctuation */
+    return c;
+}
+
+/* Decode one UTF-8 sequence; invalid bytes come back as U+FFFD. */
+static uint32_t next_cp(const unsigned char **ps) {
+    const unsigned char *s = *ps;
+    uint32_t c = *s++;
+    int more = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    if (c < 0x80)  { *ps = s; return c; }
+    if (!more)     { *ps = s; return 0xFFFD; }
+    c &= 0x3F >> more;
+    for (int i = 0; i < more; i++, s++) {
+        if ((*s & 0xC0) != 0x80) { *ps = s; return 0xFFFD; }
+        c = c << 6 | (*s & 0x3F);
+    }
+    *ps = s;
+    return c;
+}
+
+static size_t put_cp(char *out, uint32_t c) {
+    if (c < 0x80)    { out[0] = (char)c; return 1; }
+    if (c < 0x800)   { out[0] = (char)(0xC0 | c >> 6);  out[1] = (char)(0x80 | (c & 0x3F)); return 2; }
+    if (c < 0x10000) { out[0] = (char)(0xE0 | c >> 12); out[1] = (char)(0x80 | (c >> 6 & 0x3F));
+                       out[2] = (char)(0x80 | (c & 0x3F)); return 3; }
+    out[0] = (char)(0xF0 | c >> 18);        out[1] = (char)(0x80 | (c >> 12 & 0x3F));
+    out[2] = (char)(0x80 | (c >> 6 & 0x3F)); out[3] = (char)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+int iptv_search_normalize(const char *s, char *out, size_t cap) {
+    const unsigned char *p = (const unsigned char *)s;
+    size_t o = 0;
+    int    n = 0, sep = 1;                   /* sep: swallow leading spaces */
+    while (*p && o + 5 < cap) {
+        uint32_t c = fold(next_cp(&p));
+        if (c == ' ') {
+            if (!sep) { out[o++] = ' '; n++; sep = 1; }
+            continue;
+        }
+        o  += put_cp(out + o, c);
+        n++;
+        sep = 0;
+    }
+    if (o > 0 && out[o - 1] == ' ') { o--; n--; }
+    out[o] = '\0';
+    return n;
+}
+
+/* ── Trigrams ─────────────────────────────────────────────────────────────── */
+
+#define KEY(a, b, c) ((uint64_t)(a) << 42 | (uint64_t)(b) << 21 | (uint64_t)(c))
+
+static uint32_t key_hash(uint64_t k) {
+    k ^= k >> 33; k *= 0xff51afd7ed558ccdull; k ^= k >> 33;
+    return (uint32_t)k;
+}
+
+/* Trigrams of " " + name, plus the one-letter word start key "  x" of
+ * every word after the first (the first word's comes out as a trigram). */
+typedef struct {
+    const unsigned char *p;
+    uint32_t a, b;
+    uint64_t pending;
+} GramIter;
+
+static void grams_init(GramIter *g, const char *name) {
+    g->p = (const unsigned char *)name;
+    g->a = g->b = ' ';
+    g->pending = 0;
+}
+
+static int grams_next(GramIter *g, uint64_t *k) {
+    if (g->pending) { *k = g->pending; g->pending = 0; return 1; }
+    if (!*g->p) return 0;
+    uint32_t c = next_cp(&g->p);
+    *k = KEY(g->a, g->b, c);
+    if (g->b == ' ' && g->a != ' ') g->pending = KEY(' ', ' ', c);
+    g->a = g->b;
+    g->b = c;
+    return 1;
+}
+
+static uint32_t find_slot(const IptvSearch *s, uint64_t k, int *found) {
+    for (uint32_t i = key_hash(k);; i++) {
+        uint32_t j = i & s->mask;
+        if (s->keys[j] == k) { *found = 1; return j; }
+        if (!s->keys[j])     { *found = 0; return j; }
+    }
+}
+
+/* Rehash the trigram table (keys, counts and last[]) into cap slots,
+ * cap a power of two. */
+static int grow(IptvSearch *s, uint32_t **last, uint32_t cap) {
+    uint64_t *keys = calloc(cap, sizeof(uint64_t));
+    uint32_t *lens = calloc(cap, sizeof(uint32_t));
+    uint32_t *lst  = calloc(cap, sizeof(uint32_t));
+    if (!keys || !lens || !lst) { free(keys); free(lens); free(lst); return -1; }
+    IptvSearch t = { .keys = keys, .mask = cap - 1 };
+    for (uint32_t j = 0; s->keys && j <= s->mask; j++) {
+        if (!s->keys[j]) continue;
+        int found;
+        uint32_t d = find_slot(&t, s->keys[j], &found);
+        keys[d] = s->keys[j];
+        lens[d] = s->post_len[j];
+        lst[d]  = (*last)[j];
+    }
+    free(s->keys); free(s->post_len); free(*last);
+    s->keys     = keys;
+    s->post_len = lens;
+    s->mask     = cap - 1;
+    *last       = lst;
+    return 0;
+}
+
+IptvSearch *iptv_search_build(const IptvStore *st, uint32_t count) {
+    IptvSearch *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->count    = count;
+    s->norm_off = malloc((count ? count : 1) * sizeof(uint32_t));
+
+    /* Folding may grow a name (a stray byte becomes U+FFFD, three bytes),
+     * so the arena is sized for the worst case */
+    size_t cap = 1;
+    for (uint32_t i = 0; i < count; i++)
+        cap += strlen(iptv_store_str(st, st->recs[i].name)) * 2 + 6;
+    s->norm = malloc(cap);
+    if (!s->norm || !s->norm_off) { iptv_search_free(s); return NULL; }
+    size_t len = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        s->norm_off[i] = (uint32_t)len;
+        iptv_search_normalize(iptv_store_str(st, st->recs[i].name),
+                              s->norm + len, cap - len);
+        len += strlen(s->norm + len) + 1;
+    }
+    char *fit = realloc(s->norm, len ? len : 1);
+    if (fit) s->norm = fit;
+
+    /* Pass 1: collect distinct trigrams and count records per trigram
+     * (each record once). last[] holds the record + 1 last counted. */
+    uint32_t *last = NULL;
+    s->mask = 0;
+    if (grow(s, &last, 1024) < 0) { iptv_search_free(s); return NULL; }
+    uint32_t distinct = 0;
+    uint64_t total    = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        GramIter g;
+        uint64_t k;
+        for (grams_init(&g, iptv_search_name(s, i)); grams_next(&g, &k); ) {
+            int found;
+            uint32_t j = find_slot(s, k, &found);
+            if (!found) {
+                if ((distinct + 1) * 2 > s->mask + 1) {
+                    if (grow(s, &last, (s->mask + 1) * 2) < 0) {
+                        free(last); iptv_search_free(s); return NULL;
+                    }
+                    j = find_slot(s, k, &found);
+                }
+                s->keys[j] = k;
+                distinct++;
+            }
+            if (last[j] != i + 1) { last[j] = i + 1; s->post_len[j]++; total++; }
+        }
+    }
+    uint32_t tcap = s->mask + 1;
+    s->post_off = malloc(tcap * sizeof(uint32_t));
+    if (!s->post_off) { free(last); iptv_search_free(s); return NULL; }
+
+    /* Offsets, then pass 2 fills postings in record order */
+    s->post = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (!s->post) { free(last); iptv_search_free(s); return NULL; }
+    uint32_t off = 0;
+    for (uint32_t j = 0; j < tcap; j++) {
+        s->post_off[j] = off;
+        off += s->post_len[j];
+        s->post_len[j] = 0;
+        last[j] = 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        GramIter g;
+        uint64_t k;
+        for (grams_init(&g, iptv_search_name(s, i)); grams_next(&g, &k); ) {
+            int found;
+            uint32_t j = find_slot(s, k, &found);
+            if (last[j] != i + 1) {
+                last[j] = i + 1;
+                s->post[s->post_off[j] + s->post_len[j]++] = i;
+            }
+        }
+    }
+    free(last);
+    return s;
+}
+
+void iptv_search_free(IptvSearch *s) {
+    if (!s) return;
+    free(s->norm);
+    free(s->norm_off);
+    free(s->keys);
+    free(s->post_off);
+    free(s->post_len);
+    free(s->post);
+    free(s);
+}
+
+/* ── Queries ──────────────────────────────────────────────────────────────── */
+
+static const uint32_t *postings(const IptvSearch *s, uint64_t k, uint32_t *n) {
+    int found;
+    uint32_t j = find_slot(s, k, &found);
+    *n = found ? s->post_len[j] : 0;
+    return found ? s->post + s->post_off[j] : NULL;
+}
+
+const uint32_t *iptv_search_candidates(const IptvSearch *s, const char *q, int qchars,
+                                       uint32_t *n, int *exact) {
+    const unsigned char *p = (const unsigned char *)q;
+    *n = 0;
+    if (qchars <= 0) return NULL;
+    if (qchars < IPTV_SEARCH_MIN_SUBSTR) {
+        uint32_t a = next_cp(&p);
+        uint32_t b = *p ? next_cp(&p) : 0;
+        *exact = 1;
+        return postings(s, b ? KEY(' ', a, b) : KEY(' ', ' ', a), n);
+    }
+
+    /* Rarest trigram of the query; a missing one means no match at all */
+    *exact = 0;
+    const uint32_t *best = NULL;
+    uint32_t a = next_cp(&p), b = next_cp(&p), bn = UINT32_MAX;
+    while (*p) {
+        uint32_t c = next_cp(&p), cn;
+        const uint32_t *l = postings(s, KEY(a, b, c), &cn);
+        if (!l) return NULL;
+        if (cn < bn) { best = l; bn = cn; }
+        a = b; b = c;
+    }
+    *n = best ? bn : 0;
+    return best;
+}
+
+int iptv_search_match(const char *name, const char *q, int qchars) {
+    if (qchars >= IPTV_SEARCH_MIN_SUBSTR) return strstr(name, q) != NULL;
+    size_t ql = strlen(q);
+    for (const char *w = name; w; w = strchr(w, ' ')) {
+        if (*w == ' ') w++;
+        if (!strncmp(w, q, ql)) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "iptv_store.h"
+
+/* Name search over one playlist's channels.
+ *
+ * Names are normalized once — case-folded (Latin and Cyrillic, ё → е),
+ * Latin accents stripped, punctuation collapsed to single spaces — and
+ * every trigram of " " + name is posted, so a word start is a trigram
+ * beginning with a space. Short queries use the word-start keys ("  a",
+ * " ab"), longer ones the rarest of their trigrams, verified by substring.
+ *
+ * Built once per sealed store (never modified afterwards), next to the
+ * playlist's IptvIndex, and read without locking. */
+
+typedef struct IptvSearch {
+    uint32_t  count;
+    char     *norm;        /* normalized names, NUL-terminated */
+    uint32_t *norm_off;    /* record → offset in norm */
+
+    uint64_t *keys;        /* trigram table (open addressing, 0 = empty) */
+    uint32_t *post_off;    /* slot → first posting */
+    uint32_t *post_len;
+    uint32_t  mask;
+    uint32_t *post;        /* record indexes, ascending per trigram */
+} IptvSearch;
+
+/* Queries shorter than this many characters match word starts only. */
+#define IPTV_SEARCH_MIN_SUBSTR 3
+
+/* Normalize s into out (cap bytes incl. NUL). Returns the length in
+   characters (not bytes). */
+int  iptv_search_normalize(const char *s, char *out, size_t cap);
+
+/* Index records [0, count) of st. Returns NULL on allocation failure. */
+IptvSearch *iptv_search_build(const IptvStore *st, uint32_t count);
+void        iptv_search_free(IptvSearch *s);
+
+/* Records that may match the normalized query q of qchars characters,
+   ascending. *exact is set when every candidate is known to match (word
+   start keys); otherwise the caller must check iptv_search_match(). */
+const uint32_t *iptv_search_candidates(const IptvSearch *s, const char *q, int qchars,
+                                       uint32_t *n, int *exact);
+
+/* Whether normalized name contains normalized q under the rules above. */
+int  iptv_search_match(const char *name, const char *q, int qchars);
+
+static inline const char *iptv_search_name(const IptvSearch *s, uint32_t rec) {
+    return s->norm + s->norm_off[rec];
+}
@@ -0,0 +1,283 @@
+#include "iptv_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Address space reserved for a store that is being filled. Only touched
+ * pages become resident, so these bound the largest single playlist rather
+ * than what it costs: 1M channels, 64k groups, 512 MB of strings. */
+#define RES_RECS   ((size_t)1 << 20)
+#define RES_GROUPS ((size_t)1 << 16)
+#define RES_STRS   ((size_t)512 << 20)
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= 16777619u; }
+    return h;
+}
+
+static void *reserve(size_t bytes) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+/* Give back the untouched tail of a reservation; returns the new size. */
+static size_t trim(void *base, size_t reserved, size_t used) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t keep = (used + page - 1) & ~(page - 1);
+    if (keep == 0) keep = page;
+    if (keep < reserved) munmap((char *)base + keep, reserved - keep);
+    return keep < reserved ? keep : reserved;
+}
+
+/* ── Writer ───────────────────────────────────────────────────────────────── */
+
+static uint32_t add_str(IptvStore *s, const char *str) {
+    if (!str || !*str) return 0;
+    size_t n = strlen(str) + 1;
+    if (s->str_len + n > s->strs_res) { s->oom = 1; return 0; }
+    uint32_t off = s->str_len;
+    memcpy(s->strs + off, str, n);
+    s->str_len += (uint32_t)n;
+    return off;
+}
+
+IptvStore *iptv_store_new(const char *pl_id) {
+    IptvStore *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    atomic_init(&s->refs, 1);
+    strncpy(s->pl_id, pl_id, sizeof(s->pl_id)-1);
+
+    s->recs_res   = RES_RECS   * sizeof(IptvStoreRec);
+    s->groups_res = RES_GROUPS * sizeof(IptvStoreGroup);
+    s->strs_res   = RES_STRS;
+    s->recs   = reserve(s->recs_res);
+    s->groups = reserve(s->groups_res);
+    s->strs   = reserve(s->strs_res);
+    s->ghash_cap = 256;
+    s->ghash     = calloc(s->ghash_cap, sizeof(uint32_t));
+    if (!s->recs || !s->groups || !s->strs || !s->ghash) {
+        iptv_store_unref(s);
+        return NULL;
+    }
+
+    s->strs[0]  = '\0';                  /* offset 0: the shared empty string */
+    s->str_len  = 1;
+    s->groups[0] = (IptvStoreGroup){ 0, 0 };
+    s->group_count = 1;
+    atomic_init(&s->pub_groups, 1);
+    s->pl_id_off = add_str(s, s->pl_id);
+    return s;
+}
+
+static int ghash_grow(IptvStore *s) {
+    uint32_t  cap = s->ghash_cap * 2;
+    uint32_t *h   = calloc(cap, sizeof(uint32_t));
+    if (!h) return -1;
+    for (uint32_t g = 1; g < s->group_count; g++) {
+        const char *name = s->strs + s->groups[g].name;
+        uint32_t i = fnv1a(2166136261u, name, strlen(name));
+        while (h[i & (cap - 1)]) i++;
+        h[i & (cap - 1)] = g;
+    }
+    free(s->ghash);
+    s->ghash     = h;
+    s->ghash_cap = cap;
+    return 0;
+}
+
+/* Group name → index, adding it on first sight. 0 for "" or on failure. */
+static uint32_t intern_group(IptvStore *s, const char *name) {
+    if (!name || !*name) return 0;
+    if (s->group_count * 2 >= s->ghash_cap && ghash_grow(s) < 0) return 0;
+    uint32_t i = fnv1a(2166136261u, name, strlen(name));
+    for (;; i++) {
+        uint32_t *slot = &s->ghash[i & (s->ghash_cap - 1)];
+        if (!*slot) break;
+        if (!strcmp(s->strs + s->groups[*slot].name, name)) return *slot;
+    }
+    if (s->group_count >= RES_GROUPS) return 0;
+    uint32_t off = add_str(s, name);
+    if (!off) return 0;
+    uint32_t g = s->group_count++;
+    s->groups[g] = (IptvStoreGroup){ off, 0 };
+    s->ghash[i & (s->ghash_cap - 1)] = g;
+    return g;
+}
+
+int iptv_store_add(IptvStore *s, const char *id, const char *name,
+                   const char *url, const char *group, const char *logo,
+                   const char *tvg_id) {
+    if (s->sealed || s->oom || s->count >= RES_RECS) return -1;
+    IptvStoreRec r;
+    r.id    = add_str(s, id);
+    r.name  = add_str(s, name);
+    r.url   = add_str(s, url);
+    r.logo  = add_str(s, logo);
+    r.tvg_id = add_str(s, tvg_id);
+    r.group = intern_group(s, group);
+    if (s->oom) return -1;
+    s->recs[s->count++] = r;
+    return 0;
+}
+
+void iptv_store_publish(IptvStore *s) {
+    atomic_store_explicit(&s->pub_groups, s->group_count, memory_order_release);
+    atomic_store_explicit(&s->pub_count,  s->count,       memory_order_release);
+}
+
+void iptv_store_seal(IptvStore *s) {
+    if (s->sealed) return;
+    for (uint32_t i = 0; i < s->count; i++)
+        s->groups[s->recs[i].group].count++;
+    iptv_store_publish(s);
+    s->recs_res   = trim(s->recs,   s->recs_res,   s->count * sizeof(IptvStoreRec));
+    s->groups_res = trim(s->groups, s->groups_res, s->group_count * sizeof(IptvStoreGroup));
+    s->strs_res   = trim(s->strs,   s->strs_res,   s->str_len);
+    free(s->ghash);
+    s->ghash     = NULL;
+    s->ghash_cap = 0;
+    s->sealed    = 1;
+}
+
+/* ── Disk persistence ─────────────────────────────────────────────────────── */
+
+int iptv_store_save(const IptvStore *s, const char *path) {
+    size_t recs_sz   = (size_t)s->count * sizeof(IptvStoreRec);
+    size_t groups_sz = (size_t)s->group_count * sizeof(IptvStoreGroup);
+
+    IptvStoreHdr hdr = {
+        .magic       = IPTV_STORE_MAGIC,
+        .version     = IPTV_STORE_VERSION,
+        .rec_size    = sizeof(IptvStoreRec),
+        .count       = s->count,
+        .group_count = s->group_count,
+        .rec_off     = sizeof(IptvStoreHdr),
+        .group_off   = (uint32_t)(sizeof(IptvStoreHdr) + recs_sz),
+        .str_off     = (uint32_t)(sizeof(IptvStoreHdr) + recs_sz + groups_sz),
+        .str_len     = s->str_len,
+        .pl_id       = s->pl_id_off,
+    };
+    uint32_t sum = fnv1a(2166136261u, &hdr, offsetof(IptvStoreHdr, checksum));
+    sum = fnv1a(sum, s->recs, recs_sz);
+    hdr.checksum = fnv1a(sum, s->groups, groups_sz);
+
+    char tmp[512]; snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int ok = 0;
+    FILE *f = fopen(tmp, "wb");
+    if (f) {
+        ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             fwrite(s->recs,   1, recs_sz,    f) == recs_sz &&
+             fwrite(s->groups, 1, groups_sz,  f) == groups_sz &&
+             fwrite(s->strs,   1, s->str_len, f) == s->str_len;
+        if (fclose(f) != 0) ok = 0;
+        if (ok) ok = rename(tmp, path) == 0;
+        if (!ok) remove(tmp);
+    }
+    return ok ? 0 : -1;
+}
+
+IptvStore *iptv_store_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(IptvStoreHdr)) {
+        close(fd); return NULL;
+    }
+    size_t sz  = (size_t)st.st_size;
+    void  *map = mmap(NULL, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const IptvStoreHdr *h = map;
+    const char *base = map;
+    if (h->magic != IPTV_STORE_MAGIC ||
+        h->version != IPTV_STORE_VERSION ||
+        h->rec_size != sizeof(IptvStoreRec) ||
+        h->rec_off != sizeof(IptvStoreHdr) ||
+        (uint64_t)h->rec_off + (uint64_t)h->count * sizeof(IptvStoreRec) != h->group_off ||
+        (uint64_t)h->group_off + (uint64_t)h->group_count * sizeof(IptvStoreGroup) != h->str_off ||
+        h->group_count == 0 || h->str_len == 0 ||
+        (uint64_t)h->str_off + h->str_len != sz || h->pl_id >= h->str_len) {
+        fprintf(stderr, "iptv_store: %s: bad header\n", path);
+        munmap(map, sz);
+        return NULL;
+    }
+
+    /* Header and tables only: the string arena is not read here */
+    const char *strs = base + h->str_off;
+    uint32_t    sum  = fnv1a(fnv1a(2166136261u, h, offsetof(IptvStoreHdr, checksum)),
+                             base + h->rec_off, h->str_off - h->rec_off);
+    if (sum != h->checksum || strs[h->str_len - 1] != '\0') {
+        fprintf(stderr, "iptv_store: %s: checksum mismatch\n", path);
+        munmap(map, sz);
+        return NULL;
+    }
+
+    /* Offsets must land inside the blob (the trailing NUL checked above then
+     * terminates every string) and group indexes inside the group table. */
+    const IptvStoreRec   *r = (const IptvStoreRec *)(base + h->rec_off);
+    const IptvStoreGroup *g = (const IptvStoreGroup *)(base + h->group_off);
+    for (uint32_t i = 0; i < h->count; i++) {
+        if (r[i].id >= h->str_len || r[i].name >= h->str_len || r[i].url >= h->str_len ||
+            r[i].logo >= h->str_len || r[i].tvg_id >= h->str_len ||
+            r[i].group >= h->group_count) {
+            fprintf(stderr, "iptv_store: %s: record %u out of range\n", path, i);
+            munmap(map, sz);
+            return NULL;
+        }
+    }
+    for (uint32_t i = 0; i < h->group_count; i++) {
+        if (g[i].name >= h->str_len) {
+            fprintf(stderr, "iptv_store: %s: group %u out of range\n", path, i);
+            munmap(map, sz);
+            return NULL;
+        }
+    }
+    IptvStore *s = calloc(1, sizeof(*s));
+    if (!s) { munmap(map, sz); return NULL; }
+    atomic_init(&s->refs, 1);
+    strncpy(s->pl_id, strs + h->pl_id, sizeof(s->pl_id)-1);
+    s->pl_id_off   = h->pl_id;
+    /* Sealed stores are never written: the const casts below are safe and
+     * the mapping itself is read-only. */
+    s->recs        = (IptvStoreRec *)r;
+    s->groups      = (IptvStoreGroup *)g;
+    s->strs        = (char *)strs;
+    s->count       = h->count;
+    s->group_count = h->group_count;
+    s->str_len     = h->str_len;
+    s->file_map    = map;
+    s->file_len    = sz;
+    s->sealed      = 1;
+    atomic_init(&s->pub_count,  h->count);
+    atomic_init(&s->pub_groups, h->group_count);
+    madvise(map, sz, MADV_WILLNEED);
+    return s;
+}
+
+/* ── Lifetime ─────────────────────────────────────────────────────────────── */
+
+IptvStore *iptv_store_ref(IptvStore *s) {
+    if (s) atomic_fetch_add_explicit(&s->refs, 1, memory_order_relaxed);
+    return s;
+}
+
+void iptv_store_unref(IptvStore *s) {
+    if (!s || atomic_fetch_sub_explicit(&s->refs, 1, memory_order_acq_rel) != 1)
+        return;
+    if (s->file_map) {
+        munmap(s->file_map, s->file_len);
+    } else {
+        if (s->recs)   munmap(s->recs,   s->recs_res);
+        if (s->groups) munmap(s->groups, s->groups_res);
+        if (s->strs)   munmap(s->strs,   s->strs_res);
+    }
+    free(s->ghash);
+    free(s);
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Per-playlist channel table: compact fixed-size records whose string
+ * fields are offsets into one string arena, plus a table of the playlist's
+ * distinct group names. Each channel costs 24 bytes + its actual strings.
+ *
+ * The same layout is used in memory and on disk (<cache_dir>/<pl_id>.bin),
+ * so a cached playlist is loaded by mmap'ing the file and pointing the
+ * store at it — no parsing, no copy, no per-channel allocation.
+ *
+ * A store being filled by a download reserves address space up front
+ * (MAP_NORESERVE; pages are only committed as they are written) so records
+ * and strings never move. Records below the published count are immutable
+ * and may be read while the download keeps appending. */
+
+/* ── On-disk layout (little-endian, host byte order on every board we ship) ──
+ *   IptvStoreHdr
+ *   IptvStoreRec[count]          at rec_off
+ *   IptvStoreGroup[group_count]  at group_off
+ *   char strings[str_len]        at str_off, NUL-terminated, offset 0 == ""
+ * The checksum covers only the header and the two tables, so opening a
+ * cache never reads the string arena. The strings themselves — names,
+ * URLs, logos — are not protected: open() checks that every offset lands
+ * inside the arena and that it ends in a NUL, nothing more, so a flipped
+ * byte there comes back as a wrong name or a URL that does not play until
+ * the next refresh rewrites the file. */
+
+#define IPTV_STORE_MAGIC   0x48435851u   /* "QXCH" */
+#define IPTV_STORE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rec_size;    /* sizeof(IptvStoreRec) — guards against layout drift */
+    uint32_t count;
+    uint32_t group_count;
+    uint32_t rec_off;
+    uint32_t group_off;
+    uint32_t str_off;
+    uint32_t str_len;
+    uint32_t pl_id;       /* string offset of the owning playlist id */
+    uint32_t checksum;    /* FNV-1a over the fields above + records + groups */
+} IptvStoreHdr;
+
+typedef struct {
+    uint32_t id;
+    uint32_t name;
+    uint32_t url;
+    uint32_t logo;
+    uint32_t tvg_id;      /* EPG channel id from the playlist */
+    uint32_t group;       /* index into the group table; 0 is "no group" */
+} IptvStoreRec;
+
+typedef struct {
+    uint32_t name;        /* string offset */
+    uint32_t count;       /* channels in this group (filled in by seal) */
+} IptvStoreGroup;
+
+/* ── In-memory store ──────────────────────────────────────────────────────── */
+
+typedef struct IptvStore {
+    atomic_int      refs;
+    char            pl_id[32];
+    uint32_t        pl_id_off;    /* the playlist id, also kept in the arena */
+
+    IptvStoreRec   *recs;
+    IptvStoreGroup *groups;
+    char           *strs;
+    uint32_t        count;        /* records written (writer side) */
+    uint32_t        group_count;
+    uint32_t        str_len;
+    atomic_uint     pub_count;    /* records visible to readers */
+    atomic_uint     pub_groups;   /* groups visible to readers */
+    int             sealed;       /* complete and immutable */
+
+    /* Backing memory: either the mmap'd cache file or anonymous reservations */
+    void           *file_map;
+    size_t          file_len;
+    size_t          recs_res, groups_res, strs_res;
+
+    /* Writer-only group name → index table (open addressing) */
+    uint32_t       *ghash;
+    uint32_t        ghash_cap;
+    int             oom;          /* a reservation ran out — further adds dropped */
+} IptvStore;
+
+/* New empty store ready for appends. Returns NULL on allocation failure. */
+IptvStore *iptv_store_new(const char *pl_id);
+
+/* Map a cache file and validate magic, version, layout and checksum.
+   Returns a sealed store, or NULL if the file is missing or invalid.
+   A cache in an older version is converted into an anonymous store
+   (file_map is NULL) that the caller should save back. */
+IptvStore *iptv_store_open(const char *path);
+
+/* Append one channel. NULL strings are stored as "". Not visible to readers
+   until iptv_store_publish(). Returns 0, or -1 if the store is full. */
+int  iptv_store_add(IptvStore *s, const char *id, const char *name,
+                    const char *url, const char *group, const char *logo,
+                    const char *tvg_id);
+
+/* Make all appended records visible to concurrent readers. */
+void iptv_store_publish(IptvStore *s);
+
+/* Finish writing: publish, fill in group counts, release the unused tail of
+   the reservations and drop writer-only tables. */
+void iptv_store_seal(IptvStore *s);
+
+/* Write a sealed store to path atomically (tmp file + rename). Returns 0 on success. */
+int  iptv_store_save(const IptvStore *s, const char *path);
+
+IptvStore *iptv_store_ref(IptvStore *s);
+void       iptv_store_unref(IptvStore *s);
+
+/* Reader-side counts (acquire the writer's last publish). */
+static inline uint32_t iptv_store_count(const IptvStore *s) {
+    return atomic_load_explicit(&((IptvStore *)s)->pub_count, memory_order_acquire);
+}
+static inline uint32_t iptv_store_groups(const IptvStore *s) {
+    return atomic_load_explicit(&((IptvStore *)s)->pub_groups, memory_order_acquire);
+}
+
+static inline const char *iptv_store_str(const IptvStore *s, uint32_t off) {
+    return s->strs + off;
+}
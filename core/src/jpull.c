@@ -0,0 +1,251 @@
+#include "jpull.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Lexing ───────────────────────────────────────────────────────────────── */
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+static int grow(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 0;
+    size_t c = *cap ? *cap : 64;
+    while (c < need) c *= 2;
+    char *n = realloc(*buf, c);
+    if (!n) return -1;
+    *buf = n;
+    *cap = c;
+    return 0;
+}
+
+static int hex4(const char *p) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        int  d = c >= '0' && c <= '9' ? c - '0' :
+                 c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                 c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0) return -1;
+        v = v << 4 | d;
+    }
+    return v;
+}
+
+/* Unescape the string at p (the opening quote) into *buf from offset off,
+ * NUL-terminated. Raw control bytes are taken as they are: older versions
+ * wrote them unescaped. Returns the position after the closing quote, or
+ * NULL. */
+static const char *read_str(const char *p, char **buf, size_t *cap, size_t off, size_t *len) {
+    size_t o = off;
+    p++;
+    for (;;) {
+        const char *r = p;
+        while (*r && *r != '"' && *r != '\\') r++;
+        size_t n = (size_t)(r - p);
+        if (grow(buf, cap, o + n + 5) < 0) return NULL;   /* + one escape + NUL */
+        memcpy(*buf + o, p, n);
+        o += n;
+        p  = r;
+        if (*p == '"') break;
+        if (!*p) return NULL;
+
+        char *w = *buf;
+        p++;
+        char c = *p++;
+        switch (c) {
+        case '"': case '\\': case '/': w[o++] = c; break;
+        case 'b': w[o++] = '\b'; break;
+        case 'f': w[o++] = '\f'; break;
+        case 'n': w[o++] = '\n'; break;
+        case 'r': w[o++] = '\r'; break;
+        case 't': w[o++] = '\t'; break;
+        case 'u': {
+            int cp = hex4(p);
+            if (cp < 0) return NULL;
+            p += 4;
+            if (cp >= 0xD800 && cp < 0xDC00 && p[0] == '\\' && p[1] == 'u') {
+                int lo = hex4(p + 2);
+                if (lo < 0xDC00 || lo > 0xDFFF) return NULL;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+            }
+            if (cp < 0x80)         { w[o++] = (char)cp; }
+            else if (cp < 0x800)   { w[o++] = (char)(0xC0 | cp >> 6);  w[o++] = (char)(0x80 | (cp & 0x3F)); }
+            else if (cp < 0x10000) { w[o++] = (char)(0xE0 | cp >> 12); w[o++] = (char)(0x80 | (cp >> 6 & 0x3F));
+                                     w[o++] = (char)(0x80 | (cp & 0x3F)); }
+            else                   { w[o++] = (char)(0xF0 | cp >> 18); w[o++] = (char)(0x80 | (cp >> 12 & 0x3F));
+                                     w[o++] = (char)(0x80 | (cp >> 6 & 0x3F)); w[o++] = (char)(0x80 | (cp & 0x3F)); }
+            break;
+        }
+        default: return NULL;
+        }
+    }
+    (*buf)[o] = '\0';
+    *len = o - off;
+    return p + 1;
+}
+
+/* ── Reader ───────────────────────────────────────────────────────────────── */
+
+/* j->done: 0 reading, 1 complete, 2 failed (sticky) */
+static JpTok fail(JPull *j) {
+    j->done = 2;
+    return JP_ERROR;
+}
+
+void jp_init(JPull *j, const char *json) {
+    j->p     = json;
+    j->at    = json;
+    j->depth = 0;
+    j->done  = 0;
+    j->len   = 0;
+    j->mark  = 0;
+    j->num   = 0;
+}
+
+void jp_free(JPull *j) {
+    free(j->key);
+    free(j->str);
+    j->key = j->str = NULL;
+    j->key_cap = j->str_cap = 0;
+}
+
+JpTok jp_next(JPull *j) {
+    if (j->done) return j->done == 2 ? JP_ERROR : JP_END;
+    const char *p = skip_ws(j->p);
+
+    if (j->depth) {
+        int d = j->depth - 1;
+        if (*p == (j->map[d] ? '}' : ']')) {
+            j->p = p + 1;
+            if (--j->depth == 0) j->done = 1;
+            return JP_CLOSE;
+        }
+        if (!j->first[d]) {
+            if (*p != ',') return fail(j);
+            p = skip_ws(p + 1);
+        }
+        j->first[d] = 0;
+        if (j->map[d]) {
+            size_t kl;
+            if (*p != '"' || !(p = read_str(p, &j->key, &j->key_cap, 0, &kl))) return fail(j);
+            p = skip_ws(p);
+            if (*p != ':') return fail(j);
+            p = skip_ws(p + 1);
+        }
+    }
+
+    j->at = p;
+    JpTok t;
+    switch (*p) {
+    case '{': case '[':
+        if (j->depth == JP_MAX_DEPTH) return fail(j);
+        j->map  [j->depth] = *p == '{';
+        j->first[j->depth] = 1;
+        j->depth++;
+        j->p = p + 1;
+        return *p == '{' ? JP_OBJ : JP_ARR;
+    case '"':
+        if (!(p = read_str(p, &j->str, &j->str_cap, j->mark, &j->len))) return fail(j);
+        t = JP_STR;
+        break;
+    case 't':
+        if (strncmp(p, "true", 4)) return fail(j);
+        p += 4; j->num = 1; t = JP_BOOL;
+        break;
+    case 'f':
+        if (strncmp(p, "false", 5)) return fail(j);
+        p += 5; j->num = 0; t = JP_BOOL;
+        break;
+    case 'n':
+        if (strncmp(p, "null", 4)) return fail(j);
+        p += 4; t = JP_NULL;
+        break;
+    default: {
+        if (*p != '-' && (*p < '0' || *p > '9')) return fail(j);
+        char *end;
+        j->num = strtod(p, &end);
+        p = end;
+        t = JP_NUM;
+    }
+    }
+    j->p = p;
+    if (!j->depth) j->done = 1;
+    return t;
+}
+
+int jp_skip(JPull *j) {
+    if (j->done || !j->depth) return -1;
+    const char *p = j->p;
+    int depth = 1;
+    while (depth) {
+        char c = *p++;
+        if (c == '"') {
+            for (; *p != '"'; p++) {
+                if (!*p) goto bad;
+                if (*p == '\\' && !*++p) goto bad;
+            }
+            p++;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        } else if (!c) {
+            goto bad;
+        }
+    }
+    j->p = p;
+    if (--j->depth == 0) j->done = 1;
+    return 0;
+bad:
+    fail(j);
+    return -1;
+}
+
+/* ── Flat objects ─────────────────────────────────────────────────────────── */
+
+int jp_fields(JPull *j, const char *const *keys, int n, JpVal *out) {
+    for (int i = 0; i < n; i++) memset(&out[i], 0, sizeof(out[i]));
+    JpTok t = jp_next(j);
+    if (t == JP_CLOSE || t == JP_END) return 0;
+    if (t == JP_ERROR) return -1;
+    if (t == JP_ARR) return jp_skip(j) < 0 ? -1 : 1;
+    if (t != JP_OBJ) return 1;
+
+    /* Wanted strings are kept one after another in j->str; it may move
+     * while growing, so they are located by offset until the end */
+    size_t off[JP_MAX_FIELDS];
+    if (n > JP_MAX_FIELDS) { fail(j); return -1; }
+    j->mark = 0;
+    while ((t = jp_next(j)) != JP_CLOSE) {
+        if (t == JP_ERROR || t == JP_END) { j->mark = 0; return -1; }
+        if (t == JP_OBJ || t == JP_ARR) {
+            if (jp_skip(j) < 0) { j->mark = 0; return -1; }
+            continue;
+        }
+        int i = 0;
+        while (i < n && (out[i].type != JP_END || strcmp(j->key, keys[i]))) i++;
+        if (i == n) continue;
+        out[i].type = t;
+        out[i].num  = j->num;
+        if (t == JP_STR) {
+            off[i]      = j->mark;
+            out[i].len  = j->len;
+            j->mark    += j->len + 1;
+        }
+    }
+    for (int i = 0; i < n; i++)
+        if (out[i].type == JP_STR) out[i].str = j->str + off[i];
+    j->mark = 0;
+    return 1;
+}
+
+const char *jp_vstr(const JpVal *v, const char *def) {
+    return v->type == JP_STR ? v->str : def;
+}
+
+double jp_vnum(const JpVal *v, double def) {
+    return v->type == JP_NUM ? v->num : def;
+}
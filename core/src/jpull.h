@@ -0,0 +1,76 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Pull reader: walks JSON text one value at a time, without building a
+ * tree. The reading counterpart of wire.h, for big arrays of flat objects
+ * (channel lists, history, yt-dlp output) that are copied straight into
+ * C structs:
+ *
+ *   JPull j = {0}; JpVal v[2];
+ *   static const char *const keys[] = { "name", "url" };
+ *   jp_init(&j, text);
+ *   if (jp_next(&j) != JP_ARR) ...
+ *   while ((r = jp_fields(&j, keys, 2, v)) > 0)
+ *       add(jp_vstr(&v[0], ""), jp_vstr(&v[1], ""));
+ *   jp_free(&j);
+ *
+ * Memory is two string buffers that grow to the longest key and the
+ * longest object read, whatever the length of the array. The input must be
+ * NUL-terminated, but reading stops after the first complete value, so it
+ * may be followed by anything (a JSON value embedded in a larger
+ * message). */
+
+typedef enum {
+    JP_END = 0,          /* the top-level value is complete */
+    JP_ERROR,            /* malformed input, nesting past JP_MAX_DEPTH, or out of memory */
+    JP_OBJ, JP_ARR,      /* container opened */
+    JP_CLOSE,            /* innermost container closed */
+    JP_STR, JP_NUM, JP_BOOL, JP_NULL,
+} JpTok;
+
+#define JP_MAX_DEPTH  64
+#define JP_MAX_FIELDS 16
+
+typedef struct {
+    const char *p;
+    const char *at;                  /* where the last value starts */
+    int         depth, done;
+    uint8_t     map  [JP_MAX_DEPTH];
+    uint8_t     first[JP_MAX_DEPTH]; /* nothing read in the container yet */
+    char       *key;  size_t key_cap;   /* member name of the last value in an object */
+    char       *str;  size_t str_cap;   /* JP_STR, unescaped and NUL-terminated */
+    size_t      len;                    /* of str */
+    size_t      mark;                   /* jp_fields(): where the next string goes */
+    double      num;                    /* JP_NUM; JP_BOOL as 0 or 1 */
+} JPull;
+
+/* j must be zeroed before its first jp_init(); later ones reuse the buffers
+   until jp_free(). */
+void  jp_init(JPull *j, const char *json);
+void  jp_free(JPull *j);
+JpTok jp_next(JPull *j);
+
+/* After JP_OBJ or JP_ARR: skip to the end of that container without
+   decoding it. Returns 0, or -1 if it is malformed. */
+int   jp_skip(JPull *j);
+
+/* One member of a flat object, as picked by jp_fields() */
+typedef struct {
+    JpTok       type;        /* JP_END when the member is absent */
+    const char *str;         /* JP_STR */
+    size_t      len;
+    double      num;         /* JP_NUM, JP_BOOL */
+} JpVal;
+
+/* Read the next element of the current array as an object, filling out[i]
+   with the value of member keys[i] (the first one when repeated). Nested
+   values and other members are skipped; an element that is not an object
+   leaves every out[i] absent. n is at most JP_MAX_FIELDS. Strings stay
+   valid until the next call.
+   Returns 1 per element, 0 at the end of the array, -1 on malformed input. */
+int   jp_fields(JPull *j, const char *const *keys, int n, JpVal *out);
+
+/* Value of a member, or def when it is absent or of another type */
+const char *jp_vstr(const JpVal *v, const char *def);
+double      jp_vnum(const JpVal *v, double def);
@@ -0,0 +1,138 @@
+#include "m3u.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+/* ── Line handling ────────────────────────────────────────────────────────── */
+
+/* Copy len bytes of src into meta as a new string; returns its offset. */
+static size_t meta_add(M3uParser *p, const char *src, size_t len) {
+    if (len == 0 || p->meta_len + len + 1 > sizeof(p->meta)) return 0;
+    size_t off = p->meta_len;
+    memcpy(p->meta + off, src, len);
+    p->meta[off + len] = '\0';
+    p->meta_len += len + 1;
+    return off;
+}
+
+static void parse_extinf(M3uParser *p, char *line) {
+    p->meta[0]  = '\0';
+    p->meta_len = 1;
+    p->name = p->tvg_id = p->group = p->logo = 0;
+    p->has_meta = 1;
+
+    /* Extract attributes: tvg-id="..." group-title="..." tvg-logo="..." ,Name */
+    char *comma = strrchr(line, ',');
+    if (comma) {
+        const char *n = comma + 1;
+        while (*n == ' ') n++;           /* trim leading space */
+        p->name = meta_add(p, n, strlen(n));
+    }
+
+    /* Parse key="value" pairs */
+    const char *attr = line + 8;
+    while ((attr = strstr(attr, "="))) {
+        /* Find key start */
+        const char *key_end = attr;
+        const char *key_start = key_end - 1;
+        while (key_start > line && *key_start != ' ' &&
+               *key_start != '\t') key_start--;
+        if (*key_start == ' ' || *key_start == '\t') key_start++;
+
+        char key[64] = {0};
+        int  klen = (int)(key_end - key_start);
+        if (klen >= (int)sizeof(key)) klen = sizeof(key)-1;
+        memcpy(key, key_start, klen);
+
+        attr++; /* skip '=' */
+        if (*attr == '"') {
+            attr++;
+            const char *val_end = strchr(attr, '"');
+            if (!val_end) break;
+            size_t vlen = (size_t)(val_end - attr);
+
+            if      (!strcasecmp(key,"tvg-id"))      p->tvg_id = meta_add(p, attr, vlen);
+            else if (!strcasecmp(key,"group-title")) p->group  = meta_add(p, attr, vlen);
+            else if (!strcasecmp(key,"tvg-logo"))    p->logo   = meta_add(p, attr, vlen);
+
+            attr = val_end + 1;
+        } else {
+            attr++;
+        }
+    }
+}
+
+static void process_line(M3uParser *p, char *line, size_t llen) {
+    /* Trim \r */
+    while (llen > 0 && (line[llen-1] == '\r' || line[llen-1] == '\n')) llen--;
+    line[llen] = '\0';
+    if (!*line) return;
+
+    if (!strncmp(line, "#EXTINF:", 8)) {
+        parse_extinf(p, line);
+    } else if (line[0] != '#' && p->has_meta) {
+        const char *name = p->meta + p->name;
+
+        /* Generate stable id */
+        char id_src[128];
+        snprintf(id_src, sizeof(id_src), "%s_%s_%d", p->pl_id, name, p->count);
+        /* Simple hash to 8 hex chars */
+        unsigned h = 5381;
+        for (const char *s = id_src; *s; s++) h = ((h << 5) + h) ^ (unsigned char)*s;
+        snprintf(p->id, sizeof(p->id), "%s_%08x", p->pl_id, h);
+
+        IptvChannel ch = {
+            .id          = p->id,
+            .name        = name,
+            .url         = line,
+            .group       = p->meta + p->group,
+            .logo        = p->meta + p->logo,
+            .tvg_id      = p->meta + p->tvg_id,
+            .playlist_id = p->pl_id,
+        };
+        p->count++;
+        p->has_meta = 0;
+        if (p->cb) p->cb(&ch, p->userdata);
+    }
+}
+
+/* ── Public API ───────────────────────────────────────────────────────────── */
+
+void m3u_init(M3uParser *p, const char *pl_id, M3uChannelCb cb, void *userdata) {
+    memset(p, 0, sizeof(*p));
+    strncpy(p->pl_id, pl_id, sizeof(p->pl_id)-1);
+    p->cb       = cb;
+    p->userdata = userdata;
+}
+
+void m3u_feed(M3uParser *p, const char *data, size_t len) {
+    while (len > 0) {
+        const char *nl  = memchr(data, '\n', len);
+        size_t      seg = nl ? (size_t)(nl - data) : len;
+
+        /* Append to the pending line, dropping whatever exceeds the cap */
+        if (!p->overflow) {
+            size_t room = sizeof(p->line) - 1 - p->line_len;
+            size_t take = seg < room ? seg : room;
+            memcpy(p->line + p->line_len, data, take);
+            p->line_len += take;
+            if (take < seg) p->overflow = 1;
+        }
+
+        if (!nl) return;                 /* line continues in the next chunk */
+
+        process_line(p, p->line, p->line_len);
+        p->line_len = 0;
+        p->overflow = 0;
+        data += seg + 1;
+        len  -= seg + 1;
+    }
+}
+
+int m3u_finish(M3uParser *p) {
+    if (p->line_len > 0) {
+        process_line(p, p->line, p->line_len);
+        p->line_len = 0;
+    }
+    return p->count;
+}
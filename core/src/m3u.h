@@ -0,0 +1,42 @@
+#pragma once
+#include "iptv.h"
+#include <stddef.h>
+
+/* Incremental M3U/M3U8 playlist parser.
+ *
+ * Fed with arbitrary chunks straight from the download (lines may be split
+ * anywhere, including inside a CRLF pair). Each complete #EXTINF + URL pair
+ * is handed to the callback as soon as its URL line ends, so memory use is
+ * bounded by one line, not by the playlist size. */
+
+/* Longest line we keep; the rest of a longer line is discarded. */
+#define M3U_MAX_LINE 8192
+
+/* Called once per parsed channel. ch and its strings are only valid during
+   the call. */
+typedef void (*M3uChannelCb)(const IptvChannel *ch, void *userdata);
+
+typedef struct {
+    char         pl_id[32];
+    M3uChannelCb cb;
+    void        *userdata;
+    /* Attributes of the pending #EXTINF, NUL-separated in meta. Values are
+     * offsets into meta; 0 is the empty string. */
+    char         meta[M3U_MAX_LINE + 8];
+    size_t       meta_len;
+    size_t       name, tvg_id, group, logo;
+    char         id[64];       /* generated id of the emitted channel */
+    int          has_meta;
+    int          count;        /* channels emitted so far */
+    char         line[M3U_MAX_LINE];
+    size_t       line_len;     /* bytes of a partial line carried over */
+    int          overflow;     /* current line exceeded M3U_MAX_LINE */
+} M3uParser;
+
+void m3u_init(M3uParser *p, const char *pl_id, M3uChannelCb cb, void *userdata);
+
+/* Consume len bytes. May invoke the callback any number of times. */
+void m3u_feed(M3uParser *p, const char *data, size_t len);
+
+/* Flush a final line without a trailing newline. Returns channels emitted. */
+int  m3u_finish(M3uParser *p);
@@ -23,12 +23,14 @@
 #include "input.h"
 #include "mpv.h"
 #include "ws.h"
+#include "cmd.h"
 #include "ytdlp.h"
 #include "iptv.h"
+#include "iptv_pages.h"
+#include "epg.h"
 #include "history.h"
 #include "thumbcache.h"
 #include "config.h"
-#include "../third_party/cjson.h"
 
 #include "services.h"
 #include "ui/home.h"
@@ -63,17 +65,39 @@ static void epoll_del(int fd) {
     epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
 }
 
+/* WS client fds are tagged fd + 100 (see below); EPOLLOUT only while the
+ * client has frames the socket didn't take yet. */
+static void ws_poll_cb(int fd, int want_write) {
+    struct epoll_event ev = {
+        .events   = EPOLLIN | EPOLLHUP | EPOLLERR | (want_write ? EPOLLOUT : 0),
+        .data.ptr = (void*)(intptr_t)(fd + 100),
+    };
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+/* ── Broadcast helpers ─────────────────────────────────────────────────────── */
+
+/* Broadcast a finished JSON message and release its buffer. Messages built
+   off the event loop use a Wire of their own, not a shared one. */
+static void broadcast_wire(Wire *w) {
+    if (w->failed) fprintf(stderr, "ws: broadcast encoding failed\n");
+    else           ws_broadcast(w->buf);
+    wire_free(w);
+}
+
 /* ── YouTube play callback ─────────────────────────────────────────────────── */
 
 static void ws_play_cb(const char *stream_url, void *userdata) {
     const char *orig_url = (const char *)userdata;
     if (!stream_url) {
         fprintf(stderr, "play: yt-dlp FAILED for %s\n", orig_url);
-        cJSON *err = cJSON_CreateObject();
-        cJSON_AddStringToObject(err, "type", "error");
-        cJSON_AddStringToObject(err, "msg",  "yt-dlp resolve failed");
-        char *s = cJSON_Print(err); cJSON_Delete(err);
-        ws_broadcast(s); free(s);
+        Wire w = {0};
+        wire_reset(&w, WIRE_JSON);
+        wire_obj(&w);
+        wire_kstr(&w, "type", "error");
+        wire_kstr(&w, "msg",  "yt-dlp resolve failed");
+        wire_end(&w);
+        broadcast_wire(&w);
         return;
     }
     fprintf(stderr, "play: stream_url=%.120s\n", stream_url);
@@ -87,28 +111,57 @@ static void ws_play_cb(const char *stream_url, void *userdata) {
 
 /* ── IPTV playlist thread helpers ──────────────────────────────────────────── */
 
-/* Broadcast current playlists list to all WS clients. */
-static void broadcast_playlists(void) {
-    int n; IptvPlaylist *pl = iptv_get_playlists(&n);
-    cJSON *resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, "type", "playlists");
-    cJSON *arr = cJSON_CreateArray();
+/* Current playlists list, the body of a "playlists" message. */
+static void playlists_encode(Wire *w) {
+    IptvCatalog *cat = iptv_catalog_acquire();
+    int n; const IptvPlaylist *pl = iptv_catalog_playlists(cat, &n);
+    wire_key(w, "playlists");
+    wire_arr(w);
     for (int i = 0; i < n; i++) {
-        cJSON *o = cJSON_CreateObject();
-        cJSON_AddStringToObject(o, "id",            pl[i].id);
-        cJSON_AddStringToObject(o, "name",          pl[i].name);
-        cJSON_AddStringToObject(o, "url",           pl[i].url);
-        cJSON_AddNumberToObject(o, "channel_count", pl[i].channel_count);
-        cJSON_AddItemToArray(arr, o);
+        wire_obj(w);
+        wire_kstr(w, "id",            pl[i].id);
+        wire_kstr(w, "name",          pl[i].name);
+        wire_kstr(w, "url",           pl[i].url);
+        wire_knum(w, "channel_count", pl[i].channel_count);
+        if (pl[i].truncated) wire_kbool(w, "truncated", 1);
+        wire_end(w);
     }
-    cJSON_AddItemToObject(resp, "playlists", arr);
-    char *s = cJSON_Print(resp); cJSON_Delete(resp);
-    ws_broadcast(s); free(s);
+    wire_end(w);
+    iptv_catalog_release(cat);
+}
+
+/* Broadcast current playlists list to all WS clients. */
+static void broadcast_playlists(void) {
+    Wire w = {0};
+    wire_reset(&w, WIRE_JSON);
+    wire_obj(&w);
+    wire_kstr(&w, "type", "playlists");
+    playlists_encode(&w);
+    wire_end(&w);
+    broadcast_wire(&w);
 }
 
 typedef struct { char url[512]; char name[64]; } PlaylistAddArg;
 typedef struct { char id[32]; }                   PlaylistRefreshArg;
 typedef struct { char url[512]; int max; }        YoutubeRefreshArg;
+typedef struct { char url[512]; }                 EpgRefreshArg;
+
+/* Progress from a streaming playlist download (runs on the download thread).
+   The IPTV screen fills in as channels arrive; phones get a lightweight
+   progress frame instead of a full playlists list every batch. */
+static void on_iptv_change(const char *playlist_id, int channel_count, int done) {
+    if (g_screen == SCREEN_IPTV)
+        ui_iptv_refresh();
+    if (done) return;   /* the thread broadcasts the final playlists list */
+    Wire w = {0};
+    wire_reset(&w, WIRE_JSON);
+    wire_obj(&w);
+    wire_kstr(&w, "type",          "playlist_progress");
+    wire_kstr(&w, "id",            playlist_id);
+    wire_knum(&w, "channel_count", channel_count);
+    wire_end(&w);
+    broadcast_wire(&w);
+}
 
 static void *playlist_add_thread(void *arg) {
     PlaylistAddArg *a = arg;
@@ -116,9 +169,6 @@ static void *playlist_add_thread(void *arg) {
     free(a);
     fprintf(stderr, "iptv: playlist_add done, %d channels\n", count);
     broadcast_playlists();
-    /* Refresh IPTV screen if currently visible */
-    if (g_screen == SCREEN_IPTV)
-        ui_iptv_enter();
     return NULL;
 }
 
@@ -128,11 +178,52 @@ static void *playlist_refresh_thread(void *arg) {
     free(a);
     fprintf(stderr, "iptv: playlist_refresh done, %d channels\n", count);
     broadcast_playlists();
-    if (g_screen == SCREEN_IPTV)
-        ui_iptv_enter();
     return NULL;
 }
 
+/* One thread for every playlist: downloads share a curl multi handle. */
+static void *playlist_refresh_all_thread(void *arg) {
+    (void)arg;
+    int ok = iptv_refresh_all();
+    fprintf(stderr, "iptv: playlist_refresh all done, %d ok\n", ok);
+    broadcast_playlists();
+    return NULL;
+}
+
+static void *epg_refresh_thread(void *arg) {
+    EpgRefreshArg *a = arg;
+    long n = epg_refresh(a->url, g_cfg.iptv_proxy[0] ? g_cfg.iptv_proxy : NULL);
+    free(a);
+    if (n >= 0 && g_screen == SCREEN_IPTV) ui_iptv_refresh();
+
+    Wire w = {0};
+    wire_reset(&w, WIRE_JSON);
+    wire_obj(&w);
+    wire_kstr (&w, "type",       "epg_status");
+    wire_kbool(&w, "ok",         n >= 0);
+    wire_knum (&w, "programmes", n >= 0 ? n : 0);
+    wire_end(&w);
+    broadcast_wire(&w);
+    return NULL;
+}
+
+static void spawn_epg_refresh(const char *url) {
+    EpgRefreshArg *a = malloc(sizeof(*a));
+    if (!a) return;
+    snprintf(a->url, sizeof(a->url), "%s", url);
+    pthread_t tid; pthread_create(&tid, NULL, epg_refresh_thread, a);
+    pthread_detach(tid);
+}
+
+static void epg_encode(Wire *w, const EpgProgramme *p) {
+    wire_obj(w);
+    wire_knum(w, "start", (double)p->start);
+    wire_knum(w, "stop",  (double)p->stop);
+    wire_kstr(w, "title", p->title);
+    wire_kstr(w, "desc",  p->desc);
+    wire_end(w);
+}
+
 static void *youtube_refresh_thread(void *arg) {
     YoutubeRefreshArg *a = arg;
     int max = a->max > 0 ? a->max : 30;
@@ -148,244 +239,104 @@ static void *youtube_refresh_thread(void *arg) {
         ui_youtube_set_videos(vids, count);
 
         /* Broadcast video list to WS clients */
-        cJSON *resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, "type", "youtube_videos");
-        cJSON *arr = cJSON_CreateArray();
+        Wire w = {0};
+        wire_reset(&w, WIRE_JSON);
+        wire_obj(&w);
+        wire_kstr(&w, "type", "youtube_videos");
+        wire_key(&w, "videos");
+        wire_arr(&w);
         for (int i = 0; i < count; i++) {
-            cJSON *o = cJSON_CreateObject();
-            cJSON_AddStringToObject(o, "id",      vids[i].id);
-            cJSON_AddStringToObject(o, "title",   vids[i].title);
-            cJSON_AddStringToObject(o, "url",     vids[i].url);
-            cJSON_AddStringToObject(o, "channel", vids[i].channel_name);
-            cJSON_AddStringToObject(o, "thumb",   vids[i].thumbnail);
-            cJSON_AddNumberToObject(o, "dur",     vids[i].duration);
-            cJSON_AddItemToArray(arr, o);
+            wire_obj(&w);
+            wire_kstr(&w, "id",      vids[i].id);
+            wire_kstr(&w, "title",   vids[i].title);
+            wire_kstr(&w, "url",     vids[i].url);
+            wire_kstr(&w, "channel", vids[i].channel_name);
+            wire_kstr(&w, "thumb",   vids[i].thumbnail);
+            wire_knum(&w, "dur",     vids[i].duration);
+            wire_end(&w);
         }
-        cJSON_AddItemToObject(resp, "videos", arr);
-        char *s = cJSON_Print(resp); cJSON_Delete(resp);
-        ws_broadcast(s); free(s);
+        wire_end(&w);
+        wire_end(&w);
+        broadcast_wire(&w);
     }
     free(vids);
     return NULL;
 }
 
-/* ── WebSocket message handler ─────────────────────────────────────────────── */
-
-static void ws_dispatch_cmd(const char *json) {
-    fprintf(stderr, "ws recv: %.200s\n", json);
-    cJSON *j = cJSON_Parse(json);
-    if (!j) { fprintf(stderr, "ws recv: JSON parse failed\n"); return; }
-
-    const char *cmd = cJSON_GetString(j, "cmd", "");
-
-    if (!strcmp(cmd, "play")) {
-        const char *url  = cJSON_GetString(j, "url",  "");
-        const char *type = cJSON_GetString(j, "type", "");
-
-        if (!strcmp(type, "youtube") ||
-            strstr(url, "youtube.com") || strstr(url, "youtu.be")) {
-            fprintf(stderr, "play: youtube resolve -> %s\n", url);
-            static char g_play_orig_url[512];
-            strncpy(g_play_orig_url, url, sizeof(g_play_orig_url)-1);
-            ytdlp_resolve(url, NULL, ws_play_cb, g_play_orig_url);
-        } else {
-            const char *profile = (!strcmp(type,"iptv")) ? "live" : NULL;
-            fprintf(stderr, "play: direct -> %s (profile=%s)\n", url, profile ? profile : "none");
-            mpv_core_load(url, profile);
-            history_record(url, url, type[0] ? type : "direct", "", "", 0);
-        }
-    } else if (!strcmp(cmd, "pause")) {
-        mpv_core_pause_toggle();
-    } else if (!strcmp(cmd, "stop")) {
-        mpv_core_stop();
-        g_screen = SCREEN_HOME;
-    } else if (!strcmp(cmd, "seek")) {
-        double secs = cJSON_GetNumber(j, "seconds", 0);
-        mpv_core_seek(secs);
-    } else if (!strcmp(cmd, "volume")) {
-        int level = (int)cJSON_GetNumber(j, "level", 80);
-        mpv_core_set_volume(level);
-    } else if (!strcmp(cmd, "key")) {
-        const char *key = cJSON_GetString(j, "key", "");
-        switch (g_screen) {
-            case SCREEN_HOME:     ui_home_key(key);     break;
-            case SCREEN_YOUTUBE:  ui_youtube_key(key);  break;
-            case SCREEN_IPTV:     ui_iptv_key(key);     break;
-            case SCREEN_SETTINGS: ui_settings_key(key); break;
-            default: break;
-        }
-    } else if (!strcmp(cmd, "navigate")) {
-        navigate(cJSON_GetString(j, "screen", "home"));
-    } else if (!strcmp(cmd, "history_get")) {
-        int n; HistoryEntry *h = history_get_all(&n);
-        cJSON *resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, "type", "history");
-        cJSON *arr = cJSON_CreateArray();
-        int lim = (int)cJSON_GetNumber(j, "limit", 20);
-        if (lim > n) lim = n;
-        for (int i = 0; i < lim; i++) {
-            cJSON *e = cJSON_CreateObject();
-            cJSON_AddStringToObject(e, "url",          h[i].url);
-            cJSON_AddStringToObject(e, "title",        h[i].title);
-            cJSON_AddStringToObject(e, "content_type", h[i].content_type);
-            cJSON_AddStringToObject(e, "thumbnail",    h[i].thumbnail);
-            cJSON_AddNumberToObject(e, "position",     h[i].position);
-            cJSON_AddNumberToObject(e, "duration",     h[i].duration);
-            cJSON_AddNumberToObject(e, "played_at",    (double)h[i].played_at);
-            cJSON_AddItemToArray(arr, e);
-        }
-        cJSON_AddItemToObject(resp, "entries", arr);
-        char *s = cJSON_Print(resp); cJSON_Delete(resp);
-        ws_broadcast(s); free(s);
-
-    } else if (!strcmp(cmd, "history_clear")) {
-        history_clear();
-
-    } else if (!strcmp(cmd, "youtube_refresh")) {
-        const char *url = cJSON_GetString(j, "channel_url", "");
-        if (!url[0]) url = g_cfg.youtube_channel;
-        if (url[0]) {
-            YoutubeRefreshArg *a = malloc(sizeof(*a));
-            strncpy(a->url, url, sizeof(a->url)-1);
-            a->max = (int)cJSON_GetNumber(j, "max", 30);
-            pthread_t tid; pthread_create(&tid, NULL, youtube_refresh_thread, a);
-            pthread_detach(tid);
-        }
-
-    } else if (!strcmp(cmd, "playlists_get")) {
-        broadcast_playlists();
-
-    } else if (!strcmp(cmd, "playlist_add")) {
-        const char *url  = cJSON_GetString(j, "url",  "");
-        const char *name = cJSON_GetString(j, "name", "Playlist");
-        PlaylistAddArg *a = malloc(sizeof(*a));
-        strncpy(a->url,  url,  sizeof(a->url)-1);
-        strncpy(a->name, name, sizeof(a->name)-1);
-        pthread_t tid; pthread_create(&tid, NULL, playlist_add_thread, a);
-        pthread_detach(tid);
-
-    } else if (!strcmp(cmd, "playlist_refresh")) {
-        const char *id = cJSON_GetString(j, "id", "");
-        if (id[0]) {
-            PlaylistRefreshArg *a = malloc(sizeof(*a));
-            strncpy(a->id, id, sizeof(a->id)-1);
-            pthread_t tid; pthread_create(&tid, NULL, playlist_refresh_thread, a);
-            pthread_detach(tid);
-        }
+/* ── Status push ───────────────────────────────────────────────────────────── */
 
-    } else if (!strcmp(cmd, "playlist_del")) {
-        iptv_remove_playlist(cJSON_GetString(j, "id", ""));
-
-    } else if (!strcmp(cmd, "iptv_channels_get")) {
-        /* Return up to 500 channels for a playlist */
-        const char *pl_id = cJSON_GetString(j, "playlist_id", "");
-        int n; IptvChannel *ch = iptv_get_channels(pl_id[0] ? pl_id : NULL, NULL, &n);
-        cJSON *resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, "type", "iptv_channels");
-        if (pl_id[0]) cJSON_AddStringToObject(resp, "playlist_id", pl_id);
-        cJSON *arr = cJSON_CreateArray();
-        int lim = n > 500 ? 500 : n;
-        for (int i = 0; i < lim; i++) {
-            cJSON *o = cJSON_CreateObject();
-            cJSON_AddStringToObject(o, "id",    ch[i].id);
-            cJSON_AddStringToObject(o, "name",  ch[i].name);
-            cJSON_AddStringToObject(o, "url",   ch[i].url);
-            cJSON_AddStringToObject(o, "group", ch[i].group);
-            cJSON_AddItemToArray(arr, o);
-        }
-        cJSON_AddItemToObject(resp, "channels", arr);
-        cJSON_AddNumberToObject(resp, "total", n);
-        char *s = cJSON_Print(resp); cJSON_Delete(resp);
-        ws_broadcast(s); free(s);
-
-    } else if (!strcmp(cmd, "playlist_import")) {
-        /* Channels pre-parsed on Android (file-picker path, no HTTP download) */
-        const char *name = cJSON_GetString(j, "name", "Imported");
-        cJSON *channels = cJSON_GetObjectItem(j, "channels");
-        if (channels && channels->type == CJSON_ARRAY) {
-            int count = iptv_import_channels(name, channels);
-            fprintf(stderr, "iptv: imported %d channels as '%s'\n", count, name);
-            broadcast_playlists();
-            if (g_screen == SCREEN_IPTV) ui_iptv_enter();
-        }
+/* Status goes out when it changes, not on a timer: mpv reports changes
+ * through on_mpv_change(), and whatever differs from the status last sent
+ * is broadcast as a "status_delta" holding only those fields.
+ *
+ * Every delta that changes more than the position carries the next "seq".
+ * Position alone changes on every frame while playing, so it is sent at
+ * most every status_pos_ms, as a keyed frame with the current seq: a slow
+ * client may have one replaced by the next without missing anything. A
+ * client that sees seq jump asks "status_get" for the full status and the
+ * seq it reflects. An idle or paused box sends nothing. */
 
-    } else if (!strcmp(cmd, "service_get")) {
-        const ServicesState *sv = services_get(1);
-        cJSON *resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, "type", "services");
-        cJSON *xr = cJSON_CreateObject();
-        cJSON_AddBoolToObject(xr, "active",  sv->xray_active);
-        cJSON_AddBoolToObject(xr, "enabled", sv->xray_enabled);
-        cJSON_AddItemToObject(resp, "xray", xr);
-        cJSON *ts = cJSON_CreateObject();
-        cJSON_AddBoolToObject(ts, "active",  sv->tailscale_active);
-        cJSON_AddBoolToObject(ts, "enabled", sv->tailscale_enabled);
-        cJSON_AddItemToObject(resp, "tailscaled", ts);
-        char *s = cJSON_Print(resp); cJSON_Delete(resp);
-        ws_broadcast(s); free(s);
-
-    } else if (!strcmp(cmd, "service_set")) {
-        const char *name = cJSON_GetString(j, "name", "");
-        int enable = cJSON_GetBool(j, "enabled", 0);
-        services_set(name, enable);
-        /* broadcast updated state */
-        const ServicesState *sv = services_get(0);
-        cJSON *resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, "type", "services");
-        cJSON *xr = cJSON_CreateObject();
-        cJSON_AddBoolToObject(xr, "active",  sv->xray_active);
-        cJSON_AddBoolToObject(xr, "enabled", sv->xray_enabled);
-        cJSON_AddItemToObject(resp, "xray", xr);
-        cJSON *ts = cJSON_CreateObject();
-        cJSON_AddBoolToObject(ts, "active",  sv->tailscale_active);
-        cJSON_AddBoolToObject(ts, "enabled", sv->tailscale_enabled);
-        cJSON_AddItemToObject(resp, "tailscaled", ts);
-        char *s = cJSON_Print(resp); cJSON_Delete(resp);
-        ws_broadcast(s); free(s);
-
-    } else if (!strcmp(cmd, "reboot")) {
-        system("systemctl reboot");
-    }
+#define WS_KEY_STATUS 1   /* position-only deltas: only the latest matters */
 
-    cJSON_Delete(j);
-}
+enum { ST_STATE = 1, ST_URL = 2, ST_POS = 4, ST_DUR = 8, ST_VOL = 16, ST_PAUSED = 32,
+       ST_ALL = 63 };
 
-/* ── Status push ───────────────────────────────────────────────────────────── */
+static MpvStatus s_sent;              /* as the clients know it */
+static unsigned  s_status_seq    = 0;
+static long long s_pos_sent_ms   = 0;
+static int       s_pos_pending   = 0; /* a position change is being held back */
 
 /* Position-tracking state for history_update_position() */
 static char   s_pos_url[512]  = "";
 static double s_pos_last      = 0.0;  /* position at last save */
 static time_t s_pos_save_t    = 0;    /* time of last save */
-static int    s_was_playing   = 0;    /* previous frame was playing */
+static int    s_was_playing   = 0;    /* previous status was playing */
+static int    s_was_paused    = 0;
 
-static void push_status(void) {
-    MpvStatus st = mpv_core_get_status();
-    cJSON *j = cJSON_CreateObject();
-    cJSON_AddStringToObject(j, "type",     "status");
-    cJSON_AddStringToObject(j, "state",    st.state);
-    cJSON_AddStringToObject(j, "url",      st.url);
-    cJSON_AddNumberToObject(j, "position", st.position);
-    cJSON_AddNumberToObject(j, "duration", st.duration);
-    cJSON_AddNumberToObject(j, "volume",   st.volume);
-    cJSON_AddBoolToObject  (j, "paused",   st.paused);
-    char *s = cJSON_Print(j); cJSON_Delete(j);
-    ws_broadcast(s); free(s);
-
-    /* Save playback position to history:
-     *  - Every 30s during playback (for resume-on-reopen)
-     *  - On stop (transition playing → idle), to capture final position */
-    int playing = !strcmp(st.state, "playing") || !strcmp(st.state, "paused");
-    if (playing && st.url[0] && st.position > 5.0) {
-        if (strcmp(s_pos_url, st.url) != 0) {
+static long long mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Status messages go out several times a second, so they're encoded
+ * straight from MpvStatus: "seq" and the fields in mask, into an open
+ * object. */
+static void status_encode(Wire *w, const MpvStatus *st, int mask) {
+    wire_knum(w, "seq", s_status_seq);
+    if (mask & ST_STATE)  wire_kstr (w, "state",    st->state);
+    if (mask & ST_URL)    wire_kstr (w, "url",      st->url);
+    if (mask & ST_POS)    wire_knum (w, "position", st->position);
+    if (mask & ST_DUR)    wire_knum (w, "duration", st->duration);
+    if (mask & ST_VOL)    wire_knum (w, "volume",   st->volume);
+    if (mask & ST_PAUSED) wire_kbool(w, "paused",   st->paused);
+}
+
+static int status_diff(const MpvStatus *a, const MpvStatus *b) {
+    return (strcmp(a->state, b->state) ? ST_STATE  : 0) |
+           (strcmp(a->url,   b->url)   ? ST_URL    : 0) |
+           (a->position != b->position ? ST_POS    : 0) |
+           (a->duration != b->duration ? ST_DUR    : 0) |
+           (a->volume   != b->volume   ? ST_VOL    : 0) |
+           (a->paused   != b->paused   ? ST_PAUSED : 0);
+}
+
+/* Save playback position to history:
+ *  - every 30s during playback and on pause (for resume-on-reopen)
+ *  - on stop (transition playing → idle), to capture final position */
+static void track_position(const MpvStatus *st) {
+    int playing = !strcmp(st->state, "playing") || !strcmp(st->state, "paused");
+    if (playing && st->url[0] && st->position > 5.0) {
+        if (strcmp(s_pos_url, st->url) != 0) {
             /* New URL — reset tracking */
-            strncpy(s_pos_url, st.url, sizeof(s_pos_url)-1);
+            strncpy(s_pos_url, st->url, sizeof(s_pos_url)-1);
             s_pos_last = 0.0;
             s_pos_save_t = 0;
         }
         time_t now = time(NULL);
-        if (now - s_pos_save_t >= 30) {
-            history_update_position(st.url, st.position);
-            s_pos_last   = st.position;
+        if (now - s_pos_save_t >= 30 || (st->paused && !s_was_paused)) {
+            history_update_position(st->url, st->position);
+            s_pos_last   = st->position;
             s_pos_save_t = now;
         }
         s_was_playing = 1;
@@ -397,6 +348,413 @@ static void push_status(void) {
     } else if (!playing) {
         s_was_playing = 0;
     }
+    s_was_paused = st->paused;
+}
+
+static void status_update(void) {
+    MpvStatus st = mpv_core_get_status();
+    track_position(&st);
+    int mask = status_diff(&s_sent, &st);
+    if (!mask) return;
+    long long now = mono_ms();
+    if (mask == ST_POS && now - s_pos_sent_ms < g_cfg.status_pos_ms) {
+        s_pos_pending = 1;
+        return;
+    }
+    if (mask != ST_POS) s_status_seq++;
+    if (mask & ST_POS) { s_pos_sent_ms = now; s_pos_pending = 0; }
+    s_sent = st;
+
+    /* Both encodings up front, so no client's copy is transcoded */
+    static Wire js, mp;
+    wire_reset(&js, WIRE_JSON);
+    wire_reset(&mp, WIRE_MSGPACK);
+    Wire *enc[2] = { &js, &mp };
+    for (int i = 0; i < 2; i++) {
+        wire_obj(enc[i]);
+        wire_kstr(enc[i], "type", "status_delta");
+        status_encode(enc[i], &st, mask);
+        wire_end(enc[i]);
+    }
+    WsFrame *f = ws_frame_wire(&js, &mp);
+    ws_broadcast_frame(f, mask == ST_POS ? WS_KEY_STATUS : 0);
+    ws_frame_unref(f);
+}
+
+static void on_mpv_change(void) { status_update(); }
+
+/* Called every timer tick: sends a held-back position once it's due. */
+static void status_tick(void) {
+    if (s_pos_pending && mono_ms() - s_pos_sent_ms >= g_cfg.status_pos_ms) status_update();
+}
+
+/* Full status, with the seq of the last delta it includes. Held-back
+ * position changes are included too — later deltas still apply. */
+static void on_status_get(CmdCtx *c) {
+    status_update();
+    MpvStatus st = mpv_core_get_status();
+    Wire *w = cmd_wire_begin(c, "status");
+    status_encode(w, &st, ST_ALL);
+    cmd_wire_send(c, w);
+}
+
+/* ── WebSocket commands ────────────────────────────────────────────────────── */
+
+/* Every command is an on_<name>() handler in one of the tables below,
+ * registered with cmd.c at startup along with the arguments it takes.
+ * Answers to queries go only to the client that asked (cmd_wire_send(),
+ * which echoes "req_id"); changes of shared state (playlists, services, playback)
+ * are still broadcast. */
+
+/* Fields of a "services" message, after its type */
+static void services_encode(Wire *w, const ServicesState *sv) {
+    wire_key(w, "xray");
+    wire_obj(w);
+    wire_kbool(w, "active",  sv->xray_active);
+    wire_kbool(w, "enabled", sv->xray_enabled);
+    wire_end(w);
+    wire_key(w, "tailscaled");
+    wire_obj(w);
+    wire_kbool(w, "active",  sv->tailscale_active);
+    wire_kbool(w, "enabled", sv->tailscale_enabled);
+    wire_end(w);
+}
+
+/* Playback */
+
+static void on_play(CmdCtx *c) {
+    const char *url  = cmd_str(c, "url",  "");
+    const char *type = cmd_str(c, "type", "");
+
+    if (!strcmp(type, "youtube") ||
+        strstr(url, "youtube.com") || strstr(url, "youtu.be")) {
+        fprintf(stderr, "play: youtube resolve -> %s\n", url);
+        static char g_play_orig_url[512];
+        strncpy(g_play_orig_url, url, sizeof(g_play_orig_url)-1);
+        ytdlp_resolve(url, NULL, ws_play_cb, g_play_orig_url);
+    } else {
+        /* A known IPTV stream gets its channel name and logo in history */
+        IptvChannelList *found = iptv_get_channel_by_url(url);
+        IptvChannel ch;
+        int is_channel = iptv_list_get(found, 0, &ch) == 0;
+        const char *profile = (is_channel || !strcmp(type,"iptv")) ? "live" : NULL;
+        fprintf(stderr, "play: direct -> %s (profile=%s)\n", url, profile ? profile : "none");
+        mpv_core_load(url, profile);
+        if (is_channel)
+            history_record(url, ch.name, "iptv", ch.name, ch.logo, 0);
+        else
+            history_record(url, url, type[0] ? type : "direct", "", "", 0);
+        iptv_list_free(found);
+    }
+}
+
+static void on_pause(CmdCtx *c)  { (void)c; mpv_core_pause_toggle(); }
+static void on_stop(CmdCtx *c)   { (void)c; mpv_core_stop(); g_screen = SCREEN_HOME; }
+static void on_seek(CmdCtx *c)   { mpv_core_seek(cmd_num(c, "seconds", 0)); }
+static void on_volume(CmdCtx *c) { mpv_core_set_volume((int)cmd_num(c, "level", 80)); }
+
+static const CmdDef k_playback_cmds[] = {
+    { "play",   on_play,   { { "url", CMD_ARG_STR, 1 }, { "type", CMD_ARG_STR, 0 } }, 0 },
+    { "pause",  on_pause,  { { 0 } }, 0 },
+    { "stop",   on_stop,   { { 0 } }, 0 },
+    { "status_get", on_status_get, { { 0 } }, CMD_QUIET },
+    { "seek",   on_seek,   { { "seconds", CMD_ARG_NUM, 0 } }, CMD_QUIET },
+    { "volume", on_volume, { { "level",   CMD_ARG_NUM, 0 } }, CMD_QUIET },
+};
+
+/* Navigation */
+
+static void on_key(CmdCtx *c) {
+    const char *key = cmd_str(c, "key", "");
+    switch (g_screen) {
+        case SCREEN_HOME:     ui_home_key(key);     break;
+        case SCREEN_YOUTUBE:  ui_youtube_key(key);  break;
+        case SCREEN_IPTV:     ui_iptv_key(key);     break;
+        case SCREEN_SETTINGS: ui_settings_key(key); break;
+        default: break;
+    }
+}
+
+static void on_navigate(CmdCtx *c) { navigate(cmd_str(c, "screen", "home")); }
+
+static const CmdDef k_ui_cmds[] = {
+    { "key",      on_key,      { { "key",    CMD_ARG_STR, 1 } }, CMD_QUIET },
+    { "navigate", on_navigate, { { "screen", CMD_ARG_STR, 0 } }, 0 },
+};
+
+/* History and YouTube */
+
+static void on_history_get(CmdCtx *c) {
+    int n; HistoryEntry *h = history_get_all(&n);
+    int lim = (int)cmd_num(c, "limit", 20);
+    if (lim > n) lim = n;
+    Wire *w = cmd_wire_begin(c, "history");
+    wire_key(w, "entries");
+    wire_arr(w);
+    for (int i = 0; i < lim; i++) {
+        wire_obj(w);
+        wire_kstr(w, "url",          h[i].url);
+        wire_kstr(w, "title",        h[i].title);
+        wire_kstr(w, "content_type", h[i].content_type);
+        wire_kstr(w, "thumbnail",    h[i].thumbnail);
+        wire_knum(w, "position",     h[i].position);
+        wire_knum(w, "duration",     h[i].duration);
+        wire_knum(w, "played_at",    (double)h[i].played_at);
+        wire_end(w);
+    }
+    wire_end(w);
+    cmd_wire_send(c, w);
+}
+
+static void on_history_clear(CmdCtx *c) { (void)c; history_clear(); }
+
+static void on_youtube_refresh(CmdCtx *c) {
+    const char *url = cmd_str(c, "channel_url", "");
+    if (!url[0]) url = g_cfg.youtube_channel;
+    if (!url[0]) return;
+    YoutubeRefreshArg *a = malloc(sizeof(*a));
+    strncpy(a->url, url, sizeof(a->url)-1);
+    a->max = (int)cmd_num(c, "max", 30);
+    pthread_t tid; pthread_create(&tid, NULL, youtube_refresh_thread, a);
+    pthread_detach(tid);
+}
+
+static const CmdDef k_history_cmds[] = {
+    { "history_get",     on_history_get,     { { "limit", CMD_ARG_NUM, 0 } }, CMD_QUIET },
+    { "history_clear",   on_history_clear,   { { 0 } }, 0 },
+    { "youtube_refresh", on_youtube_refresh, { { "channel_url", CMD_ARG_STR, 0 },
+                                               { "max",         CMD_ARG_NUM, 0 } }, 0 },
+};
+
+/* IPTV playlists and channels */
+
+static void on_playlists_get(CmdCtx *c) {
+    Wire *w = cmd_wire_begin(c, "playlists");
+    playlists_encode(w);
+    cmd_wire_send(c, w);
+}
+
+static void on_playlist_add(CmdCtx *c) {
+    PlaylistAddArg *a = malloc(sizeof(*a));
+    strncpy(a->url,  cmd_str(c, "url",  ""),         sizeof(a->url)-1);
+    strncpy(a->name, cmd_str(c, "name", "Playlist"), sizeof(a->name)-1);
+    pthread_t tid; pthread_create(&tid, NULL, playlist_add_thread, a);
+    pthread_detach(tid);
+}
+
+static void on_playlist_refresh(CmdCtx *c) {
+    const char *id = cmd_str(c, "id", "");
+    if (id[0]) {
+        PlaylistRefreshArg *a = malloc(sizeof(*a));
+        strncpy(a->id, id, sizeof(a->id)-1);
+        pthread_t tid; pthread_create(&tid, NULL, playlist_refresh_thread, a);
+        pthread_detach(tid);
+    } else {
+        /* No id: refresh everything (unchanged playlists cost a 304) */
+        pthread_t tid; pthread_create(&tid, NULL, playlist_refresh_all_thread, NULL);
+        pthread_detach(tid);
+    }
+}
+
+static void on_playlist_del(CmdCtx *c) { iptv_remove_playlist(cmd_str(c, "id", "")); }
+
+static void on_iptv_search(CmdCtx *c) {
+    /* {"query", "limit": default 50} — sent on every keystroke */
+    const char *q = cmd_str(c, "query", "");
+    int total;
+    IptvChannelList *list = iptv_search(q, (int)cmd_num(c, "limit", 50), &total);
+    Wire *w = cmd_wire_begin(c, "iptv_search");
+    wire_kstr(w, "query", q);
+    wire_key(w, "channels");
+    wire_arr(w);
+    for (int i = 0; i < iptv_list_count(list); i++) {
+        IptvChannel ch; iptv_list_get(list, i, &ch);
+        wire_obj(w);
+        wire_kstr(w, "id",          ch.id);
+        wire_kstr(w, "name",        ch.name);
+        wire_kstr(w, "url",         ch.url);
+        wire_kstr(w, "group",       ch.group);
+        wire_kstr(w, "logo",        ch.logo);
+        wire_kstr(w, "playlist_id", ch.playlist_id);
+        wire_end(w);
+    }
+    wire_end(w);
+    wire_knum(w, "total", list ? total : 0);
+    iptv_list_free(list);
+    cmd_wire_send(c, w);
+}
+
+static void on_playlist_import(CmdCtx *c) {
+    /* Channels pre-parsed on Android (file-picker path, no HTTP download) */
+    const char *name = cmd_str(c, "name", "Imported");
+    int count = iptv_import_channels(name, cmd_raw(c, "channels"));
+    fprintf(stderr, "iptv: imported %d channels as '%s'\n", count, name);
+    broadcast_playlists();
+    if (g_screen == SCREEN_IPTV) ui_iptv_enter();
+}
+
+/* Streaming import: begin {name} → id, then batch {id, seq, channels} as
+ * often as needed, each acknowledged with the count so far (send the next
+ * one after the ack), then commit {id}. Only a batch's ack echoes a seq;
+ * begin and commit, which take none, send 0. */
+static void import_ack(CmdCtx *c, const char *id, double seq, int count, int done) {
+    if (count < 0) { cmd_error(c, "playlist import failed"); return; }
+    Wire *w = cmd_wire_begin(c, "playlist_import");
+    wire_kstr (w, "id",            id);
+    wire_knum (w, "seq",           seq);
+    wire_knum (w, "channel_count", count);
+    wire_kbool(w, "done",          done);
+    cmd_wire_send(c, w);
+}
+
+static void on_playlist_import_begin(CmdCtx *c) {
+    char id[32];
+    int  count = iptv_import_begin(cmd_str(c, "name", "Imported"), id, sizeof(id));
+    import_ack(c, id, 0, count, 0);
+}
+
+static void on_playlist_import_batch(CmdCtx *c) {
+    const char *id = cmd_str(c, "id", "");
+    int count = iptv_import_batch(id, cmd_raw(c, "channels"));
+    import_ack(c, id, cmd_num(c, "seq", 0), count, 0);
+}
+
+static void on_playlist_import_commit(CmdCtx *c) {
+    const char *id = cmd_str(c, "id", "");
+    int count = iptv_import_commit(id);
+    import_ack(c, id, 0, count, 1);
+    if (count < 0) return;
+    fprintf(stderr, "iptv: imported %d channels as %s\n", count, id);
+    broadcast_playlists();
+    if (g_screen == SCREEN_IPTV) ui_iptv_enter();
+}
+
+static void on_playlist_import_abort(CmdCtx *c) {
+    iptv_import_abort(cmd_str(c, "id", ""));
+    broadcast_playlists();
+}
+
+static const CmdDef k_iptv_cmds[] = {
+    { "playlists_get",          on_playlists_get,          { { 0 } }, CMD_QUIET },
+    { "playlist_add",           on_playlist_add,           { { "url",  CMD_ARG_STR, 1 },
+                                                             { "name", CMD_ARG_STR, 0 } }, 0 },
+    { "playlist_refresh",       on_playlist_refresh,       { { "id",   CMD_ARG_STR, 0 } }, 0 },
+    { "playlist_del",           on_playlist_del,           { { "id",   CMD_ARG_STR, 1 } }, 0 },
+    { "iptv_search",            on_iptv_search,            { { "query", CMD_ARG_STR, 0 },
+                                                             { "limit", CMD_ARG_NUM, 0 } }, CMD_QUIET },
+    { "playlist_import",        on_playlist_import,        { { "name",     CMD_ARG_STR,   0 },
+                                                             { "channels", CMD_ARG_ARRAY, 1 } }, CMD_RAW },
+    { "playlist_import_begin",  on_playlist_import_begin,  { { "name", CMD_ARG_STR, 0 } }, 0 },
+    { "playlist_import_batch",  on_playlist_import_batch,  { { "id",       CMD_ARG_STR,   1 },
+                                                             { "seq",      CMD_ARG_NUM,   0 },
+                                                             { "channels", CMD_ARG_ARRAY, 1 } },
+                                                           CMD_QUIET | CMD_RAW },
+    { "playlist_import_commit", on_playlist_import_commit, { { "id", CMD_ARG_STR, 1 } }, 0 },
+    { "playlist_import_abort",  on_playlist_import_abort,  { { "id", CMD_ARG_STR, 1 } }, 0 },
+};
+
+/* EPG */
+
+static void on_epg_refresh(CmdCtx *c) {
+    /* {"url": optional — defaults to epg_url from config} */
+    const char *url = cmd_str(c, "url", g_cfg.epg_url);
+    if (url[0]) spawn_epg_refresh(url);
+}
+
+static void on_epg_get(CmdCtx *c) {
+    /* {"channel_id", "from", "to"} — without a range: now and next */
+    const char *id = cmd_str(c, "channel_id", "");
+    IptvChannelList *l = iptv_get_channel(id);
+    IptvChannel ch;
+    Wire *w = cmd_wire_begin(c, "epg");
+    wire_kstr(w, "channel_id", id);
+    Epg  *epg = epg_acquire();
+    long  ci  = iptv_list_get(l, 0, &ch) == 0 ? epg_find(epg, ch.tvg_id, ch.name) : -1;
+    double from = cmd_num(c, "from", 0), to = cmd_num(c, "to", 0);
+    if (to > from) {
+        EpgProgramme p[256];
+        int n = epg_range(epg, ci, (time_t)from, (time_t)to, p, 256);
+        wire_key(w, "programmes");
+        wire_arr(w);
+        for (int i = 0; i < n && i < 256; i++) epg_encode(w, &p[i]);
+        wire_end(w);
+    } else {
+        EpgProgramme now, next;
+        int got = epg_now_next(epg, ci, time(NULL), &now, &next);
+        if (got & 1) { wire_key(w, "now");  epg_encode(w, &now);  }
+        if (got & 2) { wire_key(w, "next"); epg_encode(w, &next); }
+    }
+    epg_release(epg);
+    iptv_list_free(l);
+    cmd_wire_send(c, w);
+}
+
+static const CmdDef k_epg_cmds[] = {
+    { "epg_refresh", on_epg_refresh, { { "url", CMD_ARG_STR, 0 } }, 0 },
+    { "epg_get",     on_epg_get,     { { "channel_id", CMD_ARG_STR, 1 },
+                                       { "from",       CMD_ARG_NUM, 0 },
+                                       { "to",         CMD_ARG_NUM, 0 } }, CMD_QUIET },
+};
+
+/* Services and system */
+
+static void on_service_get(CmdCtx *c) {
+    Wire *w = cmd_wire_begin(c, "services");
+    services_encode(w, services_get(1));
+    cmd_wire_send(c, w);
+}
+
+static void on_service_set(CmdCtx *c) {
+    services_set(cmd_str(c, "name", ""), cmd_bool(c, "enabled", 0));
+    /* broadcast updated state */
+    Wire w = {0};
+    wire_reset(&w, WIRE_JSON);
+    wire_obj(&w);
+    wire_kstr(&w, "type", "services");
+    services_encode(&w, services_get(0));
+    wire_end(&w);
+    broadcast_wire(&w);
+}
+
+static void on_ws_stats(CmdCtx *c) {
+    WsStats st;
+    ws_get_stats(&st);
+    Wire *w = cmd_wire_begin(c, "ws_stats");
+    wire_key(w, "broadcasts");  wire_int(w, (int64_t)st.broadcasts);
+    wire_key(w, "frames");      wire_int(w, (int64_t)st.frames);
+    wire_key(w, "queued");      wire_int(w, (int64_t)st.queued);
+    wire_key(w, "coalesced");   wire_int(w, (int64_t)st.coalesced);
+    wire_key(w, "dropped");     wire_int(w, (int64_t)st.dropped);
+    wire_key(w, "cut_off");     wire_int(w, (int64_t)st.cut_off);
+    wire_key(w, "bytes");       wire_int(w, (int64_t)st.bytes);
+    wire_key(w, "writes");      wire_int(w, (int64_t)st.writes);
+    wire_key(w, "blocked");     wire_int(w, (int64_t)st.blocked);
+    wire_key(w, "deflate_in");  wire_int(w, (int64_t)st.deflate_in);
+    wire_key(w, "deflate_out"); wire_int(w, (int64_t)st.deflate_out);
+    cmd_wire_send(c, w);
+}
+
+static void on_cmd_stats(CmdCtx *c) { cmd_stats_reply(c); }
+static void on_reboot(CmdCtx *c)    { (void)c; system("systemctl reboot"); }
+
+static const CmdDef k_system_cmds[] = {
+    { "service_get", on_service_get, { { 0 } }, CMD_QUIET },
+    { "service_set", on_service_set, { { "name",    CMD_ARG_STR,  1 },
+                                       { "enabled", CMD_ARG_BOOL, 0 } }, 0 },
+    { "ws_stats",    on_ws_stats,    { { 0 } }, CMD_QUIET },
+    { "cmd_stats",   on_cmd_stats,   { { 0 } }, CMD_QUIET },
+    { "reboot",      on_reboot,      { { 0 } }, 0 },
+};
+
+#define REGISTER(t) cmd_register(t, (int)(sizeof(t) / sizeof(t[0])))
+
+static int register_commands(void) {
+    if (REGISTER(k_playback_cmds) < 0 || REGISTER(k_ui_cmds)     < 0 ||
+        REGISTER(k_history_cmds)  < 0 || REGISTER(k_iptv_cmds)   < 0 ||
+        REGISTER(k_epg_cmds)      < 0 || REGISTER(k_system_cmds) < 0 ||
+        iptv_pages_register()     < 0)
+        return -1;
+    return 0;
 }
 
 /* ── Render frame ──────────────────────────────────────────────────────────── */
@@ -551,7 +909,13 @@ int main(void) {
     ytdlp_set_proxy(g_cfg.ytdlp_proxy);
     ytdlp_set_default_quality(g_cfg.ytdlp_quality[0] ? g_cfg.ytdlp_quality : "720");
     iptv_set_proxy(g_cfg.iptv_proxy);
+    iptv_set_data_dir(g_cfg.data_dir);
+    epg_set_data_dir(g_cfg.data_dir);
+    iptv_set_limits(g_cfg.iptv_max_channels, g_cfg.iptv_max_playlists, g_cfg.iptv_mem_mb);
+    iptv_set_change_cb(on_iptv_change);
     mpv_core_set_http_proxy(g_cfg.iptv_proxy);
+    mpv_core_set_change_cb(on_mpv_change);
+    s_sent = mpv_core_get_status();
 
     /* If proxy configured, set env vars so libcurl (used by libmpv) picks it up */
     if (g_cfg.ytdlp_proxy[0]) {
@@ -586,11 +950,16 @@ int main(void) {
     if (input_init() < 0) fprintf(stderr, "input: no input devices\n");
 
     /* WebSocket — always required */
-    if (ws_init(g_cfg.ws_port, ws_dispatch_cmd) < 0) return 1;
+    if (register_commands() < 0) return 1;
+    if (ws_init(g_cfg.ws_port, cmd_dispatch) < 0) return 1;
+    ws_set_poll_cb(ws_poll_cb);
+    if (g_cfg.ws_max_msg_mb > 0) ws_set_max_message((size_t)g_cfg.ws_max_msg_mb << 20);
 
     /* Data load */
     history_load();
     iptv_load();
+    epg_load();
+    if (g_cfg.epg_url[0]) spawn_epg_refresh(g_cfg.epg_url);
 
     /* Auto-fetch YouTube channel videos at startup if configured */
     if (g_cfg.youtube_channel[0]) {
@@ -635,9 +1004,6 @@ int main(void) {
         pthread_mutex_unlock(&g_render_mu);
     }
 
-    /* Status push every 500ms */
-    static int status_counter = 0;
-
     fprintf(stderr, "qaryx: event loop started\n");
 
     while (g_running) {
@@ -682,8 +1048,8 @@ int main(void) {
                     pthread_mutex_unlock(&g_render_mu);
                 }
 
-                /* Push status every ~500ms (every 15 frames at 30fps) */
-                if (++status_counter >= 15) { status_counter = 0; push_status(); }
+                status_tick();
+                ws_tick();
 
             } else if (tag == TAG_MPV) {
                 uint64_t dummy; read(mpv_wfd, &dummy, sizeof(dummy));
@@ -698,10 +1064,14 @@ int main(void) {
 
                 } else if (val >= 100) {
                     /* WebSocket client fd (tag = fd + 100) */
-                    int cfd = (int)(val - 100);
-                    if (ws_client_read(cfd) < 0) {
-                        epoll_del(cfd);
-                    }
+                    int      cfd  = (int)(val - 100);
+                    uint32_t ev   = events[i].events;
+                    int      gone = 0;
+                    if (ev & EPOLLOUT)
+                        gone = ws_client_write(cfd) < 0;
+                    if (!gone && (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                        gone = ws_client_read(cfd) < 0;
+                    if (gone) { epoll_del(cfd); iptv_pages_client_gone(cfd); }
                 }
             }
         }
@@ -26,6 +26,8 @@ static int    g_cached_paused = 0;
 static char   g_cached_url[512] = "";
 static char   g_http_proxy[256] = "";
 
+static MpvChangeCb g_change_cb = NULL;
+
 static void on_mpv_render_update(void *ctx) {
     (void)ctx;
     atomic_store(&g_wants_render, 1);
@@ -168,13 +170,23 @@ int mpv_core_wakeup_fd(void) {
     return g_mpv ? mpv_get_wakeup_pipe(g_mpv) : -1;
 }
 
+void mpv_core_set_change_cb(MpvChangeCb cb) {
+    g_change_cb = cb;
+}
+
+static void notify_change(void) {
+    if (g_change_cb) g_change_cb();
+}
+
 void mpv_core_handle_events(void) {
     if (!g_mpv) return;
     mpv_event *ev;
+    int changed = 0;
     while ((ev = mpv_wait_event(g_mpv, 0)) && ev->event_id != MPV_EVENT_NONE) {
         switch (ev->event_id) {
             case MPV_EVENT_START_FILE:
                 atomic_store(&g_video_active, 1);
+                changed = 1;
                 break;
             case MPV_EVENT_END_FILE:
             case MPV_EVENT_IDLE:
@@ -183,8 +195,10 @@ void mpv_core_handle_events(void) {
                 g_cached_pos    = 0.0;
                 g_cached_dur    = 0.0;
                 g_cached_paused = 0;
+                changed = 1;
                 break;
             case MPV_EVENT_PROPERTY_CHANGE: {
+                changed = 1;
                 mpv_event_property *p = ev->data;
                 if (p->format == MPV_FORMAT_DOUBLE) {
                     if      (!strcmp(p->name, "time-pos"))
@@ -207,6 +221,7 @@ void mpv_core_handle_events(void) {
             default: break;
         }
     }
+    if (changed) notify_change();
 }
 
 int mpv_core_is_video_active(void) {
@@ -256,12 +271,13 @@ void mpv_core_load(const char *url, const char *profile) {
     else
         mpv_set_property_string(g_mpv, "http-proxy", "");
 
-    /* Cache URL immediately so push_status() can return it without blocking */
+    /* Cache URL immediately so status updates can return it without blocking */
     strncpy(g_cached_url, url, sizeof(g_cached_url) - 1);
     g_cached_url[sizeof(g_cached_url) - 1] = '\0';
 
     const char *cmd[] = { "loadfile", url, "replace", NULL };
     mpv_command_async(g_mpv, 0, cmd);
+    notify_change();
 }
 
 void mpv_core_pause_toggle(void) {
@@ -284,6 +300,7 @@ void mpv_core_stop(void) {
     g_cached_paused = 0;
     const char *cmd[] = { "stop", NULL };
     mpv_command_async(g_mpv, 0, cmd);
+    notify_change();
 }
 
 void mpv_core_seek(double seconds) {
@@ -299,6 +316,7 @@ void mpv_core_set_volume(int level) {
     g_cached_vol = level;
     double v = (double)level;
     mpv_set_property_async(g_mpv, 0, "volume", MPV_FORMAT_DOUBLE, &v);
+    notify_change();
 }
 
 /* Returns cached status — never blocks.
@@ -29,6 +29,14 @@ int  mpv_core_wakeup_fd(void);
 /* Process all pending mpv events (call when wakeup fd is readable). */
 void mpv_core_handle_events(void);
 
+/* Called (on the thread that made the change) whenever what
+   mpv_core_get_status() returns may have changed: once per
+   mpv_core_handle_events() batch that touched it, and from the controls
+   that update it directly (load, stop, volume). Position changes arrive
+   about once per frame while playing. */
+typedef void (*MpvChangeCb)(void);
+void mpv_core_set_change_cb(MpvChangeCb cb);
+
 /* Returns 1 if a new frame is available and should be rendered. */
 int  mpv_core_wants_render(void);
 
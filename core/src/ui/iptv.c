@@ -3,10 +3,14 @@
 #include "../render.h"
 #include "../font.h"
 #include "../iptv.h"
+#include "../epg.h"
 #include "../mpv.h"
 #include "../history.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
 
 /* ── Layout constants (1920×1080 base) ─────────────────────────────────── */
 #define HEADER_H   112   /* height of top header bar */
@@ -18,6 +22,7 @@
 #define LIST_X      (SEP_X + SEP_W + 10)
 #define ITEM_H      56   /* row height for both panes */
 #define NUM_W       56   /* channel number column width */
+#define EPG_X_FRAC   2   /* current programme starts at 1/EPG_X_FRAC of the row */
 
 typedef enum { PANE_GROUPS, PANE_CHANNELS } Pane;
 
@@ -25,15 +30,24 @@ static Pane         g_pane      = PANE_GROUPS;
 static int          g_group_idx = 0;   /* 0 = "All channels" virtual group */
 static int          g_ch_idx    = 0;
 
+/* Catalog generation the screen is showing; groups and channels below are
+ * read from it and stay valid until the next refresh swaps it out. */
+static IptvCatalog *g_cat       = NULL;
+
 static const char **g_groups    = NULL;
 static int          g_group_n   = 0;   /* count of real groups */
 
-static IptvChannel *g_channels  = NULL;
-static int          g_ch_n      = 0;
+static IptvChannelList *g_channels = NULL;
+static int              g_ch_n     = 0;
+
+/* Guards the pointers above: playlist downloads swap them from their own
+ * thread while the render thread is drawing. Only held for the swap — the
+ * queries behind it are lock-free and never wait on a refresh. */
+static pthread_mutex_t g_mu = PTHREAD_MUTEX_INITIALIZER;
 
 /* URL + name of the channel currently being played — for the "> playing" indicator */
-static char g_playing_url[512]  = "";
-static char g_playing_name[128] = "";
+static char *g_playing_url      = NULL;
+static char  g_playing_name[128] = "";
 
 /* ── Helpers ─────────────────────────────────────────────────────────────── */
 
@@ -48,17 +62,44 @@ static const char *group_label(int idx) {
 
 static void load_channels(void) {
     const char *grp = (g_group_idx == 0) ? NULL : g_groups[g_group_idx - 1];
-    g_channels = iptv_get_channels(NULL, grp, &g_ch_n);
+    iptv_list_free(g_channels);
+    g_channels = iptv_catalog_channels(g_cat, NULL, grp);
+    g_ch_n     = iptv_list_count(g_channels);
     g_ch_idx   = 0;
 }
 
+/* Pin the newest catalog generation. */
+static void load_catalog(void) {
+    iptv_catalog_release(g_cat);
+    g_cat    = iptv_catalog_acquire();
+    g_groups = iptv_catalog_groups(g_cat, &g_group_n);
+}
+
 /* ── Public API ──────────────────────────────────────────────────────────── */
 
 void ui_iptv_enter(void) {
+    pthread_mutex_lock(&g_mu);
     g_pane      = PANE_GROUPS;
     g_group_idx = 0;
-    g_groups    = iptv_get_groups(&g_group_n);
+    load_catalog();
+    load_channels();
+    pthread_mutex_unlock(&g_mu);
+}
+
+void ui_iptv_refresh(void) {
+    /* Keep the selected group by name — indexes shift as groups appear */
+    pthread_mutex_lock(&g_mu);
+    const char *cur = (g_group_idx > 0 && g_group_idx <= g_group_n)
+                    ? g_groups[g_group_idx - 1] : NULL;   /* names are never freed */
+    int ch_idx = g_ch_idx;
+
+    load_catalog();
+    g_group_idx = 0;
+    for (int i = 0; cur && i < g_group_n; i++)
+        if (!strcmp(g_groups[i], cur)) { g_group_idx = i + 1; break; }
     load_channels();
+    g_ch_idx = ch_idx < g_ch_n ? ch_idx : (g_ch_n > 0 ? g_ch_n - 1 : 0);
+    pthread_mutex_unlock(&g_mu);
 }
 
 void ui_iptv_draw(void) {
@@ -68,6 +109,8 @@ void ui_iptv_draw(void) {
     int content_h = H - HEADER_H - FOOTER_H;
     int visible   = content_h / ITEM_H;
 
+    pthread_mutex_lock(&g_mu);
+
     /* ── Header ────────────────────────────────────────────────────────── */
     font_draw(MARGIN_X, 24, "IPTV", 54, COL_ACCENT);
 
@@ -123,14 +166,17 @@ void ui_iptv_draw(void) {
     } else {
         int c_start = g_ch_idx - visible / 2;
         if (c_start < 0) c_start = 0;
+        Epg   *epg = epg_acquire();   /* one guide lookup per visible row */
+        time_t now = time(NULL);
 
         for (int i = 0; i < visible && (c_start + i) < g_ch_n; i++) {
             int idx     = c_start + i;
             int y       = HEADER_H + i * ITEM_H;
             int sel     = (idx == g_ch_idx);
             int act     = sel && (g_pane == PANE_CHANNELS);
-            int playing = g_playing_url[0] &&
-                          !strcmp(g_channels[idx].url, g_playing_url);
+            IptvChannel ch;
+            if (iptv_list_get(g_channels, idx, &ch) < 0) break;
+            int playing = g_playing_url && !strcmp(ch.url, g_playing_url);
 
             /* Row background */
             if (act) {
@@ -153,13 +199,22 @@ void ui_iptv_draw(void) {
 
             /* Channel name */
             char name[54] = {0};
-            strncpy(name, g_channels[idx].name, 52);
+            strncpy(name, ch.name, 52);
             uint32_t col = act     ? COL_WHITE  :
                            sel     ? rgba(220, 225, 255, 255) :
                            playing ? rgba(110, 210, 110, 255) :
                                      rgba(185, 185, 200, 255);
             font_draw(LIST_X + NUM_W, y + ITEM_H / 2 - 11, name, 24, col);
 
+            /* Current programme */
+            EpgProgramme cur;
+            if (epg_now_next(epg, epg_find(epg, ch.tvg_id, ch.name), now, &cur, NULL) & 1) {
+                char prog[52] = {0};
+                strncpy(prog, cur.title, 48);
+                font_draw(LIST_X + list_w / EPG_X_FRAC + 40, y + ITEM_H / 2 - 10, prog, 19,
+                          act ? rgba(200, 205, 235, 255) : rgba(120, 120, 145, 255));
+            }
+
             /* Playing indicator */
             if (playing) {
                 float pw = font_measure(">", 22);
@@ -169,6 +224,8 @@ void ui_iptv_draw(void) {
             }
         }
 
+        epg_release(epg);
+
         /* Channels scroll bar (right edge) */
         if (g_ch_n > visible) {
             int bar_h = content_h * visible / g_ch_n;
@@ -196,9 +253,14 @@ void ui_iptv_draw(void) {
         font_draw((int)(W - tw - MARGIN_X), H - FOOTER_H + 13,
                   np, 19, rgba(90, 210, 90, 255));
     }
+
+    pthread_mutex_unlock(&g_mu);
 }
 
 void ui_iptv_key(const char *key) {
+    pthread_mutex_lock(&g_mu);
+    IptvChannelList *play = NULL;   /* started after the lock is dropped */
+
     if (!strcmp(key, "right") && g_pane == PANE_GROUPS) {
         g_pane = PANE_CHANNELS;
 
@@ -217,18 +279,18 @@ void ui_iptv_key(const char *key) {
         if (g_pane == PANE_GROUPS && g_group_idx < total_groups() - 1) {
             g_group_idx++;
             load_channels();
-        } else if (g_pane == PANE_CHANNELS &&
-                   g_channels && g_ch_idx < g_ch_n - 1) {
+        } else if (g_pane == PANE_CHANNELS && g_ch_idx < g_ch_n - 1) {
             g_ch_idx++;
         }
 
     } else if (!strcmp(key, "ok")) {
-        if (g_pane == PANE_CHANNELS && g_channels && g_ch_n > 0) {
-            IptvChannel *ch = &g_channels[g_ch_idx];
-            strncpy(g_playing_url,  ch->url,  sizeof(g_playing_url) - 1);
-            strncpy(g_playing_name, ch->name, sizeof(g_playing_name) - 1);
-            mpv_core_load(ch->url, "live");
-            history_record(ch->url, ch->name, "iptv", ch->name, ch->logo, 0);
+        IptvChannel ch;
+        if (g_pane == PANE_CHANNELS &&
+            iptv_list_get(g_channels, g_ch_idx, &ch) == 0) {
+            free(g_playing_url);
+            g_playing_url = strdup(ch.url);
+            strncpy(g_playing_name, ch.name, sizeof(g_playing_name) - 1);
+            play = iptv_get_channel(ch.id);
         } else if (g_pane == PANE_GROUPS) {
             /* Enter channels pane on OK from groups */
             g_pane = PANE_CHANNELS;
@@ -236,7 +298,17 @@ void ui_iptv_key(const char *key) {
 
     } else if (!strcmp(key, "back") || !strcmp(key, "home")) {
         /* Stop playback before going home so the home screen renders */
+        pthread_mutex_unlock(&g_mu);
         mpv_core_stop();
         navigate("home");
+        return;
+    }
+    pthread_mutex_unlock(&g_mu);
+
+    IptvChannel ch;
+    if (iptv_list_get(play, 0, &ch) == 0) {
+        mpv_core_load(ch.url, "live");
+        history_record(ch.url, ch.name, "iptv", ch.name, ch.logo, 0);
     }
+    iptv_list_free(play);
 }
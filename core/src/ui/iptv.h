@@ -2,3 +2,5 @@
 void ui_iptv_draw(void);
 void ui_iptv_key(const char *key);
 void ui_iptv_enter(void);
+/* Re-read groups/channels after the catalog changed, keeping the selection. */
+void ui_iptv_refresh(void);
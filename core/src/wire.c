@@ -0,0 +1,390 @@
+#include "wire.h"
+#include "../third_party/cjson.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* ── Buffer ───────────────────────────────────────────────────────────────── */
+
+static int drain(Wire *w) {
+    size_t off = 0;
+    while (off < w->len) {
+        ssize_t r = write(w->fd, w->buf + off, w->len - off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { w->failed = 1; return -1; }
+        off += (size_t)r;
+    }
+    if (w->len) w->buf[0] = '\0';
+    w->len = 0;
+    return 0;
+}
+
+/* Room for n more bytes plus a terminator. */
+static int reserve(Wire *w, size_t n) {
+    if (w->failed) return -1;
+    if (w->to_fd && w->len >= WIRE_FLUSH_AT && drain(w) < 0) return -1;
+    if (w->len + n + 1 <= w->cap) return 0;
+    size_t cap = w->cap ? w->cap * 2 : 256;
+    while (cap < w->len + n + 1) cap *= 2;
+    char *p = realloc(w->buf, cap);
+    if (!p) { w->failed = 1; return -1; }
+    w->buf = p;
+    w->cap = cap;
+    return 0;
+}
+
+static void put(Wire *w, const void *p, size_t n) {
+    if (reserve(w, n) < 0) return;
+    memcpy(w->buf + w->len, p, n);
+    w->len += n;
+    w->buf[w->len] = '\0';
+}
+
+static void put_c(Wire *w, uint8_t c) {
+    if (reserve(w, 1) < 0) return;
+    w->buf[w->len++] = (char)c;
+    w->buf[w->len]   = '\0';
+}
+
+/* MessagePack type byte + big-endian n-byte argument */
+static void put_be(Wire *w, uint8_t type, uint64_t v, int n) {
+    uint8_t b[9];
+    b[0] = type;
+    for (int i = 0; i < n; i++) b[1 + i] = (uint8_t)(v >> (8 * (n - 1 - i)));
+    put(w, b, 1 + (size_t)n);
+}
+
+void wire_reset(Wire *w, WireFormat fmt) {
+    w->fmt    = fmt;
+    w->len    = 0;
+    w->failed = 0;
+    w->depth  = 0;
+    w->to_fd  = 0;
+    if (w->buf) w->buf[0] = '\0';
+}
+
+void wire_free(Wire *w) {
+    free(w->buf);
+    memset(w, 0, sizeof(*w));
+}
+
+/* Only JSON can leave the buffer early: MessagePack headers are rewritten
+ * when their container closes. */
+void wire_to_fd(Wire *w, int fd) {
+    if (w->fmt != WIRE_JSON || w->len) { w->failed = 1; return; }
+    w->to_fd = 1;
+    w->fd    = fd;
+}
+
+int wire_flush(Wire *w) {
+    if (w->failed) return -1;
+    return w->to_fd ? drain(w) : 0;
+}
+
+/* ── Structure ────────────────────────────────────────────────────────────── */
+
+/* Before every value: the separator in an array (a map value follows its
+ * key instead) and the element count. */
+static void elem(Wire *w) {
+    if (w->depth == 0) return;
+    int d = w->depth - 1;
+    if (w->map[d]) return;
+    if (w->count[d]++ && w->fmt == WIRE_JSON) put_c(w, ',');
+}
+
+static void open_container(Wire *w, int map) {
+    elem(w);
+    if (w->depth == WIRE_MAX_DEPTH) { w->failed = 1; return; }
+    int d = w->depth++;
+    w->map[d]   = (uint8_t)map;
+    w->count[d] = 0;
+    w->open[d]  = w->len;
+    if (w->fmt == WIRE_JSON) put_c(w, map ? '{' : '[');
+    else                     put_be(w, map ? 0xdf : 0xdd, 0, 4);   /* sized in wire_end() */
+}
+
+void wire_obj(Wire *w) { open_container(w, 1); }
+void wire_arr(Wire *w) { open_container(w, 0); }
+
+void wire_end(Wire *w) {
+    if (w->depth == 0) { w->failed = 1; return; }
+    int d = --w->depth;
+    if (w->fmt == WIRE_JSON) { put_c(w, w->map[d] ? '}' : ']'); return; }
+    if (w->failed) return;
+
+    /* Rewrite the 32-bit header at its smallest size */
+    uint32_t n   = w->count[d];
+    uint8_t *h   = (uint8_t *)w->buf + w->open[d];
+    size_t   body = w->len - w->open[d] - 5;
+    int      hl;
+    if (n <= 15)          { h[0] = (uint8_t)((w->map[d] ? 0x80 : 0x90) | n); hl = 1; }
+    else if (n <= 0xffff) { h[0] = w->map[d] ? 0xde : 0xdc;
+                            h[1] = (uint8_t)(n >> 8); h[2] = (uint8_t)n; hl = 3; }
+    else                  { h[1] = (uint8_t)(n >> 24); h[2] = (uint8_t)(n >> 16);
+                            h[3] = (uint8_t)(n >> 8);  h[4] = (uint8_t)n; return; }
+    memmove(h + hl, h + 5, body);
+    w->len -= (size_t)(5 - hl);
+    w->buf[w->len] = '\0';
+}
+
+/* ── Scalars ──────────────────────────────────────────────────────────────── */
+
+static void json_str(Wire *w, const char *s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    put_c(w, '"');
+    size_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        put(w, s + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"':  put(w, "\\\"", 2); break;
+        case '\\': put(w, "\\\\", 2); break;
+        case '\n': put(w, "\\n", 2);  break;
+        case '\r': put(w, "\\r", 2);  break;
+        case '\t': put(w, "\\t", 2);  break;
+        case '\b': put(w, "\\b", 2);  break;
+        case '\f': put(w, "\\f", 2);  break;
+        default: {
+            char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            put(w, u, 6);
+        }
+        }
+    }
+    put(w, s + run, n - run);
+    put_c(w, '"');
+}
+
+static void msgpack_str(Wire *w, const char *s, size_t n) {
+    if (n <= 31)             put_c(w, (uint8_t)(0xa0 | n));
+    else if (n <= 0xff)      put_be(w, 0xd9, n, 1);
+    else if (n <= 0xffff)    put_be(w, 0xda, n, 2);
+    else                     put_be(w, 0xdb, n, 4);
+    put(w, s, n);
+}
+
+void wire_key(Wire *w, const char *key) {
+    int d = w->depth - 1;
+    if (d < 0 || !w->map[d]) { w->failed = 1; return; }
+    size_t n = strlen(key);
+    if (w->fmt == WIRE_JSON) {
+        if (w->count[d]) put_c(w, ',');
+        json_str(w, key, n);
+        put_c(w, ':');
+    } else {
+        msgpack_str(w, key, n);
+    }
+    w->count[d]++;
+}
+
+void wire_strn(Wire *w, const char *s, size_t n) {
+    elem(w);
+    if (w->fmt == WIRE_JSON) json_str(w, s, n);
+    else                     msgpack_str(w, s, n);
+}
+
+void wire_str(Wire *w, const char *s) {
+    wire_strn(w, s ? s : "", s ? strlen(s) : 0);
+}
+
+void wire_int(Wire *w, int64_t v) {
+    elem(w);
+    if (w->fmt == WIRE_JSON) {
+        char b[24];
+        put(w, b, (size_t)snprintf(b, sizeof(b), "%lld", (long long)v));
+    } else if (v >= 0) {
+        if (v <= 0x7f)            put_c(w, (uint8_t)v);
+        else if (v <= 0xff)       put_be(w, 0xcc, (uint64_t)v, 1);
+        else if (v <= 0xffff)     put_be(w, 0xcd, (uint64_t)v, 2);
+        else if (v <= 0xffffffff) put_be(w, 0xce, (uint64_t)v, 4);
+        else                      put_be(w, 0xcf, (uint64_t)v, 8);
+    } else {
+        if (v >= -32)             put_c(w, (uint8_t)(int8_t)v);
+        else if (v >= INT8_MIN)   put_be(w, 0xd0, (uint64_t)v, 1);
+        else if (v >= INT16_MIN)  put_be(w, 0xd1, (uint64_t)v, 2);
+        else if (v >= INT32_MIN)  put_be(w, 0xd2, (uint64_t)v, 4);
+        else                      put_be(w, 0xd3, (uint64_t)v, 8);
+    }
+}
+
+void wire_num(Wire *w, double v) {
+    if (!isfinite(v)) { wire_null(w); return; }
+    if (v == floor(v) && fabs(v) < 9007199254740992.0) { wire_int(w, (int64_t)v); return; }
+    elem(w);
+    if (w->fmt == WIRE_JSON) {
+        char b[32];
+        put(w, b, (size_t)snprintf(b, sizeof(b), "%.15g", v));
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        put_be(w, 0xcb, bits, 8);
+    }
+}
+
+void wire_bool(Wire *w, int v) {
+    elem(w);
+    if (w->fmt == WIRE_JSON) put(w, v ? "true" : "false", v ? 4 : 5);
+    else                     put_c(w, v ? 0xc3 : 0xc2);
+}
+
+void wire_null(Wire *w) {
+    elem(w);
+    if (w->fmt == WIRE_JSON) put(w, "null", 4);
+    else                     put_c(w, 0xc0);
+}
+
+void wire_kstr (Wire *w, const char *k, const char *s) { wire_key(w, k); wire_str(w, s);  }
+void wire_knum (Wire *w, const char *k, double v)      { wire_key(w, k); wire_num(w, v);  }
+void wire_kbool(Wire *w, const char *k, int v)         { wire_key(w, k); wire_bool(w, v); }
+
+/* ── Transcoding ──────────────────────────────────────────────────────────── */
+
+static void from_tree(Wire *w, const cJSON *it) {
+    switch (it->type) {
+    case CJSON_STRING: wire_str(w, it->valuestring);  break;
+    case CJSON_NUMBER: wire_num(w, it->valuedouble);  break;
+    case CJSON_BOOL:   wire_bool(w, it->valuebool);   break;
+    case CJSON_ARRAY:
+    case CJSON_OBJECT:
+        open_container(w, it->type == CJSON_OBJECT);
+        for (const cJSON *ch = it->child; ch; ch = ch->next) {
+            if (it->type == CJSON_OBJECT) wire_key(w, ch->string ? ch->string : "");
+            from_tree(w, ch);
+        }
+        wire_end(w);
+        break;
+    default:           wire_null(w);                  break;
+    }
+}
+
+int wire_from_json(Wire *w, const char *json) {
+    cJSON *t = cJSON_Parse(json);
+    if (!t) return -1;
+    from_tree(w, t);
+    cJSON_Delete(t);
+    return w->failed ? -1 : 0;
+}
+
+typedef struct {
+    const uint8_t *p, *end;
+} MpIn;
+
+static int mp_take(MpIn *in, size_t n, const uint8_t **out) {
+    if ((size_t)(in->end - in->p) < n) return -1;
+    *out = in->p;
+    in->p += n;
+    return 0;
+}
+
+static int mp_uint(MpIn *in, int n, uint64_t *v) {
+    const uint8_t *b;
+    if (mp_take(in, (size_t)n, &b) < 0) return -1;
+    *v = 0;
+    for (int i = 0; i < n; i++) *v = *v << 8 | b[i];
+    return 0;
+}
+
+static int mp_value(Wire *w, MpIn *in, int depth);
+
+static int mp_items(Wire *w, MpIn *in, uint64_t n, int map, int depth) {
+    if (depth >= WIRE_MAX_DEPTH) return -1;
+    open_container(w, map);
+    for (uint64_t i = 0; i < n; i++) {
+        if (map) {
+            /* Keys must be strings */
+            uint8_t t = in->p < in->end ? *in->p : 0;
+            uint64_t len;
+            const uint8_t *s;
+            in->p++;
+            if ((t & 0xe0) == 0xa0) len = t & 0x1f;
+            else if (t == 0xd9 || t == 0xda || t == 0xdb) {
+                if (mp_uint(in, t == 0xd9 ? 1 : t == 0xda ? 2 : 4, &len) < 0) return -1;
+            } else return -1;
+            if (mp_take(in, len, &s) < 0) return -1;
+            char key[256];
+            if (len >= sizeof(key)) return -1;
+            memcpy(key, s, len);
+            key[len] = '\0';
+            wire_key(w, key);
+        }
+        if (mp_value(w, in, depth + 1) < 0) return -1;
+    }
+    wire_end(w);
+    return 0;
+}
+
+static int mp_value(Wire *w, MpIn *in, int depth) {
+    const uint8_t *b;
+    uint64_t       v;
+    if (mp_take(in, 1, &b) < 0) return -1;
+    uint8_t t = b[0];
+    if (t <= 0x7f)          { wire_int(w, t);                      return 0; }
+    if (t >= 0xe0)          { wire_int(w, (int8_t)t);              return 0; }
+    if ((t & 0xf0) == 0x80) return mp_items(w, in, t & 0x0f, 1, depth);
+    if ((t & 0xf0) == 0x90) return mp_items(w, in, t & 0x0f, 0, depth);
+    if ((t & 0xe0) == 0xa0) {
+        if (mp_take(in, t & 0x1f, &b) < 0) return -1;
+        wire_strn(w, (const char *)b, t & 0x1f);
+        return 0;
+    }
+    switch (t) {
+    case 0xc0: wire_null(w);    return 0;
+    case 0xc2: wire_bool(w, 0); return 0;
+    case 0xc3: wire_bool(w, 1); return 0;
+    case 0xc4: case 0xc5: case 0xc6:                   /* bin: as a string */
+    case 0xd9: case 0xda: case 0xdb: {
+        int n = t == 0xc4 || t == 0xd9 ? 1 : t == 0xc5 || t == 0xda ? 2 : 4;
+        if (mp_uint(in, n, &v) < 0 || mp_take(in, v, &b) < 0) return -1;
+        wire_strn(w, (const char *)b, (size_t)v);
+        return 0;
+    }
+    case 0xca: {
+        if (mp_uint(in, 4, &v) < 0) return -1;
+        uint32_t u = (uint32_t)v;
+        float    f;
+        memcpy(&f, &u, sizeof(f));
+        wire_num(w, f);
+        return 0;
+    }
+    case 0xcb: {
+        double d;
+        if (mp_uint(in, 8, &v) < 0) return -1;
+        memcpy(&d, &v, sizeof(d));
+        wire_num(w, d);
+        return 0;
+    }
+    case 0xcc: case 0xcd: case 0xce: case 0xcf:
+        if (mp_uint(in, 1 << (t - 0xcc), &v) < 0) return -1;
+        if (v > INT64_MAX) wire_num(w, (double)v);
+        else               wire_int(w, (int64_t)v);
+        return 0;
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+        int n = 1 << (t - 0xd0);
+        if (mp_uint(in, n, &v) < 0) return -1;
+        if (n < 8) {                                   /* sign-extend */
+            uint64_t sign = 1ull << (n * 8 - 1);
+            v = (v ^ sign) - sign;
+        }
+        wire_int(w, (int64_t)v);
+        return 0;
+    }
+    case 0xdc: case 0xdd:
+        if (mp_uint(in, t == 0xdc ? 2 : 4, &v) < 0) return -1;
+        return mp_items(w, in, v, 0, depth);
+    case 0xde: case 0xdf:
+        if (mp_uint(in, t == 0xde ? 2 : 4, &v) < 0) return -1;
+        return mp_items(w, in, v, 1, depth);
+    default:
+        return -1;                                     /* ext types */
+    }
+}
+
+int wire_from_msgpack(Wire *w, const void *data, size_t len) {
+    MpIn in = { data, (const uint8_t *)data + len };
+    if (mp_value(w, &in, 0) < 0 || in.p != in.end) return -1;
+    return w->failed ? -1 : 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Message encoder: compact JSON or MessagePack written straight from C
+ * values into a growable buffer, without building a tree first.
+ *
+ *   wire_reset(&w, fmt);
+ *   wire_obj(&w);
+ *     wire_key(&w, "type");    wire_str(&w, "history");
+ *     wire_key(&w, "entries"); wire_arr(&w); ... wire_end(&w);
+ *   wire_end(&w);
+ *
+ * Maps and arrays are closed with wire_end(); MessagePack counts are filled
+ * in then, so callers never count ahead. JSON output is NUL-terminated.
+ * A Wire keeps its buffer across wire_reset() calls; wire_free() releases
+ * it. Errors (out of memory, a key outside a map, nesting past
+ * WIRE_MAX_DEPTH, a failed write) set failed and leave the output unusable.
+ *
+ * A JSON Wire can also stream into a file: after wire_to_fd() the buffer
+ * is written out whenever it passes WIRE_FLUSH_AT bytes, so a document of
+ * any size costs one bounded buffer. wire_flush() writes the rest. */
+
+typedef enum { WIRE_JSON = 0, WIRE_MSGPACK = 1 } WireFormat;
+
+#define WIRE_MAX_DEPTH 32
+#define WIRE_FLUSH_AT  (64 * 1024)
+
+typedef struct {
+    WireFormat fmt;
+    char      *buf;
+    size_t     len, cap;
+    int        failed;
+    int        depth;
+    int        to_fd, fd;                /* streaming sink, see wire_to_fd() */
+    size_t     open [WIRE_MAX_DEPTH];   /* header offset of each open container */
+    uint32_t   count[WIRE_MAX_DEPTH];   /* keys (map) or values (array) so far */
+    uint8_t    map  [WIRE_MAX_DEPTH];
+} Wire;
+
+void wire_reset(Wire *w, WireFormat fmt);
+void wire_free(Wire *w);
+
+/* Stream w (reset, JSON only) into fd; wire_reset() detaches it again.
+   wire_flush() writes out what is buffered and returns 0, or -1 if any
+   write or encoding step failed. The caller owns and closes fd. */
+void wire_to_fd(Wire *w, int fd);
+int  wire_flush(Wire *w);
+
+void wire_obj(Wire *w);
+void wire_arr(Wire *w);
+void wire_end(Wire *w);
+void wire_key(Wire *w, const char *key);
+
+void wire_str (Wire *w, const char *s);      /* NULL writes "" */
+void wire_strn(Wire *w, const char *s, size_t n);
+void wire_int (Wire *w, int64_t v);
+void wire_num (Wire *w, double v);           /* integral values as integers */
+void wire_bool(Wire *w, int v);
+void wire_null(Wire *w);
+
+/* Key + value shorthands */
+void wire_kstr (Wire *w, const char *key, const char *s);
+void wire_knum (Wire *w, const char *key, double v);
+void wire_kbool(Wire *w, const char *key, int v);
+
+/* Transcoding, for messages that exist in the other format. Both append
+   one value to w and return 0, or -1 if the input is malformed. */
+int  wire_from_json   (Wire *w, const char *json);
+int  wire_from_msgpack(Wire *w, const void *data, size_t len);
@@ -1,4 +1,5 @@
 #include "ws.h"
+#include "wire.h"
 #include "../third_party/sha1.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +13,9 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <zlib.h>
 
 /* ── WebSocket magic ──────────────────────────────────────────────────────── */
 #define WS_MAGIC "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
@@ -19,21 +23,111 @@
 /* ── Client state ─────────────────────────────────────────────────────────── */
 typedef enum { CS_HANDSHAKE, CS_OPEN, CS_CLOSED } ClientState;
 
-/* 128 KB — enough for M3U playlist imports (up to ~1000 channels as JSON) */
-#define WS_RBUF_SIZE (128 * 1024)
+/* Receive buffers start at WS_RBUF_MIN, grow to fit the message being
+ * read (up to the per-message limit, ws_set_max_message()) and drop back
+ * once it has been handled. */
+#define WS_RBUF_MIN       4096
+#define WS_HANDSHAKE_MAX  (16 * 1024)
+
+/* Outbound queue limits. Frames are queued whole and written as the socket
+ * accepts them, so a slow reader only ever delays itself. Past the high
+ * water mark, keyed frames (periodic status) are dropped instead of queued;
+ * a client that reaches the hard limit or makes no progress for
+ * WS_STALL_MS is disconnected. */
+#define WS_OUT_SLOTS      64
+#define WS_OUT_HIGH_WATER (256 * 1024)
+#define WS_OUT_MAX        (4 * 1024 * 1024)
+#define WS_STALL_MS       10000
+
+/* permessage-deflate (RFC 7692), with context takeover unless the client
+ * asks otherwise. Messages under WS_DEFLATE_MIN bytes go out plain — status
+ * frames aren't worth the CPU. zlib memory per client (both directions) is
+ * capped at WS_DEFLATE_MEM; our compressor's window and memLevel are
+ * chosen to fit, and the client's window is cut to WS_DEFLATE_WBITS when
+ * it lets us. */
+#define WS_DEFLATE_MIN    512
+#define WS_DEFLATE_LEVEL  3
+#define WS_DEFLATE_WBITS  13
+#define WS_DEFLATE_MEMLVL 6
+#define WS_DEFLATE_MEM    (192 * 1024)
+
+/* Subprotocols (Sec-WebSocket-Protocol). A client that negotiates
+ * WS_PROTO_MSGPACK gets every message as a binary MessagePack frame and may
+ * send its commands that way; everyone else speaks JSON text. */
+#define WS_PROTO_JSON    "qaryx.json"
+#define WS_PROTO_MSGPACK "qaryx.msgpack"
+
+/* A framed message (header + payload), built once and shared by every
+ * client queue it is on. Immutable once built, apart from bin: the same
+ * message as a MessagePack frame, made the first time a MessagePack client
+ * needs it (or up front by ws_frame_wire()) and then shared the same way.
+ * The payload is followed by a NUL that len doesn't count. */
+struct WsFrame {
+    atomic_int refs;
+    uint8_t    op;           /* opcode; 0 = raw bytes (handshake reply) */
+    uint8_t    hlen;         /* header bytes before the payload */
+    size_t     len;
+    _Atomic(struct WsFrame *) bin;
+    uint8_t    data[];
+};
+
+typedef struct {
+    WsFrame *f;
+    int      key;            /* coalescing key, 0 = none */
+    int      ready;          /* in its final form for this client (compressed) */
+} WsOut;
 
 typedef struct {
     int         fd;
     ClientState state;
-    char        rbuf[WS_RBUF_SIZE];
-    int         rlen;
+    char       *rbuf;        /* NULL until the first read */
+    size_t      rcap;
+    size_t      rlen;
+
+    /* Fragmented message being put together (event loop only) */
+    char       *frag;
+    size_t      frag_len, frag_cap;
+    uint8_t     frag_op;     /* opcode of its first frame, 0 = none */
+    int         frag_rsv1;
+
+    /* Outbound ring, guarded by out_mu (senders run on any thread) */
+    pthread_mutex_t out_mu;
+    WsOut       out[WS_OUT_SLOTS];
+    int         out_head;
+    int         out_n;
+    size_t      out_off;     /* bytes of out[out_head] already written */
+    size_t      out_bytes;   /* queued and not yet written */
+    long long   progress_ms; /* last time the queue was empty or moved */
+    int         want_out;    /* EPOLLOUT requested */
+    int         dead;        /* cut off; the event loop closes it */
+
+    /* permessage-deflate, NULL when not negotiated. tx is used under
+     * out_mu, rx by the event loop only. */
+    z_stream   *tx;
+    z_stream   *rx;
+    int         tx_reset;    /* server_no_context_takeover */
+    atomic_size_t zmem;      /* bytes zlib holds for this client */
+
+    WireFormat  fmt;         /* negotiated subprotocol, set at handshake */
 } WsClient;
 
+/* Open clients, allocated on accept and freed on close. Only the event
+ * loop adds or removes entries, under g_clients_mu; other threads hold the
+ * lock while they look at the table. */
 static int        g_listen_fd = -1;
-static WsClient   g_clients[WS_MAX_CLIENTS];
+static WsClient **g_clients   = NULL;
+static int        g_nclients  = 0;
+static int        g_clients_cap = 0;
+static size_t     g_max_msg   = WS_DEFAULT_MAX_MESSAGE;
 static WsMsgHandler g_handler = NULL;
+static WsPollCb   g_poll_cb = NULL;
 static pthread_mutex_t g_clients_mu = PTHREAD_MUTEX_INITIALIZER;
 
+/* Counters for ws_get_stats(); bumped from whichever thread sends */
+static atomic_ullong g_st_broadcasts, g_st_frames, g_st_queued, g_st_coalesced,
+                     g_st_dropped, g_st_cut_off, g_st_bytes, g_st_writes, g_st_blocked,
+                     g_st_deflate_in, g_st_deflate_out;
+
 /* ── Helpers ──────────────────────────────────────────────────────────────── */
 
 static int set_nonblock(int fd) {
@@ -41,30 +135,510 @@ static int set_nonblock(int fd) {
     return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
+/* Event loop, or with g_clients_mu held. */
 static WsClient *find_client(int fd) {
-    for (int i = 0; i < WS_MAX_CLIENTS; i++)
-        if (g_clients[i].fd == fd) return &g_clients[i];
+    for (int i = 0; i < g_nclients; i++)
+        if (g_clients[i]->fd == fd) return g_clients[i];
     return NULL;
 }
 
-static WsClient *find_free(void) {
-    for (int i = 0; i < WS_MAX_CLIENTS; i++)
-        if (g_clients[i].fd < 0) return &g_clients[i];
-    return NULL;
+/* Resize the receive buffer to cap bytes (cap > rlen). */
+static int rbuf_resize(WsClient *c, size_t cap) {
+    char *p = realloc(c->rbuf, cap);
+    if (!p) return -1;
+    c->rbuf = p;
+    c->rcap = cap;
+    return 0;
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ── Frames ───────────────────────────────────────────────────────────────── */
+
+static WsFrame *frame_new(uint8_t op, const void *payload, size_t payload_len) {
+    uint8_t header[10];
+    int hlen = 0;
+
+    header[hlen++] = 0x80 | op;  /* FIN + opcode (+ RSV1 if compressed) */
+
+    if (payload_len < 126) {
+        header[hlen++] = (uint8_t)payload_len;
+    } else if (payload_len < 65536) {
+        header[hlen++] = 126;
+        header[hlen++] = (payload_len >> 8) & 0xff;
+        header[hlen++] = payload_len & 0xff;
+    } else {
+        header[hlen++] = 127;
+        for (int i = 7; i >= 0; i--)
+            header[hlen++] = (payload_len >> (i*8)) & 0xff;
+    }
+
+    WsFrame *f = malloc(sizeof(*f) + hlen + payload_len + 1);
+    if (!f) return NULL;
+    atomic_init(&f->refs, 1);
+    atomic_init(&f->bin, NULL);
+    f->op   = op & 0x0f;
+    f->hlen = (uint8_t)hlen;
+    f->len  = hlen + payload_len;
+    memcpy(f->data, header, hlen);
+    memcpy(f->data + hlen, payload, payload_len);
+    f->data[f->len] = '\0';
+    atomic_fetch_add_explicit(&g_st_frames, 1, memory_order_relaxed);
+    return f;
+}
+
+/* Unframed bytes (the handshake reply) in the same wrapper. */
+static WsFrame *frame_raw(const void *data, size_t len) {
+    WsFrame *f = malloc(sizeof(*f) + len + 1);
+    if (!f) return NULL;
+    atomic_init(&f->refs, 1);
+    atomic_init(&f->bin, NULL);
+    f->op   = 0;
+    f->hlen = 0;
+    f->len  = len;
+    memcpy(f->data, data, len);
+    f->data[len] = '\0';
+    return f;
+}
+
+WsFrame *ws_frame_text(const char *json) {
+    return json ? frame_new(0x1, json, strlen(json)) : NULL;
+}
+
+WsFrame *ws_frame_ref(WsFrame *f) {
+    if (f) atomic_fetch_add_explicit(&f->refs, 1, memory_order_relaxed);
+    return f;
+}
+
+void ws_frame_unref(WsFrame *f) {
+    if (f && atomic_fetch_sub_explicit(&f->refs, 1, memory_order_acq_rel) == 1) {
+        ws_frame_unref(atomic_load(&f->bin));
+        free(f);
+    }
+}
+
+WsFrame *ws_frame_wire(const Wire *json, const Wire *msgpack) {
+    if (!json || json->failed || json->fmt != WIRE_JSON) return NULL;
+    WsFrame *f = frame_new(0x1, json->buf, json->len);
+    if (f && msgpack && !msgpack->failed && msgpack->fmt == WIRE_MSGPACK)
+        atomic_init(&f->bin, frame_new(0x2, msgpack->buf, msgpack->len));
+    return f;
+}
+
+/* The MessagePack variant of text frame f, transcoded on first use; NULL
+ * if f isn't valid JSON. Any thread; the frame keeps what it made. */
+static WsFrame *frame_bin(WsFrame *f) {
+    WsFrame *b = atomic_load(&f->bin);
+    if (b) return b;
+    Wire w = {0};
+    wire_reset(&w, WIRE_MSGPACK);
+    if (wire_from_json(&w, (const char *)f->data + f->hlen) == 0)
+        b = frame_new(0x2, w.buf, w.len);
+    wire_free(&w);
+    if (!b) return NULL;
+    WsFrame *none = NULL;
+    if (!atomic_compare_exchange_strong(&f->bin, &none, b)) {
+        ws_frame_unref(b);           /* another thread got there first */
+        b = none;
+    }
+    return b;
+}
+
+/* ── permessage-deflate ────────────────────────────────────────────────── */
+
+/* zlib allocator charging the client's budget (a size_t header per block). */
+static voidpf z_alloc(voidpf opaque, uInt items, uInt size) {
+    WsClient *c = opaque;
+    size_t    n = (size_t)items * size;
+    if (atomic_load(&c->zmem) + n > WS_DEFLATE_MEM) return Z_NULL;
+    size_t *p = malloc(sizeof(size_t) + n);
+    if (!p) return Z_NULL;
+    *p = n;
+    atomic_fetch_add(&c->zmem, n);
+    return p + 1;
+}
+
+static void z_free(voidpf opaque, voidpf ptr) {
+    WsClient *c = opaque;
+    size_t   *p = (size_t *)ptr - 1;
+    atomic_fetch_sub(&c->zmem, *p);
+    free(p);
 }
 
+static void deflate_free(WsClient *c) {
+    if (c->tx) { deflateEnd(c->tx); free(c->tx); c->tx = NULL; }
+    if (c->rx) { inflateEnd(c->rx); free(c->rx); c->rx = NULL; }
+}
+
+/* Set up both streams: tx_bits for ours, rx_bits for the client's window. */
+static int deflate_init(WsClient *c, int tx_bits, int rx_bits) {
+    c->tx = calloc(1, sizeof(z_stream));
+    c->rx = calloc(1, sizeof(z_stream));
+    if (c->tx) { c->tx->zalloc = z_alloc; c->tx->zfree = z_free; c->tx->opaque = c; }
+    if (c->rx) { c->rx->zalloc = z_alloc; c->rx->zfree = z_free; c->rx->opaque = c; }
+    if (!c->tx || !c->rx ||
+        deflateInit2(c->tx, WS_DEFLATE_LEVEL, Z_DEFLATED, -tx_bits,
+                     WS_DEFLATE_MEMLVL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(c->tx); free(c->rx);
+        c->tx = c->rx = NULL;
+        return -1;
+    }
+    if (inflateInit2(c->rx, -rx_bits) != Z_OK) {
+        deflateEnd(c->tx);
+        free(c->tx); free(c->rx);
+        c->tx = c->rx = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* Compress data frame f for client c into *z, or leave it NULL to send f
+ * as it is. Every frame that goes through the compressor must then be
+ * sent, in order: the client's inflater shares its history. A failure
+ * once deflate() has run leaves that history out of step; without context
+ * takeover the stream is reset and f goes plain, otherwise this returns
+ * -1 and the client must be cut off. Caller holds out_mu. */
+static int deflate_frame(WsClient *c, const WsFrame *f, WsFrame **z) {
+    *z = NULL;
+    if ((f->op != 0x1 && f->op != 0x2) || f->len - f->hlen < WS_DEFLATE_MIN) return 0;
+    size_t   plen = f->len - f->hlen;
+    size_t   cap  = deflateBound(c->tx, plen) + 16, n = 0;
+    uint8_t *out  = malloc(cap);
+    if (!out) return 0;
+    c->tx->next_in  = (Bytef *)f->data + f->hlen;
+    c->tx->avail_in = (uInt)plen;
+    for (;;) {
+        c->tx->next_out  = out + n;
+        c->tx->avail_out = (uInt)(cap - n);
+        int r = deflate(c->tx, Z_SYNC_FLUSH);
+        n = cap - c->tx->avail_out;
+        if (r != Z_OK && r != Z_BUF_ERROR) goto fail;
+        if (c->tx->avail_in == 0 && c->tx->avail_out > 0) break;
+        uint8_t *grown = realloc(out, cap * 2);
+        if (!grown) goto fail;
+        out = grown;
+        cap *= 2;
+    }
+    /* The sync flush ends in 00 00 ff ff, which the receiver appends back */
+    if (n >= 4 && !memcmp(out + n - 4, "\x00\x00\xff\xff", 4)) n -= 4;
+    if (c->tx_reset) deflateReset(c->tx);
+    *z = frame_new(0x40 | f->op, out, n);
+    if (!*z) goto fail;
+    free(out);
+    atomic_fetch_add_explicit(&g_st_deflate_in,  plen, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_st_deflate_out, n,    memory_order_relaxed);
+    return 0;
+fail:
+    free(out);
+    if (!c->tx_reset) return -1;
+    deflateReset(c->tx);
+    return 0;
+}
+
+/* Inflate one compressed message into a new NUL-terminated buffer of at
+ * most max bytes. Event loop only. Returns NULL on error or overflow. */
+static char *inflate_msg(WsClient *c, const uint8_t *in, size_t n, size_t max,
+                         size_t *out_len) {
+    static const uint8_t tail[4] = { 0x00, 0x00, 0xff, 0xff };
+    size_t cap = n * 4 + 64, len = 0;
+    if (cap > max + 1) cap = max + 1;
+    char *out = malloc(cap);
+    if (!out) return NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        c->rx->next_in  = (Bytef *)(pass ? tail : in);
+        c->rx->avail_in = (uInt)(pass ? sizeof(tail) : n);
+        while (c->rx->avail_in > 0) {
+            if (len + 1 >= cap) {
+                if (cap > max) { free(out); return NULL; }
+                size_t nc = cap * 2 > max + 1 ? max + 1 : cap * 2;
+                char *grown = realloc(out, nc);
+                if (!grown) { free(out); return NULL; }
+                out = grown;
+                cap = nc;
+            }
+            c->rx->next_out  = (Bytef *)out + len;
+            c->rx->avail_out = (uInt)(cap - 1 - len);
+            int r = inflate(c->rx, Z_SYNC_FLUSH);
+            len = cap - 1 - c->rx->avail_out;
+            if (r == Z_BUF_ERROR && c->rx->avail_out > 0) break;
+            if (r != Z_OK && r != Z_BUF_ERROR) { free(out); return NULL; }
+        }
+    }
+    out[len] = '\0';
+    *out_len = len;
+    return out;
+}
+
+/* Drop everything queued. Caller holds out_mu. */
+static void out_clear(WsClient *c) {
+    for (int i = 0; i < c->out_n; i++)
+        ws_frame_unref(c->out[(c->out_head + i) % WS_OUT_SLOTS].f);
+    c->out_head  = 0;
+    c->out_n     = 0;
+    c->out_off   = 0;
+    c->out_bytes = 0;
+    c->want_out  = 0;
+}
+
+/* Remove c from the table and free it. Event loop only. */
 static void close_client(WsClient *c) {
     pthread_mutex_lock(&g_clients_mu);
-    int fd = c->fd;
-    c->fd    = -1;
+    for (int i = 0; i < g_nclients; i++) {
+        if (g_clients[i] != c) continue;
+        g_clients[i] = g_clients[--g_nclients];
+        break;
+    }
+    pthread_mutex_lock(&c->out_mu);
     c->state = CS_CLOSED;
-    c->rlen  = 0;
+    out_clear(c);
+    deflate_free(c);
+    pthread_mutex_unlock(&c->out_mu);
     pthread_mutex_unlock(&g_clients_mu);
-    if (fd >= 0) close(fd);
+
+    /* Nobody can reach c any more: senders only find it under the lock */
+    close(c->fd);
+    pthread_mutex_destroy(&c->out_mu);
+    free(c->rbuf);
+    free(c->frag);
+    free(c);
+}
+
+/* Disconnect from any thread: the socket is shut down, which wakes the
+ * event loop, and ws_client_read() then closes it there. Caller holds
+ * out_mu. */
+static void cut_off(WsClient *c, const char *why) {
+    if (c->dead) return;
+    atomic_fetch_add_explicit(&g_st_cut_off, 1, memory_order_relaxed);
+    fprintf(stderr, "ws: client %d %s (%zu bytes queued), disconnecting\n",
+            c->fd, why, c->out_bytes);
+    c->dead = 1;
+    out_clear(c);
+    shutdown(c->fd, SHUT_RDWR);
+}
+
+/* ── Outbound queue ───────────────────────────────────────────────────────── */
+
+/* Write as much of the queue as the socket takes. Caller holds out_mu.
+ * Returns 0 if the queue is empty afterwards, 1 if data is left, -1 if the
+ * connection failed. */
+static int out_flush(WsClient *c) {
+    while (c->out_n > 0) {
+        struct iovec iov[16];
+        int n = 0;
+        for (; n < c->out_n && n < 16; n++) {
+            WsOut *o = &c->out[(c->out_head + n) % WS_OUT_SLOTS];
+            if (c->tx && !o->ready) {
+                /* Compressed as late as possible, in send order */
+                WsFrame *z;
+                if (deflate_frame(c, o->f, &z) < 0) {
+                    cut_off(c, "deflate failed");
+                    return -1;
+                }
+                if (z) {
+                    c->out_bytes += z->len;
+                    c->out_bytes -= o->f->len;
+                    ws_frame_unref(o->f);
+                    o->f = z;
+                }
+                o->ready = 1;
+            }
+            WsFrame *f = o->f;
+            size_t off = n == 0 ? c->out_off : 0;
+            iov[n] = (struct iovec){ f->data + off, f->len - off };
+        }
+        ssize_t w = writev(c->fd, iov, n);
+        atomic_fetch_add_explicit(&g_st_writes, 1, memory_order_relaxed);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                atomic_fetch_add_explicit(&g_st_blocked, 1, memory_order_relaxed);
+                return 1;
+            }
+            return -1;
+        }
+        atomic_fetch_add_explicit(&g_st_bytes, (unsigned long long)w, memory_order_relaxed);
+        c->out_bytes  -= (size_t)w;
+        c->progress_ms = now_ms();
+        /* Pop what went out completely */
+        size_t left = (size_t)w;
+        while (left > 0) {
+            WsFrame *f  = c->out[c->out_head].f;
+            size_t  rem = f->len - c->out_off;
+            if (left < rem) { c->out_off += left; break; }
+            left -= rem;
+            ws_frame_unref(f);
+            c->out_head = (c->out_head + 1) % WS_OUT_SLOTS;
+            c->out_n--;
+            c->out_off = 0;
+        }
+    }
+    return 0;
+}
+
+/* Frames queued and none written for WS_STALL_MS. Caller holds out_mu. */
+static int out_stalled(const WsClient *c, long long t) {
+    return c->out_n > 0 && t - c->progress_ms > WS_STALL_MS;
+}
+
+/* Queue frame f (taking a reference) on an open client and write what the
+ * socket takes right away. With a key, a queued frame with the same key
+ * that hasn't started going out is replaced — unless an unkeyed frame was
+ * queued after it, which f must not overtake — and the frame is dropped
+ * rather than queued past the high water mark. Caller holds out_mu. */
+static void out_push(WsClient *c, WsFrame *f, int key) {
+    if (c->dead || c->state == CS_CLOSED) return;
+    if (c->fmt == WIRE_MSGPACK && f->op == 0x1) {
+        WsFrame *b = frame_bin(f);
+        if (b) f = b;
+    }
+    long long t = now_ms();
+    if (c->out_n == 0) c->progress_ms = t;
+    else if (out_stalled(c, t)) {
+        cut_off(c, "stalled");
+        return;
+    }
+
+    if (key) {
+        for (int i = c->out_n - 1; i >= (c->out_off ? 1 : 0); i--) {
+            WsOut *o = &c->out[(c->out_head + i) % WS_OUT_SLOTS];
+            if (!o->key) break;
+            if (o->key != key || o->ready) continue;
+            c->out_bytes += f->len - o->f->len;
+            ws_frame_unref(o->f);
+            o->f = ws_frame_ref(f);
+            atomic_fetch_add_explicit(&g_st_coalesced, 1, memory_order_relaxed);
+            return;
+        }
+        if (c->out_bytes >= WS_OUT_HIGH_WATER) {
+            atomic_fetch_add_explicit(&g_st_dropped, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    if (c->out_n == WS_OUT_SLOTS || c->out_bytes + f->len > WS_OUT_MAX) {
+        cut_off(c, "not reading");
+        return;
+    }
+    c->out[(c->out_head + c->out_n) % WS_OUT_SLOTS] = (WsOut){ ws_frame_ref(f), key, 0 };
+    c->out_n++;
+    c->out_bytes += f->len;
+    atomic_fetch_add_explicit(&g_st_queued, 1, memory_order_relaxed);
+
+    if (c->want_out) return;                 /* the event loop flushes */
+    int r = out_flush(c);
+    if (r < 0) { cut_off(c, "write failed"); return; }
+    if (r > 0) {
+        c->want_out = 1;
+        if (g_poll_cb) g_poll_cb(c->fd, 1);
+    }
+}
+
+/* Frame and queue a one-off message. Caller holds out_mu. */
+static void send_frame(WsClient *c, uint8_t op, const void *payload, size_t len) {
+    WsFrame *f = frame_new(op, payload, len);
+    if (!f) return;
+    out_push(c, f, 0);
+    ws_frame_unref(f);
 }
 
 /* ── WebSocket handshake ──────────────────────────────────────────────────── */
 
+/* Take the first permessage-deflate offer in the request we can honour,
+ * set up the client's streams and write the response parameters into ext
+ * (empty if declined). */
+static void negotiate_deflate(WsClient *c, const char *req, char *ext, size_t cap) {
+    ext[0] = '\0';
+    const char *h = strcasestr(req, "Sec-WebSocket-Extensions:");
+    if (!h) return;
+    h += strlen("Sec-WebSocket-Extensions:");
+    size_t hl = strcspn(h, "\r\n");
+    char   line[512];
+    if (hl >= sizeof(line)) hl = sizeof(line) - 1;
+    memcpy(line, h, hl);
+    line[hl] = '\0';
+
+    char *offer_save = NULL;
+    for (char *offer = strtok_r(line, ",", &offer_save); offer;
+         offer = strtok_r(NULL, ",", &offer_save)) {
+        int   tx_bits = WS_DEFLATE_WBITS, rx_bits = 15, ok = 1, first = 1;
+        int   tx_reset = 0;
+        char  resp[160] = "permessage-deflate";
+        char *param_save = NULL;
+        for (char *p = strtok_r(offer, ";", &param_save); p && ok;
+             p = strtok_r(NULL, ";", &param_save), first = 0) {
+            while (*p == ' ' || *p == '\t') p++;
+            char *e = p + strlen(p);
+            while (e > p && (e[-1] == ' ' || e[-1] == '\t')) *--e = '\0';
+            char *val = strchr(p, '=');
+            if (val) {
+                *val++ = '\0';
+                if (*val == '"') val++;
+                val[strcspn(val, "\"")] = '\0';
+            }
+            size_t rl = strlen(resp);
+            if (first) {
+                ok = !strcmp(p, "permessage-deflate");
+            } else if (!strcmp(p, "server_no_context_takeover") && !val) {
+                tx_reset = 1;
+                snprintf(resp + rl, sizeof(resp) - rl, "; server_no_context_takeover");
+            } else if (!strcmp(p, "client_no_context_takeover") && !val) {
+                snprintf(resp + rl, sizeof(resp) - rl, "; client_no_context_takeover");
+            } else if (!strcmp(p, "server_max_window_bits") && val) {
+                /* zlib can't produce a raw 8-bit window; decline those */
+                int bits = atoi(val);
+                if (bits < 9 || bits > 15) { ok = 0; break; }
+                if (bits < tx_bits) tx_bits = bits;
+                snprintf(resp + rl, sizeof(resp) - rl, "; server_max_window_bits=%d", tx_bits);
+            } else if (!strcmp(p, "client_max_window_bits")) {
+                /* Offered, so we may shrink the client's window (and our
+                 * inflate memory) */
+                int bits = val ? atoi(val) : 15;
+                if (bits < 8 || bits > 15) { ok = 0; break; }
+                rx_bits = bits < WS_DEFLATE_WBITS ? bits : WS_DEFLATE_WBITS;
+                snprintf(resp + rl, sizeof(resp) - rl, "; client_max_window_bits=%d", rx_bits);
+            } else {
+                ok = 0;
+            }
+        }
+        if (!ok) continue;
+        if (deflate_init(c, tx_bits, rx_bits) < 0) {
+            fprintf(stderr, "ws: client %d: deflate unavailable\n", c->fd);
+            return;
+        }
+        c->tx_reset = tx_reset;
+        snprintf(ext, cap, "Sec-WebSocket-Extensions: %s\r\n", resp);
+        return;
+    }
+}
+
+/* Pick our subprotocol from the client's list, MessagePack first, and write
+ * the response header into hdr (empty if it offered neither). */
+static void negotiate_protocol(WsClient *c, const char *req, char *hdr, size_t cap) {
+    hdr[0] = '\0';
+    const char *h = strcasestr(req, "Sec-WebSocket-Protocol:");
+    if (!h) return;
+    h += strlen("Sec-WebSocket-Protocol:");
+    size_t hl = strcspn(h, "\r\n");
+    char   line[256];
+    if (hl >= sizeof(line)) hl = sizeof(line) - 1;
+    memcpy(line, h, hl);
+    line[hl] = '\0';
+
+    int   json = 0, msgpack = 0;
+    char *save = NULL;
+    for (char *p = strtok_r(line, ", \t", &save); p; p = strtok_r(NULL, ", \t", &save)) {
+        if (!strcmp(p, WS_PROTO_MSGPACK)) msgpack = 1;
+        if (!strcmp(p, WS_PROTO_JSON))    json    = 1;
+    }
+    if (!json && !msgpack) return;
+    c->fmt = msgpack ? WIRE_MSGPACK : WIRE_JSON;
+    snprintf(hdr, cap, "Sec-WebSocket-Protocol: %s\r\n",
+             msgpack ? WS_PROTO_MSGPACK : WS_PROTO_JSON);
+}
+
 static void do_handshake(WsClient *c) {
     /* Find Sec-WebSocket-Key header */
     char *key_hdr = strcasestr(c->rbuf, "Sec-WebSocket-Key:");
@@ -86,74 +660,175 @@ static void do_handshake(WsClient *c) {
     char accept[64];
     base64_encode(digest, 20, accept);
 
-    char response[512];
+    char ext[256], proto[64];
+    negotiate_deflate(c, c->rbuf, ext, sizeof(ext));
+    negotiate_protocol(c, c->rbuf, proto, sizeof(proto));
+
+    char response[768];
     snprintf(response, sizeof(response),
              "HTTP/1.1 101 Switching Protocols\r\n"
              "Upgrade: websocket\r\n"
              "Connection: Upgrade\r\n"
-             "Sec-WebSocket-Accept: %s\r\n\r\n",
-             accept);
+             "Sec-WebSocket-Accept: %s\r\n"
+             "%s%s\r\n",
+             accept, proto, ext);
 
-    send(c->fd, response, strlen(response), MSG_NOSIGNAL);
+    WsFrame *raw = frame_raw(response, strlen(response));
+    if (!raw) return;
+    pthread_mutex_lock(&c->out_mu);
+    out_push(c, raw, 0);
     c->state = CS_OPEN;
+    pthread_mutex_unlock(&c->out_mu);
+    ws_frame_unref(raw);
     c->rlen  = 0;
-    fprintf(stderr, "ws: client %d handshake OK\n", c->fd);
+    fprintf(stderr, "ws: client %d handshake OK%s%s\n", c->fd,
+            c->fmt == WIRE_MSGPACK ? " (msgpack)" : "",
+            c->tx ? " (permessage-deflate)" : "");
 }
 
 /* ── WebSocket frame send ────────────────────────────────────────────────── */
 
 void ws_send(int fd, const char *json) {
     if (fd < 0 || !json) return;
-    size_t payload_len = strlen(json);
-    uint8_t header[10];
-    int hlen = 0;
+    pthread_mutex_lock(&g_clients_mu);
+    WsClient *c = find_client(fd);
+    if (c) {
+        pthread_mutex_lock(&c->out_mu);
+        if (c->state == CS_OPEN) send_frame(c, 0x1, json, strlen(json));
+        pthread_mutex_unlock(&c->out_mu);
+    }
+    pthread_mutex_unlock(&g_clients_mu);
+}
 
-    header[hlen++] = 0x81;  /* FIN + text opcode */
+WireFormat ws_client_format(int fd) {
+    WireFormat fmt = WIRE_JSON;
+    pthread_mutex_lock(&g_clients_mu);
+    WsClient *c = find_client(fd);
+    if (c) fmt = c->fmt;
+    pthread_mutex_unlock(&g_clients_mu);
+    return fmt;
+}
 
-    if (payload_len < 126) {
-        header[hlen++] = (uint8_t)payload_len;
-    } else if (payload_len < 65536) {
-        header[hlen++] = 126;
-        header[hlen++] = (payload_len >> 8) & 0xff;
-        header[hlen++] = payload_len & 0xff;
-    } else {
-        header[hlen++] = 127;
-        for (int i = 7; i >= 0; i--)
-            header[hlen++] = (payload_len >> (i*8)) & 0xff;
+void ws_send_wire(int fd, const Wire *w) {
+    if (fd < 0 || !w || w->failed) return;
+    pthread_mutex_lock(&g_clients_mu);
+    WsClient *c = find_client(fd);
+    if (c) {
+        pthread_mutex_lock(&c->out_mu);
+        if (c->state == CS_OPEN)
+            send_frame(c, w->fmt == WIRE_MSGPACK ? 0x2 : 0x1, w->buf, w->len);
+        pthread_mutex_unlock(&c->out_mu);
     }
+    pthread_mutex_unlock(&g_clients_mu);
+}
 
-    struct iovec iov[2] = {
-        { .iov_base = header,       .iov_len = hlen },
-        { .iov_base = (void *)json, .iov_len = payload_len },
-    };
-    writev(fd, iov, 2);
+void ws_broadcast_frame(WsFrame *f, int key) {
+    if (!f) return;
+    atomic_fetch_add_explicit(&g_st_broadcasts, 1, memory_order_relaxed);
+    /* Every queue shares f; nothing here blocks: each client only gets its
+     * queue appended to and whatever its socket takes without waiting */
+    pthread_mutex_lock(&g_clients_mu);
+    for (int i = 0; i < g_nclients; i++) {
+        WsClient *c = g_clients[i];
+        pthread_mutex_lock(&c->out_mu);
+        if (c->state == CS_OPEN) out_push(c, f, key);
+        pthread_mutex_unlock(&c->out_mu);
+    }
+    pthread_mutex_unlock(&g_clients_mu);
 }
 
-void ws_broadcast(const char *json) {
-    /* Snapshot open fds under lock, then release before writing.
-     * Holding the mutex during writev() blocks ws_accept/close_client. */
-    int fds[WS_MAX_CLIENTS];
-    int n = 0;
+void ws_tick(void) {
+    long long t = now_ms();
     pthread_mutex_lock(&g_clients_mu);
-    for (int i = 0; i < WS_MAX_CLIENTS; i++)
-        if (g_clients[i].fd >= 0 && g_clients[i].state == CS_OPEN)
-            fds[n++] = g_clients[i].fd;
+    for (int i = 0; i < g_nclients; i++) {
+        WsClient *c = g_clients[i];
+        pthread_mutex_lock(&c->out_mu);
+        if (!c->dead && out_stalled(c, t)) cut_off(c, "stalled");
+        pthread_mutex_unlock(&c->out_mu);
+    }
     pthread_mutex_unlock(&g_clients_mu);
-    /* fd may close between snapshot and send; ws_send uses MSG_NOSIGNAL
-     * so a dead fd produces EPIPE which writev silently drops. */
-    for (int i = 0; i < n; i++)
-        ws_send(fds[i], json);
+}
+
+void ws_broadcast(const char *json) {
+    WsFrame *f = ws_frame_text(json);
+    ws_broadcast_frame(f, 0);
+    ws_frame_unref(f);
+}
+
+void ws_broadcast_latest(const char *json, int key) {
+    WsFrame *f = ws_frame_text(json);
+    ws_broadcast_frame(f, key);
+    ws_frame_unref(f);
+}
+
+void ws_get_stats(WsStats *out) {
+    out->broadcasts = atomic_load_explicit(&g_st_broadcasts, memory_order_relaxed);
+    out->frames     = atomic_load_explicit(&g_st_frames,     memory_order_relaxed);
+    out->queued     = atomic_load_explicit(&g_st_queued,     memory_order_relaxed);
+    out->coalesced  = atomic_load_explicit(&g_st_coalesced,  memory_order_relaxed);
+    out->dropped    = atomic_load_explicit(&g_st_dropped,    memory_order_relaxed);
+    out->cut_off    = atomic_load_explicit(&g_st_cut_off,    memory_order_relaxed);
+    out->bytes      = atomic_load_explicit(&g_st_bytes,      memory_order_relaxed);
+    out->writes     = atomic_load_explicit(&g_st_writes,     memory_order_relaxed);
+    out->blocked    = atomic_load_explicit(&g_st_blocked,    memory_order_relaxed);
+    out->deflate_in  = atomic_load_explicit(&g_st_deflate_in,  memory_order_relaxed);
+    out->deflate_out = atomic_load_explicit(&g_st_deflate_out, memory_order_relaxed);
 }
 
 /* ── WebSocket frame receive ─────────────────────────────────────────────── */
 
-static void process_frames(WsClient *c) {
-    uint8_t *buf = (uint8_t *)c->rbuf;
-    int      len = c->rlen;
+/* A MessagePack message as JSON for the handler, in a buffer reused by
+ * the event loop. Returns NULL if it doesn't decode. */
+static const char *msgpack_to_json(const char *msg, size_t len) {
+    static Wire w;
+    wire_reset(&w, WIRE_JSON);
+    return wire_from_msgpack(&w, msg, len) == 0 ? w.buf : NULL;
+}
+
+/* Hand one complete text/binary message to the handler; msg[len] must be
+ * writable. Binary messages from a MessagePack client are decoded first.
+ * Returns -1 if the client was closed. */
+static int dispatch(WsClient *c, uint8_t op, char *msg, size_t len, int compressed) {
+    int   decode = op == 0x2 && c->fmt == WIRE_MSGPACK;
+    char *out    = NULL;
+    if (compressed) {
+        /* permessage-deflate: RSV1 is only legal once negotiated */
+        out = c->rx ? inflate_msg(c, (uint8_t *)msg, len, g_max_msg, &len) : NULL;
+        if (!out) {
+            fprintf(stderr, "ws: client %d: bad compressed frame\n", c->fd);
+            close_client(c);
+            return -1;
+        }
+        msg = out;
+    }
+    if (decode) {
+        const char *json = msgpack_to_json(msg, len);
+        if (!json) fprintf(stderr, "ws: client %d: bad MessagePack message\n", c->fd);
+        else if (g_handler) g_handler(c->fd, json);
+    } else if (out) {
+        if (g_handler) g_handler(c->fd, out);
+    } else {
+        /* Save, null-terminate, dispatch, restore */
+        char saved = msg[len];
+        msg[len] = '\0';
+        if (g_handler) g_handler(c->fd, msg);
+        msg[len] = saved;
+    }
+    free(out);
+    return 0;
+}
+
+/* Handle every complete frame in rbuf. Returns -1 if the client was
+ * closed (and freed). */
+static int process_frames(WsClient *c) {
+    uint8_t *buf  = (uint8_t *)c->rbuf;
+    size_t   len  = c->rlen;
+    size_t   need = 0;           /* rbuf size the next frame wants */
 
     while (len >= 2) {
-        /* uint8_t fin  = (buf[0] >> 7) & 1; */
+        int     fin    = (buf[0] >> 7) & 1;
         uint8_t opcode = buf[0] & 0x0f;
+        int     rsv1   = (buf[0] >> 6) & 1;
         int     masked = (buf[1] >> 7) & 1;
         uint64_t plen  = buf[1] & 0x7f;
         int      hlen  = 2;
@@ -170,13 +845,19 @@ static void process_frames(WsClient *c) {
         }
 
         if (masked) hlen += 4;
+        if (plen > g_max_msg) {
+            fprintf(stderr, "ws: client %d: %llu-byte message over the %zu limit\n",
+                    c->fd, (unsigned long long)plen, g_max_msg);
+            close_client(c);
+            return -1;
+        }
         uint64_t total = hlen + plen;
-        if ((uint64_t)len < total) break;
+        if ((uint64_t)len < total) { need = (size_t)total + 1; break; }
 
         if (opcode == 0x8) {
             /* Close frame */
             close_client(c);
-            return;
+            return -1;
         } else if (opcode == 0x9) {
             /* Ping frame — respond with Pong (opcode 0xA), same payload */
             uint64_t copy = plen < 125 ? plen : 125;
@@ -189,36 +870,79 @@ static void process_frames(WsClient *c) {
             } else {
                 memcpy(payload, buf + hlen, copy);
             }
-            uint8_t pong_hdr[2] = { 0x8A, (uint8_t)copy };
-            struct iovec iov[2] = {
-                { .iov_base = pong_hdr, .iov_len = 2 },
-                { .iov_base = payload,  .iov_len = (size_t)copy },
-            };
-            writev(c->fd, iov, copy > 0 ? 2 : 1);
-        } else if (opcode == 0x1 || opcode == 0x2) {
-            /* Text / binary frame — unmask in-place within rbuf, then dispatch.
-             * The rbuf is WS_RBUF_SIZE (128 KB), large enough for any single
-             * frame we accept.  We must NOT copy into a small stack buffer or
-             * large messages (e.g. playlist_import with 500 channels) get
-             * silently truncated and the JSON parse fails. */
+            pthread_mutex_lock(&c->out_mu);
+            send_frame(c, 0xA, payload, (size_t)copy);
+            pthread_mutex_unlock(&c->out_mu);
+        } else if (opcode <= 0x2) {
+            /* Text / binary / continuation frame — unmask in-place within
+             * rbuf. rbuf was grown to hold the whole frame plus a
+             * terminator, so a large unfragmented message (e.g.
+             * playlist_import with thousands of channels) is dispatched
+             * from there without copying. */
             if (masked) {
                 uint8_t mask[4];
                 memcpy(mask, buf + hlen - 4, 4);
                 for (uint64_t i = 0; i < plen; i++)
                     buf[hlen + i] ^= mask[i & 3];
             }
-            /* buf[total] == buf[hlen+plen] is within rbuf bounds (total <= len
-             * <= WS_RBUF_SIZE-1).  Save, null-terminate, dispatch, restore. */
-            uint8_t saved = buf[hlen + plen];
-            buf[hlen + plen] = '\0';
-            if (g_handler) g_handler((char *)(buf + hlen));
-            buf[hlen + plen] = saved;
+            if ((opcode == 0x0) != (c->frag_op != 0)) {
+                fprintf(stderr, "ws: client %d: unexpected %s frame\n", c->fd,
+                        opcode ? "data" : "continuation");
+                close_client(c);
+                return -1;
+            }
+            if (fin && opcode) {
+                if (dispatch(c, opcode, (char *)buf + hlen, (size_t)plen, rsv1) < 0) return -1;
+            } else {
+                /* Fragments are collected unmasked (and, if compressed,
+                 * inflated as one message) up to the same size limit */
+                if (c->frag_len + plen > g_max_msg) {
+                    fprintf(stderr, "ws: client %d: fragmented message over the %zu limit\n",
+                            c->fd, g_max_msg);
+                    close_client(c);
+                    return -1;
+                }
+                size_t need = c->frag_len + (size_t)plen + 1;
+                if (need > c->frag_cap) {
+                    /* Doubling keeps a message sent as many small fragments
+                     * linear; never past the limit (+ terminator) */
+                    size_t cap = c->frag_cap ? c->frag_cap * 2 : 4096;
+                    if (cap < need)          cap = need;
+                    if (cap > g_max_msg + 1) cap = g_max_msg + 1;
+                    char *f = realloc(c->frag, cap);
+                    if (!f) { close_client(c); return -1; }
+                    c->frag     = f;
+                    c->frag_cap = cap;
+                }
+                memcpy(c->frag + c->frag_len, buf + hlen, (size_t)plen);
+                c->frag_len += (size_t)plen;
+                if (opcode) { c->frag_op = opcode; c->frag_rsv1 = rsv1; }
+                if (fin) {
+                    int r = dispatch(c, c->frag_op, c->frag, c->frag_len, c->frag_rsv1);
+                    if (r < 0) return -1;
+                    free(c->frag);
+                    c->frag     = NULL;
+                    c->frag_len = 0;
+                    c->frag_cap = 0;
+                    c->frag_op  = 0;
+                }
+            }
         }
         /* Shift buffer */
         memmove(buf, buf + total, len - total);
-        len -= (int)total;
+        len -= (size_t)total;
     }
     c->rlen = len;
+
+    /* Make room for a partly received frame in one step, and give back
+     * what a large message needed once it's done */
+    if (need > c->rcap && rbuf_resize(c, need) < 0) {
+        fprintf(stderr, "ws: client %d: no memory for a %zu-byte frame\n", c->fd, need);
+        close_client(c);
+        return -1;
+    }
+    if (len == 0 && c->rcap > WS_RBUF_MIN) rbuf_resize(c, WS_RBUF_MIN);
+    return 0;
 }
 
 /* ── Public API ───────────────────────────────────────────────────────────── */
@@ -226,12 +950,6 @@ static void process_frames(WsClient *c) {
 int ws_init(uint16_t port, WsMsgHandler handler) {
     g_handler = handler;
 
-    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
-        g_clients[i].fd    = -1;
-        g_clients[i].state = CS_CLOSED;
-        g_clients[i].rlen  = 0;
-    }
-
     g_listen_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (g_listen_fd < 0) {
         /* Fallback to IPv4 */
@@ -271,6 +989,10 @@ int ws_init(uint16_t port, WsMsgHandler handler) {
 
 int ws_listen_fd(void) { return g_listen_fd; }
 
+void ws_set_poll_cb(WsPollCb cb) { g_poll_cb = cb; }
+
+void ws_set_max_message(size_t bytes) { g_max_msg = bytes; }
+
 int ws_accept(void) {
     struct sockaddr_storage addr;
     socklen_t addrlen = sizeof(addr);
@@ -286,12 +1008,31 @@ int ws_accept(void) {
     setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &keepintvl, sizeof(keepintvl));
     setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,   &keepcnt,   sizeof(keepcnt));
 
-    pthread_mutex_lock(&g_clients_mu);
-    WsClient *c = find_free();
-    if (!c) { pthread_mutex_unlock(&g_clients_mu); close(fd); return -1; }
+    WsClient *c = g_nclients < WS_MAX_CLIENTS ? calloc(1, sizeof(*c)) : NULL;
+    if (!c) {
+        fprintf(stderr, "ws: refusing client fd=%d (%d connected)\n", fd, g_nclients);
+        close(fd);
+        return -1;
+    }
     c->fd    = fd;
     c->state = CS_HANDSHAKE;
-    c->rlen  = 0;
+    pthread_mutex_init(&c->out_mu, NULL);
+
+    pthread_mutex_lock(&g_clients_mu);
+    if (g_nclients == g_clients_cap) {
+        int cap = g_clients_cap ? g_clients_cap * 2 : 4;
+        WsClient **t = realloc(g_clients, cap * sizeof(*t));
+        if (!t) {
+            pthread_mutex_unlock(&g_clients_mu);
+            pthread_mutex_destroy(&c->out_mu);
+            free(c);
+            close(fd);
+            return -1;
+        }
+        g_clients     = t;
+        g_clients_cap = cap;
+    }
+    g_clients[g_nclients++] = c;
     pthread_mutex_unlock(&g_clients_mu);
 
     fprintf(stderr, "ws: new client fd=%d\n", fd);
@@ -301,34 +1042,57 @@ int ws_accept(void) {
 int ws_client_read(int fd) {
     WsClient *c = find_client(fd);
     if (!c) return -1;
+    if (c->dead) { close_client(c); return -1; }
 
-    int space = (int)sizeof(c->rbuf) - c->rlen - 1;
-    if (space <= 0) { close_client(c); return -1; }
+    if (c->rlen + 1 >= c->rcap) {
+        /* Full, and no frame header has said how much more is coming (or
+         * still in the HTTP request): double, within the limits */
+        size_t limit = c->state == CS_HANDSHAKE ? WS_HANDSHAKE_MAX : g_max_msg + 15;
+        size_t cap   = c->rcap ? c->rcap * 2 : WS_RBUF_MIN;
+        if (cap > limit) cap = limit;
+        if (cap <= c->rlen + 1 || rbuf_resize(c, cap) < 0) { close_client(c); return -1; }
+    }
 
-    ssize_t n = recv(fd, c->rbuf + c->rlen, space, 0);
+    ssize_t n = recv(fd, c->rbuf + c->rlen, c->rcap - c->rlen - 1, 0);
     if (n <= 0) { close_client(c); return -1; }
-    c->rlen += n;
+    c->rlen += (size_t)n;
     c->rbuf[c->rlen] = '\0';
 
     if (c->state == CS_HANDSHAKE) {
         /* Look for end of HTTP headers */
         if (strstr(c->rbuf, "\r\n\r\n")) do_handshake(c);
     } else if (c->state == CS_OPEN) {
-        process_frames(c);
-        if (c->state == CS_CLOSED) return -1;
+        if (process_frames(c) < 0) return -1;
+    }
+    return 0;
+}
+
+int ws_client_write(int fd) {
+    WsClient *c = find_client(fd);
+    if (!c) return -1;
+    pthread_mutex_lock(&c->out_mu);
+    int r = c->dead ? -1 : out_flush(c);
+    if (r == 0 && c->want_out) {
+        c->want_out = 0;
+        if (g_poll_cb) g_poll_cb(fd, 0);
     }
+    pthread_mutex_unlock(&c->out_mu);
+    if (r < 0) { close_client(c); return -1; }
     return 0;
 }
 
 int ws_client_fds(int *out, int max) {
     int n = 0;
-    for (int i = 0; i < WS_MAX_CLIENTS && n < max; i++)
-        if (g_clients[i].fd >= 0) out[n++] = g_clients[i].fd;
+    pthread_mutex_lock(&g_clients_mu);
+    for (int i = 0; i < g_nclients && n < max; i++) out[n++] = g_clients[i]->fd;
+    pthread_mutex_unlock(&g_clients_mu);
     return n;
 }
 
 void ws_destroy(void) {
-    for (int i = 0; i < WS_MAX_CLIENTS; i++)
-        close_client(&g_clients[i]);
+    while (g_nclients > 0) close_client(g_clients[g_nclients - 1]);
+    free(g_clients);
+    g_clients     = NULL;
+    g_clients_cap = 0;
     if (g_listen_fd >= 0) { close(g_listen_fd); g_listen_fd = -1; }
 }
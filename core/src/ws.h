@@ -1,13 +1,27 @@
 #pragma once
 #include <stddef.h>
 #include <stdint.h>
+#include "wire.h"
 
-/* Maximum simultaneous WebSocket clients */
-#define WS_MAX_CLIENTS 8
+/* Maximum simultaneous WebSocket clients. Clients are allocated as they
+   connect, so this only bounds the worst case. */
+#define WS_MAX_CLIENTS 64
 
-/* Called for each text frame received from any client.
+/* Default limit on one incoming message (ws_set_max_message()). */
+#define WS_DEFAULT_MAX_MESSAGE (16 * 1024 * 1024)
+
+/* Called for each text message received from any client (fragments are
+   reassembled, compressed messages inflated, MessagePack decoded to JSON),
+   on the event loop thread.
+   client: the sender's fd, for replies with ws_send() during the call.
    json: null-terminated UTF-8 payload. */
-typedef void (*WsMsgHandler)(const char *json);
+typedef void (*WsMsgHandler)(int client, const char *json);
+
+/* Called from any thread when a client's outbound queue can't be written
+   right away (want_write = 1) and again once it has drained (0). The event
+   loop should add or remove EPOLLOUT on fd and call ws_client_write() when
+   it fires. */
+typedef void (*WsPollCb)(int fd, int want_write);
 
 /* Initialise TCP listen socket on port. Returns 0 on success. */
 int  ws_init(uint16_t port, WsMsgHandler handler);
@@ -15,6 +29,12 @@ int  ws_init(uint16_t port, WsMsgHandler handler);
 /* Return listen fd — add to epoll with EPOLLIN. */
 int  ws_listen_fd(void);
 
+void ws_set_poll_cb(WsPollCb cb);
+
+/* Largest message accepted from a client, in bytes; a client sending more
+   is disconnected. Receive buffers grow to fit and shrink back when idle. */
+void ws_set_max_message(size_t bytes);
+
 /* Accept a new client (call when listen fd is readable).
    Returns the new client fd (already added to client set), or -1. */
 int  ws_accept(void);
@@ -23,12 +43,75 @@ int  ws_accept(void);
    Returns -1 if the client disconnected (fd is closed + removed). */
 int  ws_client_read(int fd);
 
+/* Write queued frames to a client fd (call when it's writable).
+   Returns -1 if the client was dropped (fd is closed + removed). */
+int  ws_client_write(int fd);
+
+/* Sending never blocks: frames go to a bounded per-client queue and out as
+   fast as each client reads. A client that stops reading is disconnected
+   rather than allowed to hold anyone else up. */
+
 /* Send a text frame to all connected clients. */
 void ws_broadcast(const char *json);
 
+/* Same, for state that only matters in its latest version (key: nonzero,
+   chosen by the caller). A queued frame with the same key that hasn't
+   started going out is replaced, as long as no unkeyed frame is queued
+   behind it (order against those is kept), and a client that is falling
+   behind gets none until it catches up. */
+void ws_broadcast_latest(const char *json, int key);
+
 /* Send a text frame to one specific client fd. */
 void ws_send(int fd, const char *json);
 
+/* Clients may ask for the "qaryx.msgpack" subprotocol (or "qaryx.json",
+   the default). A MessagePack client gets every message as a binary frame:
+   JSON sent through the calls here is transcoded once per frame, and
+   producers on a hot path can skip that by encoding for it directly. */
+WireFormat ws_client_format(int fd);
+
+/* Send w (a complete message) to one client, as a text or binary frame
+   according to w->fmt. */
+void ws_send_wire(int fd, const Wire *w);
+
+/* A text frame built once (header + payload) and shared, without copying,
+   by every client queue it goes on. Use it to fan one message out to all
+   clients, or to keep a frame around and send it again. */
+typedef struct WsFrame WsFrame;
+
+WsFrame *ws_frame_text(const char *json);
+/* One message encoded both ways (msgpack may be NULL), each client getting
+   its own format. */
+WsFrame *ws_frame_wire(const Wire *json, const Wire *msgpack);
+WsFrame *ws_frame_ref(WsFrame *f);
+void     ws_frame_unref(WsFrame *f);
+
+/* Queue f on every open client; key as for ws_broadcast_latest(), or 0.
+   The caller keeps its reference. */
+void ws_broadcast_frame(WsFrame *f, int key);
+
+/* Disconnect clients whose queued frames have not moved for a while. The
+   check also runs on every push, but a client that stopped reading on an
+   idle box gets none; call this from a periodic timer on the event loop. */
+void ws_tick(void);
+
+/* Cumulative counters since start. */
+typedef struct {
+    uint64_t broadcasts;  /* ws_broadcast*() calls */
+    uint64_t frames;      /* frames built */
+    uint64_t queued;      /* frames put on client queues */
+    uint64_t coalesced;   /* keyed frames that replaced a queued one */
+    uint64_t dropped;     /* keyed frames skipped for a lagging client */
+    uint64_t cut_off;     /* clients disconnected for not reading */
+    uint64_t bytes;       /* bytes written to sockets */
+    uint64_t writes;      /* writev() calls */
+    uint64_t blocked;     /* ... that found the socket full */
+    uint64_t deflate_in;  /* payload bytes compressed (permessage-deflate) */
+    uint64_t deflate_out; /* ... and what they compressed to */
+} WsStats;
+
+void ws_get_stats(WsStats *out);
+
 /* Close all clients + listen socket. */
 void ws_destroy(void);
 
@@ -0,0 +1,300 @@
+#include "xmltv.h"
+#include <string.h>
+#include <stdlib.h>
+
+/* ── Text helpers ─────────────────────────────────────────────────────────── */
+
+static int is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+static size_t put_utf8(char *dst, unsigned long cp) {
+    if (cp < 0x80)    { dst[0] = (char)cp; return 1; }
+    if (cp < 0x800)   { dst[0] = (char)(0xC0 | cp >> 6);
+                        dst[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) { dst[0] = (char)(0xE0 | cp >> 12);
+                        dst[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+                        dst[2] = (char)(0x80 | (cp & 0x3F)); return 3; }
+    if (cp < 0x110000){ dst[0] = (char)(0xF0 | cp >> 18);
+                        dst[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+                        dst[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+                        dst[3] = (char)(0x80 | (cp & 0x3F)); return 4; }
+    return 0;
+}
+
+/* Decode entities of src[0..len) into dst (cap bytes incl. NUL), trimming
+ * surrounding whitespace. A sequence cut by the cap is dropped whole so the
+ * result stays valid UTF-8. */
+static void decode(char *dst, size_t cap, const char *src, size_t len) {
+    while (len > 0 && is_space(*src))          { src++; len--; }
+    while (len > 0 && is_space(src[len - 1]))  len--;
+
+    size_t o = 0;
+    for (size_t i = 0; i < len && o + 5 < cap; ) {
+        if (src[i] != '&') { dst[o++] = src[i++]; continue; }
+        const char *semi = memchr(src + i, ';', len - i < 12 ? len - i : 12);
+        if (!semi) { dst[o++] = src[i++]; continue; }
+        const char *e  = src + i + 1;
+        size_t      el = (size_t)(semi - e);
+        char        c  = 0;
+        if      (el == 3 && !memcmp(e, "amp",  3)) c = '&';
+        else if (el == 2 && !memcmp(e, "lt",   2)) c = '<';
+        else if (el == 2 && !memcmp(e, "gt",   2)) c = '>';
+        else if (el == 4 && !memcmp(e, "quot", 4)) c = '"';
+        else if (el == 4 && !memcmp(e, "apos", 4)) c = '\'';
+        if (c) {
+            dst[o++] = c;
+        } else if (el > 1 && e[0] == '#') {
+            unsigned long cp = (e[1] == 'x' || e[1] == 'X') ? strtoul(e + 2, NULL, 16)
+                                                            : strtoul(e + 1, NULL, 10);
+            o += put_utf8(dst + o, cp);
+        } else {
+            dst[o++] = '&';                    /* unknown entity: keep as text */
+            i++;
+            continue;
+        }
+        i = (size_t)(semi - src) + 1;
+    }
+    /* Don't end on half a multi-byte character */
+    size_t k = o;
+    while (k > 0 && ((unsigned char)dst[k - 1] & 0xC0) == 0x80) k--;
+    if (k > 0 && (unsigned char)dst[k - 1] >= 0xC0) {
+        unsigned char lead = (unsigned char)dst[k - 1];
+        size_t want = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        if (o - (k - 1) < want) o = k - 1;
+    }
+    dst[o] = '\0';
+}
+
+/* Find attribute key in a start tag's attribute text and decode its value
+ * into out. Returns 1 if present. */
+static int attr(const char *a, const char *key, char *out, size_t cap) {
+    size_t klen = strlen(key);
+    while (*a) {
+        while (is_space(*a)) a++;
+        const char *k = a;
+        while (*a && *a != '=' && !is_space(*a)) a++;
+        size_t kl = (size_t)(a - k);
+        while (is_space(*a)) a++;
+        if (*a != '=') { if (*a) a++; continue; }
+        a++;
+        while (is_space(*a)) a++;
+        char q = *a;
+        if (q != '"' && q != '\'') return 0;
+        const char *v   = ++a;
+        const char *end = strchr(v, q);
+        if (!end) return 0;
+        if (kl == klen && !memcmp(k, key, klen)) {
+            decode(out, cap, v, (size_t)(end - v));
+            return 1;
+        }
+        a = end + 1;
+    }
+    return 0;
+}
+
+/* ── Times ────────────────────────────────────────────────────────────────── */
+
+/* Days since 1970-01-01 of a proleptic Gregorian date. */
+static int64_t days_from_civil(int64_t y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int digits(const char *s, int n) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return -1;
+        v = v * 10 + (s[i] - '0');
+    }
+    return v;
+}
+
+int64_t xmltv_time(const char *s) {
+    int y  = digits(s, 4),      mo = digits(s + 4, 2), d = digits(s + 6, 2);
+    int h  = digits(s + 8, 2),  mi = digits(s + 10, 2);
+    if (y < 0 || mo < 1 || mo > 12 || d < 1 || d > 31 || h < 0 || mi < 0) return 0;
+    int sec = digits(s + 12, 2);
+    const char *z = s + (sec < 0 ? 12 : 14);
+    if (sec < 0) sec = 0;
+
+    int64_t t = days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec;
+    while (*z == ' ') z++;
+    if (*z == '+' || *z == '-') {
+        int zh = digits(z + 1, 2), zm = digits(z + 3, 2);
+        if (zh >= 0 && zm >= 0) {
+            int off = zh * 3600 + zm * 60;
+            t += *z == '+' ? -off : off;
+        }
+    }
+    return t;
+}
+
+/* ── Elements ─────────────────────────────────────────────────────────────── */
+
+static void start_element(XmltvParser *p, const char *name, const char *attrs, int empty) {
+    if (!strcmp(name, "programme")) {
+        char buf[32];
+        p->in_programme = 1;
+        p->channel[0] = p->title[0] = p->desc[0] = '\0';
+        attr(attrs, "channel", p->channel, sizeof(p->channel));
+        p->start = attr(attrs, "start", buf, sizeof(buf)) ? xmltv_time(buf) : 0;
+        p->stop  = attr(attrs, "stop",  buf, sizeof(buf)) ? xmltv_time(buf) : 0;
+        if (empty) p->in_programme = 0;
+    } else if (!strcmp(name, "channel")) {
+        p->in_channel = !empty;
+        p->named      = 0;
+        p->channel[0] = '\0';
+        attr(attrs, "id", p->channel, sizeof(p->channel));
+    } else if (empty) {
+        return;
+    } else if (p->in_programme && !strcmp(name, "title") && !p->title[0]) {
+        p->field = XT_TITLE;                 /* first title wins (usually the main language) */
+    } else if (p->in_programme && !strcmp(name, "desc") && !p->desc[0]) {
+        p->field = XT_DESC;
+    } else if (p->in_channel && !strcmp(name, "display-name")) {
+        p->field = XT_NAME;
+    } else {
+        return;
+    }
+    p->text_len = 0;
+}
+
+static void end_element(XmltvParser *p, const char *name) {
+    if (p->field != XT_NONE) {
+        if (p->field == XT_TITLE && !strcmp(name, "title")) {
+            decode(p->title, sizeof(p->title), p->text, p->text_len);
+        } else if (p->field == XT_DESC && !strcmp(name, "desc")) {
+            decode(p->desc, sizeof(p->desc), p->text, p->text_len);
+        } else if (p->field == XT_NAME && !strcmp(name, "display-name")) {
+            char dn[XMLTV_MAX_TEXT];
+            decode(dn, sizeof(dn), p->text, p->text_len);
+            if (p->channel[0] && dn[0] && p->on_channel) {
+                p->on_channel(p->channel, dn, p->userdata);
+                p->named = 1;
+            }
+        } else {
+            return;                          /* a nested element closed */
+        }
+        p->field = XT_NONE;
+        return;
+    }
+
+    if (!strcmp(name, "programme") && p->in_programme) {
+        p->in_programme = 0;
+        if (!p->channel[0] || !p->start) return;
+        XmltvProgramme pr = { p->channel, p->start, p->stop, p->title, p->desc };
+        p->programmes++;
+        if (p->on_programme) p->on_programme(&pr, p->userdata);
+    } else if (!strcmp(name, "channel") && p->in_channel) {
+        p->in_channel = 0;
+        if (!p->channel[0]) return;
+        p->channels++;
+        if (!p->named && p->on_channel) p->on_channel(p->channel, "", p->userdata);
+    }
+}
+
+static void handle_tag(XmltvParser *p) {
+    char  *t   = p->tag;
+    size_t len = p->tag_len;
+    if (p->tag_overflow || len == 0 || t[0] == '?' || t[0] == '!') return;
+    t[len] = '\0';
+
+    if (t[0] == '/') {
+        char *n = t + 1;
+        size_t nl = strcspn(n, " \t\r\n");
+        n[nl] = '\0';
+        end_element(p, n);
+        return;
+    }
+    int empty = t[len - 1] == '/';
+    if (empty) t[--len] = '\0';
+    size_t nl = strcspn(t, " \t\r\n");
+    char *attrs = t + nl;
+    if (*attrs) *attrs++ = '\0';
+    start_element(p, t, attrs, empty);
+    if (empty) end_element(p, t);
+}
+
+static void add_text(XmltvParser *p, const char *s, size_t n) {
+    if (p->field == XT_NONE) return;
+    size_t room = sizeof(p->text) - p->text_len;
+    if (n > room) n = room;
+    memcpy(p->text + p->text_len, s, n);
+    p->text_len += n;
+}
+
+/* ── Public API ───────────────────────────────────────────────────────────── */
+
+void xmltv_init(XmltvParser *p, XmltvChannelCb on_channel,
+                XmltvProgrammeCb on_programme, void *userdata) {
+    memset(p, 0, sizeof(*p));
+    p->on_channel   = on_channel;
+    p->on_programme = on_programme;
+    p->userdata     = userdata;
+}
+
+void xmltv_feed(XmltvParser *p, const char *data, size_t len) {
+    const char *end = data + len;
+    while (data < end) {
+        switch (p->mode) {
+        case XT_TEXT: {
+            /* Runs of text are copied (or skipped) in one go */
+            const char *lt = memchr(data, '<', (size_t)(end - data));
+            add_text(p, data, (size_t)((lt ? lt : end) - data));
+            if (!lt) return;
+            data = lt + 1;
+            p->mode = XT_TAG;
+            p->tag_len = 0;
+            p->tag_overflow = 0;
+            p->quote = 0;
+            break;
+        }
+        case XT_TAG: {
+            char c = *data++;
+            if (p->quote) {
+                if (c == p->quote) p->quote = 0;
+            } else if (c == '"' || c == '\'') {
+                p->quote = c;
+            } else if (c == '>') {
+                handle_tag(p);
+                p->mode = XT_TEXT;
+                break;
+            }
+            if (p->tag_len < sizeof(p->tag) - 1) p->tag[p->tag_len++] = c;
+            else                                 p->tag_overflow = 1;
+            if (p->tag_len == 3 && !memcmp(p->tag, "!--", 3)) {
+                p->mode = XT_COMMENT;
+                p->tail = 0;
+            } else if (p->tag_len == 8 && !memcmp(p->tag, "![CDATA[", 8)) {
+                p->mode = XT_CDATA;
+                p->tail = 0;
+            }
+            break;
+        }
+        case XT_COMMENT: {
+            char c = *data++;
+            if (c == '-')                       p->tail = p->tail < 2 ? p->tail + 1 : 2;
+            else if (c == '>' && p->tail == 2)  p->mode = XT_TEXT;
+            else                                p->tail = 0;
+            break;
+        }
+        case XT_CDATA: {
+            char c = *data++;
+            if (c == ']') {
+                if (p->tail == 2) add_text(p, "]", 1);
+                else              p->tail++;
+            } else if (c == '>' && p->tail == 2) {
+                p->mode = XT_TEXT;
+            } else {
+                add_text(p, "]]", (size_t)p->tail);
+                p->tail = 0;
+                add_text(p, &c, 1);
+            }
+            break;
+        }
+        }
+    }
+}
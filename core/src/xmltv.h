@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Incremental XMLTV parser.
+ *
+ * Fed with arbitrary chunks of the (already decompressed) guide, it reports
+ * each <channel> display name and each <programme> as soon as its closing
+ * tag arrives. Only the current tag and the text of the element being
+ * collected are buffered, so memory stays fixed however large the guide.
+ *
+ * Understands the subset of XML that XMLTV uses: elements, attributes,
+ * the five named entities plus numeric ones, comments, CDATA, and the
+ * <?xml?> / <!DOCTYPE> prologue. Anything else is skipped, not rejected. */
+
+#define XMLTV_MAX_TAG   4096   /* longest start tag kept; longer tags are ignored */
+#define XMLTV_MAX_TEXT  1024   /* title / desc / display-name text kept, in bytes */
+
+typedef struct {
+    const char *channel;    /* XMLTV channel id */
+    int64_t     start;      /* UTC seconds */
+    int64_t     stop;       /* UTC seconds, 0 if the guide gives none */
+    const char *title;
+    const char *desc;
+} XmltvProgramme;
+
+/* Called for every <display-name> of a <channel>, and once with name ""
+   for a channel that has none. Strings are only valid during the call. */
+typedef void (*XmltvChannelCb)(const char *id, const char *name, void *userdata);
+typedef void (*XmltvProgrammeCb)(const XmltvProgramme *p, void *userdata);
+
+typedef enum { XT_TEXT, XT_TAG, XT_COMMENT, XT_CDATA } XmltvMode;
+typedef enum { XT_NONE, XT_TITLE, XT_DESC, XT_NAME } XmltvField;
+
+typedef struct {
+    XmltvChannelCb   on_channel;
+    XmltvProgrammeCb on_programme;
+    void            *userdata;
+
+    XmltvMode  mode;
+    char       tag[XMLTV_MAX_TAG];
+    size_t     tag_len;
+    int        tag_overflow;
+    char       quote;         /* inside an attribute value in a tag */
+    int        tail;          /* matched chars of "-->" / "]]>" */
+
+    XmltvField field;         /* element whose text is being collected */
+    char       text[XMLTV_MAX_TEXT];
+    size_t     text_len;
+
+    /* Enclosing <channel> or <programme> */
+    int        in_channel, in_programme, named;
+    char       channel[256];
+    int64_t    start, stop;
+    char       title[XMLTV_MAX_TEXT];
+    char       desc[XMLTV_MAX_TEXT];
+
+    long       channels, programmes;
+} XmltvParser;
+
+void xmltv_init(XmltvParser *p, XmltvChannelCb on_channel,
+                XmltvProgrammeCb on_programme, void *userdata);
+
+/* Consume len bytes. May invoke the callbacks any number of times. */
+void xmltv_feed(XmltvParser *p, const char *data, size_t len);
+
+/* Parse an XMLTV time ("20240131203000 +0300"; seconds, zone optional).
+   Returns UTC seconds, or 0 if the string is not a time. */
+int64_t xmltv_time(const char *s);
@@ -1,5 +1,5 @@
 #include "ytdlp.h"
-#include "../third_party/cjson.h"
+#include "jpull.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -270,6 +270,39 @@ int *ytdlp_pending_fds(int *n_out) {
 
 /* ── Synchronous channel video fetch ─────────────────────────────────────── */
 
+/* One --dump-json line into v. Every other member, nested ones included,
+ * is skipped unparsed. Returns 0, or -1 if the line is malformed. */
+static int read_video(JPull *j, const char *line, YoutubeVideo *v) {
+    static const char *const thumb_keys[] = { "url" };
+    memset(v, 0, sizeof(*v));
+    jp_init(j, line);
+    if (jp_next(j) != JP_OBJ) return -1;
+
+    JpTok t;
+    while ((t = jp_next(j)) != JP_CLOSE) {
+        if (t == JP_ERROR) return -1;
+        const char *k = j->key;
+        if (t == JP_STR) {
+            if      (!strcmp(k, "id"))      strncpy(v->id,           j->str, sizeof(v->id)-1);
+            else if (!strcmp(k, "title"))   strncpy(v->title,        j->str, sizeof(v->title)-1);
+            else if (!strcmp(k, "channel")) strncpy(v->channel_name, j->str, sizeof(v->channel_name)-1);
+        } else if (t == JP_NUM && !strcmp(k, "duration")) {
+            v->duration = (int)j->num;
+        } else if (t == JP_ARR && !strcmp(k, "thumbnails")) {
+            /* Thumbnail: last item in thumbnails array */
+            JpVal u;
+            int   r;
+            while ((r = jp_fields(j, thumb_keys, 1, &u)) > 0)
+                snprintf(v->thumbnail, sizeof(v->thumbnail), "%s", jp_vstr(&u, ""));
+            if (r < 0) return -1;
+        } else if ((t == JP_OBJ || t == JP_ARR) && jp_skip(j) < 0) {
+            return -1;
+        }
+    }
+    snprintf(v->url, sizeof(v->url), "https://www.youtube.com/watch?v=%s", v->id);
+    return 0;
+}
+
 int ytdlp_get_channel_videos(const char *channel_url, int max, YoutubeVideo *out) {
     char max_str[16];
     snprintf(max_str, sizeof(max_str), "%d", max);
@@ -304,38 +337,17 @@ int ytdlp_get_channel_videos(const char *channel_url, int max, YoutubeVideo *out
     close(pipefd[0]);
     waitpid(pid, NULL, 0);
 
-    int count = 0;
-    char *line = buf;
+    int   count = 0;
+    char *line  = buf;
+    JPull j     = {0};
     while (count < max && line && *line) {
         char *nl = strchr(line, '\n');
         if (nl) *nl = '\0';
 
-        if (*line == '{') {
-            cJSON *j = cJSON_Parse(line);
-            if (j) {
-                YoutubeVideo *v = &out[count];
-                memset(v, 0, sizeof(*v));
-                strncpy(v->id,           cJSON_GetString(j,"id",""),       sizeof(v->id)-1);
-                strncpy(v->title,        cJSON_GetString(j,"title",""),    sizeof(v->title)-1);
-                strncpy(v->channel_name, cJSON_GetString(j,"channel",""),  sizeof(v->channel_name)-1);
-                v->duration = (int)cJSON_GetNumber(j,"duration",0);
-
-                snprintf(v->url, sizeof(v->url),
-                         "https://www.youtube.com/watch?v=%s", v->id);
-
-                /* Thumbnail: last item in thumbnails array */
-                cJSON *thumbs = cJSON_GetObjectItem(j, "thumbnails");
-                if (thumbs && cJSON_GetArraySize(thumbs) > 0) {
-                    cJSON *last = cJSON_GetArrayItem(thumbs, cJSON_GetArraySize(thumbs)-1);
-                    strncpy(v->thumbnail, cJSON_GetString(last,"url",""), sizeof(v->thumbnail)-1);
-                }
-
-                cJSON_Delete(j);
-                count++;
-            }
-        }
+        if (*line == '{' && read_video(&j, line, &out[count]) == 0) count++;
         line = nl ? nl+1 : NULL;
     }
+    jp_free(&j);
 
     free(buf);
     return count;
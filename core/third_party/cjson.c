@@ -2,15 +2,100 @@
    Subset sufficient for Qaryx: parse responses from yt-dlp/history,
    generate status/history JSON for Android. */
 #include "cjson.h"
+#include "cjson_scan.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <math.h>
 
+/* ── Arena ────────────────────────────────────────────────────────────────── */
+
+/* Parsed trees are bump-allocated from a chain of blocks, newest first.
+ * The first block of a document is sized from its length (nodes plus
+ * strings come to about twice the text for typical JSON); later blocks
+ * double, up to ARENA_BLOCK_MAX. */
+#define ARENA_BLOCK_MIN  512
+#define ARENA_BLOCK_MAX  (1024 * 1024)
+#define ARENA_KEEP       (64 * 1024)    /* block kept across cJSON_ArenaReset() */
+
+enum { HEAP = 0, IN_ARENA = 1, ARENA_ROOT = 2 };
+
+typedef struct Block {
+    struct Block *next;
+    size_t        cap, used;
+} Block;
+
+#define BLOCK_HDR ((sizeof(Block) + 15) & ~(size_t)15)
+
+struct cJSON_Arena {
+    Block  *head;
+    size_t  next_cap;
+    int     hosted;           /* this struct lives in its own oldest block */
+};
+
+/* The root of a cJSON_Parse() tree, which owns its arena. */
+typedef struct {
+    cJSON        item;
+    cJSON_Arena *arena;
+} ArenaRoot;
+
+static void *arena_alloc(cJSON_Arena *a, size_t n, size_t align) {
+    Block *b = a->head;
+    if (b) {
+        size_t off = (b->used + align - 1) & ~(align - 1);
+        if (off + n <= b->cap) {
+            b->used = off + n;
+            return (char *)b + BLOCK_HDR + off;
+        }
+    }
+    size_t cap = a->next_cap < n ? n : a->next_cap;
+    b = malloc(BLOCK_HDR + cap);
+    if (!b) return NULL;
+    b->next = a->head;
+    b->cap  = cap;
+    b->used = n;
+    a->head = b;
+    a->next_cap = cap * 2 < ARENA_BLOCK_MAX ? cap * 2 : ARENA_BLOCK_MAX;
+    return (char *)b + BLOCK_HDR;
+}
+
+/* Free blocks from the head on; keep (if not NULL) survives. */
+static void free_blocks(Block *b, Block *keep) {
+    while (b) {
+        Block *next = b->next;
+        if (b != keep) free(b);
+        b = next;
+    }
+}
+
+cJSON_Arena *cJSON_ArenaNew(void) {
+    cJSON_Arena *a = calloc(1, sizeof(*a));
+    if (a) a->next_cap = 4096;
+    return a;
+}
+
+void cJSON_ArenaReset(cJSON_Arena *a) {
+    if (!a) return;
+    Block *keep = a->head && a->head->cap <= ARENA_KEEP ? a->head : NULL;
+    free_blocks(a->head, keep);
+    a->head = keep;
+    if (keep) { keep->next = NULL; keep->used = 0; }
+    a->next_cap = 4096;
+}
+
+void cJSON_ArenaFree(cJSON_Arena *a) {
+    if (!a) return;
+    if (a->hosted) { free_blocks(a->head, NULL); return; }
+    free_blocks(a->head, NULL);
+    free(a);
+}
+
 /* ── Allocator ────────────────────────────────────────────────────────────── */
-static cJSON *new_item(void) {
-    cJSON *n = calloc(1, sizeof(cJSON));
+static cJSON *new_item(cJSON_Arena *a) {
+    if (!a) return calloc(1, sizeof(cJSON));
+    cJSON *n = arena_alloc(a, sizeof(cJSON), _Alignof(cJSON));
+    if (n) { memset(n, 0, sizeof(*n)); n->arena = IN_ARENA; }
     return n;
 }
 
@@ -19,103 +104,129 @@ static void suffix_object(cJSON *prev, cJSON *item) {
 }
 
 void cJSON_Delete(cJSON *c) {
+    if (c && c->arena == ARENA_ROOT) {
+        cJSON_ArenaFree(((ArenaRoot *)c)->arena);
+        return;
+    }
     cJSON *next;
     while (c) {
         next = c->next;
-        if (c->child) cJSON_Delete(c->child);
-        free(c->valuestring);
-        free(c->string);
-        free(c);
+        if (c->arena == HEAP) {
+            if (c->child) cJSON_Delete(c->child);
+            free(c->valuestring);
+            free(c->string);
+            free(c);
+        }
         c = next;
     }
 }
 
 /* ── Parser ───────────────────────────────────────────────────────────────── */
+/* Compact JSON mostly has nothing to skip; the vector scan is for indented
+ * documents. */
 static const char *skip_ws(const char *s) {
-    while (s && *s && (unsigned char)*s <= ' ') s++;
-    return s;
+    if (!s || !*s || (unsigned char)*s > ' ') return s;
+    return cjson_skip_ws(s + 1);
 }
 
-static const char *parse_string_raw(const char *s, char **out) {
+/* Strings without escapes (nearly all of them) are scanned once and copied
+ * whole. With escapes the closing quote is found first, so the copy can be
+ * sized (decoding never lengthens a string), then the runs between escapes
+ * are copied. */
+static const char *parse_string_raw(cJSON_Arena *a, const char *s, char **out) {
     if (*s != '"') return NULL;
-    s++;
-    const char *b = s;
-    size_t len = 0;
-    while (*s && *s != '"') { if (*s == '\\') s++; s++; len++; }
-    char *p = malloc(len + 1), *w = p;
-    s = b;
-    while (*s && *s != '"') {
-        if (*s == '\\') {
-            s++;
-            switch (*s) {
-                case '"': *w++='"'; break;
-                case '\\': *w++='\\'; break;
-                case '/': *w++='/'; break;
-                case 'n': *w++='\n'; break;
-                case 'r': *w++='\r'; break;
-                case 't': *w++='\t'; break;
-                default: *w++=*s; break;
-            }
-        } else { *w++=*s; }
-        s++;
+    const char *b = s + 1;
+    const char *e = cjson_scan_str(b);
+    if (*e == '"') {
+        size_t len = (size_t)(e - b);
+        char  *p   = arena_alloc(a, len + 1, 1);
+        if (!p) return NULL;
+        memcpy(p, b, len);
+        p[len] = '\0';
+        *out = p;
+        return e + 1;
+    }
+
+    const char *end = e;
+    while (*end == '\\') {
+        if (!end[1]) return NULL;
+        end = cjson_scan_str(end + 2);
+    }
+    if (*end != '"') return NULL;
+    char *p = arena_alloc(a, (size_t)(end - b) + 1, 1), *w = p;
+    if (!p) return NULL;
+    for (s = b;; s = e + 2, e = cjson_scan_str(s)) {
+        memcpy(w, s, (size_t)(e - s));
+        w += e - s;
+        if (e == end) break;
+        switch (e[1]) {
+            case 'n': *w++='\n'; break;
+            case 'r': *w++='\r'; break;
+            case 't': *w++='\t'; break;
+            default:  *w++=e[1]; break;      /* '"', '\\', '/' and the rest as is */
+        }
     }
     *w = '\0';
     *out = p;
-    return (*s == '"') ? s+1 : NULL;
+    return end + 1;
 }
 
-static const char *parse_value(cJSON *item, const char *s);
+static const char *parse_value(cJSON_Arena *a, cJSON *item, const char *s);
 
-static const char *parse_array(cJSON *item, const char *s) {
+static const char *parse_array(cJSON_Arena *a, cJSON *item, const char *s) {
     item->type = CJSON_ARRAY;
     s = skip_ws(s);
     if (*s == ']') return s+1;
-    cJSON *child = new_item();
+    cJSON *child = new_item(a);
+    if (!child) return NULL;
     item->child = child;
-    s = parse_value(child, s);
+    s = parse_value(a, child, s);
     while (s && (s=skip_ws(s)) && *s == ',') {
-        cJSON *n = new_item();
+        cJSON *n = new_item(a);
+        if (!n) return NULL;
         suffix_object(child, n);
         child = n;
-        s = parse_value(child, skip_ws(s+1));
+        s = parse_value(a, child, skip_ws(s+1));
     }
     return (s && *s==']') ? s+1 : NULL;
 }
 
-static const char *parse_object(cJSON *item, const char *s) {
+static const char *parse_object(cJSON_Arena *a, cJSON *item, const char *s) {
     item->type = CJSON_OBJECT;
     s = skip_ws(s);
     if (*s == '}') return s+1;
-    cJSON *child = new_item();
+    cJSON *child = new_item(a);
+    if (!child) return NULL;
     item->child = child;
-    s = parse_string_raw(s, &child->string);
+    s = parse_string_raw(a, s, &child->string);
     if (!s) return NULL;
     s = skip_ws(s);
     if (*s != ':') return NULL;
-    s = parse_value(child, skip_ws(s+1));
+    s = parse_value(a, child, skip_ws(s+1));
     while (s && (s=skip_ws(s)) && *s == ',') {
-        cJSON *n = new_item();
+        cJSON *n = new_item(a);
+        if (!n) return NULL;
         suffix_object(child, n);
         child = n;
         s = skip_ws(s+1);
-        s = parse_string_raw(s, &child->string);
+        s = parse_string_raw(a, s, &child->string);
         if (!s) return NULL;
         s = skip_ws(s);
         if (*s != ':') return NULL;
-        s = parse_value(child, skip_ws(s+1));
+        s = parse_value(a, child, skip_ws(s+1));
     }
     return (s && *s=='}') ? s+1 : NULL;
 }
 
-static const char *parse_value(cJSON *item, const char *s) {
+static const char *parse_value(cJSON_Arena *a, cJSON *item, const char *s) {
     s = skip_ws(s);
     if (!s) return NULL;
     if (*s == '"') {
         item->type = CJSON_STRING;
-        return parse_string_raw(s, &item->valuestring);
+        return parse_string_raw(a, s, &item->valuestring);
     }
-    if (*s == '[') return parse_array(item, skip_ws(s+1));
-    if (*s == '{') return parse_object(item, skip_ws(s+1));
+    if (*s == '[') return parse_array(a, item, skip_ws(s+1));
+    if (*s == '{') return parse_object(a, item, skip_ws(s+1));
     if (!strncmp(s,"true",4)){item->type=CJSON_BOOL;item->valuebool=1;item->valueint=1;return s+4;}
     if (!strncmp(s,"false",5)){item->type=CJSON_BOOL;item->valuebool=0;item->valueint=0;return s+5;}
     if (!strncmp(s,"null",4)){item->type=CJSON_NULL;return s+4;}
@@ -131,8 +242,24 @@ static const char *parse_value(cJSON *item, const char *s) {
 
 cJSON *cJSON_Parse(const char *json) {
     if (!json) return NULL;
-    cJSON *c = new_item();
-    if (!parse_value(c, skip_ws(json))) { cJSON_Delete(c); return NULL; }
+    /* The arena and the root share the first block */
+    size_t      cap = strlen(json) * 2 + ARENA_BLOCK_MIN;
+    cJSON_Arena boot = { NULL, cap < ARENA_BLOCK_MAX ? cap : ARENA_BLOCK_MAX, 1 };
+    cJSON_Arena *a   = arena_alloc(&boot, sizeof(*a), _Alignof(cJSON_Arena));
+    ArenaRoot   *r   = a ? arena_alloc(&boot, sizeof(*r), _Alignof(ArenaRoot)) : NULL;
+    if (!r) { free_blocks(boot.head, NULL); return NULL; }
+    *a = boot;
+    memset(r, 0, sizeof(*r));
+    r->item.arena = ARENA_ROOT;
+    r->arena      = a;
+    if (!parse_value(a, &r->item, skip_ws(json))) { cJSON_ArenaFree(a); return NULL; }
+    return &r->item;
+}
+
+cJSON *cJSON_ParseIn(cJSON_Arena *a, const char *json) {
+    if (!a || !json) return NULL;
+    cJSON *c = new_item(a);
+    if (!c || !parse_value(a, c, skip_ws(json))) return NULL;
     return c;
 }
 
@@ -170,12 +297,12 @@ int cJSON_GetBool(const cJSON *obj, const char *key, int def) {
 }
 
 /* ── Builder ──────────────────────────────────────────────────────────────── */
-cJSON *cJSON_CreateObject(void){cJSON*n=new_item();n->type=CJSON_OBJECT;return n;}
-cJSON *cJSON_CreateArray(void){cJSON*n=new_item();n->type=CJSON_ARRAY;return n;}
-cJSON *cJSON_CreateNull(void){cJSON*n=new_item();n->type=CJSON_NULL;return n;}
-cJSON *cJSON_CreateBool(int b){cJSON*n=new_item();n->type=CJSON_BOOL;n->valuebool=b;n->valueint=b;return n;}
-cJSON *cJSON_CreateNumber(double d){cJSON*n=new_item();n->type=CJSON_NUMBER;n->valuedouble=d;n->valueint=(int)d;return n;}
-cJSON *cJSON_CreateString(const char *s){cJSON*n=new_item();n->type=CJSON_STRING;n->valuestring=strdup(s?s:"");return n;}
+cJSON *cJSON_CreateObject(void){cJSON*n=new_item(NULL);n->type=CJSON_OBJECT;return n;}
+cJSON *cJSON_CreateArray(void){cJSON*n=new_item(NULL);n->type=CJSON_ARRAY;return n;}
+cJSON *cJSON_CreateNull(void){cJSON*n=new_item(NULL);n->type=CJSON_NULL;return n;}
+cJSON *cJSON_CreateBool(int b){cJSON*n=new_item(NULL);n->type=CJSON_BOOL;n->valuebool=b;n->valueint=b;return n;}
+cJSON *cJSON_CreateNumber(double d){cJSON*n=new_item(NULL);n->type=CJSON_NUMBER;n->valuedouble=d;n->valueint=(int)d;return n;}
+cJSON *cJSON_CreateString(const char *s){cJSON*n=new_item(NULL);n->type=CJSON_STRING;n->valuestring=strdup(s?s:"");return n;}
 
 /* O(1) tail-append for builder nodes.
  * Invariant: for any array/object built via cJSON_Add*, first_child->prev
@@ -199,7 +326,8 @@ static void attach_child(cJSON *parent, cJSON *child) {
 
 void cJSON_AddItemToObject(cJSON *obj, const char *key, cJSON *item) {
     if (!item) return;
-    free(item->string); item->string=strdup(key);
+    if (!item->arena) free(item->string);
+    item->string=strdup(key);
     attach_child(obj, item);
 }
 
@@ -17,14 +17,33 @@ typedef struct cJSON {
     int    valueint;
     double valuedouble;
     int    valuebool;
+    int    arena;     /* 0: malloc'd, else lives in a parse arena */
 } cJSON;
 
-/* Parse null-terminated JSON string. Returns root node or NULL. */
+/* Parse null-terminated JSON string. Returns root node or NULL.
+   The whole tree — nodes, keys and strings — is carved out of one or a few
+   large blocks, and cJSON_Delete() on the root frees them at once. Parsed
+   trees are read-only: don't add items to them or move their items into
+   another tree. */
 cJSON *cJSON_Parse(const char *json);
 
-/* Free a parsed tree. */
+/* Free a parsed tree (O(1)) or a built one. Items inside a parsed tree
+   are left alone. */
 void cJSON_Delete(cJSON *item);
 
+/* ── Parse arenas ────────────────────────────────────────────────────────────
+   For a caller parsing one document after another (incoming messages):
+   trees parsed into an arena stay valid until it is reset, and a reset
+   keeps a block of up to 64 KB for the next one, so small documents parse
+   without touching malloc at all. cJSON_Delete() is a no-op on them. An
+   arena must not be used from two threads at once. */
+typedef struct cJSON_Arena cJSON_Arena;
+
+cJSON_Arena *cJSON_ArenaNew(void);
+cJSON       *cJSON_ParseIn(cJSON_Arena *a, const char *json);
+void         cJSON_ArenaReset(cJSON_Arena *a);
+void         cJSON_ArenaFree(cJSON_Arena *a);
+
 /* Object access. */
 cJSON *cJSON_GetObjectItem(const cJSON *obj, const char *key);
 
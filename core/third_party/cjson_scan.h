@@ -0,0 +1,116 @@
+/* Byte scanners for the cJSON parser: SSE2 on x86-64, NEON on ARM, plain
+   C elsewhere or when built with CJSON_NO_SIMD. Internal to cjson.c; the
+   plain versions are always defined so bench_json can hold one against the
+   other. */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(CJSON_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CJSON_SIMD "sse2"
+#define CJSON_SSE2 1
+#elif !defined(CJSON_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CJSON_SIMD "neon"
+#define CJSON_NEON 1
+#else
+#define CJSON_SIMD "scalar"
+#endif
+
+/* First '"', '\\' or NUL at or after s */
+static inline const char *cjson_scan_str_scalar(const char *s) {
+    while (*s && *s != '"' && *s != '\\') s++;
+    return s;
+}
+
+/* First byte at or after s that is not whitespace (0x01..0x20, as the
+   parser has always taken it); NUL stops too */
+static inline const char *cjson_skip_ws_scalar(const char *s) {
+    while (*s && (unsigned char)*s <= ' ') s++;
+    return s;
+}
+
+#if defined(CJSON_SSE2) || defined(CJSON_NEON)
+
+/* 16 bytes at a time from the aligned block holding s. Aligned loads never
+ * cross into the next page, so reading past the terminator cannot fault,
+ * but ASan would flag the bytes outside the string: not instrumented. */
+#if defined(__GNUC__)
+#define CJSON_NO_ASAN __attribute__((no_sanitize_address))
+#else
+#define CJSON_NO_ASAN
+#endif
+
+#if defined(CJSON_SSE2)
+
+#define CJSON_MASK_SHIFT 0             /* mask bits per byte: 1 */
+
+CJSON_NO_ASAN static inline uint64_t cjson_str_stops(const char *p) {
+    __m128i v = _mm_load_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                          _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                             _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return (uint64_t)(unsigned)_mm_movemask_epi8(m);
+}
+
+CJSON_NO_ASAN static inline uint64_t cjson_ws_stops(const char *p) {
+    __m128i v  = _mm_load_si128((const __m128i *)p);
+    __m128i ws = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_setzero_si128()),
+                                  _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(' ')), v));
+    return ~(uint64_t)(unsigned)_mm_movemask_epi8(ws) & 0xffff;
+}
+
+#else
+
+#define CJSON_MASK_SHIFT 2             /* mask bits per byte: 4 */
+
+/* Compare result (0x00/0xff per byte) to 4 bits per byte */
+static inline uint64_t cjson_neon_mask(uint8x16_t m) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+CJSON_NO_ASAN static inline uint64_t cjson_str_stops(const char *p) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p);
+    uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')),
+                                     vceqq_u8(v, vdupq_n_u8('\\'))),
+                            vceqq_u8(v, vdupq_n_u8(0)));
+    return cjson_neon_mask(m);
+}
+
+CJSON_NO_ASAN static inline uint64_t cjson_ws_stops(const char *p) {
+    uint8x16_t v  = vld1q_u8((const uint8_t *)p);
+    uint8x16_t ws = vandq_u8(vcleq_u8(v, vdupq_n_u8(' ')), vtstq_u8(v, v));
+    return cjson_neon_mask(vmvnq_u8(ws));
+}
+
+#endif
+
+CJSON_NO_ASAN static inline const char *cjson_scan_str(const char *s) {
+    size_t      mis = (uintptr_t)s & 15;
+    const char *p   = s - mis;
+    uint64_t    m   = cjson_str_stops(p) >> (mis << CJSON_MASK_SHIFT);
+    if (m) return s + (__builtin_ctzll(m) >> CJSON_MASK_SHIFT);
+    for (;;) {
+        p += 16;
+        if ((m = cjson_str_stops(p))) return p + (__builtin_ctzll(m) >> CJSON_MASK_SHIFT);
+    }
+}
+
+CJSON_NO_ASAN static inline const char *cjson_skip_ws(const char *s) {
+    size_t      mis = (uintptr_t)s & 15;
+    const char *p   = s - mis;
+    uint64_t    m   = cjson_ws_stops(p) >> (mis << CJSON_MASK_SHIFT);
+    if (m) return s + (__builtin_ctzll(m) >> CJSON_MASK_SHIFT);
+    for (;;) {
+        p += 16;
+        if ((m = cjson_ws_stops(p))) return p + (__builtin_ctzll(m) >> CJSON_MASK_SHIFT);
+    }
+}
+
+#else
+
+#define cjson_scan_str cjson_scan_str_scalar
+#define cjson_skip_ws  cjson_skip_ws_scalar
+
+#endif